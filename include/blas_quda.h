@@ -14,8 +14,8 @@ namespace quda {
   void setBlasTuning(QudaTune tune, QudaVerbosity verbose);
   void setBlasParam(int kernel, int prec, int threads, int blocks);
 
-  extern unsigned long long blas_flops;
-  extern unsigned long long blas_bytes;
+  extern COMM_RANK_LOCAL unsigned long long blas_flops;
+  extern COMM_RANK_LOCAL unsigned long long blas_bytes;
 }
 
 
@@ -44,6 +44,9 @@ void mxpyCuda(cudaColorSpinorField &x, cudaColorSpinorField &y);
 
 void axpyZpbxCuda(const double &a, cudaColorSpinorField &x, cudaColorSpinorField &y, cudaColorSpinorField &z, const double &b);
 void axpyBzpcxCuda(const double &a, cudaColorSpinorField& x, cudaColorSpinorField& y, const double &b, cudaColorSpinorField& z, const double &c); 
+// x[j] += a[j]*p[j]; p[j] = b[j]*r + c[j]*p[j] for each of nShift shifts, in one pass over r
+void multiShiftAxpyBzpcxCuda(const double *a, cudaColorSpinorField **p, cudaColorSpinorField **x,
+			     const double *b, cudaColorSpinorField &r, const double *c, int nShift);
 
 void caxpbyCuda(const quda::Complex &a, cudaColorSpinorField &x, const quda::Complex &b, cudaColorSpinorField &y);
 void caxpyCuda(const quda::Complex &a, cudaColorSpinorField &x, cudaColorSpinorField &y);
@@ -89,6 +92,8 @@ void axpyZpbxCpu(const double &a, cpuColorSpinorField &x, cpuColorSpinorField &y
 		 const cpuColorSpinorField &z, const double &b);
 void axpyBzpcxCpu(const double &a, cpuColorSpinorField& x, cpuColorSpinorField& y,
 		  const double &b, const cpuColorSpinorField& z, const double &c); 
+void multiShiftAxpyBzpcxCpu(const double *a, cpuColorSpinorField **p, cpuColorSpinorField **x,
+			    const double *b, const cpuColorSpinorField &r, const double *c, int nShift);
 
 void caxpbyCpu(const quda::Complex &a, const cpuColorSpinorField &x, const quda::Complex &b, cpuColorSpinorField &y);
 void caxpyCpu(const quda::Complex &a, const cpuColorSpinorField &x, cpuColorSpinorField &y);
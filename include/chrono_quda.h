@@ -0,0 +1,28 @@
+#ifndef _CHRONO_QUDA_H
+#define _CHRONO_QUDA_H
+
+#include <dirac_quda.h>
+#include <color_spinor_field.h>
+
+// Chronological initial guesses for a sequence of solves whose
+// operator changes slowly from one solve to the next, as along a
+// molecular-dynamics trajectory.  The last few solutions of the
+// operator identified by a tag are kept on the device, and the guess
+// for the next solve is the combination of them that minimizes the
+// residual (minimal residual extrapolation, Brower et al.,
+// hep-lat/9509012): with a hermitian operator in the norm of its
+// inverse, from the projection of the operator onto their span,
+// otherwise in the 2-norm, by least squares.  See chrono_window and
+// chrono_tag in QudaInvertParam and flushChronoQuda() in quda.h.
+
+// Sets x to the guess for mat x = b from the solutions kept for tag,
+// leaving it as it is if there are none.  Applies mat once per
+// solution kept; returns the number of solutions used.
+int chronoGuess(int tag, const DiracMatrix &mat, bool hermitian, cudaColorSpinorField &x,
+		cudaColorSpinorField &b);
+
+// Keeps a copy of the solution x for tag, discarding the oldest if
+// window solutions are already kept.
+void chronoSave(int tag, int window, const cudaColorSpinorField &x);
+
+#endif // _CHRONO_QUDA_H
@@ -96,6 +96,11 @@ class ColorSpinorParam {
     } else if (inv_param.dirac_order == QUDA_DIRAC_ORDER) {
       fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
       siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+    } else if (inv_param.dirac_order == QUDA_LEX_DIRAC_ORDER) {
+      fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+      // a single parity is in lexicographic order already
+      siteOrder = (siteSubset == QUDA_FULL_SITE_SUBSET) ? 
+	QUDA_LEXICOGRAPHIC_SITE_ORDER : QUDA_EVEN_ODD_SITE_ORDER;
     } else {
       errorQuda("Dirac order %d not supported", inv_param.dirac_order);
     }
@@ -258,15 +263,16 @@ class cudaColorSpinorField : public ColorSpinorField {
   bool init;
   bool reference; // whether the field is a reference or not
 
-  static void *buffer_h;// pinned memory
-  static void *buffer_d;// device_mapped pointer to buffer
-  static bool bufferInit;
-  static size_t bufferBytes;
+  // the shared buffers are per rank (see COMM_RANK_LOCAL)
+  static COMM_RANK_LOCAL void *buffer_h;// pinned memory
+  static COMM_RANK_LOCAL void *buffer_d;// device_mapped pointer to buffer
+  static COMM_RANK_LOCAL bool bufferInit;
+  static COMM_RANK_LOCAL size_t bufferBytes;
 
-  static void* fwdGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
-  static void* backGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
-  static int initGhostFaceBuffer;
-  static QudaPrecision facePrecision;
+  static COMM_RANK_LOCAL void* fwdGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
+  static COMM_RANK_LOCAL void* backGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
+  static COMM_RANK_LOCAL int initGhostFaceBuffer;
+  static COMM_RANK_LOCAL QudaPrecision facePrecision;
 
   void create(const QudaFieldCreate);
   void destroy();
@@ -310,6 +316,13 @@ class cudaColorSpinorField : public ColorSpinorField {
 
   void zero();
 
+  // raw copies of the device storage (the elements, followed by the
+  // norms for half precision) to and from BackupBytes() of host
+  // memory, e.g., for checkpointing a solver
+  size_t BackupBytes() const;
+  void backup(void *host) const;
+  void restore(const void *host);
+
   friend std::ostream& operator<<(std::ostream &out, const cudaColorSpinorField &);
 };
 
@@ -329,11 +342,12 @@ class cpuColorSpinorField : public ColorSpinorField {
   template <typename Float> friend class QOPDomainWallOrder;
 
  public:
-  static void* fwdGhostFaceBuffer[QUDA_MAX_DIM]; //cpu memory
-  static void* backGhostFaceBuffer[QUDA_MAX_DIM]; //cpu memory
-  static void* fwdGhostFaceSendBuffer[QUDA_MAX_DIM]; //cpu memory
-  static void* backGhostFaceSendBuffer[QUDA_MAX_DIM]; //cpu memory
-  static int initGhostFaceBuffer;
+  // per rank (see COMM_RANK_LOCAL)
+  static COMM_RANK_LOCAL void* fwdGhostFaceBuffer[QUDA_MAX_DIM]; //cpu memory
+  static COMM_RANK_LOCAL void* backGhostFaceBuffer[QUDA_MAX_DIM]; //cpu memory
+  static COMM_RANK_LOCAL void* fwdGhostFaceSendBuffer[QUDA_MAX_DIM]; //cpu memory
+  static COMM_RANK_LOCAL void* backGhostFaceSendBuffer[QUDA_MAX_DIM]; //cpu memory
+  static COMM_RANK_LOCAL int initGhostFaceBuffer;
 
  private:
   void *v; // the field elements
@@ -377,6 +391,12 @@ class cpuColorSpinorField : public ColorSpinorField {
   void* V() { return v; }
   const void * V() const { return v; }
 
+  // element accessors valid for any field order (see color_spinor_field_order.h)
+  ColorSpinorFieldOrder<double>& OrderDouble() { return *order_double; }
+  const ColorSpinorFieldOrder<double>& OrderDouble() const { return *order_double; }
+  ColorSpinorFieldOrder<float>& OrderSingle() { return *order_single; }
+  const ColorSpinorFieldOrder<float>& OrderSingle() const { return *order_single; }
+
   void copy(const cpuColorSpinorField&);
   void zero();
 };
@@ -22,6 +22,26 @@ class ColorSpinorFieldOrder {
   int Nspin() const { return field.Nspin(); }
   int Volume() const { return field.Volume(); }
 
+  // storage index of the site with even-odd index x, so that fields
+  // with different site orders can be traversed together
+  int SiteIndex(const int &x) const {
+    if (field.SiteSubset() != QUDA_FULL_SITE_SUBSET) return x;
+    int half = field.Volume()/2;
+    if (field.SiteOrder() == QUDA_ODD_EVEN_SITE_ORDER) {
+      return x < half ? x + half : x - half;
+    } else if (field.SiteOrder() == QUDA_LEXICOGRAPHIC_SITE_ORDER) {
+      // lex = 2*cb + x0%2, where x0 follows from the parity
+      int parity = x / half, cb = x - parity*half;
+      int rest = cb / (field.X(0)/2), sum = parity;
+      for (int d=1; d<field.Ndim(); d++) {
+	sum += rest % field.X(d);
+	rest /= field.X(d);
+      }
+      return 2*cb + (sum & 1);
+    }
+    return x;
+  }
+
 };
 
 template <typename Float>
@@ -87,14 +107,14 @@ class QOPDomainWallOrder : public ColorSpinorFieldOrder<Float> {
   virtual ~QOPDomainWallOrder() { ; }
 
   const Float& operator()(const int &x, const int &s, const int &c, const int &z) const {
-    int ls = x / Ls;
+    int ls = x / volume_4d;
     int x_4d = x - ls*volume_4d;
     unsigned long index_4d = ((x_4d*field.nColor+c)*field.nSpin+s)*2+z;
     return ((Float**)(field.v))[ls][index_4d];
   }
 
   Float& operator()(const int &x, const int &s, const int &c, const int &z) {
-    int ls = x / Ls;
+    int ls = x / volume_4d;
     int x_4d = x - ls*volume_4d;
     unsigned long index_4d = ((x_4d*field.nColor+c)*field.nSpin+s)*2+z;
     return ((Float**)(field.v))[ls][index_4d];
@@ -17,6 +17,24 @@ extern "C" {
 #define Z_FWD_NBR  7
 #define T_FWD_NBR  8
 
+#ifdef THREAD_COMMS
+/* With the threaded backend each rank is a thread in one process, so
+   file-scope state that belongs to a rank must be thread-local. */
+#define COMM_RANK_LOCAL __thread
+
+/* Stand-in for MPI_Request so that face_mpi.cpp builds unchanged on
+   top of comm_thread.cpp. */
+typedef struct comm_thread_request_s {
+  void *buf;
+  int len;
+  int src;
+  int tag;
+  int pending;
+} MPI_Request;
+#else
+#define COMM_RANK_LOCAL
+#endif
+
 /* The following routines are implemented over MPI only. */
 
 void            comm_set_gridsize(int x, int y, int z, int t);
@@ -50,6 +68,12 @@ void		comm_exit(int);
 char *          comm_hostname(void);
 int		comm_rank(void);
 void            comm_broadcast(void *data, size_t nbytes);
+
+#ifdef THREAD_COMMS
+/* threaded backend only: run main_fn on nranks threads, one per rank */
+int             comm_thread_launch(int nranks, int (*main_fn)(int, char**),
+				   int argc, char **argv);
+#endif
   
 #ifdef __cplusplus
 }
@@ -0,0 +1,129 @@
+#ifndef _CPU_RECONSTRUCT_H
+#define _CPU_RECONSTRUCT_H
+
+#include <math.h>
+#include <enum_quda.h>
+
+// Compressed storage of gauge links on the host, using the same
+// formats as the device fields (see lib/pack_gauge.h and
+// lib/read_gauge.h):
+//
+//   12 reals: the first two rows; the third row is u0 * (row0 x row1)^*
+//    8 reals: arg(U00), arg(U20), U01, U02, U10; the remaining elements
+//             follow from the rows having norm 1/|u0|
+//
+// The scale u0 accounts for what makes a stored link differ from an
+// SU(3) matrix: the anisotropy and the temporal boundary condition
+// for Wilson links, or the long-link coefficient times the staggered
+// phase for long links.  cpuGaugeField::LinkScale() returns it for a
+// given link.
+
+template <typename Float>
+inline void packLink(Float *r, const Float *U, const QudaReconstructType reconstruct) {
+  if (reconstruct == QUDA_RECONSTRUCT_8) {
+    r[0] = atan2(U[1], U[0]);
+    r[1] = atan2(U[13], U[12]);
+    for (int i=2; i<8; i++) r[i] = U[i];
+  } else {
+    for (int i=0; i<reconstruct; i++) r[i] = U[i];
+  }
+}
+
+// a = conj(b)*c
+template <typename Float>
+inline void cpuComplexDotProduct(Float *a, const Float *b, const Float *c) {
+  a[0] = b[0]*c[0] + b[1]*c[1];
+  a[1] = b[0]*c[1] - b[1]*c[0];
+}
+
+// a = conj(b)*conj(c)
+template <typename Float>
+inline void cpuComplexConjugateProduct(Float *a, const Float *b, const Float *c) {
+  a[0] = b[0]*c[0] - b[1]*c[1];
+  a[1] = -b[0]*c[1] - b[1]*c[0];
+}
+
+// a += sign*b*c
+template <typename Float>
+inline void cpuAccumulateComplexProduct(Float *a, const Float *b, const Float *c, Float sign) {
+  a[0] += sign*(b[0]*c[0] - b[1]*c[1]);
+  a[1] += sign*(b[0]*c[1] + b[1]*c[0]);
+}
+
+// 48 flops
+template <typename Float>
+inline void reconstructLink12(Float *U, const Float *r, const Float u0) {
+  for (int i=0; i<12; i++) U[i] = r[i];
+  const Float *u = U, *v = U + 6;
+  Float *w = U + 12;
+  for (int c=0; c<3; c++) {
+    int a = (c+1)%3, b = (c+2)%3;
+    // w_c = u0 * (u_a v_b - u_b v_a)^*
+    w[2*c+0] = u0*( (u[2*a]*v[2*b] - u[2*a+1]*v[2*b+1]) - (u[2*b]*v[2*a] - u[2*b+1]*v[2*a+1]));
+    w[2*c+1] = -u0*( (u[2*a]*v[2*b+1] + u[2*a+1]*v[2*b]) - (u[2*b]*v[2*a+1] + u[2*b+1]*v[2*a]));
+  }
+}
+
+template <typename Float>
+inline void reconstructLink8(Float *U, const Float *r, const Float u0) {
+  for (int i=2; i<8; i++) U[i] = r[i];
+
+  // first row
+  Float row_sum = U[2]*U[2] + U[3]*U[3] + U[4]*U[4] + U[5]*U[5];
+  Float diff = 1.0/(u0*u0) - row_sum;
+  Float U00_mag = sqrt(diff >= 0 ? diff : 0.0);
+  U[0] = U00_mag * cos(r[0]);
+  U[1] = U00_mag * sin(r[0]);
+
+  // first column
+  Float column_sum = U[0]*U[0] + U[1]*U[1] + U[6]*U[6] + U[7]*U[7];
+  diff = 1.0/(u0*u0) - column_sum;
+  Float U20_mag = sqrt(diff >= 0 ? diff : 0.0);
+  U[12] = U20_mag * cos(r[1]);
+  U[13] = U20_mag * sin(r[1]);
+
+  // the rest from the SU(2) rotation
+  Float r_inv2 = 1.0/(u0*row_sum);
+  Float A[2];
+
+  cpuComplexDotProduct(A, U+0, U+6);
+  cpuComplexConjugateProduct(U+8, U+12, U+4);
+  cpuAccumulateComplexProduct(U+8, A, U+2, u0);
+  U[8] *= -r_inv2;
+  U[9] *= -r_inv2;
+
+  cpuComplexConjugateProduct(U+10, U+12, U+2);
+  cpuAccumulateComplexProduct(U+10, A, U+4, -u0);
+  U[10] *= r_inv2;
+  U[11] *= r_inv2;
+
+  cpuComplexDotProduct(A, U+0, U+12);
+  cpuComplexConjugateProduct(U+14, U+6, U+4);
+  cpuAccumulateComplexProduct(U+14, A, U+2, -u0);
+  U[14] *= r_inv2;
+  U[15] *= r_inv2;
+
+  cpuComplexConjugateProduct(U+16, U+6, U+2);
+  cpuAccumulateComplexProduct(U+16, A, U+4, u0);
+  U[16] *= -r_inv2;
+  U[17] *= -r_inv2;
+}
+
+// Returns a pointer to the full link stored at r: r itself when the
+// link is uncompressed, otherwise tmp (18 reals) holding the
+// reconstructed link.
+template <typename Float>
+inline const Float* loadLink(Float *tmp, const Float *r, const QudaReconstructType reconstruct, const Float u0) {
+  switch (reconstruct) {
+  case QUDA_RECONSTRUCT_12:
+    reconstructLink12(tmp, r, u0);
+    return tmp;
+  case QUDA_RECONSTRUCT_8:
+    reconstructLink8(tmp, r, u0);
+    return tmp;
+  default:
+    return r;
+  }
+}
+
+#endif // _CPU_RECONSTRUCT_H
@@ -28,6 +28,7 @@ extern "C" {
     QUDA_QDP_GAUGE_ORDER, // expect *gauge[4], even-odd, row-column color
     QUDA_CPS_WILSON_GAUGE_ORDER, // expect *gauge, even-odd, mu inside, column-row color
     QUDA_MILC_GAUGE_ORDER, // expect *gauge, even-odd, mu inside, row-column order
+    QUDA_QDP_LEX_GAUGE_ORDER, // expect *gauge[4], lexicographic, row-column color
     QUDA_INVALID_GAUGE_ORDER = QUDA_INVALID_ENUM
   } QudaGaugeFieldOrder;
 
@@ -182,6 +183,16 @@ extern "C" {
     QUDA_INVALID_PARITY = QUDA_INVALID_ENUM
   } QudaParity;
 
+  //
+  // Type used for the file format of writeSolutionAsyncQuda()
+  //
+
+  typedef enum QudaFileFormat_s {
+    QUDA_LIME_FILE_FORMAT, // SciDAC (LIME) file shared by all ranks
+    QUDA_RAW_FILE_FORMAT,  // one file per rank, with a header locating its block
+    QUDA_INVALID_FILE_FORMAT = QUDA_INVALID_ENUM
+  } QudaFileFormat;
+
   //  
   // Types used only internally
   //
@@ -290,6 +301,13 @@ extern "C" {
     QUDA_FAT_PRESERVE_COMM_MEM=4,
   }QudaFatLinkFlag;
 
+  typedef enum QudaLinkSmearType_s {
+    QUDA_APE_SMEAR,
+    QUDA_STOUT_SMEAR,
+    QUDA_HYP_SMEAR,
+    QUDA_INVALID_SMEAR = QUDA_INVALID_ENUM
+  } QudaLinkSmearType;
+
   typedef enum QudaFieldGeometry_s {
     QUDA_SCALAR_GEOMETRY,
     QUDA_VECTOR_GEOMETRY,
@@ -297,6 +315,13 @@ extern "C" {
     QUDA_INVALID_GEOMETRY
   } QudaFieldGeometry;
 
+  typedef enum QudaSolverEventType_s {
+    QUDA_SOLVER_ITERATION,        // an iteration, with the iterated residual
+    QUDA_SOLVER_RELIABLE_UPDATE,  // a reliable update or restart, with the true residual
+    QUDA_SOLVER_DONE,             // the end of the solve, with the final iterated residual
+    QUDA_INVALID_SOLVER_EVENT = QUDA_INVALID_ENUM
+  } QudaSolverEventType;
+
 #ifdef __cplusplus
 }
 #endif
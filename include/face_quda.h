@@ -69,6 +69,9 @@ class FaceBuffer {
   int  commsQuery(int dir);
   void scatter(cudaColorSpinorField &out, int dagger, int dir);
 
+  // the size of one (uncompressed) message in a given dimension
+  size_t MessageBytes(int dim) const { return nbytes[dim]; }
+
   void exchangeCpuSpinor(cpuColorSpinorField &in, int parity, int dagger);
 
   void exchangeCpuLink(void** ghost_link, void** link_sendbuf);
@@ -123,10 +126,19 @@ class FaceBuffer {
   void* pageable_fwd_nbr_spinor[QUDA_MAX_DIM];
   void* pageable_back_nbr_spinor[QUDA_MAX_DIM];
   
+  // wire buffers used when compressSpinorHalo is set (allocated on first use)
+  void* compressed_fwd_nbr_spinor_sendbuf[QUDA_MAX_DIM];
+  void* compressed_back_nbr_spinor_sendbuf[QUDA_MAX_DIM];
+  void* compressed_fwd_nbr_spinor[QUDA_MAX_DIM];
+  void* compressed_back_nbr_spinor[QUDA_MAX_DIM];
+  size_t compressed_nbytes[QUDA_MAX_DIM];
+
   void* recv_request1[QUDA_MAX_DIM], *recv_request2[QUDA_MAX_DIM];
   void* send_request1[QUDA_MAX_DIM], *send_request2[QUDA_MAX_DIM];
   
   void setupDims(const int *X);
+  bool compressFaces() const;
+  void allocateCompressedBuffers();
   
  public:
   FaceBuffer(const int *X, const int nDim, const int Ninternal,
@@ -140,6 +152,9 @@ class FaceBuffer {
   int  commsQuery(int dir);
   void scatter(cudaColorSpinorField &out, int dagger, int dir);
 
+  // the size of one (uncompressed) message in a given dimension
+  size_t MessageBytes(int dim) const { return nbytes[dim]; }
+
   void exchangeCpuSpinor(cpuColorSpinorField &in, int parity, int dagger);
 
   void exchangeCpuLink(void** ghost_link, void** link_sendbuf);
@@ -175,12 +190,17 @@ extern "C" {
 #ifdef __cplusplus
 extern "C" {
 #endif
-  extern bool globalReduce;
+  extern COMM_RANK_LOCAL bool globalReduce;
 
   void reduceMaxDouble(double &);
   void reduceDouble(double &);
   void reduceDoubleArray(double *, const int len);
 
+  // halo compression, see face_compress.cpp
+  extern bool compressSpinorHalo;
+  extern bool compressLinkHalo;
+  void setHaloCompression(const char *type); // "none", "spinor", "link" or "all"
+
 #ifdef MULTI_GPU
   int commDim(int);
   int commCoords(int);
@@ -197,4 +217,12 @@ extern "C" {
 }
 #endif
 
+size_t spinorFaceWireBytes(int nBlocks, int blockLength);
+size_t compressSpinorFace(void *wire, const void *face, int nBlocks, int blockLength, QudaPrecision precision);
+void decompressSpinorFace(void *face, const void *wire, int nBlocks, int blockLength, QudaPrecision precision);
+
+size_t linkFaceWireBytes(int nLinks, QudaPrecision precision);
+size_t compressLinkFace(void *wire, const void *links, int nLinks, QudaPrecision precision);
+void decompressLinkFace(void *links, const void *wire, int nLinks, QudaPrecision precision);
+
 #endif // _FACE_QUDA_H
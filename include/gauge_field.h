@@ -114,6 +114,9 @@ class GaugeField : public LatticeField {
 
   void checkField(const GaugeField &);
 
+  // fills param with the parameters of this field (the data pointer is left untouched)
+  void fill(GaugeFieldParam &param) const;
+
   const size_t& Bytes() const { return bytes; }
 
 };
@@ -174,14 +177,35 @@ class cpuGaugeField : public GaugeField {
 
   mutable void **ghost; // stores the ghost zone of the gauge field
   int pinned;
+
+  int version; // incremented whenever the links are modified
+  mutable int ghost_version; // version of the links the ghost zone was built from (-1 if never)
+  mutable void *ghost_send[QUDA_MAX_DIM]; // packed faces sent to the neighbors
+  mutable int *ghost_index[QUDA_MAX_DIM]; // source site of each packed face site
   
  public:
   cpuGaugeField(const GaugeFieldParam &);
   virtual ~cpuGaugeField();
 
+  // fills the ghost zone; does nothing if the links are unchanged since the last call
   void exchangeGhost() const;
   const void** Ghost() const { return (const void**)ghost; }
 
+  // must be called after writing to the links through Gauge_p() or a
+  // reference pointer, so that the next exchangeGhost() refreshes the ghost zone
+  void markModified() { version++; }
+  int Version() const { return version; }
+
+  // For 12 and 8 reconstruction: loadLinks() compresses full (18 real)
+  // QDP-ordered links into this field, saveLinks() expands them again.
+  // See cpu_reconstruct.h for the storage formats.
+  void loadLinks(void **links);
+  void saveLinks(void **links) const;
+
+  // the scale u0 of the third row of the link in dimension dim at
+  // local coordinates x (x[dim] may be negative for ghost links)
+  double LinkScale(const int dim, const int *x) const;
+
   void* Gauge_p() { return gauge; }
   void setGauge(void** _gauge); //only allowed when create== QUDA_REFERENCE_FIELD_CREATE
 };
@@ -0,0 +1,15 @@
+#ifndef _GAUGE_IO_H
+#define _GAUGE_IO_H
+
+#include <quda.h>
+
+// Reads a gauge configuration like readGaugeFileQuda(), storing the
+// average plaquette in *plaquette, but returns false rather than
+// failing when the checksum or the plaquette recorded in the file
+// disagrees with the data; the mismatch is reported with
+// warningQuda().  Malformed files are still errors.  See
+// lib/gauge_io.cpp.
+
+bool readGaugeFile(void *h_gauge, QudaGaugeParam *param, const char *filename, double *plaquette);
+
+#endif // _GAUGE_IO_H
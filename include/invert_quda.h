@@ -38,10 +38,6 @@ class BiCGstab : public Solver {
   const DiracMatrix &matSloppy;
   const DiracMatrix &matPrecon;
 
-  // pointers to fields to avoid multiple creation overhead
-  cudaColorSpinorField *yp, *rp, *pp, *vp, *tmpp, *tp, *wp, *zp;
-  bool init;
-
  public:
   BiCGstab(DiracMatrix &mat, DiracMatrix &matSloppy, DiracMatrix &matPrecon,
 	   QudaInvertParam &invParam);
@@ -123,4 +119,19 @@ class MultiShiftCG : public MultiShiftSolver {
   void operator()(cudaColorSpinorField **out, cudaColorSpinorField &in);
 };
 
+// refines the solutions of a multi-shift solve, given in out, with a
+// batch of CGs, one per shift, that advance together
+class MultiShiftRefineCG : public MultiShiftSolver {
+
+ protected:
+  const DiracMatrix &mat;
+  const DiracMatrix &matSloppy;
+
+ public:
+  MultiShiftRefineCG(DiracMatrix &mat, DiracMatrix &matSloppy, QudaInvertParam &invParam);
+  virtual ~MultiShiftRefineCG();
+
+  void operator()(cudaColorSpinorField **out, cudaColorSpinorField &in);
+};
+
 #endif // _INVERT_QUDA_H
@@ -0,0 +1,54 @@
+#ifndef _MALLOC_QUDA_H
+#define _MALLOC_QUDA_H
+
+#include <stdlib.h>
+
+// Caching allocators for field storage.  Blocks released with
+// pool_device_free() or pool_host_free() are kept and handed out again
+// to the next request of exactly the same size, so that fields which
+// are repeatedly created and destroyed (solver temporaries, the
+// fields created by invertQuda() for each solve) do not go back to
+// cudaMalloc()/malloc() every time.  Since the size of a field is
+// determined by its dimensions, precision and pad, blocks are
+// effectively keyed on these.
+//
+// With NUMA affinity enabled, host blocks of 2 MB or more are mapped
+// with huge pages where available and first touched by the OpenMP
+// threads that will work on them, or by the calling thread without
+// host OpenMP (see lib/malloc_quda.cpp);
+// printPoolStats() then also reports on which NUMA nodes their pages
+// reside.  QUDA_ENABLE_HUGE_PAGES=0 in the environment turns off the
+// huge pages, but not the first-touch placement.
+//
+// Cached blocks are only returned to the system by trimPool(), which
+// is called by endQuda() and may be called by the application through
+// trimMemoryPoolQuda().  Setting QUDA_ENABLE_MEMORY_POOL=0 in the
+// environment disables caching.
+
+void *pool_device_malloc(size_t bytes);
+void pool_device_free(void *ptr);
+
+void *pool_host_malloc(size_t bytes);
+void pool_host_free(void *ptr);
+
+// release all cached blocks that are not in use
+void trimPool();
+
+void setPoolEnabled(bool enable);
+void setHostHugePages(bool enable);
+void printPoolStats();
+
+// the counters behind printPoolStats()
+struct PoolStats {
+  size_t live_bytes;    // in blocks handed out
+  size_t cached_bytes;  // in blocks kept for reuse
+  size_t cached_blocks;
+  size_t peak_bytes;    // of live plus cached
+  long hits;            // requests served from the cache
+  long misses;          // requests that allocated
+};
+
+PoolStats devicePoolStats();
+PoolStats hostPoolStats();
+
+#endif // _MALLOC_QUDA_H
@@ -0,0 +1,57 @@
+#ifndef _PARALLEL_IO_H
+#define _PARALLEL_IO_H
+
+#include <stdlib.h>
+
+// Partitioned I/O of lattice fields stored in a shared file.  The
+// file holds the global lattice of dimensions X in lexicographic
+// order (x running fastest), site_bytes per site, starting at byte
+// offset.  Each rank reads or writes only its own block of
+// dimensions L with origin start, stored in lexicographic order in
+// memory, so that no rank handles more than its share of the field.
+// The block must lie inside the lattice; blocks of different ranks
+// may have different shapes (e.g., faces of the sublattice).
+//
+// With MPI comms these are collective calls using MPI-IO; with the
+// threaded or QMP backends each row of the block is transferred with
+// pread()/pwrite().
+
+void readSublattice(void *block, const char *filename, size_t offset, size_t site_bytes,
+		    const int *X, const int *L, const int *start);
+void writeSublattice(const char *filename, size_t offset, const void *block, size_t site_bytes,
+		     const int *X, const int *L, const int *start);
+
+// With posix set, readSublattice() and writeSublattice() use
+// pread()/pwrite() even with MPI comms, e.g., on file systems without
+// MPI-IO support.  It must be set alike on all ranks.
+void setPosixSublatticeIO(bool posix);
+
+// Writes the block of this rank with pwrite(), without synchronizing
+// with the other ranks or using the OpenMP threads, so that it may be
+// called from a thread other than the one that drives the rank (see
+// lib/solution_writer.cpp).  The file must exist.  Returns false if
+// the write failed, rather than calling errorQuda() from that thread.
+bool writeSublatticeLocal(const char *filename, size_t offset, const void *block, size_t site_bytes,
+			  const int *X, const int *L, const int *start);
+
+// Rank 0 creates (or truncates) the file; all ranks return once it exists.
+void createSharedFile(const char *filename);
+
+// Rank 0 writes bytes at the start of the file; all ranks return once it is written.
+void writeSharedHeader(const char *filename, const void *header, size_t bytes);
+
+// Reads the first bytes of the file on every rank, returning the number read.
+size_t readSharedHeader(void *header, const char *filename, size_t bytes);
+
+// LIME files (ILDG configurations and SciDAC fields) are a sequence
+// of records, each a big-endian header of LIME_HEADER_BYTES followed
+// by the record data padded to a multiple of 8 bytes.
+#define LIME_MAGIC 0x456789ab
+#define LIME_HEADER_BYTES 144
+
+// The CRC-32 of zlib, from which the SciDAC checksums of LIME files
+// are formed; crc_table (256 entries) is filled by initCrcTable().
+void initCrcTable(unsigned int *crc_table);
+unsigned int scidacCrc32(const unsigned int *crc_table, const void *buf, size_t len);
+
+#endif // _PARALLEL_IO_H
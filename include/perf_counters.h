@@ -0,0 +1,36 @@
+#ifndef _PERF_COUNTERS_H
+#define _PERF_COUNTERS_H
+
+// Hardware performance counters, read with the Linux perf_event
+// interface, for telling whether a host kernel is limited by memory
+// bandwidth or latency (few instructions per cycle and many last-level
+// cache misses per flop) or by computation.  The counters count the
+// calling thread and, with HOST_OPENMP, the threads of its OpenMP
+// team, which are opened by perfCountersOpen(); with thread comms
+// every rank opens its own.
+//
+// Counting may be restricted by /proc/sys/kernel/perf_event_paranoid,
+// and not every processor (or virtual machine) has every event; an
+// event that cannot be opened reads as -1.  The last-level cache
+// misses are the lines moved from memory, so 64 bytes per miss
+// estimates the memory traffic.
+
+enum PerfCounter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_REFERENCES,
+  PERF_LLC_MISSES,
+  PERF_COUNTERS
+};
+
+const char* perfCounterName(PerfCounter counter);
+
+// opens the counters of the calling thread (and its OpenMP team),
+// returning false if none is available
+bool perfCountersOpen();
+void perfCountersClose();
+
+// the counts since perfCountersOpen(), summed over the threads
+void perfCountersRead(double count[PERF_COUNTERS]);
+
+#endif // _PERF_COUNTERS_H
@@ -0,0 +1,66 @@
+#ifndef _PROFILE_QUDA_H
+#define _PROFILE_QUDA_H
+
+#include <perf_counters.h>
+
+// A hierarchical profiler.  A ProfileRegion times the scope in which
+// it lives and charges the time, together with the flops and bytes
+// given to it, to a node named after the region under the innermost
+// enclosing region; for example, the dslash regions entered inside
+// invertQuda() are accumulated as invert/dslash/interior, etc.  Each
+// rank keeps its own tree, and printProfile(), which is collective
+// and called by endQuda(), prints the mean and maximum time over the
+// ranks of every node along with the achieved GB/s and GFLOP/s.
+//
+// The profiler is disabled unless QUDA_ENABLE_PROFILER=1 is set in
+// the environment, in which case the device is synchronized when a
+// region is entered and left, so that the time of asynchronous work
+// is charged to the region that launched it.  This serializes the
+// overlap of communication with computation in the dslash, so the
+// total time of a profiled run is longer than that of a normal run.
+//
+// The bytes are the compulsory traffic, i.e., every field read or
+// written is counted once, so the GB/s is a lower bound on the
+// bandwidth actually achieved.
+//
+// With QUDA_PROFILE_COUNTERS=1 set as well, the hardware counters of
+// perf_counters.h are read when a region is entered and left, and the
+// instructions per cycle, the last-level cache miss rate and the
+// bytes moved from memory per flop (64 bytes per miss) of every node
+// are printed too, which tells whether a host kernel is bound by
+// memory bandwidth or latency.  The counters count the host threads
+// only, so those of a device kernel are of the host waiting for it.
+//
+// The regions are also recorded by the event tracer if it is enabled
+// (see trace_quda.h), for which the name must be a string literal.
+
+class ProfileRegion {
+
+ private:
+  const char *name;
+  int node;
+  double start;
+  double count[PERF_COUNTERS]; // the hardware counters when the region was entered
+
+ public:
+  ProfileRegion(const char *name, long long flops=0, long long bytes=0);
+  ~ProfileRegion();
+
+  // charge additional work to this region
+  void add(long long flops, long long bytes);
+};
+
+// charge an interval that was timed elsewhere (e.g., a polled
+// message, with id its direction) to a child of the innermost region;
+// the times are those of traceClock()
+void profileRecord(const char *name, double start, double end, long long flops=0, long long bytes=0,
+		   int id=-1);
+
+void setProfilerEnabled(bool enable);
+bool profilerEnabled();
+void setProfilerCounters(bool enable);
+
+void printProfile();
+void resetProfile();
+
+#endif // _PROFILE_QUDA_H
@@ -87,6 +87,19 @@ extern "C" {
   } QudaGaugeParam;
 
 
+  /**
+   * An event recorded by the solver telemetry (see QudaInvertParam).
+   */
+  typedef struct QudaSolverEvent_s {
+    QudaSolverEventType type;
+    int iter;     /**< Iterations completed */
+    double r2;    /**< Squared norm of the (iterated or true) residual */
+    double time;  /**< Seconds since the start of the solve */
+  } QudaSolverEvent;
+
+  /** Called by the solver with every event it records */
+  typedef void (*QudaSolverCallback)(const QudaSolverEvent *event, void *arg);
+
   /**
    * Parameters relating to the solver and the choice of Dirac operator.
    */
@@ -119,6 +132,13 @@ extern "C" {
     /** Solver tolerance for each offset */
     double tol_offset[QUDA_MAX_MULTI_SHIFT];
 
+    /**
+     * Number of shifts that invertMultiShiftQudaMixed refines together,
+     * in one batched CG seeded from the sloppy solutions, each to its
+     * own tol_offset (0 or 1 = one shift at a time, each to tol)
+     */
+    int refine_batch;
+
     QudaSolutionType solution_type;  /**< Type of system to solve */
     QudaSolveType solve_type;        /**< How to solve it */
     QudaMatPCType matpc_type;
@@ -145,12 +165,30 @@ extern "C" {
     QudaCloverFieldOrder clover_order;
     QudaUseInitGuess use_init_guess;
 
+    /**
+     * Number of previous solutions, of the operator identified by
+     * chrono_tag, from which invertQuda extrapolates the initial guess
+     * (0 = none).  The guess replaces the one given by use_init_guess
+     * once a solution has been kept; see flushChronoQuda().
+     */
+    int chrono_window;
+    int chrono_tag;
+
     QudaVerbosity verbosity;    
 
     int sp_pad;
     int cl_pad;
 
     int iter;
+
+    /**
+     * Relative residuals, iterated and true, reached by the last
+     * solve.  The iterated one is that of the final telemetry event,
+     * sqrt(r2/|b|^2) for the source b of the solver.
+     */
+    double iter_res;
+    double true_res;
+
     double spinorGiB;
     double cloverGiB;
     double gflops;
@@ -197,6 +235,42 @@ extern "C" {
     /** Whether to use additive or multiplicative Schwarz preconditioning */
     QudaSchwarzType schwarz_type;
 
+    /**
+     * Iterations between checkpoints of the multi-shift solver, from
+     * which an interrupted solve resumes (0 = no checkpoints)
+     */
+    int checkpoint_interval;
+
+    /**
+     * Prefix of the checkpoint files, one per rank, preferably on
+     * node-local disk (see include/solver_checkpoint.h)
+     */
+    char checkpoint_path[256];
+
+    /**
+     * Ring buffer of telemetry_size events, owned by the caller, in
+     * which the solver records its iterations, reliable updates and
+     * end without any formatting or I/O (NULL = no buffer)
+     */
+    QudaSolverEvent *telemetry_buffer;
+    int telemetry_size;
+
+    /**
+     * Number of events recorded by the last solve, of which the last
+     * telemetry_size are in the buffer.  invertMultiShiftQudaMixed
+     * refines each shift, or each batch of refine_batch shifts, in a
+     * solve of its own, so afterwards the buffer and count cover only
+     * the refinement of the last one; the callback sees them all.
+     */
+    int telemetry_count;
+
+    /**
+     * Called with every event as it is recorded, on every rank, and
+     * given telemetry_arg (NULL = no callback)
+     */
+    QudaSolverCallback telemetry_callback;
+    void *telemetry_arg;
+
   } QudaInvertParam;
 
 
@@ -247,6 +321,17 @@ extern "C" {
    */
   void endQuda(void);
 
+  /**
+   * Return the memory cached for reuse by QUDA's fields to the system.
+   * Fields created and destroyed by the library (e.g., solver
+   * temporaries) keep their storage in a pool so that subsequent
+   * solves need not allocate it again; call this to release that
+   * storage, for example before allocating device memory elsewhere in
+   * the application.  Set QUDA_ENABLE_MEMORY_POOL=0 in the
+   * environment to disable the pool.
+   */
+  void trimMemoryPoolQuda(void);
+
   /**
    * A new QudaGaugeParam should always be initialized immediately
    * after it's defined (and prior to explicitly setting its members)
@@ -280,6 +365,89 @@ extern "C" {
    */
   void loadGaugeQuda(void *h_gauge, QudaGaugeParam *param);
 
+  /**
+   * Read a gauge configuration in NERSC, ILDG or MILC format, which
+   * is recognized from the file header, into h_gauge.  Each rank
+   * reads its own sublattice of dimensions param->X, stored in the
+   * order and precision given by param->gauge_order (QDP, QDP_LEX or
+   * MILC) and param->cpu_prec.  The checksum and, for NERSC files,
+   * the plaquette recorded in the file are verified.
+   *
+   * @return The average plaquette, Re tr(U_p)/3
+   */
+  double readGaugeFileQuda(void *h_gauge, QudaGaugeParam *param, const char *filename);
+
+  /**
+   * Write a gauge configuration in NERSC format (3x3 links, big
+   * endian, in the precision param->cpu_prec), with each rank
+   * writing its own sublattice h_gauge into the shared file.
+   */
+  void writeGaugeFileQuda(void *h_gauge, QudaGaugeParam *param, const char *filename);
+
+  /**
+   * Write a full spinor field, given in the order and precision of
+   * param->dirac_order and param->cpu_prec on a sublattice of
+   * dimensions X, with each rank writing its own sublattice into
+   * the shared file.  See lib/spinor_io.cpp for the file format.
+   */
+  void writeSpinorFileQuda(void *h_spinor, QudaInvertParam *param, const int *X, const char *filename);
+
+  /**
+   * Read a full spinor field written by writeSpinorFileQuda(), with
+   * each rank reading its own sublattice, and verify its checksum.
+   */
+  void readSpinorFileQuda(void *h_spinor, QudaInvertParam *param, const int *X, const char *filename);
+
+  /**
+   * Write n_field full spinor fields (e.g., the 12 spin-color
+   * components of a propagator) to one file, in the format of
+   * writeSpinorFileQuda() with the fields interleaved by site.  With
+   * bits = 16 or 8 each field is stored at each site as a float norm
+   * plus 16- or 8-bit fixed-point mantissas, as in half-precision
+   * device fields, which cuts the size of double-precision data by
+   * about 3.7x or 6.9x; bits = 0 stores the fields uncompressed.  If
+   * max_error > 0, the write fails unless the largest rounding error,
+   * relative to the norm of its site, is within max_error.
+   */
+  void writePropagatorFileQuda(void **h_prop, int n_field, QudaInvertParam *param, const int *X,
+			       const char *filename, int bits, double max_error);
+
+  /**
+   * Read n_field spinor fields written by writePropagatorFileQuda()
+   * (or, with n_field = 1, by writeSpinorFileQuda()), decompressing
+   * them into the order and precision given by param.
+   */
+  void readPropagatorFileQuda(void **h_prop, int n_field, QudaInvertParam *param, const int *X,
+			      const char *filename);
+
+  /**
+   * Queue a full solution field, given as for writeSpinorFileQuda(),
+   * to be written to filename by a background thread, so that the
+   * output overlaps with the next solve.  The call returns as soon as
+   * the field has been copied into one of a fixed number of host
+   * buffers (QUDA_SOLUTION_WRITER_BUFFERS, default 2); if all of them
+   * are still being written it waits for one to become free.  It must
+   * be called by all ranks.  See lib/solution_writer.cpp for the
+   * formats.  A failed write is reported by the next call or by
+   * flushSolutionWriterQuda().
+   */
+  void writeSolutionAsyncQuda(void *h_x, QudaInvertParam *param, const int *X, const char *filename,
+			      QudaFileFormat format);
+
+  /**
+   * Wait until all queued solutions are written and their files are
+   * complete.  Called by endQuda().
+   */
+  void flushSolutionWriterQuda(void);
+
+  /**
+   * Discard the solutions kept for the chronological initial guess
+   * (chrono_window in QudaInvertParam) of chrono_tag = tag, or of all
+   * tags if tag < 0, e.g., when a trajectory is rejected or the
+   * operator changes abruptly.  Called by endQuda().
+   */
+  void flushChronoQuda(int tag);
+
   /**
    * Free QUDA's internal copy of the gauge field.
    */
@@ -318,7 +486,11 @@ extern "C" {
 
   /**
    * Mixed-precision multi-shift solver.  In the future, this functionality
-   * will be folded into invertMultiShiftQuda().
+   * will be folded into invertMultiShiftQuda().  The solutions of a
+   * sloppy multi-shift solve are refined in the full precision, with
+   * param->refine_batch > 1 in batches of that many shifts, each to
+   * the tolerance residue_sq[i] (relative, like param->tol).  The
+   * telemetry_count left in param is that of the last refinement.
    */
   void invertMultiShiftQudaMixed(void **_hp_x, void *_hp_b,
 				 QudaInvertParam *param, double* offsets,
@@ -358,6 +530,41 @@ extern "C" {
   int computeFatLinkQuda(void* fatlink, void** sitelink,
 			 double* act_path_coeff, QudaGaugeParam* param, 
 			 QudaComputeFatMethod method);
+
+  /**
+   * Smear the host gauge field h_gauge in place by n_step steps of
+   * APE, stout or HYP smearing, with the coefficients
+   *   APE:   coeff[0] = alpha, the weight of the staples
+   *   stout: coeff[0] = rho, the isotropic stout parameter
+   *   HYP:   coeff[0..2] = alpha1, alpha2, alpha3 (e.g. 0.75, 0.6, 0.3)
+   * The links of dimensions param->X are stored in the order and
+   * precision given by param->gauge_order (QDP, QDP_LEX or MILC) and
+   * param->cpu_prec, without boundary phases.  The smearing is done
+   * on the host, in double precision, with the halos exchanged
+   * between ranks as for computeFatLinkQuda().
+   *
+   * @return The average plaquette of the smeared field, Re tr(U_p)/3
+   */
+  double smearLinkQuda(void *h_gauge, QudaGaugeParam *param, QudaLinkSmearType type,
+		       const double *coeff, int n_step);
+
+  /**
+   * Integrate the Wilson flow of the host gauge field h_gauge, in
+   * place, from flow time 0 to t_max, with Luscher's third-order
+   * Runge-Kutta scheme (arXiv:1006.4518) and steps of size epsilon.
+   * With tol > 0 the step size is adapted so that no link differs by
+   * more than tol (|dU|/3) from an embedded second-order step, and
+   * steps that do are repeated.  The clover energy density E(t),
+   * averaged over the lattice, and the topological charge Q(t) are
+   * measured at the start of every step, in the same pass as the
+   * first stage, and at t_max; the first max_meas of them are stored
+   * in t, E and Q, any of which may be NULL.  The links are as for
+   * smearLinkQuda().
+   *
+   * @return The number of measurements made, which may exceed max_meas
+   */
+  int wilsonFlowQuda(void *h_gauge, QudaGaugeParam *param, double t_max, double epsilon, double tol,
+		     double *t, double *E, double *Q, int max_meas);
   
   /*
    * The following routines are only used by the examples in tests/ .
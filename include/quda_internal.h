@@ -60,8 +60,9 @@ extern "C" {
     void *field; /**< Pointer to a ColorSpinorField */
   };
 
-  extern cudaDeviceProp deviceProp;  
-  extern cudaStream_t *streams;
+  // per rank, see interface_quda.cpp
+  extern COMM_RANK_LOCAL cudaDeviceProp deviceProp;
+  extern COMM_RANK_LOCAL cudaStream_t *streams;
   
 #ifdef __cplusplus
 }
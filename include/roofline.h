@@ -0,0 +1,32 @@
+#ifndef _ROOFLINE_H
+#define _ROOFLINE_H
+
+#include <enum_quda.h>
+
+// A roofline model of the host, calibrated by a short probe of the
+// memory bandwidth (the STREAM triad, over arrays much larger than
+// the caches) and of the multiply-add throughput (independent chains
+// that the compiler can pipeline and vectorize), both run on all the
+// host threads of a rank.  If every rank of a node probes at the same
+// time, as tests/benchmark_test does before its kernels, the peaks are
+// those of a rank's share of the node, which are the ones its kernels
+// can reach.
+//
+// Since the probe is compiled like the rest of the host code, the
+// flop peak is the one that code can reach rather than the one on the
+// data sheet.
+
+void probeRoofline();
+bool rooflineMeasured();
+
+// bytes/s and flops/s
+double rooflineBandwidth();
+double rooflineFlops(QudaPrecision precision);
+
+// the fraction of the roofline achieved by a kernel with the given
+// work per call that took the given time, i.e., the time that the
+// work takes at the peak bandwidth or the peak flop rate, whichever
+// is longer, over the time taken
+double rooflineFraction(double flops, double bytes, double seconds, QudaPrecision precision);
+
+#endif // _ROOFLINE_H
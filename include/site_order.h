@@ -0,0 +1,22 @@
+#ifndef _SITE_ORDER_H
+#define _SITE_ORDER_H
+
+#include <stdlib.h>
+
+// Conversion of host fields between lexicographic and even-odd site
+// order (see QudaSiteOrder), for fields that store all the data of a
+// site contiguously, site_bytes per site.  X holds the full lattice
+// dimensions, with X[0] even; the parity of a site is the sum of its
+// coordinates in all nDim dimensions, and within each parity sites
+// keep their lexicographic order.
+//
+// The sites of a row in X[0] alternate between the two parities, so
+// each row is read or written in one sequential pass while the two
+// halves of the even-odd field are each traversed sequentially too.
+// The work is split among the OpenMP threads in whole slices of the
+// outermost dimension.
+
+void lexToEvenOdd(void *eo, const void *lex, size_t site_bytes, int nDim, const int *X);
+void evenOddToLex(void *lex, const void *eo, size_t site_bytes, int nDim, const int *X);
+
+#endif // _SITE_ORDER_H
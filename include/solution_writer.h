@@ -0,0 +1,12 @@
+#ifndef _SOLUTION_WRITER_H
+#define _SOLUTION_WRITER_H
+
+// Asynchronous writing of solution fields, see writeSolutionAsyncQuda()
+// in quda.h and lib/solution_writer.cpp.
+
+// Number of host buffers, i.e., of fields that may be queued or being
+// written before writeSolutionAsyncQuda() blocks.  Set from
+// QUDA_SOLUTION_WRITER_BUFFERS in the environment (default 2).
+void setSolutionWriterBuffers(int n);
+
+#endif // _SOLUTION_WRITER_H
@@ -0,0 +1,46 @@
+#ifndef _SOLVER_CHECKPOINT_H
+#define _SOLVER_CHECKPOINT_H
+
+#include <quda.h>
+#include <color_spinor_field.h>
+
+// Checkpoints of the state of an iterative solver, so that a solve
+// that is interrupted (e.g., by preemption of the job) can resume
+// where it left off.  With param.checkpoint_interval > 0, the solver
+// calls save() every that many iterations, which writes its scalars
+// and fields to checkpoint_path.<rank> (best on node-local disk),
+// staging the fields through host memory.  The file is replaced
+// atomically, so that an interruption while writing leaves the
+// previous checkpoint intact.
+//
+// When the solve starts, load() looks for a checkpoint of the same
+// solve, identified by a key (e.g., the source norm and the shifts),
+// and restores it only if every rank has a valid one for the same
+// iteration; otherwise the solve starts from scratch.  The checkpoint
+// is removed once the solve has converged, while a solve that stops at
+// maxiter keeps it, so that it can be resumed with a larger maxiter.
+
+class SolverCheckpoint {
+
+ private:
+  const int interval;
+  char filename[512];
+  const char *solver;
+
+ public:
+  SolverCheckpoint(const QudaInvertParam &param, const char *solver);
+
+  bool Enabled() const { return interval > 0; }
+  bool Due(int iter) const { return interval > 0 && iter > 0 && iter % interval == 0; }
+
+  void save(int iter, const double *key, int nKey, const double *state, int nState,
+	    cudaColorSpinorField **fields, int nField) const;
+
+  // returns true and sets iter, state and fields if a checkpoint was restored
+  bool load(int &iter, const double *key, int nKey, double *state, int nState,
+	    cudaColorSpinorField **fields, int nField) const;
+
+  void remove() const;
+};
+
+#endif // _SOLVER_CHECKPOINT_H
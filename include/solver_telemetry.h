@@ -0,0 +1,44 @@
+#ifndef _SOLVER_TELEMETRY_H
+#define _SOLVER_TELEMETRY_H
+
+#include <quda.h>
+#include <trace_quda.h>
+
+// The convergence history of a solve, delivered to the application
+// as it happens.  A solver records an event for every iteration,
+// every reliable update (or restart) and the end of the solve in the
+// telemetry_buffer of its QudaInvertParam, a ring buffer owned by the
+// caller, and passes it to the telemetry_callback, either of which
+// may be NULL.  Recording an event only stores four numbers, so it
+// can be left on in production runs where the VERBOSE output would
+// be too costly.  The residuals are those that every rank sees, so
+// the callback can act on them (e.g., to stop watching a stalled
+// solve) on each rank alike.
+
+class SolverTelemetry {
+
+ private:
+  QudaInvertParam &param;
+  const double start;
+
+ public:
+  SolverTelemetry(QudaInvertParam &param) : param(param), start(traceClock()) { param.telemetry_count = 0; }
+
+  bool Enabled() const { return param.telemetry_buffer || param.telemetry_callback; }
+
+  void record(QudaSolverEventType type, int iter, double r2) {
+    if (!Enabled()) return;
+
+    QudaSolverEvent event;
+    event.type = type;
+    event.iter = iter;
+    event.r2 = r2;
+    event.time = 1e-6 * (traceClock() - start);
+
+    if (param.telemetry_buffer) param.telemetry_buffer[param.telemetry_count % param.telemetry_size] = event;
+    param.telemetry_count++;
+    if (param.telemetry_callback) param.telemetry_callback(&event, param.telemetry_arg);
+  }
+};
+
+#endif // _SOLVER_TELEMETRY_H
@@ -0,0 +1,38 @@
+#ifndef _TRACE_QUDA_H
+#define _TRACE_QUDA_H
+
+#include <sys/time.h>
+
+// An event tracer for looking at the timeline of a run, e.g., at the
+// overlap of the halo exchange with the dslash, or at the ranks that
+// others wait for in a reduction.  With QUDA_TRACE_FILE set in the
+// environment, every ProfileRegion (see profile_quda.h) and every
+// solver iteration is recorded as an event with its begin and end
+// time, in a ring buffer per rank of QUDA_TRACE_EVENTS events (by
+// default 262144), so that the most recent events are kept.
+// Recording does not synchronize the device, so the events of
+// asynchronous work only cover its launch unless the profiler is
+// enabled as well.
+//
+// writeTrace(), which is collective and called by endQuda(), writes
+// the events of all ranks to QUDA_TRACE_FILE in the Chrome trace
+// event format (one process per rank), which can be opened with
+// chrome://tracing or Perfetto.  The times are taken from the wall
+// clock of each node.
+
+// wall-clock time in microseconds
+inline double traceTime(const struct timeval &t) { return 1e6*t.tv_sec + t.tv_usec; }
+double traceClock();
+
+// records an event with the given begin and end time; id (e.g., the
+// direction of a message or the iteration count) is shown if >= 0.
+// The name is kept, not copied, so it must be a string literal.
+void traceEvent(const char *name, double start, double end, int id=-1);
+
+void setTraceFile(const char *filename);
+void setTraceEvents(int events);
+bool traceEnabled();
+
+void writeTrace();
+
+#endif // _TRACE_QUDA_H
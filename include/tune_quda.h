@@ -66,9 +66,6 @@ class TuneParam {
 class Tunable {
 
  protected:
-  virtual long long flops() const = 0;
-  virtual long long bytes() const { return 0; } // FIXME
-
   // the minimum number of shared bytes per thread
   virtual int sharedBytesPerThread() const = 0;
 
@@ -138,6 +135,10 @@ class Tunable {
   virtual void postTune() { }
   virtual int tuningIter() const { return 1; }
 
+  // the work done by one launch, also used by the profiler (see profile_quda.h)
+  virtual long long flops() const = 0;
+  virtual long long bytes() const { return 0; } // FIXME
+
   virtual std::string paramString(const TuneParam &param) const
   {
     std::stringstream ps;
@@ -184,4 +185,8 @@ void loadTuneCache(QudaVerbosity verbosity);
 void saveTuneCache(QudaVerbosity verbosity);
 TuneParam tuneLaunch(Tunable &tunable, QudaTune enabled, QudaVerbosity verbosity);
 
+// the version and build hash that identify the tunecache (and benchmark results)
+const char* getQudaVersion();
+const char* getQudaHash();
+
 #endif // _TUNE_QUDA_H
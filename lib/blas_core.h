@@ -220,6 +220,7 @@ void blasCuda(const int kernel, const double2 &a, const double2 &b, const double
   quda::blas_bytes += Functor<double2,double2>::streams()*x.RealLength()*x.Precision();
   quda::blas_flops += Functor<double2,double2>::flops()*x.RealLength();
 
+  ProfileRegion region("blas", blas->flops(), blas->bytes());
   blas->apply(*blasStream);
   delete blas;
 
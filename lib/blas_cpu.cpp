@@ -1,7 +1,89 @@
 #include <color_spinor_field.h>
+#include <color_spinor_field_order.h>
 #include <blas_quda.h>
 #include <face_quda.h>
 
+#include <vector>
+
+// The host BLAS routines work directly on the storage of their
+// arguments when these share a layout (precision, field order and
+// site order).  Otherwise they go element by element through the
+// field-order accessors, so that fields wrapping application memory
+// in any supported order can be used as they are, without first
+// being copied into a common order.
+
+static void checkSpinorShape(const cpuColorSpinorField &a, const cpuColorSpinorField &b) {
+  if (a.Volume() != b.Volume() || a.Nspin() != b.Nspin() || a.Ncolor() != b.Ncolor())
+    errorQuda("Fields do not match (volume %d %d, nSpin %d %d, nColor %d %d)",
+	      a.Volume(), b.Volume(), a.Nspin(), b.Nspin(), a.Ncolor(), b.Ncolor());
+}
+
+static bool sameLayout(const cpuColorSpinorField &a, const cpuColorSpinorField &b) {
+  return a.Precision() == b.Precision() && a.FieldOrder() == b.FieldOrder() &&
+    a.SiteOrder() == b.SiteOrder() && a.FieldOrder() != QUDA_QOP_DOMAIN_WALL_FIELD_ORDER;
+}
+
+// complex element (x, s, c) of a field, where x is the even-odd site index
+static inline quda::Complex getElement(const cpuColorSpinorField &f, int x, int s, int c) {
+  if (f.Precision() == QUDA_DOUBLE_PRECISION) {
+    const ColorSpinorFieldOrder<double> &o = f.OrderDouble();
+    int i = o.SiteIndex(x);
+    return quda::Complex(o(i, s, c, 0), o(i, s, c, 1));
+  } else {
+    const ColorSpinorFieldOrder<float> &o = f.OrderSingle();
+    int i = o.SiteIndex(x);
+    return quda::Complex(o(i, s, c, 0), o(i, s, c, 1));
+  }
+}
+
+static inline void setElement(cpuColorSpinorField &f, int x, int s, int c, const quda::Complex &v) {
+  if (f.Precision() == QUDA_DOUBLE_PRECISION) {
+    ColorSpinorFieldOrder<double> &o = f.OrderDouble();
+    int i = o.SiteIndex(x);
+    o(i, s, c, 0) = real(v);
+    o(i, s, c, 1) = imag(v);
+  } else {
+    ColorSpinorFieldOrder<float> &o = f.OrderSingle();
+    int i = o.SiteIndex(x);
+    o(i, s, c, 0) = real(v);
+    o(i, s, c, 1) = imag(v);
+  }
+}
+
+// z = a*x + b*y + c*z through the accessors (y may be NULL)
+static void genericCaxpbypcz(const quda::Complex &a, const cpuColorSpinorField &x,
+			     const quda::Complex &b, const cpuColorSpinorField *y,
+			     const quda::Complex &c, cpuColorSpinorField &z) {
+  checkSpinorShape(x, z);
+  if (y) checkSpinorShape(*y, z);
+  if (z.Precision() != QUDA_DOUBLE_PRECISION && z.Precision() != QUDA_SINGLE_PRECISION)
+    errorQuda("Precision type %d not implemented", z.Precision());
+
+  for (int i=0; i<z.Volume(); i++) {
+    for (int s=0; s<z.Nspin(); s++) {
+      for (int col=0; col<z.Ncolor(); col++) {
+	quda::Complex v = a*getElement(x, i, s, col) + c*getElement(z, i, s, col);
+	if (y) v += b*getElement(*y, i, s, col);
+	setElement(z, i, s, col, v);
+      }
+    }
+  }
+}
+
+// (a, b) through the accessors
+static quda::Complex genericCDotProduct(const cpuColorSpinorField &a, const cpuColorSpinorField &b) {
+  checkSpinorShape(a, b);
+  quda::Complex dot = 0.0;
+  for (int i=0; i<a.Volume(); i++) {
+    for (int s=0; s<a.Nspin(); s++) {
+      for (int c=0; c<a.Ncolor(); c++) {
+	dot += conj(getElement(a, i, s, c))*getElement(b, i, s, c);
+      }
+    }
+  }
+  return dot;
+}
+
 template <typename Float>
 void axpby(const Float &a, const Float *x, const Float &b, Float *y, const int N) {
   for (int i=0; i<N; i++) y[i] = a*x[i] + b*y[i];
@@ -9,7 +91,9 @@ void axpby(const Float &a, const Float *x, const Float &b, Float *y, const int N
 
 void axpbyCpu(const double &a, const cpuColorSpinorField &x, 
 	      const double &b, cpuColorSpinorField &y) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(x, y))
+    genericCaxpbypcz(quda::Complex(a), x, 0.0, NULL, quda::Complex(b), y);
+  else if (x.Precision() == QUDA_DOUBLE_PRECISION)
     axpby(a, (double*)x.V(), b, (double*)y.V(), x.Length());
   else if (x.Precision() == QUDA_SINGLE_PRECISION)
     axpby((float)a, (float*)x.V(), (float)b, (float*)y.V(), x.Length());
@@ -18,50 +102,28 @@ void axpbyCpu(const double &a, const cpuColorSpinorField &x,
 }
 
 void xpyCpu(const cpuColorSpinorField &x, cpuColorSpinorField &y) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
-    axpby(1.0, (double*)x.V(), 1.0, (double*)y.V(), x.Length());
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    axpby(1.0f, (float*)x.V(), 1.0f, (float*)y.V(), x.Length());
-  else
-    errorQuda("Precision type %d not implemented", x.Precision());
+  axpbyCpu(1.0, x, 1.0, y);
 }
 
 void axpyCpu(const double &a, const cpuColorSpinorField &x, 
 	     cpuColorSpinorField &y) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
-    axpby(a, (double*)x.V(), 1.0, (double*)y.V(), x.Length());
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    axpby((float)a, (float*)x.V(), 1.0f, (float*)y.V(), x.Length());
-  else
-    errorQuda("Precision type %d not implemented", x.Precision());
+  axpbyCpu(a, x, 1.0, y);
 }
 
 void xpayCpu(const cpuColorSpinorField &x, const double &a, 
 	     cpuColorSpinorField &y) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
-    axpby(1.0, (double*)x.V(), a, (double*)y.V(), x.Length());
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    axpby(1.0f, (float*)x.V(), (float)a, (float*)y.V(), x.Length());
-  else
-    errorQuda("Precision type %d not implemented", x.Precision());
+  axpbyCpu(1.0, x, a, y);
 }
 
 void mxpyCpu(const cpuColorSpinorField &x, cpuColorSpinorField &y) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
-    axpby(-1.0, (double*)x.V(), 1.0, (double*)y.V(), x.Length());
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    axpby(-1.0f, (float*)x.V(), 1.0f, (float*)y.V(), x.Length());
-  else
-    errorQuda("Precision type %d not implemented", x.Precision());
+  axpbyCpu(-1.0, x, 1.0, y);
 }
 
 void axCpu(const double &a, cpuColorSpinorField &x) {
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
-    axpby(0.0, (double*)x.V(), a, (double*)x.V(), x.Length());
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    axpby(0.0f, (float*)x.V(), (float)a, (float*)x.V(), x.Length());
+  if (x.FieldOrder() == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER)
+    genericCaxpbypcz(0.0, x, 0.0, NULL, quda::Complex(a), x);
   else
-    errorQuda("Precision type %d not implemented", x.Precision());
+    axpbyCpu(0.0, x, a, x);
 }
 
 template <typename Float>
@@ -76,21 +138,15 @@ void caxpby(const std::complex<Float> &a, const std::complex<Float> *x,
 
 void caxpyCpu(const quda::Complex &a, const cpuColorSpinorField &x,
 	      cpuColorSpinorField &y) {
-
-  if ( x.Precision() == QUDA_DOUBLE_PRECISION)
-    caxpby(a, (quda::Complex*)x.V(), quda::Complex(1.0), 
-	   (quda::Complex*)y.V(), x.Length()/2);
-  else if (x.Precision() == QUDA_SINGLE_PRECISION)
-    caxpby((std::complex<float>)a, (std::complex<float>*)x.V(), std::complex<float>(1.0), 
-	   (std::complex<float>*)y.V(), x.Length()/2);
-  else 
-    errorQuda("Precision type %d not implemented", x.Precision());
+  caxpbyCpu(a, x, quda::Complex(1.0), y);
 }
 
 void caxpbyCpu(const quda::Complex &a, const cpuColorSpinorField &x,
 	       const quda::Complex &b, cpuColorSpinorField &y) {
 
-  if ( x.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(x, y))
+    genericCaxpbypcz(a, x, 0.0, NULL, b, y);
+  else if ( x.Precision() == QUDA_DOUBLE_PRECISION)
     caxpby(a, (quda::Complex*)x.V(), b, (quda::Complex*)y.V(), x.Length()/2);
   else if (x.Precision() == QUDA_SINGLE_PRECISION)
     caxpby((std::complex<float>)a, (std::complex<float>*)x.V(), (std::complex<float>)b, 
@@ -114,7 +170,9 @@ void cxpaypbzCpu(const cpuColorSpinorField &x, const quda::Complex &a,
 		 const cpuColorSpinorField &y, const quda::Complex &b,
 		 cpuColorSpinorField &z) {
 
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(x, z) || !sameLayout(y, z))
+    genericCaxpbypcz(quda::Complex(1, 0), x, a, &y, b, z);
+  else if (x.Precision() == QUDA_DOUBLE_PRECISION)
     caxpbypcz(quda::Complex(1, 0), (quda::Complex*)x.V(), a, (quda::Complex*)y.V(), 
 	     b, (quda::Complex*)z.V(), x.Length()/2);
   else if (x.Precision() == QUDA_SINGLE_PRECISION)
@@ -130,6 +188,50 @@ void axpyBzpcxCpu(const double &a, cpuColorSpinorField& x, cpuColorSpinorField&
   axpbyCpu(b, z, c, x);
 }
 
+// x[j][i] += a[j]*p[j][i]; p[j][i] = b[j]*r[i] + c[j]*p[j][i] for every shift j,
+// a block of r at a time, so that r is read from memory once for all
+// the shifts rather than once per shift
+template <typename Float>
+void multiShiftAxpyBzpcx(const double *a, Float **p, Float **x, const double *b, const Float *r,
+			 const double *c, const int nShift, const int N) {
+  const int block = 1024; // reals of r kept in the L1 cache
+  for (int i0=0; i0<N; i0+=block) {
+    const int i1 = i0 + block < N ? i0 + block : N;
+    for (int j=0; j<nShift; j++) {
+      const Float aj = a[j], bj = b[j], cj = c[j];
+      Float *pj = p[j], *xj = x[j];
+      for (int i=i0; i<i1; i++) {
+	xj[i] += aj*pj[i];
+	pj[i] = bj*r[i] + cj*pj[i];
+      }
+    }
+  }
+}
+
+void multiShiftAxpyBzpcxCpu(const double *a, cpuColorSpinorField **p, cpuColorSpinorField **x,
+			    const double *b, const cpuColorSpinorField &r, const double *c, int nShift) {
+  bool same = true;
+  for (int j=0; j<nShift; j++) same = same && sameLayout(*p[j], r) && sameLayout(*x[j], r);
+
+  if (!same || (r.Precision() != QUDA_DOUBLE_PRECISION && r.Precision() != QUDA_SINGLE_PRECISION)) {
+    for (int j=0; j<nShift; j++) axpyBzpcxCpu(a[j], *p[j], *x[j], b[j], r, c[j]);
+  } else if (r.Precision() == QUDA_DOUBLE_PRECISION) {
+    std::vector<double*> pp(nShift), xp(nShift);
+    for (int j=0; j<nShift; j++) {
+      pp[j] = (double*)p[j]->V();
+      xp[j] = (double*)x[j]->V();
+    }
+    if (nShift > 0) multiShiftAxpyBzpcx(a, &pp[0], &xp[0], b, (const double*)r.V(), c, nShift, r.Length());
+  } else {
+    std::vector<float*> pp(nShift), xp(nShift);
+    for (int j=0; j<nShift; j++) {
+      pp[j] = (float*)p[j]->V();
+      xp[j] = (float*)x[j]->V();
+    }
+    if (nShift > 0) multiShiftAxpyBzpcx(a, &pp[0], &xp[0], b, (const float*)r.V(), c, nShift, r.Length());
+  }
+}
+
 // performs the operations: {y[i] = a*x[i] + y[i]; x[i] = z[i] + b*x[i]}
 void axpyZpbxCpu(const double &a, cpuColorSpinorField &x, cpuColorSpinorField &y, 
 		 const cpuColorSpinorField &z, const double &b) {
@@ -141,7 +243,9 @@ void axpyZpbxCpu(const double &a, cpuColorSpinorField &x, cpuColorSpinorField &y
 void caxpbypzYmbwCpu(const quda::Complex &a, const cpuColorSpinorField &x, const quda::Complex &b, 
 		     cpuColorSpinorField &y, cpuColorSpinorField &z, const cpuColorSpinorField &w) {
 
-  if (x.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(x, z) || !sameLayout(y, z))
+    genericCaxpbypcz(a, x, b, &y, quda::Complex(1, 0), z);
+  else if (x.Precision() == QUDA_DOUBLE_PRECISION)
     caxpbypcz(a, (quda::Complex*)x.V(), b, (quda::Complex*)y.V(), 
 	      quda::Complex(1, 0), (quda::Complex*)z.V(), x.Length()/2);
   else if (x.Precision() == QUDA_SINGLE_PRECISION)
@@ -163,7 +267,9 @@ double norm(const Float *a, const int N) {
 
 double normCpu(const cpuColorSpinorField &a) {
   double norm2 = 0.0;
-  if (a.Precision() == QUDA_DOUBLE_PRECISION)
+  if (a.FieldOrder() == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER)
+    norm2 = real(genericCDotProduct(a, a));
+  else if (a.Precision() == QUDA_DOUBLE_PRECISION)
     norm2 = norm((double*)a.V(), a.Length());
   else if (a.Precision() == QUDA_SINGLE_PRECISION)
     norm2 = norm((float*)a.V(), a.Length());
@@ -188,7 +294,9 @@ double reDotProduct(const Float *a, const Float *b, const int N) {
 
 double reDotProductCpu(const cpuColorSpinorField &a, const cpuColorSpinorField &b) {
   double dot = 0.0;
-  if (a.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(a, b))
+    dot = real(genericCDotProduct(a, b));
+  else if (a.Precision() == QUDA_DOUBLE_PRECISION)
     dot = reDotProduct((double*)a.V(), (double*)b.V(), a.Length());
   else if (a.Precision() == QUDA_SINGLE_PRECISION)
     dot = reDotProduct((float*)a.V(), (float*)b.V(), a.Length());
@@ -214,7 +322,9 @@ quda::Complex cDotProduct(const std::complex<Float> *a, const std::complex<Float
 
 quda::Complex cDotProductCpu(const cpuColorSpinorField &a, const cpuColorSpinorField &b) {
   quda::Complex dot = 0.0;
-  if (a.Precision() == QUDA_DOUBLE_PRECISION)
+  if (!sameLayout(a, b))
+    dot = genericCDotProduct(a, b);
+  else if (a.Precision() == QUDA_DOUBLE_PRECISION)
     dot = cDotProduct((quda::Complex*)a.V(), (quda::Complex*)b.V(), a.Length()/2);
   else if (a.Precision() == QUDA_SINGLE_PRECISION)
     dot = cDotProduct((std::complex<float>*)a.V(), (std::complex<float>*)b.V(), a.Length()/2);
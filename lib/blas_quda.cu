@@ -5,6 +5,7 @@
 #include <blas_quda.h>
 #include <color_spinor_field.h>
 #include <face_quda.h> // this is where the MPI / QMP depdendent code is
+#include <profile_quda.h>
 
 #define REDUCE_MAX_BLOCKS 65536
 
@@ -19,15 +20,15 @@
 #include <double_single.h>
 #endif
 
-// These are used for reduction kernels
-static QudaSumFloat *d_reduce=0;
-static QudaSumFloat *h_reduce=0;
-static QudaSumFloat *hd_reduce=0;
-static cudaEvent_t reduceEnd;
+// These are used for reduction kernels, per rank (see interface_quda.cpp)
+static COMM_RANK_LOCAL QudaSumFloat *d_reduce=0;
+static COMM_RANK_LOCAL QudaSumFloat *h_reduce=0;
+static COMM_RANK_LOCAL QudaSumFloat *hd_reduce=0;
+static COMM_RANK_LOCAL cudaEvent_t reduceEnd;
 
 namespace quda {
-  unsigned long long blas_flops;
-  unsigned long long blas_bytes;
+  COMM_RANK_LOCAL unsigned long long blas_flops;
+  COMM_RANK_LOCAL unsigned long long blas_bytes;
 }
 
 #include <float_vector.h>
@@ -58,12 +59,12 @@ void zeroCuda(cudaColorSpinorField &a) { a.zero(); }
   }
 
 // blasTuning = 1 turns off error checking
-static QudaTune blasTuning = QUDA_TUNE_NO;
-static QudaVerbosity verbosity = QUDA_SILENT;
+static COMM_RANK_LOCAL QudaTune blasTuning = QUDA_TUNE_NO;
+static COMM_RANK_LOCAL QudaVerbosity verbosity = QUDA_SILENT;
 
-static cudaStream_t *blasStream;
+static COMM_RANK_LOCAL cudaStream_t *blasStream;
 
-static struct {
+static COMM_RANK_LOCAL struct {
   int x[QUDA_MAX_DIM];
   int stride;
 } blasConstants;
@@ -325,9 +326,11 @@ void copyCuda(cudaColorSpinorField &dst, const cudaColorSpinorField &src) {
   }
   
   if (dst.Precision() != src.Precision()) {
+    ProfileRegion region("blas", 0, copy->bytes());
     copy->apply(*blasStream);
     delete copy;
   } else {
+    ProfileRegion region("blas", 0, 2*(dst.Bytes() + (dst.Precision() == QUDA_HALF_PRECISION ? dst.NormBytes() : 0)));
     cudaMemcpy(dst.V(), src.V(), dst.Bytes(), cudaMemcpyDeviceToDevice);
     if (dst.Precision() == QUDA_HALF_PRECISION) {
       cudaMemcpy(dst.Norm(), src.Norm(), dst.NormBytes(), cudaMemcpyDeviceToDevice);
@@ -612,6 +615,194 @@ void axpyZpbxCuda(const double &a, cudaColorSpinorField& x, cudaColorSpinorField
 			     x, y, z, x);
 }
 
+/**
+   The update of the shifted solutions and search directions of the
+   multi-shift solver: x[j] += a[j]*p[j]; p[j] = b[j]*r + c[j]*p[j]
+   for every shift j.  The shifts are done in one pass, so that r is
+   read once for up to MAX_FUSED_SHIFT of them rather than once per
+   shift.  The fields are treated as flat arrays, as in blasKernel.
+*/
+#define MAX_FUSED_SHIFT 4 // bounded by the size of the kernel arguments
+
+template <typename Float, typename FloatN>
+struct MultiShiftArg {
+  FloatN *x[MAX_FUSED_SHIFT];
+  FloatN *p[MAX_FUSED_SHIFT];
+  const FloatN *r;
+  Float a[MAX_FUSED_SHIFT];
+  Float b[MAX_FUSED_SHIFT];
+  Float c[MAX_FUSED_SHIFT];
+  int length;
+};
+
+template <typename Float, typename FloatN, int nShift>
+__global__ void multiShiftAxpyBzpcxKernel(MultiShiftArg<Float, FloatN> arg) {
+  unsigned int i = blockIdx.x*(blockDim.x) + threadIdx.x;
+  unsigned int gridSize = gridDim.x*blockDim.x;
+  while (i < arg.length) {
+    FloatN r = arg.r[i];
+#pragma unroll
+    for (int j=0; j<nShift; j++) {
+      FloatN p = arg.p[j][i];
+      FloatN x = arg.x[j][i];
+      x += arg.a[j]*p;
+      p = arg.b[j]*r + arg.c[j]*p;
+      arg.x[j][i] = x;
+      arg.p[j][i] = p;
+    }
+    i += gridSize;
+  }
+}
+
+template <typename Float, typename FloatN>
+class MultiShiftAxpyBzpcxCuda : public Tunable {
+
+private:
+  MultiShiftArg<Float, FloatN> arg;
+  const int nShift;
+  const QudaPrecision precision;
+
+  // host backups of x and p when tuning
+  char *x_h[MAX_FUSED_SHIFT], *p_h[MAX_FUSED_SHIFT];
+
+  int sharedBytesPerThread() const { return 0; }
+  int sharedBytesPerBlock(const TuneParam &param) const { return 0; }
+
+  virtual bool advanceSharedBytes(TuneParam &param) const
+  {
+    TuneParam next(param);
+    advanceBlockDim(next); // to get next blockDim
+    int nthreads = next.block.x * next.block.y * next.block.z;
+    param.shared_bytes = sharedBytesPerThread()*nthreads > sharedBytesPerBlock(param) ?
+      sharedBytesPerThread()*nthreads : sharedBytesPerBlock(param);
+    return false;
+  }
+
+public:
+  MultiShiftAxpyBzpcxCuda(const MultiShiftArg<Float, FloatN> &arg, int nShift, QudaPrecision precision)
+    : arg(arg), nShift(nShift), precision(precision) { ; }
+  virtual ~MultiShiftAxpyBzpcxCuda() { ; }
+
+  TuneKey tuneKey() const {
+    std::stringstream vol, aux;
+    vol << blasConstants.x[0] << "x";
+    vol << blasConstants.x[1] << "x";
+    vol << blasConstants.x[2] << "x";
+    vol << blasConstants.x[3];
+    aux << "stride=" << blasConstants.stride << ",prec=" << precision << ",shifts=" << nShift;
+    return TuneKey(vol.str(), "multiShiftAxpyBzpcxKernel", aux.str());
+  }
+
+  void apply(const cudaStream_t &stream) {
+    TuneParam tp = tuneLaunch(*this, blasTuning, verbosity);
+    switch (nShift) {
+    case 1: multiShiftAxpyBzpcxKernel<Float,FloatN,1><<<tp.grid, tp.block, tp.shared_bytes, stream>>>(arg); break;
+    case 2: multiShiftAxpyBzpcxKernel<Float,FloatN,2><<<tp.grid, tp.block, tp.shared_bytes, stream>>>(arg); break;
+    case 3: multiShiftAxpyBzpcxKernel<Float,FloatN,3><<<tp.grid, tp.block, tp.shared_bytes, stream>>>(arg); break;
+    case 4: multiShiftAxpyBzpcxKernel<Float,FloatN,4><<<tp.grid, tp.block, tp.shared_bytes, stream>>>(arg); break;
+    default: errorQuda("Unsupported number of shifts %d", nShift);
+    }
+  }
+
+  void preTune() {
+    size_t bytes = arg.length*sizeof(FloatN);
+    for (int j=0; j<nShift; j++) {
+      x_h[j] = new char[bytes];
+      p_h[j] = new char[bytes];
+      cudaMemcpy(x_h[j], arg.x[j], bytes, cudaMemcpyDeviceToHost);
+      cudaMemcpy(p_h[j], arg.p[j], bytes, cudaMemcpyDeviceToHost);
+    }
+    checkCudaError();
+  }
+
+  void postTune() {
+    size_t bytes = arg.length*sizeof(FloatN);
+    for (int j=0; j<nShift; j++) {
+      cudaMemcpy(arg.x[j], x_h[j], bytes, cudaMemcpyHostToDevice);
+      cudaMemcpy(arg.p[j], p_h[j], bytes, cudaMemcpyHostToDevice);
+      delete []x_h[j];
+      delete []p_h[j];
+    }
+    checkCudaError();
+  }
+
+  long long flops() const { return 5*(sizeof(FloatN)/sizeof(Float))*(long long)arg.length*nShift; }
+  long long bytes() const { return (4*nShift + 1)*sizeof(FloatN)*(long long)arg.length; }
+};
+
+template <typename Float, typename FloatN>
+static void multiShiftAxpyBzpcx(const double *a, cudaColorSpinorField **p, cudaColorSpinorField **x,
+				const double *b, cudaColorSpinorField &r, const double *c, int nShift) {
+  MultiShiftArg<Float, FloatN> arg;
+  arg.r = (const FloatN*)r.V();
+  arg.length = r.Length() / (sizeof(FloatN)/sizeof(Float));
+  for (int j=0; j<nShift; j++) {
+    arg.x[j] = (FloatN*)x[j]->V();
+    arg.p[j] = (FloatN*)p[j]->V();
+    arg.a[j] = a[j];
+    arg.b[j] = b[j];
+    arg.c[j] = c[j];
+  }
+
+  MultiShiftAxpyBzpcxCuda<Float, FloatN> blas(arg, nShift, r.Precision());
+  ProfileRegion region("blas", blas.flops(), blas.bytes());
+  blas.apply(*blasStream);
+}
+
+void multiShiftAxpyBzpcxCuda(const double *a, cudaColorSpinorField **p, cudaColorSpinorField **x,
+			     const double *b, cudaColorSpinorField &r, const double *c, int nShift) {
+  if (nShift == 0) return;
+
+  // half precision needs the norms, so it is done shift by shift
+  if (r.Precision() == QUDA_HALF_PRECISION) {
+    for (int j=0; j<nShift; j++) axpyBzpcxCuda(a[j], *p[j], *x[j], b[j], r, c[j]);
+    return;
+  }
+
+  if (r.SiteSubset() == QUDA_FULL_SITE_SUBSET) {
+    cudaColorSpinorField *pe[MAX_FUSED_SHIFT], *xe[MAX_FUSED_SHIFT];
+    cudaColorSpinorField *po[MAX_FUSED_SHIFT], *xo[MAX_FUSED_SHIFT];
+    for (int j0=0; j0<nShift; j0+=MAX_FUSED_SHIFT) {
+      const int n = nShift - j0 < MAX_FUSED_SHIFT ? nShift - j0 : MAX_FUSED_SHIFT;
+      for (int j=0; j<n; j++) {
+	pe[j] = &p[j0+j]->Even();
+	xe[j] = &x[j0+j]->Even();
+	po[j] = &p[j0+j]->Odd();
+	xo[j] = &x[j0+j]->Odd();
+      }
+      multiShiftAxpyBzpcxCuda(a+j0, pe, xe, b+j0, r.Even(), c+j0, n);
+      multiShiftAxpyBzpcxCuda(a+j0, po, xo, b+j0, r.Odd(), c+j0, n);
+    }
+    return;
+  }
+
+  for (int j=0; j<nShift; j++) {
+    checkSpinor(r, (*p[j]));
+    checkSpinor(r, (*x[j]));
+  }
+
+  for (int d=0; d<QUDA_MAX_DIM; d++) blasConstants.x[d] = r.X()[d];
+  blasConstants.stride = r.Stride();
+
+  for (int j0=0; j0<nShift; j0+=MAX_FUSED_SHIFT) {
+    const int n = nShift - j0 < MAX_FUSED_SHIFT ? nShift - j0 : MAX_FUSED_SHIFT;
+    if (r.Precision() == QUDA_DOUBLE_PRECISION) {
+      multiShiftAxpyBzpcx<double, double2>(a+j0, p+j0, x+j0, b+j0, r, c+j0, n);
+    } else {
+      multiShiftAxpyBzpcx<float, float4>(a+j0, p+j0, x+j0, b+j0, r, c+j0, n);
+    }
+  }
+
+  // x and p of every shift are read and written, and r is read once
+  // per launch, rather than the 5*nShift streams of one
+  // axpyBzpcxCuda() per shift
+  const int nLaunch = (nShift + MAX_FUSED_SHIFT - 1) / MAX_FUSED_SHIFT;
+  quda::blas_bytes += (4*nShift + nLaunch)*r.RealLength()*r.Precision();
+  quda::blas_flops += 10*nShift*r.RealLength();
+
+  checkCudaError();
+}
+
 /**
    Functor performing the operations z[i] = a*x[i] + b*y[i] + z[i] and y[i] -= b*w[i]
 */
@@ -214,6 +214,16 @@ void printQudaInvertParam(QudaInvertParam *param) {
   P(omega, INVALID_DOUBLE);
 #endif
 
+#if defined INIT_PARAM
+  P(chrono_window, 0); // no chronological guess by default
+  P(chrono_tag, 0);
+#elif defined CHECK_PARAM
+  if (param->chrono_window < 0) errorQuda("Invalid chrono_window %d", param->chrono_window);
+#else
+  P(chrono_window, INVALID_INT);
+  if (param->chrono_window > 0) P(chrono_tag, INVALID_INT);
+#endif
+
 #ifndef INIT_PARAM
   if (param->dslash_type == QUDA_CLOVER_WILSON_DSLASH) {
 #endif
@@ -234,8 +244,39 @@ void printQudaInvertParam(QudaInvertParam *param) {
 
   P(verbosity, QUDA_INVALID_VERBOSITY);
 
+#if defined INIT_PARAM
+  P(checkpoint_interval, 0); // no checkpoints by default
+  ret.checkpoint_path[0] = '\0';
+#else
+  P(checkpoint_interval, INVALID_INT);
+#endif
+#ifdef PRINT_PARAM
+  if (param->checkpoint_interval > 0) printfQuda("checkpoint_path = %s\n", param->checkpoint_path);
+#endif
+
+#if defined INIT_PARAM
+  ret.telemetry_buffer = NULL; // no telemetry by default
+  P(telemetry_size, 0);
+  ret.telemetry_callback = NULL;
+  ret.telemetry_arg = NULL;
+#elif defined CHECK_PARAM
+  if (param->telemetry_buffer && param->telemetry_size <= 0)
+    errorQuda("Invalid telemetry_size %d for the telemetry buffer", param->telemetry_size);
+#else
+  if (param->telemetry_buffer) P(telemetry_size, INVALID_INT);
+  if (param->telemetry_callback) printfQuda("telemetry_callback = %p\n", (void*)param->telemetry_callback);
+#endif
+
+#if defined INIT_PARAM
+  P(refine_batch, 0); // refine one shift at a time by default
+#else
+  P(refine_batch, INVALID_INT);
+#endif
+
 #ifdef PRINT_PARAM
   P(iter, INVALID_INT);
+  P(iter_res, INVALID_DOUBLE);
+  P(true_res, INVALID_DOUBLE);
   P(spinorGiB, INVALID_DOUBLE);
   if (param->dslash_type == QUDA_CLOVER_WILSON_DSLASH)
     P(cloverGiB, INVALID_DOUBLE);
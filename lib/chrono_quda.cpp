@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <math.h>
+#include <map>
+#include <deque>
+#include <vector>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <color_spinor_field.h>
+#include <blas_quda.h>
+#include <comm_quda.h>
+#include <chrono_quda.h>
+
+// See chrono_quda.h.  The solutions kept for a tag are in a deque,
+// the newest first.  For a guess they are copied and orthonormalized
+// (modified Gram-Schmidt, dropping any that is numerically dependent
+// on the newer ones, since successive solutions are nearly parallel),
+// and the small projected system is solved on the host.
+
+typedef std::deque<cudaColorSpinorField*> Chrono;
+
+// with thread comms every rank has its own solutions
+static COMM_RANK_LOCAL std::map<int, Chrono> *chrono = NULL;
+
+static void flush(Chrono &solutions)
+{
+  for (size_t i=0; i<solutions.size(); i++) delete solutions[i];
+  solutions.clear();
+}
+
+static bool compatible(const cudaColorSpinorField &a, const cudaColorSpinorField &b)
+{
+  return a.Precision() == b.Precision() && a.Length() == b.Length() &&
+    a.SiteSubset() == b.SiteSubset() && a.Nspin() == b.Nspin();
+}
+
+// solves the n x n system G y = c by Gaussian elimination with
+// partial pivoting, G stored by rows and overwritten, y returned in c;
+// returns false if G is singular
+static bool solve(std::vector<quda::Complex> &G, std::vector<quda::Complex> &c, int n)
+{
+  for (int k=0; k<n; k++) {
+    int pivot = k;
+    for (int i=k+1; i<n; i++) if (abs(G[i*n+k]) > abs(G[pivot*n+k])) pivot = i;
+    if (abs(G[pivot*n+k]) == 0.0) return false;
+    if (pivot != k) {
+      for (int j=0; j<n; j++) std::swap(G[k*n+j], G[pivot*n+j]);
+      std::swap(c[k], c[pivot]);
+    }
+    for (int i=k+1; i<n; i++) {
+      quda::Complex l = G[i*n+k] / G[k*n+k];
+      for (int j=k; j<n; j++) G[i*n+j] -= l * G[k*n+j];
+      c[i] -= l * c[k];
+    }
+  }
+  for (int k=n-1; k>=0; k--) {
+    for (int j=k+1; j<n; j++) c[k] -= G[k*n+j] * c[j];
+    c[k] /= G[k*n+k];
+  }
+  return true;
+}
+
+int chronoGuess(int tag, const DiracMatrix &mat, bool hermitian, cudaColorSpinorField &x,
+		cudaColorSpinorField &b)
+{
+  if (!chrono || chrono->find(tag) == chrono->end()) return 0;
+  Chrono &solutions = (*chrono)[tag];
+  if (solutions.empty()) return 0;
+
+  if (!compatible(*solutions[0], x)) {
+    if (getVerbosity() >= QUDA_VERBOSE)
+      printfQuda("Chrono: discarding the solutions of tag %d, which do not match the solve\n", tag);
+    flush(solutions);
+    return 0;
+  }
+
+  // an orthonormal basis of the span of the solutions
+  const double drop = (x.Precision() == QUDA_DOUBLE_PRECISION) ? 1e-10 : 1e-5;
+  std::vector<cudaColorSpinorField*> q;
+  for (size_t i=0; i<solutions.size(); i++) {
+    cudaColorSpinorField *v = new cudaColorSpinorField(*solutions[i]);
+    double v2 = normCuda(*v);
+    for (size_t j=0; j<q.size(); j++) caxpyCuda(-cDotProductCuda(*q[j], *v), *q[j], *v);
+    double q2 = normCuda(*v);
+    if (q2 <= 0.0 || sqrt(q2 / v2) < drop) {
+      delete v;
+      continue;
+    }
+    axCuda(1.0/sqrt(q2), *v);
+    q.push_back(v);
+  }
+  const int n = q.size();
+  if (n == 0) return 0;
+
+  // the projected system: with a hermitian operator G = Q^dag A Q and
+  // c = Q^dag b, otherwise G = (A Q)^dag (A Q) and c = (A Q)^dag b
+  std::vector<quda::Complex> G(n*n), c(n);
+  ColorSpinorParam param(x);
+  param.create = QUDA_NULL_FIELD_CREATE;
+  cudaColorSpinorField tmp(x, param);
+  if (hermitian) {
+    for (int j=0; j<n; j++) {
+      mat(tmp, *q[j]);
+      for (int i=0; i<n; i++) G[i*n+j] = cDotProductCuda(*q[i], tmp);
+      c[j] = cDotProductCuda(*q[j], b);
+    }
+  } else {
+    std::vector<cudaColorSpinorField*> w(n);
+    for (int j=0; j<n; j++) {
+      w[j] = new cudaColorSpinorField(x, param);
+      mat(*w[j], *q[j]);
+      for (int i=0; i<=j; i++) {
+	G[i*n+j] = cDotProductCuda(*w[i], *w[j]);
+	G[j*n+i] = conj(G[i*n+j]);
+      }
+      c[j] = cDotProductCuda(*w[j], b);
+    }
+    for (int j=0; j<n; j++) delete w[j];
+  }
+
+  bool solved = solve(G, c, n);
+  if (solved) {
+    zeroCuda(x);
+    for (int j=0; j<n; j++) caxpyCuda(c[j], *q[j], x);
+  }
+
+  for (int j=0; j<n; j++) delete q[j];
+
+  if (!solved) {
+    warningQuda("Chrono: the projected system of tag %d is singular, no guess made", tag);
+    return 0;
+  }
+
+  if (getVerbosity() >= QUDA_VERBOSE)
+    printfQuda("Chrono: guess for tag %d from %d of %d solutions\n", tag, n, (int)solutions.size());
+
+  return n;
+}
+
+void chronoSave(int tag, int window, const cudaColorSpinorField &x)
+{
+  if (window <= 0) return;
+  if (!chrono) chrono = new std::map<int, Chrono>;
+  Chrono &solutions = (*chrono)[tag];
+
+  if (!solutions.empty() && !compatible(*solutions[0], x)) flush(solutions);
+
+  cudaColorSpinorField *v;
+  if ((int)solutions.size() >= window) { // recycle the oldest
+    v = solutions.back();
+    solutions.pop_back();
+    copyCuda(*v, x);
+  } else {
+    v = new cudaColorSpinorField(x);
+  }
+  solutions.push_front(v);
+
+  while ((int)solutions.size() > window) {
+    delete solutions.back();
+    solutions.pop_back();
+  }
+}
+
+void flushChronoQuda(int tag)
+{
+  if (!chrono) return;
+
+  if (tag < 0) {
+    for (std::map<int, Chrono>::iterator it = chrono->begin(); it != chrono->end(); ++it) flush(it->second);
+    delete chrono;
+    chrono = NULL;
+  } else if (chrono->find(tag) != chrono->end()) {
+    flush((*chrono)[tag]);
+    chrono->erase(tag);
+  }
+}
@@ -0,0 +1,706 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <comm_quda.h>
+
+/*
+ * In-process communication backend: every "rank" is a thread of the
+ * same process, and point-to-point messages are memcpy'd through a
+ * mailbox owned by the receiving rank.  Sends are eager (the payload
+ * is copied into the mailbox when the send is posted), so a send
+ * request is complete as soon as it is issued; a receive completes
+ * when a message with matching source and tag has been delivered.
+ * Messages between a given pair of ranks with the same tag are
+ * matched in order, as with MPI.
+ *
+ * The rank-local state below is thread-local; the mailboxes, the
+ * barrier and the reduction slots are shared between all ranks.
+ */
+
+static char hostname[128] = "undetermined";
+static int size = 1;
+extern int getGpuCount();
+
+static COMM_RANK_LOCAL int rank = 0;
+static COMM_RANK_LOCAL int fwd_nbr=-1;
+static COMM_RANK_LOCAL int back_nbr=-1;
+
+static COMM_RANK_LOCAL int x_fwd_nbr=-1;
+static COMM_RANK_LOCAL int y_fwd_nbr=-1;
+static COMM_RANK_LOCAL int z_fwd_nbr=-1;
+static COMM_RANK_LOCAL int t_fwd_nbr=-1;
+static COMM_RANK_LOCAL int x_back_nbr=-1;
+static COMM_RANK_LOCAL int y_back_nbr=-1;
+static COMM_RANK_LOCAL int z_back_nbr=-1;
+static COMM_RANK_LOCAL int t_back_nbr=-1;
+
+static COMM_RANK_LOCAL int xgridsize=1;
+static COMM_RANK_LOCAL int ygridsize=1;
+static COMM_RANK_LOCAL int zgridsize=1;
+static COMM_RANK_LOCAL int tgridsize=1;
+static COMM_RANK_LOCAL int xgridid = -1;
+static COMM_RANK_LOCAL int ygridid = -1;
+static COMM_RANK_LOCAL int zgridid = -1;
+static COMM_RANK_LOCAL int tgridid = -1;
+
+static COMM_RANK_LOCAL int manual_set_partition[4] ={0, 0, 0, 0};
+
+/* a message in flight, the payload follows the header */
+typedef struct comm_thread_msg_s {
+  int src;
+  int tag;
+  int len;
+  struct comm_thread_msg_s *next;
+} comm_thread_msg;
+
+typedef struct comm_thread_mailbox_s {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  comm_thread_msg *head;
+  comm_thread_msg *tail;
+} comm_thread_mailbox;
+
+static comm_thread_mailbox *mailbox = NULL;
+
+static pthread_mutex_t barrier_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t barrier_cond = PTHREAD_COND_INITIALIZER;
+static int barrier_count = 0;
+static unsigned long barrier_generation = 0;
+
+/* each rank publishes a pointer to its reduction/broadcast buffer here */
+static void **reduce_slot = NULL;
+
+#define X_FASTEST_DIM_NODE_RANKING
+
+#ifdef X_FASTEST_DIM_NODE_RANKING
+#define GRID_ID(xid,yid,zid,tid) (tid*zgridsize*ygridsize*xgridsize+zid*ygridsize*xgridsize+yid*xgridsize+xid)
+#else
+#define GRID_ID(xid,yid,zid,tid) (xid*ygridsize*zgridsize*tgridsize+yid*zgridsize*tgridsize+zid*tgridsize+tid)
+#endif
+
+static void
+comm_thread_barrier(void)
+{
+  if (size == 1) return;
+
+  pthread_mutex_lock(&barrier_lock);
+  unsigned long generation = barrier_generation;
+  if (++barrier_count == size) {
+    barrier_count = 0;
+    barrier_generation++;
+    pthread_cond_broadcast(&barrier_cond);
+  } else {
+    while (generation == barrier_generation) pthread_cond_wait(&barrier_cond, &barrier_lock);
+  }
+  pthread_mutex_unlock(&barrier_lock);
+}
+
+static void
+comm_thread_setup(int nranks)
+{
+  size = nranks;
+
+  mailbox = (comm_thread_mailbox*)malloc(size*sizeof(comm_thread_mailbox));
+  reduce_slot = (void**)malloc(size*sizeof(void*));
+  if (mailbox == NULL || reduce_slot == NULL) {
+    printf("ERROR: malloc failed for thread comms mailboxes\n");
+    comm_exit(1);
+  }
+
+  for (int i=0; i<size; i++) {
+    pthread_mutex_init(&mailbox[i].lock, NULL);
+    pthread_cond_init(&mailbox[i].cond, NULL);
+    mailbox[i].head = NULL;
+    mailbox[i].tail = NULL;
+    reduce_slot[i] = NULL;
+  }
+}
+
+static void
+comm_thread_teardown(void)
+{
+  for (int i=0; i<size; i++) {
+    comm_thread_msg *msg = mailbox[i].head;
+    if (msg) printf("WARNING: undelivered messages left in mailbox of rank %d\n", i);
+    while (msg) {
+      comm_thread_msg *next = msg->next;
+      free(msg);
+      msg = next;
+    }
+    pthread_mutex_destroy(&mailbox[i].lock);
+    pthread_cond_destroy(&mailbox[i].cond);
+  }
+  free(mailbox);
+  free(reduce_slot);
+  mailbox = NULL;
+  reduce_slot = NULL;
+  size = 1;
+}
+
+typedef struct comm_thread_arg_s {
+  int rank;
+  int (*main_fn)(int, char**);
+  int argc;
+  char **argv;
+  int ret;
+} comm_thread_arg;
+
+static void*
+comm_thread_main(void *_arg)
+{
+  comm_thread_arg *arg = (comm_thread_arg*)_arg;
+  rank = arg->rank;
+  arg->ret = arg->main_fn(arg->argc, arg->argv);
+  return NULL;
+}
+
+int
+comm_thread_launch(int nranks, int (*main_fn)(int, char**), int argc, char **argv)
+{
+  if (nranks < 1) {
+    printf("ERROR: invalid number of thread ranks (%d)\n", nranks);
+    comm_exit(1);
+  }
+
+  comm_thread_setup(nranks);
+
+  pthread_t *threads = (pthread_t*)malloc(nranks*sizeof(pthread_t));
+  comm_thread_arg *args = (comm_thread_arg*)malloc(nranks*sizeof(comm_thread_arg));
+  if (threads == NULL || args == NULL) {
+    printf("ERROR: malloc failed for thread ranks\n");
+    comm_exit(1);
+  }
+
+  for (int i=0; i<nranks; i++) {
+    args[i].rank = i;
+    args[i].main_fn = main_fn;
+    args[i].argc = argc;
+    args[i].argv = argv;
+    args[i].ret = 0;
+  }
+
+  // rank 0 runs on the calling thread
+  for (int i=1; i<nranks; i++) {
+    if (pthread_create(&threads[i], NULL, comm_thread_main, &args[i]) != 0) {
+      printf("ERROR: failed to create thread for rank %d\n", i);
+      comm_exit(1);
+    }
+  }
+  comm_thread_main(&args[0]);
+  for (int i=1; i<nranks; i++) pthread_join(threads[i], NULL);
+
+  int ret = 0;
+  for (int i=0; i<nranks; i++) if (args[i].ret != 0) ret = args[i].ret;
+
+  free(args);
+  free(threads);
+  comm_thread_teardown();
+
+  return ret;
+}
+
+void
+comm_set_gridsize(int x, int y, int z, int t)
+{
+  xgridsize = x;
+  ygridsize = y;
+  zgridsize = z;
+  tgridsize = t;
+
+  return;
+}
+
+/* This function is for testing and debugging purposes only */
+void
+comm_dim_partitioned_set(int dir)
+{
+  manual_set_partition[dir] = 1;
+  return;
+}
+
+int
+comm_dim_partitioned(int dir)
+{
+  int ret = 0;
+
+  switch(dir){
+  case 0:
+    ret = (xgridsize > 1);
+    break;
+  case 1:
+    ret = (ygridsize > 1);
+    break;
+  case 2:
+    ret = (zgridsize > 1);
+    break;
+  case 3:
+    ret = (tgridsize > 1);
+    break;
+  default:
+    printf("ERROR: invalid direction\n");
+    comm_exit(1);
+  }
+
+  if( manual_set_partition[dir]){
+    ret = manual_set_partition[dir];
+  }
+
+  return ret;
+}
+
+static void
+comm_partition(void)
+{
+  if(xgridsize*ygridsize*zgridsize*tgridsize != size){
+    if (rank ==0){
+      printf("ERROR: Invalid configuration (t,z,y,x gridsize=%d %d %d %d) "
+             "but # of thread ranks is %d\n", tgridsize, zgridsize, ygridsize, xgridsize, size);
+    }
+    comm_exit(1);
+  }
+
+  int leftover;
+
+#ifdef X_FASTEST_DIM_NODE_RANKING
+  tgridid  = rank/(zgridsize*ygridsize*xgridsize);
+  leftover = rank%(zgridsize*ygridsize*xgridsize);
+  zgridid  = leftover/(ygridsize*xgridsize);
+  leftover = leftover%(ygridsize*xgridsize);
+  ygridid  = leftover/xgridsize;
+  xgridid  = leftover%xgridsize;
+#else
+  xgridid  = rank/(ygridsize*zgridsize*tgridsize);
+  leftover = rank%(ygridsize*zgridsize*tgridsize);
+  ygridid  = leftover/(zgridsize*tgridsize);
+  leftover = leftover%(zgridsize*tgridsize);
+  zgridid  = leftover/tgridsize;
+  tgridid  = leftover%tgridsize;
+#endif
+
+  x_fwd_nbr = comm_get_neighbor_rank(+1, 0, 0, 0);
+  x_back_nbr = comm_get_neighbor_rank(-1, 0, 0, 0);
+  y_fwd_nbr = comm_get_neighbor_rank(0, +1, 0, 0);
+  y_back_nbr = comm_get_neighbor_rank(0, -1, 0, 0);
+  z_fwd_nbr = comm_get_neighbor_rank(0, 0, +1, 0);
+  z_back_nbr = comm_get_neighbor_rank(0, 0, -1, 0);
+  t_fwd_nbr = comm_get_neighbor_rank(0, 0, 0, +1);
+  t_back_nbr = comm_get_neighbor_rank(0, 0, 0, -1);
+
+  printf("Thread rank: rank=%d, gridid(t,z,y,x): %d %d %d %d, fwd_nbr(t,z,y,x)=%d %d %d %d, back_nbr(t,z,y,x)=%d %d %d %d\n",
+	 rank, tgridid, zgridid, ygridid, xgridid, t_fwd_nbr, z_fwd_nbr, y_fwd_nbr, x_fwd_nbr,
+	 t_back_nbr, z_back_nbr, y_back_nbr, x_back_nbr);
+}
+
+int
+comm_get_neighbor_rank(int dx, int dy, int dz, int dt)
+{
+  int xid, yid, zid, tid;
+  xid=(xgridid + dx + xgridsize)%xgridsize;
+  yid=(ygridid + dy + ygridsize)%ygridsize;
+  zid=(zgridid + dz + zgridsize)%zgridsize;
+  tid=(tgridid + dt + tgridsize)%tgridsize;
+
+  return GRID_ID(xid,yid,zid,tid);
+}
+
+void
+comm_init(void)
+{
+  static COMM_RANK_LOCAL int firsttime=1;
+  if (!firsttime){
+    return;
+  }
+  firsttime = 0;
+
+  // not started through comm_thread_launch: run as a single rank
+  if (mailbox == NULL) comm_thread_setup(1);
+
+  if (rank == 0) {
+    gethostname(hostname, 128);
+    hostname[127] = '\0';
+  }
+
+  comm_partition();
+
+  back_nbr = (rank -1 + size)%size;
+  fwd_nbr = (rank +1)%size;
+
+  srand(rank*999);
+
+  comm_thread_barrier();
+  return;
+}
+
+char *
+comm_hostname(void)
+{
+  return hostname;
+}
+
+// all ranks live on the same node, so they share its devices round-robin
+int comm_gpuid()
+{
+  return rank%getGpuCount();
+}
+
+int
+comm_rank(void)
+{
+  return rank;
+}
+
+int
+comm_size(void)
+{
+  return size;
+}
+
+int
+comm_dim(int dir) {
+
+  int i = 1;
+  switch(dir) {
+  case 0:
+    i = xgridsize;
+    break;
+  case 1:
+    i = ygridsize;
+    break;
+  case 2:
+    i = zgridsize;
+    break;
+  case 3:
+    i = tgridsize;
+    break;
+  default:
+    printf("Cannot get direction %d", dir);
+    comm_exit(1);
+  }
+
+  return i;
+}
+
+int
+comm_coords(int dir) {
+
+  int i = 0;
+  switch(dir) {
+  case 0:
+    i = xgridid;
+    break;
+  case 1:
+    i = ygridid;
+    break;
+  case 2:
+    i = zgridid;
+    break;
+  case 3:
+    i = tgridid;
+    break;
+  default:
+    printf("Cannot get direction %d", dir);
+    comm_exit(1);
+  }
+
+  return i;
+}
+
+static int
+comm_neighbor_proc(int nbr)
+{
+  int proc = -1;
+  switch(nbr){
+  case X_BACK_NBR:
+    proc = x_back_nbr;
+    break;
+  case X_FWD_NBR:
+    proc = x_fwd_nbr;
+    break;
+  case Y_BACK_NBR:
+    proc = y_back_nbr;
+    break;
+  case Y_FWD_NBR:
+    proc = y_fwd_nbr;
+    break;
+  case Z_BACK_NBR:
+    proc = z_back_nbr;
+    break;
+  case Z_FWD_NBR:
+    proc = z_fwd_nbr;
+    break;
+  case T_BACK_NBR:
+    proc = t_back_nbr;
+    break;
+  case T_FWD_NBR:
+    proc = t_fwd_nbr;
+    break;
+  default:
+    printf("ERROR: invalid neighbor %d, line %d, file %s\n", nbr, __LINE__, __FILE__);
+    comm_exit(1);
+  }
+  return proc;
+}
+
+static unsigned long
+comm_thread_send(void *buf, int len, int dst, int tag, void *_request)
+{
+  MPI_Request *request = (MPI_Request*)_request;
+  if (request == NULL){
+    printf("ERROR: malloc failed for thread comms request\n");
+    comm_exit(1);
+  }
+  if (dst < 0 || dst >= size) {
+    printf("ERROR: Invalid dst rank(%d)\n", dst);
+    comm_exit(1);
+  }
+
+  comm_thread_msg *msg = (comm_thread_msg*)malloc(sizeof(comm_thread_msg) + len);
+  if (msg == NULL) {
+    printf("ERROR: malloc failed for thread comms message\n");
+    comm_exit(1);
+  }
+  msg->src = rank;
+  msg->tag = tag;
+  msg->len = len;
+  msg->next = NULL;
+  memcpy(msg+1, buf, len);
+
+  comm_thread_mailbox *box = &mailbox[dst];
+  pthread_mutex_lock(&box->lock);
+  if (box->tail) box->tail->next = msg;
+  else box->head = msg;
+  box->tail = msg;
+  pthread_cond_broadcast(&box->cond);
+  pthread_mutex_unlock(&box->lock);
+
+  request->buf = buf;
+  request->len = len;
+  request->src = rank;
+  request->tag = tag;
+  request->pending = 0;
+
+  return (unsigned long)request;
+}
+
+static unsigned long
+comm_thread_recv(void *buf, int len, int src, int tag, void *_request)
+{
+  MPI_Request *request = (MPI_Request*)_request;
+  if (request == NULL){
+    printf("ERROR: malloc failed for thread comms request\n");
+    comm_exit(1);
+  }
+  if (src < 0 || src >= size) {
+    printf("ERROR: Invalid src rank(%d)\n", src);
+    comm_exit(1);
+  }
+
+  request->buf = buf;
+  request->len = len;
+  request->src = src;
+  request->tag = tag;
+  request->pending = 1;
+
+  return (unsigned long)request;
+}
+
+/* Try to complete a receive request; the mailbox lock must be held.
+   Returns the matching message unlinked from the mailbox, or NULL. */
+static comm_thread_msg*
+comm_thread_match(comm_thread_mailbox *box, MPI_Request *request)
+{
+  comm_thread_msg *prev = NULL;
+  for (comm_thread_msg *msg = box->head; msg; prev = msg, msg = msg->next) {
+    if (msg->src != request->src || msg->tag != request->tag) continue;
+    if (prev) prev->next = msg->next;
+    else box->head = msg->next;
+    if (box->tail == msg) box->tail = prev;
+    return msg;
+  }
+  return NULL;
+}
+
+static void
+comm_thread_deliver(comm_thread_msg *msg, MPI_Request *request)
+{
+  if (msg->len > request->len) {
+    printf("ERROR: message of %d bytes from rank %d (tag %d) truncated to %d bytes\n",
+	   msg->len, msg->src, msg->tag, request->len);
+    comm_exit(1);
+  }
+  memcpy(request->buf, msg+1, msg->len);
+  free(msg);
+  request->pending = 0;
+}
+
+unsigned long
+comm_send(void* buf, int len, int dst, void* request)
+{
+  if (dst == BACK_NBR){
+    return comm_thread_send(buf, len, back_nbr, BACK_NBR, request);
+  }else if (dst == FWD_NBR){
+    return comm_thread_send(buf, len, fwd_nbr, FWD_NBR, request);
+  }
+  printf("ERROR: invalid dest\n");
+  comm_exit(1);
+  return 0;
+}
+
+unsigned long
+comm_send_to_rank(void* buf, int len, int dst_rank, void* request)
+{
+  return comm_thread_send(buf, len, dst_rank, 99, request);
+}
+
+unsigned long
+comm_send_with_tag(void* buf, int len, int dst, int tag, void* request)
+{
+  return comm_thread_send(buf, len, comm_neighbor_proc(dst), tag, request);
+}
+
+unsigned long
+comm_recv(void* buf, int len, int src, void* request)
+{
+  //recvtag is opposite to the sendtag
+  if (src == BACK_NBR){
+    return comm_thread_recv(buf, len, back_nbr, FWD_NBR, request);
+  }else if (src == FWD_NBR){
+    return comm_thread_recv(buf, len, fwd_nbr, BACK_NBR, request);
+  }
+  printf("ERROR: invalid source\n");
+  comm_exit(1);
+  return 0;
+}
+
+unsigned long
+comm_recv_from_rank(void* buf, int len, int src_rank, void* request)
+{
+  return comm_thread_recv(buf, len, src_rank, 99, request);
+}
+
+unsigned long
+comm_recv_with_tag(void* buf, int len, int src, int tag, void* request)
+{
+  return comm_thread_recv(buf, len, comm_neighbor_proc(src), tag, request);
+}
+
+int comm_query(void* _request)
+{
+  MPI_Request *request = (MPI_Request*)_request;
+  if (!request->pending) return 1;
+
+  comm_thread_mailbox *box = &mailbox[rank];
+  pthread_mutex_lock(&box->lock);
+  comm_thread_msg *msg = comm_thread_match(box, request);
+  pthread_mutex_unlock(&box->lock);
+
+  if (msg == NULL) return 0;
+  comm_thread_deliver(msg, request);
+  return 1;
+}
+
+void comm_free(void* request) {
+  free((void*)request);
+  return;
+}
+
+//this request should be some return value from comm_recv
+void
+comm_wait(void* _request)
+{
+  MPI_Request *request = (MPI_Request*)_request;
+  if (!request->pending) return;
+
+  comm_thread_mailbox *box = &mailbox[rank];
+  pthread_mutex_lock(&box->lock);
+  comm_thread_msg *msg;
+  while ((msg = comm_thread_match(box, request)) == NULL) pthread_cond_wait(&box->cond, &box->lock);
+  pthread_mutex_unlock(&box->lock);
+
+  comm_thread_deliver(msg, request);
+  return;
+}
+
+/* All ranks sum the published buffers in rank order, so every rank
+   ends up with a bitwise identical result. */
+static void
+comm_thread_reduce(double* data, size_t n, int max)
+{
+  if (size == 1) return;
+
+  double *recvbuf = (double*)malloc(n*sizeof(double));
+  if (recvbuf == NULL) {
+    printf("ERROR: malloc failed for reduction buffer\n");
+    comm_exit(1);
+  }
+
+  reduce_slot[rank] = data;
+  comm_thread_barrier();
+
+  for (size_t i=0; i<n; i++) recvbuf[i] = ((double*)reduce_slot[0])[i];
+  for (int r=1; r<size; r++) {
+    double *src = (double*)reduce_slot[r];
+    for (size_t i=0; i<n; i++) {
+      if (max) recvbuf[i] = (src[i] > recvbuf[i]) ? src[i] : recvbuf[i];
+      else recvbuf[i] += src[i];
+    }
+  }
+
+  // everyone must have read the inputs before they are overwritten
+  comm_thread_barrier();
+  memcpy(data, recvbuf, n*sizeof(double));
+  free(recvbuf);
+}
+
+//we always reduce one double value
+void
+comm_allreduce(double* data)
+{
+  comm_thread_reduce(data, 1, 0);
+}
+
+//reduce n double value
+void
+comm_allreduce_array(double* data, size_t size)
+{
+  comm_thread_reduce(data, size, 0);
+}
+
+//we always reduce one double value
+void
+comm_allreduce_max(double* data)
+{
+  comm_thread_reduce(data, 1, 1);
+}
+
+// broadcast from rank 0
+void
+comm_broadcast(void *data, size_t nbytes)
+{
+  if (size == 1) return;
+
+  reduce_slot[rank] = data;
+  comm_thread_barrier();
+  if (rank != 0) memcpy(data, reduce_slot[0], nbytes);
+  comm_thread_barrier();
+}
+
+void
+comm_barrier(void)
+{
+  comm_thread_barrier();
+}
+
+void
+comm_cleanup()
+{
+  comm_thread_barrier();
+}
+
+void
+comm_exit(int ret)
+{
+  exit(ret);
+}
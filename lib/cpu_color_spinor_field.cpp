@@ -5,6 +5,8 @@
 #include <typeinfo>
 #include <color_spinor_field.h>
 #include <color_spinor_field_order.h>
+#include <malloc_quda.h>
+#include <site_order.h>
 
 /*
 Maybe this will be useful at some point
@@ -29,11 +31,11 @@ aligned_malloc(size_t n, void **m0)
   }*/
 
 
-int cpuColorSpinorField::initGhostFaceBuffer =0;
-void* cpuColorSpinorField::fwdGhostFaceBuffer[QUDA_MAX_DIM]; 
-void* cpuColorSpinorField::backGhostFaceBuffer[QUDA_MAX_DIM];
-void* cpuColorSpinorField::fwdGhostFaceSendBuffer[QUDA_MAX_DIM]; 
-void* cpuColorSpinorField::backGhostFaceSendBuffer[QUDA_MAX_DIM];
+COMM_RANK_LOCAL int cpuColorSpinorField::initGhostFaceBuffer =0;
+COMM_RANK_LOCAL void* cpuColorSpinorField::fwdGhostFaceBuffer[QUDA_MAX_DIM]; 
+COMM_RANK_LOCAL void* cpuColorSpinorField::backGhostFaceBuffer[QUDA_MAX_DIM];
+COMM_RANK_LOCAL void* cpuColorSpinorField::fwdGhostFaceSendBuffer[QUDA_MAX_DIM]; 
+COMM_RANK_LOCAL void* cpuColorSpinorField::backGhostFaceSendBuffer[QUDA_MAX_DIM];
 
 cpuColorSpinorField::cpuColorSpinorField(const ColorSpinorParam &param) :
   ColorSpinorField(param), init(false), reference(false), order_double(NULL), order_single(NULL) {
@@ -138,9 +140,9 @@ void cpuColorSpinorField::create(const QudaFieldCreate create) {
     if (fieldOrder == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) {
       int Ls = x[nDim-1];
       v = (void**)malloc(Ls * sizeof(void*));
-      for (int i=0; i<Ls; i++) ((void**)v)[i] = (void*)malloc(bytes / Ls);
+      for (int i=0; i<Ls; i++) ((void**)v)[i] = pool_host_malloc(bytes / Ls);
     } else {
-      v = (void*)malloc(bytes);
+      v = pool_host_malloc(bytes);
     }
     init = true;
   }
@@ -185,9 +187,12 @@ void cpuColorSpinorField::destroy() {
   }
   
   if (init) {
-    if (fieldOrder == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) 
-      for (int i=0; i<x[nDim-1]; i++) free(((void**)v)[i]);
-    free(v);
+    if (fieldOrder == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) {
+      for (int i=0; i<x[nDim-1]; i++) pool_host_free(((void**)v)[i]);
+      free(v);
+    } else {
+      pool_host_free(v);
+    }
     init = false;
   }
 
@@ -197,10 +202,11 @@ template <class D, class S>
 void genericCopy(D &dst, const S &src) {
 
   for (int x=0; x<dst.Volume(); x++) {
+    int xd = dst.SiteIndex(x), xs = src.SiteIndex(x);
     for (int s=0; s<dst.Nspin(); s++) {
       for (int c=0; c<dst.Ncolor(); c++) {
 	for (int z=0; z<2; z++) {
-	  dst(x, s, c, z) = src(x, s, c, z);
+	  dst(xd, s, c, z) = src(xs, s, c, z);
 	}
       }
     }
@@ -210,11 +216,20 @@ void genericCopy(D &dst, const S &src) {
 
 void cpuColorSpinorField::copy(const cpuColorSpinorField &src) {
   checkField(*this, src);
-  if (fieldOrder == src.fieldOrder) {
+  if (fieldOrder == src.fieldOrder && precision == src.precision && siteOrder == src.siteOrder) {
     if (fieldOrder == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) 
-      for (int i=0; i<x[nDim-1]; i++) memcpy(((void**)v)[i], ((void**)src.v)[i], bytes);
+      for (int i=0; i<x[nDim-1]; i++) memcpy(((void**)v)[i], ((void**)src.v)[i], bytes/x[nDim-1]);
     else 
       memcpy(v, src.v, bytes);
+  } else if (fieldOrder == src.fieldOrder && precision == src.precision &&
+	     fieldOrder != QUDA_QOP_DOMAIN_WALL_FIELD_ORDER &&
+	     siteSubset == QUDA_FULL_SITE_SUBSET && 
+	     ((siteOrder == QUDA_LEXICOGRAPHIC_SITE_ORDER && src.siteOrder == QUDA_EVEN_ODD_SITE_ORDER) ||
+	      (siteOrder == QUDA_EVEN_ODD_SITE_ORDER && src.siteOrder == QUDA_LEXICOGRAPHIC_SITE_ORDER))) {
+    // only the site order differs, so whole sites can be moved
+    size_t site_bytes = nColor*nSpin*2*precision;
+    if (siteOrder == QUDA_EVEN_ODD_SITE_ORDER) lexToEvenOdd(v, src.v, site_bytes, nDim, x);
+    else evenOddToLex(v, src.v, site_bytes, nDim, x);
   } else {
     if (precision == QUDA_DOUBLE_PRECISION) {
       if (src.precision == QUDA_DOUBLE_PRECISION) {
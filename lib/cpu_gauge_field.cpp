@@ -1,15 +1,26 @@
 #include <gauge_field.h>
 #include <face_quda.h>
+#include <cpu_reconstruct.h>
+#include <malloc_quda.h>
 #include <assert.h>
 #include <string.h>
 
 cpuGaugeField::cpuGaugeField(const GaugeFieldParam &param) : 
-  GaugeField(param, QUDA_CPU_FIELD_LOCATION), pinned(param.pinned) {
+  GaugeField(param, QUDA_CPU_FIELD_LOCATION), pinned(param.pinned), version(0), ghost_version(-1) {
 
   if (reconstruct != QUDA_RECONSTRUCT_NO && 
-      reconstruct != QUDA_RECONSTRUCT_10)
+      reconstruct != QUDA_RECONSTRUCT_10 &&
+      reconstruct != QUDA_RECONSTRUCT_12 &&
+      reconstruct != QUDA_RECONSTRUCT_8)
     errorQuda("Reconstruction type %d not supported", reconstruct);
 
+  if ((reconstruct == QUDA_RECONSTRUCT_12 || reconstruct == QUDA_RECONSTRUCT_8)) {
+    if (order != QUDA_QDP_GAUGE_ORDER)
+      errorQuda("12 and 8 reconstruction only supported with QDP gauge order");
+    if (link_type != QUDA_WILSON_LINKS && link_type != QUDA_ASQTAD_LONG_LINKS)
+      errorQuda("12 and 8 reconstruction not supported for link type %d", link_type);
+  }
+
   if (reconstruct == QUDA_RECONSTRUCT_10 && order != QUDA_MILC_GAUGE_ORDER)
     errorQuda("10 reconstruction only supported with MILC gauge order");
 
@@ -24,7 +35,7 @@ cpuGaugeField::cpuGaugeField(const GaugeFieldParam &param) :
 	    errorQuda("ERROR: cudaMallocHost failed for gauge\n");
 	  }
 	}else{
-	  gauge[d] = malloc(volume * reconstruct * precision);
+	  gauge[d] = pool_host_malloc(volume * reconstruct * precision);
 	}
 	
 	if(create == QUDA_ZERO_FIELD_CREATE){
@@ -46,7 +57,7 @@ cpuGaugeField::cpuGaugeField(const GaugeFieldParam &param) :
 	  errorQuda("ERROR: cudaMallocHost failed for gauge\n");
 	}
       }else{
-	gauge = (void**)malloc(nDim * volume * reconstruct * precision);
+	gauge = (void**)pool_host_malloc(nDim * volume * reconstruct * precision);
       }
       if(create == QUDA_ZERO_FIELD_CREATE){
 	memset(gauge, 0, nDim*volume * reconstruct * precision);
@@ -71,6 +82,12 @@ cpuGaugeField::cpuGaugeField(const GaugeFieldParam &param) :
       ghost[i] = malloc(nFace * surface[i] * reconstruct * precision);
     }
   }
+
+  // the send buffers and index tables are allocated on the first exchange
+  for (int i=0; i<QUDA_MAX_DIM; i++) {
+    ghost_send[i] = NULL;
+    ghost_index[i] = NULL;
+  }
   
 }
 
@@ -83,7 +100,7 @@ cpuGaugeField::~cpuGaugeField() {
 	if(pinned){
 	  if (gauge[d]) cudaFreeHost(gauge[d]);	  
 	}else{
-	  if (gauge[d]) free(gauge[d]);
+	  if (gauge[d]) pool_host_free(gauge[d]);
 	}
       }
       if (gauge) free(gauge);
@@ -91,7 +108,7 @@ cpuGaugeField::~cpuGaugeField() {
       if(pinned){
 	  if (gauge) cudaFreeHost(gauge);	  
 	}else{
-	  if (gauge) free(gauge);
+	  if (gauge) pool_host_free(gauge);
 	}
     }
   }else{ // QUDA_REFERENCE_FIELD_CREATE 
@@ -109,12 +126,19 @@ cpuGaugeField::~cpuGaugeField() {
     }
   }
   free(ghost);
+
+  for (int i=0; i<QUDA_MAX_DIM; i++) {
+    if (ghost_send[i]) free(ghost_send[i]);
+    if (ghost_index[i]) free(ghost_index[i]);
+  }
   
 }
 
-template <typename Float>
-void packGhost(Float **gauge, Float **ghost, const int nFace, const int *X, 
-	       const int volumeCB, const int *surfaceCB) {
+// Returns the source site (checkerboard index) of every site in the
+// ghost zone of dimension dir, in the order in which they are packed.
+// Entries [0, n) are even sites and [n, 2n) odd sites, where
+// n = nFace*surfaceCB[dir].
+static int* ghostIndexTable(const int dir, const int nFace, const int *X, const int *surfaceCB) {
   int XY=X[0]*X[1];
   int XYZ=X[0]*X[1]*X[2];
 
@@ -143,10 +167,43 @@ void packGhost(Float **gauge, Float **ghost, const int nFace, const int *X,
     { XY,  X[0],    1,   XYZ}
   };
 
+  const int n = nFace*surfaceCB[dir];
+  int *table = (int*)malloc(2*n*sizeof(int));
+  if (table == NULL) errorQuda("malloc failed for ghost index table");
+
+  int even_dst_index = 0;
+  int odd_dst_index = 0;
+
+  for(int d = X[dir]- nFace; d < X[dir]; d++){
+    for(int a = 0; a < A[dir]; a++){
+      for(int b = 0; b < B[dir]; b++){
+	for(int c = 0; c < C[dir]; c++){
+	  int index = ( a*f[dir][0] + b*f[dir][1]+ c*f[dir][2] + d*f[dir][3])>> 1;
+	  int oddness = (a+b+c+d)%2;
+	  if (oddness == 0){ //even
+	    table[even_dst_index++] = index;
+	  }else{ //odd
+	    table[n + odd_dst_index++] = index;
+	  }
+	}//c
+      }//b
+    }//a
+  }//d
+
+  assert( even_dst_index == n);
+  assert( odd_dst_index == n);
+
+  return table;
+}
+
+template <typename Float>
+void packGhost(Float **gauge, Float **ghost, const int nFace, const int *X, 
+	       const int volumeCB, const int *surfaceCB, int* const *index, const int siteSize) {
+
   for(int dir =0; dir < 4; dir++)
     {
-      Float* even_src = gauge[dir];
-      Float* odd_src = gauge[dir] + volumeCB*gaugeSiteSize;
+      const Float* even_src = gauge[dir];
+      const Float* odd_src = gauge[dir] + volumeCB*siteSize;
 
       Float* even_dst;
       Float* odd_dst;
@@ -155,75 +212,52 @@ void packGhost(Float **gauge, Float **ghost, const int nFace, const int *X,
      //only switch if X[dir] is odd and the gridsize in that dimension is greater than 1
       if((X[dir] % 2 ==0) || (commDim(dir) == 1)){
         even_dst = ghost[dir];
-        odd_dst = ghost[dir] + nFace*surfaceCB[dir]*gaugeSiteSize;	
+        odd_dst = ghost[dir] + nFace*surfaceCB[dir]*siteSize;	
      }else{
-	even_dst = ghost[dir] + nFace*surfaceCB[dir]*gaugeSiteSize;
+	even_dst = ghost[dir] + nFace*surfaceCB[dir]*siteSize;
         odd_dst = ghost[dir];
      }
 
-      int even_dst_index = 0;
-      int odd_dst_index = 0;
-
-      int d;
-      int a,b,c;
-      for(d = X[dir]- nFace; d < X[dir]; d++){
-        for(a = 0; a < A[dir]; a++){
-          for(b = 0; b < B[dir]; b++){
-            for(c = 0; c < C[dir]; c++){
-              int index = ( a*f[dir][0] + b*f[dir][1]+ c*f[dir][2] + d*f[dir][3])>> 1;
-              int oddness = (a+b+c+d)%2;
-              if (oddness == 0){ //even
-                for(int i=0;i < 18;i++){
-                  even_dst[18*even_dst_index+i] = even_src[18*index + i];
-                }
-                even_dst_index++;
-              }else{ //odd
-                for(int i=0;i < 18;i++){
-                  odd_dst[18*odd_dst_index+i] = odd_src[18*index + i];
-                }
-                odd_dst_index++;
-              }
-            }//c
-          }//b
-        }//a
-      }//d
-
-      assert( even_dst_index == nFace*surfaceCB[dir]);
-      assert( odd_dst_index == nFace*surfaceCB[dir]);
+      const int n = nFace*surfaceCB[dir];
+      const int *table = index[dir];
+
+#pragma omp parallel for
+      for (int i=0; i<2*n; i++) {
+	const Float *src = (i < n ? even_src : odd_src) + siteSize*table[i];
+	Float *dst = (i < n) ? even_dst + siteSize*i : odd_dst + siteSize*(i-n);
+	for (int j=0; j<siteSize; j++) dst[j] = src[j];
+      }
     }
 
 }
 
 // This does the exchange of the gauge field ghost zone and places it
-// into the ghost array.
-// This should be optimized so it is reused if called multiple times
+// into the ghost array.  The ghost zone is tagged with the version of
+// the links it was built from, so repeated calls are free until the
+// field is modified (see markModified()).
 void cpuGaugeField::exchangeGhost() const {
-  void **send = (void**)malloc(sizeof(void*)*QUDA_MAX_DIM);
+  if (ghost_version == version) return;
 
   for (int d=0; d<nDim; d++) {
-    send[d] = malloc(nFace * surface[d] * reconstruct * precision);
+    if (ghost_send[d] == NULL) {
+      ghost_send[d] = malloc(nFace * surface[d] * reconstruct * precision);
+      if (ghost_send[d] == NULL) errorQuda("malloc failed for ghost send buffer");
+      ghost_index[d] = ghostIndexTable(d, nFace, x, surfaceCB);
+    }
   }
 
   // get the links into a contiguous buffer
   if (precision == QUDA_DOUBLE_PRECISION) {
-    packGhost((double**)gauge, (double**)send, nFace, x, volumeCB, surfaceCB);
+    packGhost((double**)gauge, (double**)ghost_send, nFace, x, volumeCB, surfaceCB, ghost_index, reconstruct);
   } else {
-    packGhost((float**)gauge, (float**)send, nFace, x, volumeCB, surfaceCB);
+    packGhost((float**)gauge, (float**)ghost_send, nFace, x, volumeCB, surfaceCB, ghost_index, reconstruct);
   }
 
   // communicate between nodes
   FaceBuffer faceBuf(x, nDim, reconstruct, nFace, precision);
-  faceBuf.exchangeCpuLink(ghost, send);
+  faceBuf.exchangeCpuLink(ghost, ghost_send);
 
-  for (int i=0; i<4; i++) {
-    double sum = 0.0;
-    for (int j=0; j<nFace*surface[i]*reconstruct; j++) {
-      sum += ((double*)(ghost[i]))[j];
-    }
-  }
-
-  for (int d=0; d<nDim; d++) free(send[d]);
-  free(send);
+  ghost_version = version;
 }
 
 void cpuGaugeField::setGauge(void**_gauge)
@@ -233,4 +267,119 @@ void cpuGaugeField::setGauge(void**_gauge)
 	      "is of QUDA_REFERENCE_FIELD_CREATE type\n");
   }
   gauge= _gauge;
+  markModified();
+}
+
+double cpuGaugeField::LinkScale(const int dim, const int *x) const
+{
+  if (link_type == QUDA_WILSON_LINKS) {
+    if (dim < 3) return anisotropy;
+    if (t_boundary == QUDA_PERIODIC_T) return 1.0;
+    // the boundary links are the last time slice of the global lattice
+    int T = commDim(3)*this->x[3];
+    int t = (commCoords(3)*this->x[3] + x[3] + T) % T;
+    return (t == T-1) ? -1.0 : 1.0;
+  } else if (link_type == QUDA_ASQTAD_LONG_LINKS) {
+    // staggered phases and boundary as in staggered_dslash_core.h
+    int x1 = (x[0] + this->x[0]) % this->x[0];
+    int x2 = (x[1] + this->x[1]) % this->x[1];
+    int x4 = (x[3] + this->x[3]) % this->x[3];
+    int sign = 1;
+    switch (dim) {
+    case 0: sign = (x4%2 == 1) ? -1 : 1; break;
+    case 1: sign = ((x4+x1)%2 == 1) ? -1 : 1; break;
+    case 2: sign = ((x4+x1+x2)%2 == 1) ? -1 : 1; break;
+    case 3: sign = (t_boundary == QUDA_ANTI_PERIODIC_T && x4 >= this->x[3]-3) ? -1 : 1; break;
+    }
+    return -24.0*tadpole*tadpole*sign;
+  }
+  errorQuda("Link scale not defined for link type %d", link_type);
+  return 0.0;
+}
+
+// local coordinates of checkerboard site i with the given parity
+static inline void siteCoords(int *c, const int i, const int parity, const int *X)
+{
+  int X1h = X[0]/2;
+  int za = i / X1h;
+  int x1h = i - za*X1h;
+  int zb = za / X[1];
+  c[1] = za - zb*X[1];
+  c[3] = zb / X[2];
+  c[2] = zb - c[3]*X[2];
+  c[0] = 2*x1h + ((c[1] + c[2] + c[3] + parity) & 1);
+}
+
+template <typename Float>
+static void compressLinks(Float **dst, Float **src, const cpuGaugeField &field)
+{
+  const QudaReconstructType recon = field.Reconstruct();
+  const double tol = (sizeof(Float) == sizeof(double)) ? 1e-10 : 1e-4;
+  int bad = 0;
+
+  for (int dir=0; dir<4; dir++) {
+#pragma omp parallel for reduction(+:bad)
+    for (int i=0; i<field.Volume(); i++) {
+      int parity = i / field.VolumeCB();
+      int c[4];
+      siteCoords(c, i - parity*field.VolumeCB(), parity, field.X());
+
+      const Float *U = src[dir] + i*gaugeSiteSize;
+      Float *r = dst[dir] + i*recon;
+      packLink(r, U, recon);
+      if (recon == QUDA_RECONSTRUCT_NO) continue;
+
+      // check the link can be recovered
+      Float tmp[gaugeSiteSize];
+      const Float *V = loadLink(tmp, r, recon, (Float)field.LinkScale(dir, c));
+      for (int j=0; j<gaugeSiteSize; j++) {
+	if (fabs(V[j] - U[j]) > tol*(1.0 + fabs(U[j]))) { bad++; break; }
+      }
+    }
+  }
+
+  if (bad) errorQuda("%d links cannot be stored with reconstruct %d", bad, recon);
+}
+
+template <typename Float>
+static void expandLinks(Float **dst, Float **src, const cpuGaugeField &field)
+{
+  const QudaReconstructType recon = field.Reconstruct();
+
+  for (int dir=0; dir<4; dir++) {
+#pragma omp parallel for
+    for (int i=0; i<field.Volume(); i++) {
+      int parity = i / field.VolumeCB();
+      int c[4];
+      siteCoords(c, i - parity*field.VolumeCB(), parity, field.X());
+
+      Float *U = dst[dir] + i*gaugeSiteSize;
+      Float u0 = (recon == QUDA_RECONSTRUCT_NO) ? 1.0 : field.LinkScale(dir, c);
+      const Float *V = loadLink(U, src[dir] + i*recon, recon, u0);
+      if (V != U) for (int j=0; j<gaugeSiteSize; j++) U[j] = V[j];
+    }
+  }
+}
+
+void cpuGaugeField::loadLinks(void **links)
+{
+  if (order != QUDA_QDP_GAUGE_ORDER) errorQuda("Only QDP gauge order supported");
+
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    compressLinks((double**)gauge, (double**)links, *this);
+  } else {
+    compressLinks((float**)gauge, (float**)links, *this);
+  }
+  markModified();
+}
+
+void cpuGaugeField::saveLinks(void **links) const
+{
+  if (order != QUDA_QDP_GAUGE_ORDER) errorQuda("Only QDP gauge order supported");
+
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    expandLinks((double**)links, (double**)gauge, *this);
+  } else {
+    expandLinks((float**)links, (float**)gauge, *this);
+  }
 }
@@ -10,6 +10,8 @@
 #include "misc_helpers.h"
 #include <face_quda.h>
 #include <dslash_quda.h>
+#include <malloc_quda.h>
+#include <profile_quda.h>
 
 // Easy to switch between overlapping communication or not
 #ifdef OVERLAP_COMMS
@@ -18,15 +20,15 @@
 #define CUDAMEMCPY(dst, src, size, type, stream) cudaMemcpy(dst, src, size, type)
 #endif
 
-void* cudaColorSpinorField::buffer_h = 0;
-void* cudaColorSpinorField::buffer_d = 0;
-bool cudaColorSpinorField::bufferInit = false;
-size_t cudaColorSpinorField::bufferBytes = 0;
+COMM_RANK_LOCAL void* cudaColorSpinorField::buffer_h = 0;
+COMM_RANK_LOCAL void* cudaColorSpinorField::buffer_d = 0;
+COMM_RANK_LOCAL bool cudaColorSpinorField::bufferInit = false;
+COMM_RANK_LOCAL size_t cudaColorSpinorField::bufferBytes = 0;
 
-int cudaColorSpinorField::initGhostFaceBuffer = 0;
-void* cudaColorSpinorField::fwdGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
-void* cudaColorSpinorField::backGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
-QudaPrecision cudaColorSpinorField::facePrecision; 
+COMM_RANK_LOCAL int cudaColorSpinorField::initGhostFaceBuffer = 0;
+COMM_RANK_LOCAL void* cudaColorSpinorField::fwdGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
+COMM_RANK_LOCAL void* cudaColorSpinorField::backGhostFaceBuffer[QUDA_MAX_DIM]; //gpu memory
+COMM_RANK_LOCAL QudaPrecision cudaColorSpinorField::facePrecision; 
 
 extern bool kernelPackT;
 
@@ -169,15 +171,8 @@ void cudaColorSpinorField::create(const QudaFieldCreate create) {
 
   if (create != QUDA_REFERENCE_FIELD_CREATE) {
     // Overallocate to hold tface bytes extra
-    if (cudaMalloc((void**)&v, bytes) == cudaErrorMemoryAllocation) {
-      errorQuda("Error allocating spinor: bytes=%lu", (unsigned long)bytes);
-    }
-
-    if (precision == QUDA_HALF_PRECISION) {
-      if (cudaMalloc((void**)&norm, norm_bytes) == cudaErrorMemoryAllocation) {
-	errorQuda("Error allocating norm");
-      }
-    }
+    v = pool_device_malloc(bytes);
+    if (precision == QUDA_HALF_PRECISION) norm = pool_device_malloc(norm_bytes);
     alloc = true;
   }
 
@@ -244,8 +239,8 @@ void cudaColorSpinorField::freeBuffer() {
 
 void cudaColorSpinorField::destroy() {
   if (alloc) {
-    cudaFree(v);
-    if (precision == QUDA_HALF_PRECISION) cudaFree(norm);
+    pool_device_free(v);
+    if (precision == QUDA_HALF_PRECISION) pool_device_free(norm);
     if (siteSubset == QUDA_FULL_SITE_SUBSET) {
       delete even;
       delete odd;
@@ -280,6 +275,22 @@ void cudaColorSpinorField::zero() {
   if (precision == QUDA_HALF_PRECISION) cudaMemset(norm, 0, norm_bytes);
 }
 
+size_t cudaColorSpinorField::BackupBytes() const {
+  return bytes + (precision == QUDA_HALF_PRECISION ? norm_bytes : 0);
+}
+
+void cudaColorSpinorField::backup(void *host) const {
+  cudaMemcpy(host, v, bytes, cudaMemcpyDeviceToHost);
+  if (precision == QUDA_HALF_PRECISION) cudaMemcpy((char*)host + bytes, norm, norm_bytes, cudaMemcpyDeviceToHost);
+  checkCudaError();
+}
+
+void cudaColorSpinorField::restore(const void *host) {
+  cudaMemcpy(v, host, bytes, cudaMemcpyHostToDevice);
+  if (precision == QUDA_HALF_PRECISION) cudaMemcpy(norm, (const char*)host + bytes, norm_bytes, cudaMemcpyHostToDevice);
+  checkCudaError();
+}
+
 
 void cudaColorSpinorField::zeroPad() {
   size_t pad_bytes = (stride - volume) * precision * fieldOrder;
@@ -306,6 +317,18 @@ void cudaColorSpinorField::loadSpinorField(const ColorSpinorField &src) {
     errorQuda("Volumes %d %d don't match", volume, src.Volume());
   }
 
+  // reorder lexicographic fields on the host first (see site_order.h)
+  if (src.SiteOrder() == QUDA_LEXICOGRAPHIC_SITE_ORDER && siteOrder == QUDA_EVEN_ODD_SITE_ORDER) {
+    if (typeid(src) == typeid(cudaColorSpinorField)) errorQuda("Must use a cpuColorSpinorField here");
+    ColorSpinorParam param(src); // acquire all attributes of this
+    param.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+    param.create = QUDA_NULL_FIELD_CREATE;
+    cpuColorSpinorField tmp(param);
+    tmp.copy(dynamic_cast<const cpuColorSpinorField&>(src));
+    loadSpinorField(tmp);
+    return;
+  }
+
   if (SiteOrder() != src.SiteOrder()) {
     errorQuda("Subset orders don't match");
   }
@@ -384,6 +407,10 @@ void cudaColorSpinorField::loadSpinorField(const ColorSpinorField &src) {
     }									\
   }
 
+  // a device source is only reordered
+  const bool host = (typeid(src) == typeid(cpuColorSpinorField));
+  ProfileRegion transfer(host ? "h2d" : "reorder", 0, host ? src.Bytes() : src.Bytes() + bytes);
+
   if (REORDER_LOCATION == QUDA_CPU_FIELD_LOCATION && typeid(src) == typeid(cpuColorSpinorField)) {
     // (temporary?) bug fix for padding
     memset(buffer_h, 0, bufferBytes);
@@ -456,6 +483,17 @@ void cudaColorSpinorField::saveSpinorField(ColorSpinorField &dest) const {
     errorQuda("Volumes %d %d don't match", volume, dest.Volume());
   }
 
+  if (dest.SiteOrder() == QUDA_LEXICOGRAPHIC_SITE_ORDER && siteOrder == QUDA_EVEN_ODD_SITE_ORDER) {
+    if (typeid(dest) == typeid(cudaColorSpinorField)) errorQuda("Must use a cpuColorSpinorField here");
+    ColorSpinorParam param(dest); // acquire all attributes of this
+    param.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+    param.create = QUDA_NULL_FIELD_CREATE;
+    cpuColorSpinorField tmp(param);
+    saveSpinorField(tmp);
+    dynamic_cast<cpuColorSpinorField&>(dest).copy(tmp);
+    return;
+  }
+
   if (SiteOrder() != dest.SiteOrder()) {
     errorQuda("Subset orders don't match");
   }
@@ -539,6 +577,10 @@ void cudaColorSpinorField::saveSpinorField(ColorSpinorField &dest) const {
       }									\
   }
 
+  // a device destination is only reordered
+  const bool host = (typeid(dest) == typeid(cpuColorSpinorField));
+  ProfileRegion transfer(host ? "d2h" : "reorder", 0, host ? dest.Bytes() : dest.Bytes() + bytes);
+
   if (REORDER_LOCATION == QUDA_CPU_FIELD_LOCATION && typeid(dest) == typeid(cpuColorSpinorField)) {
     cudaMemcpy(buffer_h, v, bytes, cudaMemcpyDeviceToHost);
     
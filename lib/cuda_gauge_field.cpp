@@ -30,10 +30,10 @@ cudaGaugeField::~cudaGaugeField() {
 }
 
 // FIXME temporary hack 
-static double anisotropy_;
-static double fat_link_max_;
-static const int *X_;
-static QudaTboundary t_boundary_; 
+static COMM_RANK_LOCAL double anisotropy_;
+static COMM_RANK_LOCAL double fat_link_max_;
+static COMM_RANK_LOCAL const int *X_;
+static COMM_RANK_LOCAL QudaTboundary t_boundary_; 
 #include <pack_gauge.h>
 
 template <typename Float, typename FloatN>
@@ -144,6 +144,18 @@ void cudaGaugeField::loadCPUField(const cpuGaugeField &cpu, const QudaFieldLocat
 
   checkField(cpu);
 
+  if (cpu.Reconstruct() == QUDA_RECONSTRUCT_12 || cpu.Reconstruct() == QUDA_RECONSTRUCT_8) {
+    // the host links are compressed: expand them before packing
+    GaugeFieldParam param;
+    cpu.fill(param);
+    param.reconstruct = QUDA_RECONSTRUCT_NO;
+    param.create = QUDA_NULL_FIELD_CREATE;
+    cpuGaugeField expanded(param);
+    cpu.saveLinks(expanded.gauge);
+    loadCPUField(expanded, pack_location);
+    return;
+  }
+
   if (pack_location == QUDA_CUDA_FIELD_LOCATION) {
     errorQuda("Not implemented"); // awaiting Guochun's new gauge packing
   } else if (pack_location == QUDA_CPU_FIELD_LOCATION) {
@@ -341,6 +353,18 @@ void cudaGaugeField::saveCPUField(cpuGaugeField &cpu, const QudaFieldLocation &p
 {
   if (geometry != QUDA_VECTOR_GEOMETRY) errorQuda("Only vector geometry is supported");
 
+  if (cpu.Reconstruct() == QUDA_RECONSTRUCT_12 || cpu.Reconstruct() == QUDA_RECONSTRUCT_8) {
+    // save to full links and compress them into the host field
+    GaugeFieldParam param;
+    cpu.fill(param);
+    param.reconstruct = QUDA_RECONSTRUCT_NO;
+    param.create = QUDA_NULL_FIELD_CREATE;
+    cpuGaugeField expanded(param);
+    saveCPUField(expanded, pack_location);
+    cpu.loadLinks(expanded.gauge);
+    return;
+  }
+
   // do device-side reordering then copy
   if (pack_location == QUDA_CUDA_FIELD_LOCATION) {
     // check parameters are suitable for device-side packing
@@ -445,6 +469,7 @@ void cudaGaugeField::saveCPUField(cpuGaugeField &cpu, const QudaFieldLocation &p
     errorQuda("Invalid pack location %d", pack_location);
   }
 
+  cpu.markModified();
 }
 
 void cudaGaugeField::backup() const {
@@ -60,52 +60,55 @@ struct DslashParam {
 // as opposed to multiple calls to cudaMemcpy()
 bool kernelPackT = false;
 
-DslashParam dslashParam;
+// the launch state below belongs to a rank (see interface_quda.cpp);
+// the constants in device memory are shared, and are the same on
+// every rank since all ranks have the same local lattice
+COMM_RANK_LOCAL DslashParam dslashParam;
 
 // these are set in initDslashConst
-int Vspatial;
+COMM_RANK_LOCAL int Vspatial;
 
-static cudaEvent_t packEnd[Nstream];
-static cudaEvent_t gatherStart[Nstream];
-static cudaEvent_t gatherEnd[Nstream];
-static cudaEvent_t scatterStart[Nstream];
-static cudaEvent_t scatterEnd[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t packEnd[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t gatherStart[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t gatherEnd[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t scatterStart[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t scatterEnd[Nstream];
 
-static struct timeval dslashStart_h;
+static COMM_RANK_LOCAL struct timeval dslashStart_h;
 #ifdef MULTI_GPU
-static struct timeval commsStart[Nstream];
-static struct timeval commsEnd[Nstream];
+static COMM_RANK_LOCAL struct timeval commsStart[Nstream];
+static COMM_RANK_LOCAL struct timeval commsEnd[Nstream];
 #endif
 
 // these events are only used for profiling
 #ifdef DSLASH_PROFILING
 #define DSLASH_TIME_PROFILE() dslashTimeProfile()
 
-static cudaEvent_t dslashStart;
-static cudaEvent_t dslashEnd;
-static cudaEvent_t packStart[Nstream];
-static cudaEvent_t kernelStart[Nstream];
-static cudaEvent_t kernelEnd[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t dslashStart;
+static COMM_RANK_LOCAL cudaEvent_t dslashEnd;
+static COMM_RANK_LOCAL cudaEvent_t packStart[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t kernelStart[Nstream];
+static COMM_RANK_LOCAL cudaEvent_t kernelEnd[Nstream];
 
 // dimension 2 because we want absolute and relative
-float packTime[Nstream][2];
-float gatherTime[Nstream][2];
-float commsTime[Nstream][2];
-float scatterTime[Nstream][2];
-float kernelTime[Nstream][2];
-float dslashTime;
+COMM_RANK_LOCAL float packTime[Nstream][2];
+COMM_RANK_LOCAL float gatherTime[Nstream][2];
+COMM_RANK_LOCAL float commsTime[Nstream][2];
+COMM_RANK_LOCAL float scatterTime[Nstream][2];
+COMM_RANK_LOCAL float kernelTime[Nstream][2];
+COMM_RANK_LOCAL float dslashTime;
 #define CUDA_EVENT_RECORD(a,b) cudaEventRecord(a,b)
 #else
 #define CUDA_EVENT_RECORD(a,b)
 #define DSLASH_TIME_PROFILE()
 #endif
 
-static FaceBuffer *face;
-static cudaColorSpinorField *inSpinor;
+static COMM_RANK_LOCAL FaceBuffer *face;
+static COMM_RANK_LOCAL cudaColorSpinorField *inSpinor;
 
 // For tuneLaunch() to uniquely identify a suitable set of launch parameters, we need copies of a few of
 // the constants set by initDslashConstants().
-static struct {
+static COMM_RANK_LOCAL struct {
   int x[4];
   int Ls;
   unsigned long long VolumeCB() { return x[0]*x[1]*x[2]*x[3]/2; }
@@ -114,8 +117,8 @@ static struct {
 
 // dslashTuning = QUDA_TUNE_YES enables autotuning when the dslash is
 // first launched
-static QudaTune dslashTuning = QUDA_TUNE_NO;
-static QudaVerbosity verbosity = QUDA_SILENT;
+static COMM_RANK_LOCAL QudaTune dslashTuning = QUDA_TUNE_NO;
+static COMM_RANK_LOCAL QudaVerbosity verbosity = QUDA_SILENT;
 
 void setDslashTuning(QudaTune tune, QudaVerbosity verbose)
 {
@@ -177,6 +180,8 @@ static inline __device__ float2 short22float2(short2 a) {
 
 #include <blas_quda.h>
 #include <face_quda.h>
+#include <profile_quda.h>
+#include <trace_quda.h>
 
 
 __global__ void dummyKernel() {
@@ -418,6 +423,11 @@ class DslashCuda : public Tunable {
   }
   virtual int Nface() { return 2; }
 
+  // compulsory traffic of the fields bound to textures
+  long long bytes() const { // FIXME for multi-GPU
+    return dslashTraffic.gauge + dslashTraffic.long_gauge + dslashTraffic.clover + dslashTraffic.spinor;
+  }
+
   virtual void initTuneParam(TuneParam &param) const
   {
     Tunable::initTuneParam(param);
@@ -1227,10 +1237,10 @@ void printDslashProfile() {
 }
 #endif
 
-int gatherCompleted[Nstream];
-int previousDir[Nstream];
-int commsCompleted[Nstream];
-int commDimTotal;
+COMM_RANK_LOCAL int gatherCompleted[Nstream];
+COMM_RANK_LOCAL int previousDir[Nstream];
+COMM_RANK_LOCAL int commsCompleted[Nstream];
+COMM_RANK_LOCAL int commDimTotal;
 
 /**
  * Initialize the arrays used for the dynamic scheduling.
@@ -1270,6 +1280,10 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
   dslashParam.kernel_type = INTERIOR_KERNEL;
   dslashParam.threads = volume;
 
+  // the flops and bytes are those of the whole operator, since those
+  // of the individual kernels are not known (see DslashCuda::bytes())
+  ProfileRegion region("dslash", dslash.flops(), dslash.bytes());
+
   CUDA_EVENT_RECORD(dslashStart, 0);
   gettimeofday(&dslashStart_h, NULL);
 
@@ -1277,6 +1291,8 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
   for(int i = 3; i >=0; i--){
     if (!dslashParam.commDim[i]) continue;
 
+    ProfileRegion pack("pack", 0, 4*face->MessageBytes(i)); // read and written, both directions
+
     // Record the start of the packing
     CUDA_EVENT_RECORD(packStart[2*i+0], streams[Nstream-1]);
     CUDA_EVENT_RECORD(packStart[2*i+1], streams[Nstream-1]);
@@ -1293,6 +1309,8 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
     if (!dslashParam.commDim[i]) continue;
 
     for (int dir=1; dir>=0; dir--) {
+      ProfileRegion gather("d2h", 0, face->MessageBytes(i));
+
       cudaStreamWaitEvent(streams[2*i+dir], packEnd[2*i+dir], 0);
 
       // Record the start of the gathering
@@ -1307,9 +1325,12 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
   }
 #endif
 
-  CUDA_EVENT_RECORD(kernelStart[Nstream-1], streams[Nstream-1]);
-  dslash.apply(streams[Nstream-1]);
-  CUDA_EVENT_RECORD(kernelEnd[Nstream-1], streams[Nstream-1]);
+  {
+    ProfileRegion interior("interior");
+    CUDA_EVENT_RECORD(kernelStart[Nstream-1], streams[Nstream-1]);
+    dslash.apply(streams[Nstream-1]);
+    CUDA_EVENT_RECORD(kernelEnd[Nstream-1], streams[Nstream-1]);
+  }
 
 #ifdef MULTI_GPU
   initDslashCommsPattern();
@@ -1338,6 +1359,12 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
 	    commsCompleted[2*i+dir] = 1;
 	    completeSum++;
 	    gettimeofday(&commsEnd[2*i+dir], NULL);
+
+	    // sent and received
+	    profileRecord("comms", traceTime(commsStart[2*i+dir]), traceTime(commsEnd[2*i+dir]),
+			  0, 2*face->MessageBytes(i), 2*i+dir);
+
+	    ProfileRegion scatter("h2d", 0, face->MessageBytes(i));
 	    
 	    // Record the end of the scattering
 	    CUDA_EVENT_RECORD(scatterStart[2*i+dir], streams[2*i+dir]);
@@ -1365,6 +1392,7 @@ void dslashCuda(DslashCuda &dslash, const size_t regSize, const int parity, cons
     cudaStreamWaitEvent(streams[Nstream-1], scatterEnd[2*i], 0);
     cudaStreamWaitEvent(streams[Nstream-1], scatterEnd[2*i+1], 0);
 
+    ProfileRegion exterior("exterior");
     CUDA_EVENT_RECORD(kernelStart[2*i], streams[Nstream-1]);
     dslash.apply(streams[Nstream-1]); // all faces use this stream
     CUDA_EVENT_RECORD(kernelEnd[2*i], streams[Nstream-1]);
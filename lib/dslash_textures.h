@@ -102,6 +102,17 @@ texture<short2, 1, cudaReadModeNormalizedFloat> interTexHalf2;
 texture<float, 1, cudaReadModeElementType> interTexHalfNorm;
 texture<float, 1, cudaReadModeElementType> interTexHalf2Norm;
 
+// The bytes of the fields that are bound to textures, i.e., the
+// compulsory traffic of a dslash kernel that reads them (see
+// DslashCuda::bytes()).  Both parities of the gauge field are read
+// (the forward and backward links), but only one of the clover term.
+static struct {
+  size_t gauge;
+  size_t long_gauge;
+  size_t clover;
+  size_t spinor;
+} dslashTraffic;
+
 void bindGaugeTex(const cudaGaugeField &gauge, const int oddBit, 
 			 void **gauge0, void **gauge1)
 {
@@ -112,6 +123,7 @@ void bindGaugeTex(const cudaGaugeField &gauge, const int oddBit,
     *gauge0 = gauge.even;
     *gauge1 = gauge.odd;
   }
+  dslashTraffic.gauge = gauge.bytes;
   
   if (gauge.reconstruct == QUDA_RECONSTRUCT_NO) {
     if (gauge.precision == QUDA_DOUBLE_PRECISION) {
@@ -141,6 +153,7 @@ void bindGaugeTex(const cudaGaugeField &gauge, const int oddBit,
 
 void unbindGaugeTex(const cudaGaugeField &gauge)
 {
+  dslashTraffic.gauge = 0;
   if (gauge.reconstruct == QUDA_RECONSTRUCT_NO) {
     if (gauge.precision == QUDA_DOUBLE_PRECISION) {
       cudaUnbindTexture(gauge0TexDouble2); 
@@ -176,6 +189,7 @@ void bindFatGaugeTex(const cudaGaugeField &gauge, const int oddBit, void **gauge
     *gauge0 = gauge.even;
     *gauge1 = gauge.odd;
   }
+  dslashTraffic.gauge = gauge.bytes;
   
   if (gauge.precision == QUDA_DOUBLE_PRECISION) {
     cudaBindTexture(0, fatGauge0TexDouble, *gauge0, gauge.bytes/2); 
@@ -191,6 +205,7 @@ void bindFatGaugeTex(const cudaGaugeField &gauge, const int oddBit, void **gauge
 
 void unbindFatGaugeTex(const cudaGaugeField &gauge)
 {
+  dslashTraffic.gauge = 0;
   if (gauge.precision == QUDA_DOUBLE_PRECISION) {
     cudaUnbindTexture(fatGauge0TexDouble);
     cudaUnbindTexture(fatGauge1TexDouble);
@@ -212,6 +227,7 @@ void bindLongGaugeTex(const cudaGaugeField &gauge, const int oddBit, void **gaug
     *gauge0 = gauge.even;
     *gauge1 = gauge.odd;
   }
+  dslashTraffic.long_gauge = gauge.bytes;
   
   if (gauge.precision == QUDA_DOUBLE_PRECISION) {
     cudaBindTexture(0, longGauge0TexDouble, *gauge0, gauge.bytes/2); 
@@ -237,6 +253,7 @@ void bindLongGaugeTex(const cudaGaugeField &gauge, const int oddBit, void **gaug
 
 void unbindLongGaugeTex(const cudaGaugeField &gauge)
 {
+  dslashTraffic.long_gauge = 0;
   if (gauge.precision == QUDA_DOUBLE_PRECISION) {
     cudaUnbindTexture(longGauge0TexDouble);
     cudaUnbindTexture(longGauge1TexDouble);
@@ -267,6 +284,9 @@ int bindSpinorTex(const size_t spinor_bytes, const size_t norm_bytes, const spin
 {
   int size;
 
+  const size_t field_bytes = spinor_bytes + (inNorm ? norm_bytes : 0);
+  dslashTraffic.spinor = (1 + (out ? 1 : 0) + (x ? 1 : 0)) * field_bytes;
+
   if (typeid(spinorFloat) == typeid(double2)) {
     cudaBindTexture(0, spinorTexDouble, in, spinor_bytes); 
     if (out) cudaBindTexture(0, interTexDouble, out, spinor_bytes);
@@ -309,6 +329,8 @@ template <typename spinorFloat>
 void unbindSpinorTex(const spinorFloat *in, const float *inNorm, const spinorFloat *out=0, const float *outNorm=0,
 			    const spinorFloat *x=0, const float *xNorm=0)
 {
+  dslashTraffic.spinor = 0;
+
   if (typeid(spinorFloat) == typeid(double2)) {
     cudaUnbindTexture(spinorTexDouble);
     if (out) cudaUnbindTexture(interTexDouble);
@@ -361,6 +383,7 @@ QudaPrecision bindCloverTex(const FullClover clover, const int oddBit,
     *cloverP = clover.even;
     *cloverNormP = clover.evenNorm;
   }
+  dslashTraffic.clover = clover.bytes + (clover.precision == QUDA_HALF_PRECISION ? clover.norm_bytes : 0);
 
   if (clover.precision == QUDA_DOUBLE_PRECISION) {
     cudaBindTexture(0, cloverTexDouble, *cloverP, clover.bytes); 
@@ -376,6 +399,7 @@ QudaPrecision bindCloverTex(const FullClover clover, const int oddBit,
 
 void unbindCloverTex(const FullClover clover)
 {
+  dslashTraffic.clover = 0;
   if (clover.precision == QUDA_DOUBLE_PRECISION) {
     cudaUnbindTexture(cloverTexDouble);
   } else if (clover.precision == QUDA_SINGLE_PRECISION) {
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <quda_internal.h>
+#include <gauge_field.h>
+#include <face_quda.h>
+
+// Wire formats used to cut the size of halo messages.
+//
+// Spinor faces are sent in 16-bit fixed point: each block of
+// blockLength reals (one site for host-ordered faces) is preceded by
+// a float norm equal to the largest magnitude in the block, and the
+// reals are stored as shorts scaled by MAX_SHORT/norm.  This is the
+// same representation as QUDA's half-precision fields.
+//
+// Link faces are sent as the first two rows of each matrix (12 reals).
+// The third row is reconstructed on receipt as the complex conjugate
+// of the cross product of the first two, so this is only exact for
+// SU(3) matrices.  Links that have been multiplied by -1 (boundary
+// conditions or staggered phases) are flagged by a per-link sign bit.
+// If any link in the face is not in SU(3) (e.g., fat links), the
+// whole face is sent uncompressed instead.
+//
+//   [ int mode ][ int nLinks ][ sign bits, (nLinks+31)/32 words ][ payload ]
+//
+// where mode is LINK_FACE_RAW or LINK_FACE_RECON_12.
+
+bool compressSpinorHalo = false;
+bool compressLinkHalo = false;
+
+#define MAX_SHORT 32767.0f
+
+#define LINK_FACE_RAW 0
+#define LINK_FACE_RECON_12 1
+
+void setHaloCompression(const char *type)
+{
+  if (type == NULL || strcmp(type, "none") == 0) {
+    compressSpinorHalo = false;
+    compressLinkHalo = false;
+  } else if (strcmp(type, "spinor") == 0) {
+    compressSpinorHalo = true;
+    compressLinkHalo = false;
+  } else if (strcmp(type, "link") == 0) {
+    compressSpinorHalo = false;
+    compressLinkHalo = true;
+  } else if (strcmp(type, "all") == 0) {
+    compressSpinorHalo = true;
+    compressLinkHalo = true;
+  } else {
+    errorQuda("Invalid halo compression type %s", type);
+  }
+}
+
+size_t spinorFaceWireBytes(int nBlocks, int blockLength)
+{
+  size_t bytes = (size_t)nBlocks*(sizeof(float) + blockLength*sizeof(short));
+  return (bytes + 7) & ~((size_t)7);
+}
+
+template <typename Float>
+static void packSpinorFace(char *wire, const Float *face, int nBlocks, int blockLength)
+{
+  const size_t block_bytes = sizeof(float) + blockLength*sizeof(short);
+  for (int i=0; i<nBlocks; i++) {
+    const Float *in = face + (size_t)i*blockLength;
+    char *out = wire + i*block_bytes;
+
+    float norm = 0.0f;
+    for (int j=0; j<blockLength; j++) {
+      float a = fabs((float)in[j]);
+      if (a > norm) norm = a;
+    }
+    memcpy(out, &norm, sizeof(float));
+
+    short *s = (short*)(out + sizeof(float));
+    float scale = (norm > 0.0f) ? MAX_SHORT / norm : 0.0f;
+    for (int j=0; j<blockLength; j++) s[j] = (short)lrintf((float)in[j] * scale);
+  }
+}
+
+template <typename Float>
+static void unpackSpinorFace(Float *face, const char *wire, int nBlocks, int blockLength)
+{
+  const size_t block_bytes = sizeof(float) + blockLength*sizeof(short);
+  for (int i=0; i<nBlocks; i++) {
+    Float *out = face + (size_t)i*blockLength;
+    const char *in = wire + i*block_bytes;
+
+    float norm;
+    memcpy(&norm, in, sizeof(float));
+    const short *s = (const short*)(in + sizeof(float));
+    Float scale = (Float)norm / (Float)MAX_SHORT;
+    for (int j=0; j<blockLength; j++) out[j] = scale * s[j];
+  }
+}
+
+size_t compressSpinorFace(void *wire, const void *face, int nBlocks, int blockLength, QudaPrecision precision)
+{
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    packSpinorFace((char*)wire, (const double*)face, nBlocks, blockLength);
+  } else if (precision == QUDA_SINGLE_PRECISION) {
+    packSpinorFace((char*)wire, (const float*)face, nBlocks, blockLength);
+  } else {
+    errorQuda("Halo compression not supported for precision %d", precision);
+  }
+  return spinorFaceWireBytes(nBlocks, blockLength);
+}
+
+void decompressSpinorFace(void *face, const void *wire, int nBlocks, int blockLength, QudaPrecision precision)
+{
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    unpackSpinorFace((double*)face, (const char*)wire, nBlocks, blockLength);
+  } else if (precision == QUDA_SINGLE_PRECISION) {
+    unpackSpinorFace((float*)face, (const char*)wire, nBlocks, blockLength);
+  } else {
+    errorQuda("Halo compression not supported for precision %d", precision);
+  }
+}
+
+// header rounded up so that the payload is 8-byte aligned
+static inline size_t linkFaceHeaderBytes(int nLinks)
+{
+  size_t bytes = 2*sizeof(int) + ((nLinks+31)/32)*sizeof(uint32_t);
+  return (bytes + 7) & ~((size_t)7);
+}
+
+size_t linkFaceWireBytes(int nLinks, QudaPrecision precision)
+{
+  return linkFaceHeaderBytes(nLinks) + (size_t)nLinks*gaugeSiteSize*precision;
+}
+
+// third row of an SU(3) matrix: conj(row0 x row1)
+template <typename Float>
+static inline void reconstructRow3(Float *r2, const Float *r0, const Float *r1)
+{
+  for (int c=0; c<3; c++) {
+    int a = (c+1)%3, b = (c+2)%3;
+    // (r0[a]*r1[b] - r0[b]*r1[a])^*
+    Float re = r0[2*a]*r1[2*b] - r0[2*a+1]*r1[2*b+1] - (r0[2*b]*r1[2*a] - r0[2*b+1]*r1[2*a+1]);
+    Float im = r0[2*a]*r1[2*b+1] + r0[2*a+1]*r1[2*b] - (r0[2*b]*r1[2*a+1] + r0[2*b+1]*r1[2*a]);
+    r2[2*c] = re;
+    r2[2*c+1] = -im;
+  }
+}
+
+template <typename Float>
+static size_t packLinkFace(char *wire, const Float *links, int nLinks)
+{
+  const Float tol = (sizeof(Float) == sizeof(double)) ? 1e-12 : 1e-5;
+
+  int *header = (int*)wire;
+  uint32_t *sign = (uint32_t*)(wire + 2*sizeof(int));
+  Float *payload = (Float*)(wire + linkFaceHeaderBytes(nLinks));
+
+  header[1] = nLinks;
+  memset(sign, 0, ((nLinks+31)/32)*sizeof(uint32_t));
+
+  for (int i=0; i<nLinks; i++) {
+    const Float *U = links + (size_t)i*gaugeSiteSize;
+    Float r2[6];
+    reconstructRow3(r2, U, U+6);
+
+    Float dplus = 0.0, dminus = 0.0;
+    for (int j=0; j<6; j++) {
+      Float p = fabs(U[12+j] - r2[j]), m = fabs(U[12+j] + r2[j]);
+      if (p > dplus) dplus = p;
+      if (m > dminus) dminus = m;
+    }
+
+    if (dplus < tol) {
+      // positive orientation, nothing to flag
+    } else if (dminus < tol) {
+      sign[i/32] |= (1u << (i%32));
+    } else {
+      // not an SU(3) matrix: fall back to sending the face as is
+      header[0] = LINK_FACE_RAW;
+      memcpy(payload, links, (size_t)nLinks*gaugeSiteSize*sizeof(Float));
+      return linkFaceHeaderBytes(nLinks) + (size_t)nLinks*gaugeSiteSize*sizeof(Float);
+    }
+
+    memcpy(payload + (size_t)i*12, U, 12*sizeof(Float));
+  }
+
+  header[0] = LINK_FACE_RECON_12;
+  return linkFaceHeaderBytes(nLinks) + (size_t)nLinks*12*sizeof(Float);
+}
+
+template <typename Float>
+static void unpackLinkFace(Float *links, const char *wire, int nLinks)
+{
+  const int *header = (const int*)wire;
+  const uint32_t *sign = (const uint32_t*)(wire + 2*sizeof(int));
+  const Float *payload = (const Float*)(wire + linkFaceHeaderBytes(nLinks));
+
+  if (header[1] != nLinks) errorQuda("Link face size mismatch (%d != %d)", header[1], nLinks);
+
+  if (header[0] == LINK_FACE_RAW) {
+    memcpy(links, payload, (size_t)nLinks*gaugeSiteSize*sizeof(Float));
+    return;
+  } else if (header[0] != LINK_FACE_RECON_12) {
+    errorQuda("Invalid link face mode %d", header[0]);
+  }
+
+  for (int i=0; i<nLinks; i++) {
+    Float *U = links + (size_t)i*gaugeSiteSize;
+    memcpy(U, payload + (size_t)i*12, 12*sizeof(Float));
+    reconstructRow3(U+12, U, U+6);
+    if (sign[i/32] & (1u << (i%32))) {
+      for (int j=12; j<18; j++) U[j] = -U[j];
+    }
+  }
+}
+
+size_t compressLinkFace(void *wire, const void *links, int nLinks, QudaPrecision precision)
+{
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    return packLinkFace((char*)wire, (const double*)links, nLinks);
+  } else if (precision == QUDA_SINGLE_PRECISION) {
+    return packLinkFace((char*)wire, (const float*)links, nLinks);
+  }
+  errorQuda("Halo compression not supported for precision %d", precision);
+  return 0;
+}
+
+void decompressLinkFace(void *links, const void *wire, int nLinks, QudaPrecision precision)
+{
+  if (precision == QUDA_DOUBLE_PRECISION) {
+    unpackLinkFace((double*)links, (const char*)wire, nLinks);
+  } else if (precision == QUDA_SINGLE_PRECISION) {
+    unpackLinkFace((float*)links, (const char*)wire, nLinks);
+  } else {
+    errorQuda("Halo compression not supported for precision %d", precision);
+  }
+}
@@ -6,16 +6,18 @@
 #include <quda.h>
 #include <string.h>
 #include <sys/time.h>
+#ifndef THREAD_COMMS
 #include <mpi.h>
+#endif
 #include <cuda.h>
 
 #include <fat_force_quda.h>
 
 using namespace std;
 
-cudaStream_t *stream;
+COMM_RANK_LOCAL cudaStream_t *stream;
 
-bool globalReduce = true;
+COMM_RANK_LOCAL bool globalReduce = true;
 
 FaceBuffer::FaceBuffer(const int *X, const int nDim, const int Ninternal, 
 		       const int nFace, const QudaPrecision precision, const int Ls) : 
@@ -53,6 +55,14 @@ FaceBuffer::FaceBuffer(const int *X, const int nDim, const int Ninternal,
     }
   }
 
+  for(int dir =0 ; dir < QUDA_MAX_DIM; dir++){
+    compressed_fwd_nbr_spinor_sendbuf[dir] = NULL;
+    compressed_back_nbr_spinor_sendbuf[dir] = NULL;
+    compressed_fwd_nbr_spinor[dir] = NULL;
+    compressed_back_nbr_spinor[dir] = NULL;
+    compressed_nbytes[dir] = 0;
+  }
+
   for(int dir =0 ; dir < 4;dir++){
     nbytes[dir] = nFace*faceVolumeCB[dir]*Ninternal*precision;
     if (precision == QUDA_HALF_PRECISION) nbytes[dir] += nFace*faceVolumeCB[dir]*sizeof(float);
@@ -150,6 +160,17 @@ FaceBuffer::~FaceBuffer()
       back_nbr_spinor[dir] = NULL;
     }    
 
+    if(compressed_fwd_nbr_spinor_sendbuf[dir]){
+      free(compressed_fwd_nbr_spinor_sendbuf[dir]);
+      free(compressed_back_nbr_spinor_sendbuf[dir]);
+      free(compressed_fwd_nbr_spinor[dir]);
+      free(compressed_back_nbr_spinor[dir]);
+      compressed_fwd_nbr_spinor_sendbuf[dir] = NULL;
+      compressed_back_nbr_spinor_sendbuf[dir] = NULL;
+      compressed_fwd_nbr_spinor[dir] = NULL;
+      compressed_back_nbr_spinor[dir] = NULL;
+    }
+
 #ifdef GPU_DIRECT
     pageable_fwd_nbr_spinor_sendbuf[dir] = NULL;
     pageable_back_nbr_spinor_sendbuf[dir]=NULL;
@@ -181,6 +202,27 @@ FaceBuffer::~FaceBuffer()
   }
 }
 
+// Half-precision faces are already 16-bit, so they are never compressed further
+bool FaceBuffer::compressFaces() const
+{
+  return compressSpinorHalo && precision != QUDA_HALF_PRECISION;
+}
+
+void FaceBuffer::allocateCompressedBuffers()
+{
+  for(int dir =0; dir < 4; dir++){
+    if(compressed_fwd_nbr_spinor_sendbuf[dir]) continue;
+    compressed_nbytes[dir] = spinorFaceWireBytes(nFace*faceVolumeCB[dir], Ninternal);
+    compressed_fwd_nbr_spinor_sendbuf[dir] = malloc(compressed_nbytes[dir]);
+    compressed_back_nbr_spinor_sendbuf[dir] = malloc(compressed_nbytes[dir]);
+    compressed_fwd_nbr_spinor[dir] = malloc(compressed_nbytes[dir]);
+    compressed_back_nbr_spinor[dir] = malloc(compressed_nbytes[dir]);
+    if (compressed_fwd_nbr_spinor_sendbuf[dir] == NULL || compressed_back_nbr_spinor_sendbuf[dir] == NULL ||
+	compressed_fwd_nbr_spinor[dir] == NULL || compressed_back_nbr_spinor[dir] == NULL)
+      errorQuda("malloc failed for compressed spinor face buffers");
+  }
+}
+
 void FaceBuffer::pack(cudaColorSpinorField &in, int parity, int dagger, int dim, cudaStream_t *stream_p)
 {
   if(!commDimPartitioned(dim)) return;
@@ -212,6 +254,22 @@ void FaceBuffer::commsStart(int dir) {
   int downtags[4] = {XDOWN, YDOWN, ZDOWN, TDOWN};
   int uptags[4] = {XUP, YUP, ZUP, TUP};
 
+  if (compressFaces()) {
+    // the faces travel in 16-bit form, see face_compress.cpp
+    allocateCompressedBuffers();
+    int nblocks = nFace*faceVolumeCB[dim];
+    if (dir %2 == 0) {
+      comm_recv_with_tag(compressed_fwd_nbr_spinor[dim], compressed_nbytes[dim], fwd_nbr[dim], downtags[dim], recv_request1[dim]);
+      compressSpinorFace(compressed_back_nbr_spinor_sendbuf[dim], back_nbr_spinor_sendbuf[dim], nblocks, Ninternal, precision);
+      comm_send_with_tag(compressed_back_nbr_spinor_sendbuf[dim], compressed_nbytes[dim], back_nbr[dim], downtags[dim], send_request1[dim]);
+    } else {
+      comm_recv_with_tag(compressed_back_nbr_spinor[dim], compressed_nbytes[dim], back_nbr[dim], uptags[dim], recv_request2[dim]);
+      compressSpinorFace(compressed_fwd_nbr_spinor_sendbuf[dim], fwd_nbr_spinor_sendbuf[dim], nblocks, Ninternal, precision);
+      comm_send_with_tag(compressed_fwd_nbr_spinor_sendbuf[dim], compressed_nbytes[dim], fwd_nbr[dim], uptags[dim], send_request2[dim]);
+    }
+    return;
+  }
+
   if (dir %2 == 0) {
     // Prepost all receives
 
@@ -240,6 +298,11 @@ int FaceBuffer::commsQuery(int dir) {
   if(dir%2==0) {
     if (comm_query(recv_request1[dim]) && 
 	comm_query(send_request1[dim])) {
+      if (compressFaces()) {
+	decompressSpinorFace(fwd_nbr_spinor[dim], compressed_fwd_nbr_spinor[dim], 
+			     nFace*faceVolumeCB[dim], Ninternal, precision);
+	return 1;
+      }
 #ifndef GPU_DIRECT
       memcpy(fwd_nbr_spinor[dim], pageable_fwd_nbr_spinor[dim], nbytes[dim]);
 #endif
@@ -248,6 +311,11 @@ int FaceBuffer::commsQuery(int dir) {
   } else {
     if (comm_query(recv_request2[dim]) &&
 	comm_query(send_request2[dim])) {
+      if (compressFaces()) {
+	decompressSpinorFace(back_nbr_spinor[dim], compressed_back_nbr_spinor[dim], 
+			     nFace*faceVolumeCB[dim], Ninternal, precision);
+	return 1;
+      }
 #ifndef GPU_DIRECT
       memcpy(back_nbr_spinor[dim], pageable_back_nbr_spinor[dim], nbytes[dim]);
 #endif
@@ -293,11 +361,25 @@ void FaceBuffer::exchangeCpuSpinor(cpuColorSpinorField &spinor, int oddBit, int
   int uptags[4] = {XUP, YUP, ZUP, TUP};
   int downtags[4] = {XDOWN, YDOWN, ZDOWN, TDOWN};
   
-  for(int i= 0;i < 4; i++){
-    comm_recv_with_tag(spinor.backGhostFaceBuffer[i], len[i], back_nbr[i], uptags[i], recv_request1[i]);
-    comm_recv_with_tag(spinor.fwdGhostFaceBuffer[i], len[i], fwd_nbr[i], downtags[i], recv_request2[i]);    
-    comm_send_with_tag(spinor.fwdGhostFaceSendBuffer[i], len[i], fwd_nbr[i], uptags[i], send_request1[i]);
-    comm_send_with_tag(spinor.backGhostFaceSendBuffer[i], len[i], back_nbr[i], downtags[i], send_request2[i]);
+  if (compressFaces()) {
+    // the faces travel in 16-bit form, one norm per site
+    allocateCompressedBuffers();
+    for(int i= 0;i < 4; i++){
+      int nblocks = nFace*faceVolumeCB[i];
+      compressSpinorFace(compressed_fwd_nbr_spinor_sendbuf[i], spinor.fwdGhostFaceSendBuffer[i], nblocks, Ninternal, precision);
+      compressSpinorFace(compressed_back_nbr_spinor_sendbuf[i], spinor.backGhostFaceSendBuffer[i], nblocks, Ninternal, precision);
+      comm_recv_with_tag(compressed_back_nbr_spinor[i], compressed_nbytes[i], back_nbr[i], uptags[i], recv_request1[i]);
+      comm_recv_with_tag(compressed_fwd_nbr_spinor[i], compressed_nbytes[i], fwd_nbr[i], downtags[i], recv_request2[i]);
+      comm_send_with_tag(compressed_fwd_nbr_spinor_sendbuf[i], compressed_nbytes[i], fwd_nbr[i], uptags[i], send_request1[i]);
+      comm_send_with_tag(compressed_back_nbr_spinor_sendbuf[i], compressed_nbytes[i], back_nbr[i], downtags[i], send_request2[i]);
+    }
+  } else {
+    for(int i= 0;i < 4; i++){
+      comm_recv_with_tag(spinor.backGhostFaceBuffer[i], len[i], back_nbr[i], uptags[i], recv_request1[i]);
+      comm_recv_with_tag(spinor.fwdGhostFaceBuffer[i], len[i], fwd_nbr[i], downtags[i], recv_request2[i]);    
+      comm_send_with_tag(spinor.fwdGhostFaceSendBuffer[i], len[i], fwd_nbr[i], uptags[i], send_request1[i]);
+      comm_send_with_tag(spinor.backGhostFaceSendBuffer[i], len[i], back_nbr[i], downtags[i], send_request2[i]);
+    }
   }
 
   for(int i=0;i < 4;i++){
@@ -307,6 +389,51 @@ void FaceBuffer::exchangeCpuSpinor(cpuColorSpinorField &spinor, int oddBit, int
     comm_wait(send_request2[i]);
   }
 
+  if (compressFaces()) {
+    for(int i=0;i < 4;i++){
+      int nblocks = nFace*faceVolumeCB[i];
+      decompressSpinorFace(spinor.backGhostFaceBuffer[i], compressed_back_nbr_spinor[i], nblocks, Ninternal, precision);
+      decompressSpinorFace(spinor.fwdGhostFaceBuffer[i], compressed_fwd_nbr_spinor[i], nblocks, Ninternal, precision);
+    }
+  }
+
+}
+
+// Sends n link faces, each to its own neighbor, and receives n faces.
+// With compressLinkHalo set the SU(3) links travel as 12 reals, see
+// face_compress.cpp.
+static void exchangeLinkFaces(int n, void** recvbuf, void** sendbuf, const int *nLinks,
+			      const int *src_nbr, const int *dst_nbr, const int *tag, QudaPrecision precision)
+{
+  MPI_Request recv_request[8], send_request[8];
+  void *wire_recv[8], *wire_send[8];
+  if (n > 8) errorQuda("Too many link faces (%d) in one exchange", n);
+
+  for(int i=0; i<n; i++){
+    int len = nLinks[i]*gaugeSiteSize*precision;
+    if (compressLinkHalo) {
+      size_t wire_bytes = linkFaceWireBytes(nLinks[i], precision);
+      wire_recv[i] = malloc(wire_bytes);
+      wire_send[i] = malloc(wire_bytes);
+      if (wire_recv[i] == NULL || wire_send[i] == NULL) errorQuda("malloc failed for compressed link face");
+      size_t send_bytes = compressLinkFace(wire_send[i], sendbuf[i], nLinks[i], precision);
+      comm_recv_with_tag(wire_recv[i], wire_bytes, src_nbr[i], tag[i], &recv_request[i]);
+      comm_send_with_tag(wire_send[i], send_bytes, dst_nbr[i], tag[i], &send_request[i]);
+    } else {
+      comm_recv_with_tag(recvbuf[i], len, src_nbr[i], tag[i], &recv_request[i]);
+      comm_send_with_tag(sendbuf[i], len, dst_nbr[i], tag[i], &send_request[i]);
+    }
+  }
+
+  for(int i=0; i<n; i++){
+    comm_wait(&recv_request[i]);
+    comm_wait(&send_request[i]);
+    if (compressLinkHalo) {
+      decompressLinkFace(recvbuf[i], wire_recv[i], nLinks[i], precision);
+      free(wire_recv[i]);
+      free(wire_send[i]);
+    }
+  }
 }
 
 
@@ -315,6 +442,13 @@ void FaceBuffer::exchangeCpuLink(void** ghost_link, void** link_sendbuf) {
   int fwd_nbrs[4] = {X_FWD_NBR, Y_FWD_NBR, Z_FWD_NBR, T_FWD_NBR};
   int back_nbrs[4] = {X_BACK_NBR, Y_BACK_NBR, Z_BACK_NBR, T_BACK_NBR};
 
+  if (compressLinkHalo && Ninternal == gaugeSiteSize) {
+    int nLinks[4];
+    for(int dir =0; dir < 4; dir++) nLinks[dir] = 2*nFace*faceVolumeCB[dir];
+    exchangeLinkFaces(4, ghost_link, link_sendbuf, nLinks, back_nbrs, fwd_nbrs, uptags, precision);
+    return;
+  }
+
   for(int dir =0; dir < 4; dir++)
     {
       int len = 2*nFace*faceVolumeCB[dir]*Ninternal;
@@ -368,31 +502,31 @@ void commDimPartitionedSet(int dir) { comm_dim_partitioned_set(dir);}
 #define gaugeSiteSize 18
 
 #ifdef GPU_DIRECT
-static void* fwd_nbr_staple_cpu[4];
-static void* back_nbr_staple_cpu[4];
-static void* fwd_nbr_staple_sendbuf_cpu[4];
-static void* back_nbr_staple_sendbuf_cpu[4];
+static COMM_RANK_LOCAL void* fwd_nbr_staple_cpu[4];
+static COMM_RANK_LOCAL void* back_nbr_staple_cpu[4];
+static COMM_RANK_LOCAL void* fwd_nbr_staple_sendbuf_cpu[4];
+static COMM_RANK_LOCAL void* back_nbr_staple_sendbuf_cpu[4];
 #endif
 
-static void* fwd_nbr_staple_gpu[4];
-static void* back_nbr_staple_gpu[4];
-
-static void* fwd_nbr_staple[4];
-static void* back_nbr_staple[4];
-static void* fwd_nbr_staple_sendbuf[4];
-static void* back_nbr_staple_sendbuf[4];
-
-static int dims[4];
-static int X1,X2,X3,X4;
-static int V;
-static int Vh;
-static int Vs[4], Vsh[4];
-static int Vs_x, Vs_y, Vs_z, Vs_t;
-static int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
-static MPI_Request llfat_send_request1[4];
-static MPI_Request llfat_recv_request1[4];
-static MPI_Request llfat_send_request2[4];
-static MPI_Request llfat_recv_request2[4];
+static COMM_RANK_LOCAL void* fwd_nbr_staple_gpu[4];
+static COMM_RANK_LOCAL void* back_nbr_staple_gpu[4];
+
+static COMM_RANK_LOCAL void* fwd_nbr_staple[4];
+static COMM_RANK_LOCAL void* back_nbr_staple[4];
+static COMM_RANK_LOCAL void* fwd_nbr_staple_sendbuf[4];
+static COMM_RANK_LOCAL void* back_nbr_staple_sendbuf[4];
+
+static COMM_RANK_LOCAL int dims[4];
+static COMM_RANK_LOCAL int X1,X2,X3,X4;
+static COMM_RANK_LOCAL int V;
+static COMM_RANK_LOCAL int Vh;
+static COMM_RANK_LOCAL int Vs[4], Vsh[4];
+static COMM_RANK_LOCAL int Vs_x, Vs_y, Vs_z, Vs_t;
+static COMM_RANK_LOCAL int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
+static COMM_RANK_LOCAL MPI_Request llfat_send_request1[4];
+static COMM_RANK_LOCAL MPI_Request llfat_recv_request1[4];
+static COMM_RANK_LOCAL MPI_Request llfat_send_request2[4];
+static COMM_RANK_LOCAL MPI_Request llfat_recv_request2[4];
 
 #include "gauge_field.h"
 extern void setup_dims_in_gauge(int *XX);
@@ -428,7 +562,7 @@ setup_dims(int* X)
 void 
 exchange_llfat_init(QudaPrecision prec)
 {
-  static int initialized = 0;
+  static COMM_RANK_LOCAL int initialized = 0;
   if (initialized){
     return;
   }
@@ -614,6 +748,17 @@ exchange_sitelink(int*X, Float** sitelink, Float** ghost_sitelink, Float** ghost
     int len = Vsh[dir]*gaugeSiteSize*sizeof(Float);
     Float* ghost_sitelink_back = ghost_sitelink[dir];
     Float* ghost_sitelink_fwd = ghost_sitelink[dir] + 8*Vsh[dir]*gaugeSiteSize;
+
+    if (compressLinkHalo) {
+      void* recvbuf[2] = {ghost_sitelink_back, ghost_sitelink_fwd};
+      void* sendbuf[2] = {sitelink_fwd_sendbuf[dir], sitelink_back_sendbuf[dir]};
+      int nLinks[2] = {8*Vsh[dir], 8*Vsh[dir]};
+      int src_nbr[2] = {back_neighbors[dir], fwd_neighbors[dir]};
+      int dst_nbr[2] = {fwd_neighbors[dir], back_neighbors[dir]};
+      int tags[2] = {up_tags[dir], down_tags[dir]};
+      exchangeLinkFaces(2, recvbuf, sendbuf, nLinks, src_nbr, dst_nbr, tags, (QudaPrecision)sizeof(Float));
+      continue;
+    }
     
     MPI_Request recv_request1;
     MPI_Request recv_request2;
@@ -641,9 +786,9 @@ void exchange_cpu_sitelink(int* X,
 			   QudaPrecision gPrecision, QudaGaugeParam* param, int optflag)
 {  
   setup_dims(X);
-  static void*  sitelink_fwd_sendbuf[4];
-  static void*  sitelink_back_sendbuf[4];
-  static int allocated = 0;
+  static COMM_RANK_LOCAL void*  sitelink_fwd_sendbuf[4];
+  static COMM_RANK_LOCAL void*  sitelink_back_sendbuf[4];
+  static COMM_RANK_LOCAL int allocated = 0;
 
   if(!allocated){
     for(int i=0;i < 4;i++){
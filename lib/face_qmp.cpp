@@ -15,7 +15,7 @@ using namespace std;
 
 cudaStream_t *stream;
 
-bool globalReduce = true;
+COMM_RANK_LOCAL bool globalReduce = true;
 
 // Easy to switch between overlapping communication or not
 #ifdef OVERLAP_COMMS
@@ -8,6 +8,7 @@
 #include "fat_force_quda.h"
 #include <quda_internal.h>
 #include <face_quda.h>
+#include <comm_quda.h>
 #include "misc_helpers.h"
 #include <assert.h>
 #include <cuda.h>
@@ -19,10 +20,10 @@
 #include "face_quda.h"
 #endif
 
-static double anisotropy_;
+static COMM_RANK_LOCAL double anisotropy_;
 extern float fat_link_max_;
-static int X_[4];
-static QudaTboundary t_boundary_;
+static COMM_RANK_LOCAL int X_[4];
+static COMM_RANK_LOCAL QudaTboundary t_boundary_;
 
 #define SHORT_LENGTH 65536
 #define SCALE_FLOAT ((SHORT_LENGTH-1) / 2.f)
@@ -725,11 +726,11 @@ loadLinkToGPU(cudaGaugeField* cudaGauge, cpuGaugeField* cpuGauge, QudaGaugeParam
 
 
 
-  static void* ghost_cpuGauge[4];
-  static void* ghost_cpuGauge_diag[16];
+  static COMM_RANK_LOCAL void* ghost_cpuGauge[4];
+  static COMM_RANK_LOCAL void* ghost_cpuGauge_diag[16];
 
 #ifdef MULTI_GPU
-  static int allocated = 0;
+  static COMM_RANK_LOCAL int allocated = 0;
   int Vs[4] = {2*Vsh_x, 2*Vsh_y, 2*Vsh_z, 2*Vsh_t};
   
   if(allocated == 0){
@@ -974,6 +975,7 @@ storeLinkToCPU(cpuGaugeField* cpuGauge, cudaGaugeField *cudaGauge, QudaGaugePara
     printf("ERROR: half precision not supported in this function %s\n", __FUNCTION__);
     exit(1);
   }
+  cpuGauge->markModified();
 }
 
 
@@ -43,6 +43,25 @@ void GaugeField::checkField(const GaugeField &a) {
   if (a.tadpole != tadpole) errorQuda("tadpole does not match %e %e", tadpole, a.tadpole);
 }
 
+void GaugeField::fill(GaugeFieldParam &param) const {
+  param.nDim = nDim;
+  for (int i=0; i<nDim; i++) param.x[i] = x[i];
+  param.pad = pad;
+  param.precision = precision;
+  param.verbosity = verbosity;
+  param.nColor = nColor;
+  param.nFace = nFace;
+  param.reconstruct = reconstruct;
+  param.order = order;
+  param.fixed = fixed;
+  param.link_type = link_type;
+  param.t_boundary = t_boundary;
+  param.anisotropy = anisotropy;
+  param.tadpole = tadpole;
+  param.create = create;
+  param.geometry = geometry;
+}
+
 std::ostream& operator<<(std::ostream& output, const GaugeFieldParam& param) {
   output << static_cast<const LatticeFieldParam &>(param);
   output << "nColor = " << param.nColor << std::endl;
@@ -0,0 +1,716 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <face_quda.h>
+#include <malloc_quda.h>
+#include <parallel_io.h>
+#include <gauge_io.h>
+
+// Reader for gauge configurations in NERSC, ILDG (LIME) and MILC
+// format and writer for NERSC format, see readGaugeFileQuda() and
+// writeGaugeFileQuda() in quda.h.
+//
+// The headers are parsed from a mapping of the file.  Each rank then
+// reads its own sublattice with the partitioned I/O of parallel_io.h
+// and decodes it in a single OpenMP loop: links are byte-swapped and
+// converted from the file precision, stored in the requested order,
+// and the checksum and plaquette are accumulated along the way.  All
+// three formats store the global lattice with x running fastest and
+// the four links of a site together, so the neighbouring links
+// needed for the plaquette are read from the file as the forward
+// faces of the sublattice, and no halo exchange is needed.
+
+enum GaugeFileFormat { NERSC_FORMAT, ILDG_FORMAT, MILC_FORMAT };
+
+static const char *format_name[] = { "NERSC", "ILDG", "MILC" };
+
+struct GaugeFile {
+  GaugeFileFormat format;
+  const char *data;  // start of the binary data
+  int X[4];          // global lattice dimensions
+  int file_prec;     // bytes per real in the file
+  bool swap;         // whether the file byte order differs from ours
+  int rows;          // rows stored per link (2 or 3)
+
+  bool has_checksum;
+  unsigned int checksum[2]; // NERSC: sum, ILDG: suma/sumb, MILC: sum29/sum31
+  bool has_plaquette;
+  double plaquette;
+
+  size_t siteBytes() const { return 4 * rows * 6 * file_prec; }
+};
+
+static bool bigEndianHost()
+{
+  const unsigned int one = 1;
+  return *(const char*)&one == 0;
+}
+
+static inline unsigned int swap32(unsigned int x)
+{
+  return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+static inline unsigned long long swap64(unsigned long long x)
+{
+  return ((unsigned long long)swap32((unsigned int)x) << 32) | swap32((unsigned int)(x >> 32));
+}
+
+static inline unsigned int readBig32(const char *p)
+{
+  unsigned int x;
+  memcpy(&x, p, 4);
+  return bigEndianHost() ? x : swap32(x);
+}
+
+static inline unsigned long long readBig64(const char *p)
+{
+  unsigned long long x;
+  memcpy(&x, p, 8);
+  return bigEndianHost() ? x : swap64(x);
+}
+
+static inline unsigned int rotl(unsigned int x, int n) { return n ? (x << n) | (x >> (32 - n)) : x; }
+
+// value of the text between <tag> and </tag> in an XML record
+static bool xmlValue(char *value, size_t len, const char *xml, size_t xml_len, const char *tag)
+{
+  char open[64];
+  snprintf(open, sizeof(open), "<%s>", tag);
+  const char *end = xml + xml_len;
+  for (const char *p = xml; p + strlen(open) < end; p++) {
+    if (strncmp(p, open, strlen(open))) continue;
+    p += strlen(open);
+    size_t n = 0;
+    while (p + n < end && p[n] != '<' && n < len-1) n++;
+    memcpy(value, p, n);
+    value[n] = '\0';
+    return true;
+  }
+  return false;
+}
+
+static void parseNersc(GaugeFile &f, const char *map, size_t bytes)
+{
+  const char *end = (const char*)memmem(map, bytes < 65536 ? bytes : 65536, "END_HEADER", 10);
+  if (!end) errorQuda("No END_HEADER in NERSC header");
+  const char *data = (const char*)memchr(end, '\n', map + bytes - end);
+  if (!data) errorQuda("Truncated NERSC header");
+  f.data = data + 1;
+
+  bool big_endian = true;
+  f.file_prec = 0;
+  f.rows = 0;
+  f.has_checksum = false;
+  f.has_plaquette = false;
+  for (int d=0; d<4; d++) f.X[d] = 0;
+
+  for (const char *line = map; line < end; ) {
+    const char *eol = (const char*)memchr(line, '\n', end - line);
+    if (!eol) eol = end;
+    char buf[256];
+    size_t n = (size_t)(eol - line) < sizeof(buf) - 1 ? eol - line : sizeof(buf) - 1;
+    memcpy(buf, line, n);
+    buf[n] = '\0';
+    line = eol + 1;
+
+    char key[128], value[128];
+    if (sscanf(buf, " %127[A-Z_0-9] = %127s", key, value) != 2) continue;
+
+    int d;
+    if (sscanf(key, "DIMENSION_%d", &d) == 1 && d >= 1 && d <= 4) {
+      f.X[d-1] = atoi(value);
+    } else if (!strcmp(key, "CHECKSUM")) {
+      f.checksum[0] = (unsigned int)strtoul(value, NULL, 16);
+      f.has_checksum = true;
+    } else if (!strcmp(key, "PLAQUETTE")) {
+      f.plaquette = atof(value);
+      f.has_plaquette = true;
+    } else if (!strcmp(key, "DATATYPE")) {
+      if (!strcmp(value, "4D_SU3_GAUGE")) f.rows = 2;
+      else if (!strcmp(value, "4D_SU3_GAUGE_3x3")) f.rows = 3;
+      else errorQuda("Unsupported NERSC datatype %s", value);
+    } else if (!strcmp(key, "FLOATING_POINT")) {
+      if (!strncmp(value, "IEEE32", 6)) f.file_prec = 4;
+      else if (!strncmp(value, "IEEE64", 6)) f.file_prec = 8;
+      else errorQuda("Unsupported NERSC floating point type %s", value);
+      big_endian = strstr(value, "LITTLE") == NULL;
+    }
+  }
+
+  if (!f.rows || !f.file_prec) errorQuda("NERSC header lacks DATATYPE or FLOATING_POINT");
+  f.swap = (big_endian != bigEndianHost());
+}
+
+static void parseIldg(GaugeFile &f, const char *map, size_t bytes)
+{
+  f.data = NULL;
+  f.file_prec = 0;
+  f.rows = 3;
+  f.swap = !bigEndianHost(); // ILDG binary data is big endian
+  f.has_checksum = false;
+  f.has_plaquette = false;
+  for (int d=0; d<4; d++) f.X[d] = 0;
+
+  static const char *dim_tag[] = { "lx", "ly", "lz", "lt" };
+
+  for (size_t offset = 0; offset + LIME_HEADER_BYTES <= bytes; ) {
+    const char *header = map + offset;
+    if (readBig32(header) != LIME_MAGIC) errorQuda("Bad LIME record at offset %lu", (unsigned long)offset);
+    size_t length = readBig64(header + 8);
+    const char *type = header + 16;
+    const char *record = header + LIME_HEADER_BYTES;
+    if (offset + LIME_HEADER_BYTES + length > bytes) errorQuda("Truncated LIME record %.128s", type);
+
+    char value[64];
+    if (!strncmp(type, "ildg-format", 128)) {
+      if (xmlValue(value, sizeof(value), record, length, "precision")) f.file_prec = atoi(value) / 8;
+      for (int d=0; d<4; d++)
+	if (xmlValue(value, sizeof(value), record, length, dim_tag[d])) f.X[d] = atoi(value);
+    } else if (!strncmp(type, "ildg-binary-data", 128)) {
+      f.data = record;
+    } else if (!strncmp(type, "scidac-checksum", 128)) {
+      if (xmlValue(value, sizeof(value), record, length, "suma")) {
+	f.checksum[0] = (unsigned int)strtoul(value, NULL, 16);
+	if (xmlValue(value, sizeof(value), record, length, "sumb")) {
+	  f.checksum[1] = (unsigned int)strtoul(value, NULL, 16);
+	  f.has_checksum = true;
+	}
+      }
+    }
+
+    offset += LIME_HEADER_BYTES + ((length + 7) & ~(size_t)7);
+  }
+
+  if (!f.data) errorQuda("No ildg-binary-data record found");
+  if (f.file_prec != 4 && f.file_prec != 8) errorQuda("Unsupported ILDG precision %d", 8*f.file_prec);
+}
+
+#define MILC_MAGIC 20103
+#define MILC_HEADER_BYTES 96
+
+static void parseMilc(GaugeFile &f, const char *map, size_t)
+{
+  unsigned int magic;
+  memcpy(&magic, map, 4);
+  f.swap = (magic != MILC_MAGIC);
+
+  unsigned int word[4];
+  memcpy(word, map + 4, 16);
+  for (int d=0; d<4; d++) f.X[d] = f.swap ? swap32(word[d]) : word[d];
+
+  unsigned int order;
+  memcpy(&order, map + 84, 4);
+  if (order != 0) errorQuda("Only MILC files in natural site order are supported");
+
+  memcpy(word, map + 88, 8);
+  f.checksum[0] = f.swap ? swap32(word[0]) : word[0];
+  f.checksum[1] = f.swap ? swap32(word[1]) : word[1];
+  f.has_checksum = true;
+  f.has_plaquette = false;
+
+  f.data = map + MILC_HEADER_BYTES;
+  f.file_prec = 4; // MILC configurations are stored in single precision
+  f.rows = 3;
+}
+
+// real number i of the site data, in host byte order
+static inline double fileReal(const GaugeFile &f, const char *site, int i)
+{
+  if (f.file_prec == 8) {
+    unsigned long long x;
+    memcpy(&x, site + 8*i, 8);
+    if (f.swap) x = swap64(x);
+    double v;
+    memcpy(&v, &x, 8);
+    return v;
+  } else {
+    unsigned int x;
+    memcpy(&x, site + 4*i, 4);
+    if (f.swap) x = swap32(x);
+    float v;
+    memcpy(&v, &x, 4);
+    return v;
+  }
+}
+
+// link mu of a site, completing the third row of two-row links
+static inline void fileLink(double *U, const GaugeFile &f, const char *site, int mu)
+{
+  const int n = 6 * f.rows;
+  for (int i=0; i<n; i++) U[i] = fileReal(f, site, mu*n + i);
+  if (f.rows == 2) {
+    // row2 = conj(row0 x row1)
+    for (int c=0; c<3; c++) {
+      int a = (c+1)%3, b = (c+2)%3;
+      const double *u = U, *v = U + 6;
+      U[12+2*c] = (u[2*a]*v[2*b] - u[2*a+1]*v[2*b+1]) - (u[2*b]*v[2*a] - u[2*b+1]*v[2*a+1]);
+      U[12+2*c+1] = -((u[2*a]*v[2*b+1] + u[2*a+1]*v[2*b]) - (u[2*b]*v[2*a+1] + u[2*b+1]*v[2*a]));
+    }
+  }
+}
+
+// C = A*B
+static inline void su3Mul(double *C, const double *A, const double *B)
+{
+  for (int i=0; i<3; i++) {
+    for (int j=0; j<3; j++) {
+      double re = 0.0, im = 0.0;
+      for (int k=0; k<3; k++) {
+	double a_re = A[6*i+2*k], a_im = A[6*i+2*k+1];
+	double b_re = B[6*k+2*j], b_im = B[6*k+2*j+1];
+	re += a_re*b_re - a_im*b_im;
+	im += a_re*b_im + a_im*b_re;
+      }
+      C[6*i+2*j] = re;
+      C[6*i+2*j+1] = im;
+    }
+  }
+}
+
+// Re tr(A B^dagger)
+static inline double reTraceMulDagger(const double *A, const double *B)
+{
+  double tr = 0.0;
+  for (int i=0; i<18; i++) tr += A[i]*B[i];
+  return tr;
+}
+
+// The links of a rank's sublattice as stored in the file, together
+// with the forward face in each dimension, which holds the
+// neighbouring links needed for the plaquette.  The faces are read
+// through the same partitioned I/O as the sublattice itself.
+struct SiteBlock {
+  size_t site_bytes;
+  int L[4];
+  char *local;
+  char *face[4];
+  bool own_local;
+
+  SiteBlock(const GaugeFile &f, const char *filename, size_t data_offset, const int *L_, const int *start,
+	    char *local_=NULL) : site_bytes(f.siteBytes()), local(local_), own_local(local_ == NULL) {
+    size_t volume = 1;
+    for (int d=0; d<4; d++) {
+      L[d] = L_[d];
+      volume *= L[d];
+    }
+    if (own_local) {
+      local = (char*)pool_host_malloc(volume*site_bytes);
+      readSublattice(local, filename, data_offset, site_bytes, f.X, L, start);
+    }
+    for (int mu=0; mu<4; mu++) {
+      int Lf[4] = {L[0], L[1], L[2], L[3]}, sf[4] = {start[0], start[1], start[2], start[3]};
+      Lf[mu] = 1;
+      sf[mu] = (start[mu] + L[mu]) % f.X[mu];
+      face[mu] = (char*)pool_host_malloc(volume/L[mu]*site_bytes);
+      readSublattice(face[mu], filename, data_offset, site_bytes, f.X, Lf, sf);
+    }
+  }
+
+  ~SiteBlock() {
+    for (int mu=0; mu<4; mu++) pool_host_free(face[mu]);
+    if (own_local) pool_host_free(local);
+  }
+
+  // data of the site at local coordinates x, where x[mu] may be L[mu]
+  // in (at most) one dimension
+  const char* site(const int *x) const {
+    for (int mu=0; mu<4; mu++) {
+      if (x[mu] == L[mu]) {
+	int Lf[4] = {L[0], L[1], L[2], L[3]};
+	Lf[mu] = 1;
+	int y[4] = {x[0], x[1], x[2], x[3]};
+	y[mu] = 0;
+	return face[mu] + (((size_t)(y[3]*Lf[2] + y[2])*Lf[1] + y[1])*Lf[0] + y[0])*site_bytes;
+      }
+    }
+    return local + (((size_t)(x[3]*L[2] + x[2])*L[1] + x[1])*L[0] + x[0])*site_bytes;
+  }
+};
+
+// sum of Re tr of the six plaquettes at local site x with links U
+static double sitePlaquette(const GaugeFile &f, const SiteBlock &b, const int *x, const double U[4][18])
+{
+  double plaq = 0.0;
+  for (int mu=0; mu<4; mu++) {
+    for (int nu=mu+1; nu<4; nu++) {
+      int xmu[4] = {x[0], x[1], x[2], x[3]}, xnu[4] = {x[0], x[1], x[2], x[3]};
+      xmu[mu]++;
+      xnu[nu]++;
+
+      double Unu_xmu[18], Umu_xnu[18], A[18], B[18];
+      fileLink(Unu_xmu, f, b.site(xmu), nu);
+      fileLink(Umu_xnu, f, b.site(xnu), mu);
+      su3Mul(A, U[mu], Unu_xmu);
+      su3Mul(B, U[nu], Umu_xnu);
+      plaq += reTraceMulDagger(A, B);
+    }
+  }
+  return plaq;
+}
+
+// NERSC checksum contribution of a link in the file precision
+static inline unsigned long long nerscSum(const GaugeFile &f, const double *U)
+{
+  unsigned long long sum = 0;
+  for (int j=0; j<18; j++) {
+    if (f.file_prec == 8) {
+      unsigned int w[2];
+      memcpy(w, &U[j], 8);
+      sum += w[0] + (unsigned long long)w[1];
+    } else {
+      float v = U[j];
+      unsigned int w;
+      memcpy(&w, &v, 4);
+      sum += w;
+    }
+  }
+  return sum;
+}
+
+template <typename Float>
+static Float* hostLink(void *h_gauge, QudaGaugeFieldOrder order, int mu, size_t lex, size_t eo)
+{
+  if (order == QUDA_QDP_GAUGE_ORDER) return (Float*)((void**)h_gauge)[mu] + eo*18;
+  else if (order == QUDA_QDP_LEX_GAUGE_ORDER) return (Float*)((void**)h_gauge)[mu] + lex*18;
+  else return (Float*)h_gauge + (eo*4 + mu)*18; // MILC
+}
+
+template <typename Float>
+static void storeLinks(void *h_gauge, QudaGaugeFieldOrder order, const double U[4][18],
+		       size_t lex, size_t eo)
+{
+  for (int mu=0; mu<4; mu++) {
+    Float *dst = hostLink<Float>(h_gauge, order, mu, lex, eo);
+    for (int i=0; i<18; i++) dst[i] = U[mu][i];
+  }
+}
+
+template <typename Float>
+static void loadLinks(double U[4][18], void *h_gauge, QudaGaugeFieldOrder order, size_t lex, size_t eo)
+{
+  for (int mu=0; mu<4; mu++) {
+    const Float *src = hostLink<Float>(h_gauge, order, mu, lex, eo);
+    for (int i=0; i<18; i++) U[mu][i] = src[i];
+  }
+}
+
+static void checkGaugeIOParam(QudaGaugeParam *param)
+{
+  if (param->gauge_order != QUDA_QDP_GAUGE_ORDER && param->gauge_order != QUDA_QDP_LEX_GAUGE_ORDER &&
+      param->gauge_order != QUDA_MILC_GAUGE_ORDER)
+    errorQuda("Gauge order %d not supported", param->gauge_order);
+  if (param->cpu_prec != QUDA_DOUBLE_PRECISION && param->cpu_prec != QUDA_SINGLE_PRECISION)
+    errorQuda("Precision %d not supported", param->cpu_prec);
+}
+
+// the sublattice of this rank, checking it against the file
+static size_t localLattice(int *L, int *offset, const GaugeFile &f, const QudaGaugeParam *param,
+			   const char *filename)
+{
+  size_t volume = 1;
+  for (int d=0; d<4; d++) {
+    L[d] = param->X[d];
+    offset[d] = commCoords(d) * L[d];
+    if (f.X[d] != L[d] * commDim(d))
+      errorQuda("Lattice dimension %d of %s is %d, expected %d", d, filename, f.X[d], L[d] * commDim(d));
+    volume *= L[d];
+  }
+  return volume;
+}
+
+bool readGaugeFile(void *h_gauge, QudaGaugeParam *param, const char *filename, double *plaquette)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  checkGaugeIOParam(param);
+
+  // the headers are parsed from a mapping of the file, which only
+  // touches the pages they occupy
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) errorQuda("Cannot open gauge file %s", filename);
+  struct stat st;
+  if (fstat(fd, &st)) errorQuda("Cannot stat gauge file %s", filename);
+  size_t bytes = st.st_size;
+  const char *map = (const char*)mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == (const char*)MAP_FAILED) errorQuda("Cannot map gauge file %s", filename);
+  close(fd);
+
+  GaugeFile f;
+  unsigned int magic = bytes >= 4 ? readBig32(map) : 0;
+  if (bytes >= 12 && !strncmp(map, "BEGIN_HEADER", 12)) {
+    f.format = NERSC_FORMAT;
+    parseNersc(f, map, bytes);
+  } else if (magic == LIME_MAGIC) {
+    f.format = ILDG_FORMAT;
+    parseIldg(f, map, bytes);
+  } else if (bytes >= MILC_HEADER_BYTES && (magic == MILC_MAGIC || swap32(magic) == MILC_MAGIC)) {
+    f.format = MILC_FORMAT;
+    parseMilc(f, map, bytes);
+  } else {
+    errorQuda("Unrecognized format of gauge file %s", filename);
+  }
+
+  const size_t data_offset = f.data - map;
+  munmap((void*)map, bytes);
+  f.data = NULL;
+
+  int L[4], offset[4];
+  const size_t volume = localLattice(L, offset, f, param, filename);
+  const size_t global_volume = volume * commDim(0) * commDim(1) * commDim(2) * commDim(3);
+
+  const size_t site_bytes = f.siteBytes();
+  if (data_offset + global_volume * site_bytes > bytes)
+    errorQuda("Gauge file %s is truncated", filename);
+
+  // each rank reads its own sublattice and forward faces
+  SiteBlock block(f, filename, data_offset, L, offset);
+
+  unsigned int crc_table[256];
+  if (f.format == ILDG_FORMAT) initCrcTable(crc_table);
+
+  const size_t Vh = volume / 2;
+  unsigned long long nersc_sum = 0; // only the low 32 bits matter
+  unsigned int sum_a = 0, sum_b = 0;
+  double plaq = 0.0;
+
+#pragma omp parallel for schedule(static) reduction(+:nersc_sum, plaq) reduction(^:sum_a, sum_b)
+  for (long i=0; i<(long)volume; i++) {
+    int x[4], g[4];
+    long rest = i;
+    for (int d=0; d<4; d++) {
+      x[d] = rest % L[d];
+      rest /= L[d];
+      g[d] = x[d] + offset[d];
+    }
+    size_t rank = ((size_t)(g[3]*f.X[2] + g[2])*f.X[1] + g[1])*f.X[0] + g[0];
+    const char *site = block.site(x);
+
+    double U[4][18];
+    for (int mu=0; mu<4; mu++) fileLink(U[mu], f, site, mu);
+
+    // checksum
+    if (f.format == NERSC_FORMAT) {
+      // sum of the 32-bit words of the full links, in the file precision
+      for (int mu=0; mu<4; mu++) nersc_sum += nerscSum(f, U[mu]);
+    } else if (f.format == ILDG_FORMAT) {
+      unsigned int crc = scidacCrc32(crc_table, site, site_bytes);
+      sum_a ^= rotl(crc, rank % 29);
+      sum_b ^= rotl(crc, rank % 31);
+    } else {
+      const int words = site_bytes / 4;
+      for (int k=0; k<words; k++) {
+	unsigned int w;
+	memcpy(&w, site + 4*k, 4);
+	if (f.swap) w = swap32(w);
+	size_t index = rank*words + k;
+	sum_a ^= rotl(w, index % 29);
+	sum_b ^= rotl(w, index % 31);
+      }
+    }
+
+    plaq += sitePlaquette(f, block, x, U);
+
+    size_t eo = ((x[0] + x[1] + x[2] + x[3]) & 1) * Vh + i/2;
+    if (param->cpu_prec == QUDA_DOUBLE_PRECISION) storeLinks<double>(h_gauge, param->gauge_order, U, i, eo);
+    else storeLinks<float>(h_gauge, param->gauge_order, U, i, eo);
+  }
+
+  // the XOR checksums are reduced bit by bit
+  double sums[65];
+  for (int b=0; b<32; b++) {
+    sums[b] = (sum_a >> b) & 1;
+    sums[32+b] = (sum_b >> b) & 1;
+  }
+  sums[64] = plaq;
+  reduceDoubleArray(sums, 65);
+  sum_a = sum_b = 0;
+  for (int b=0; b<32; b++) {
+    sum_a |= ((unsigned int)sums[b] & 1) << b;
+    sum_b |= ((unsigned int)sums[32+b] & 1) << b;
+  }
+  plaq = sums[64] / (18.0 * global_volume);
+
+  // the sum of the 32-bit partial sums stays below 2^53, so the reduction is exact
+  double nersc_partial = (double)(nersc_sum & 0xffffffffull);
+  reduceDouble(nersc_partial);
+  unsigned int nersc_checksum = (unsigned int)((unsigned long long)nersc_partial & 0xffffffffull);
+
+  bool verified = true;
+  if (f.has_checksum) {
+    if (f.format == NERSC_FORMAT && nersc_checksum != f.checksum[0]) {
+      warningQuda("Checksum mismatch in %s: %x, expected %x", filename, nersc_checksum, f.checksum[0]);
+      verified = false;
+    }
+    if (f.format != NERSC_FORMAT && (sum_a != f.checksum[0] || sum_b != f.checksum[1])) {
+      warningQuda("Checksum mismatch in %s: %x %x, expected %x %x", filename, sum_a, sum_b, f.checksum[0], f.checksum[1]);
+      verified = false;
+    }
+  } else {
+    warningQuda("No checksum in %s", filename);
+  }
+
+  if (f.has_plaquette && fabs(plaq - f.plaquette) > 1e-6) {
+    warningQuda("Plaquette mismatch in %s: %.10f, expected %.10f", filename, plaq, f.plaquette);
+    verified = false;
+  }
+
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec);
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Read %s configuration %s (%dx%dx%dx%d): plaquette %.10f, checksum %s, %.2f s\n",
+	       format_name[f.format], filename, f.X[0], f.X[1], f.X[2], f.X[3], plaq,
+	       !f.has_checksum ? "absent" : verified ? "verified" : "not verified", secs);
+  }
+
+  *plaquette = plaq;
+  return verified;
+}
+
+double readGaugeFileQuda(void *h_gauge, QudaGaugeParam *param, const char *filename)
+{
+  double plaq;
+  if (!readGaugeFile(h_gauge, param, filename, &plaq)) errorQuda("Gauge file %s failed verification", filename);
+  return plaq;
+}
+
+// fixed-width fields, so that the length is known before the values
+static size_t nerscHeader(char *header, size_t bytes, const GaugeFile &f, unsigned int checksum, double plaq)
+{
+  return snprintf(header, bytes,
+		  "BEGIN_HEADER\n"
+		  "HDR_VERSION = 1.0\n"
+		  "DATATYPE = 4D_SU3_GAUGE_3x3\n"
+		  "STORAGE_FORMAT = 1.0\n"
+		  "DIMENSION_1 = %d\n"
+		  "DIMENSION_2 = %d\n"
+		  "DIMENSION_3 = %d\n"
+		  "DIMENSION_4 = %d\n"
+		  "CHECKSUM = %08x\n"
+		  "PLAQUETTE = % .10f\n"
+		  "BOUNDARY_1 = PERIODIC\n"
+		  "BOUNDARY_2 = PERIODIC\n"
+		  "BOUNDARY_3 = PERIODIC\n"
+		  "BOUNDARY_4 = PERIODIC\n"
+		  "FLOATING_POINT = %s\n"
+		  "END_HEADER\n",
+		  f.X[0], f.X[1], f.X[2], f.X[3], checksum, plaq,
+		  f.file_prec == 8 ? "IEEE64BIG" : "IEEE32BIG");
+}
+
+void writeGaugeFileQuda(void *h_gauge, QudaGaugeParam *param, const char *filename)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  checkGaugeIOParam(param);
+
+  GaugeFile f;
+  f.format = NERSC_FORMAT;
+  f.file_prec = param->cpu_prec;
+  f.swap = !bigEndianHost();
+  f.rows = 3;
+  f.has_checksum = true;
+  f.has_plaquette = true;
+  for (int d=0; d<4; d++) f.X[d] = param->X[d] * commDim(d);
+
+  int L[4], offset[4];
+  const size_t volume = localLattice(L, offset, f, param, filename);
+  const size_t global_volume = volume * commDim(0) * commDim(1) * commDim(2) * commDim(3);
+  const size_t site_bytes = f.siteBytes();
+  const size_t Vh = volume / 2;
+
+  char header[1024];
+  const size_t header_bytes = nerscHeader(header, sizeof(header), f, 0, 0.0);
+
+  // encode the sublattice in the file format
+  char *local = (char*)pool_host_malloc(volume*site_bytes);
+  unsigned long long nersc_sum = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:nersc_sum)
+  for (long i=0; i<(long)volume; i++) {
+    int x[4];
+    long rest = i;
+    for (int d=0; d<4; d++) {
+      x[d] = rest % L[d];
+      rest /= L[d];
+    }
+    size_t eo = ((x[0] + x[1] + x[2] + x[3]) & 1) * Vh + i/2;
+
+    double U[4][18];
+    if (param->cpu_prec == QUDA_DOUBLE_PRECISION) loadLinks<double>(U, h_gauge, param->gauge_order, i, eo);
+    else loadLinks<float>(U, h_gauge, param->gauge_order, i, eo);
+
+    char *site = local + i*site_bytes;
+    for (int mu=0; mu<4; mu++) {
+      nersc_sum += nerscSum(f, U[mu]);
+      for (int j=0; j<18; j++) {
+	if (f.file_prec == 8) {
+	  unsigned long long w;
+	  memcpy(&w, &U[mu][j], 8);
+	  if (f.swap) w = swap64(w);
+	  memcpy(site + 8*(18*mu + j), &w, 8);
+	} else {
+	  float v = U[mu][j];
+	  unsigned int w;
+	  memcpy(&w, &v, 4);
+	  if (f.swap) w = swap32(w);
+	  memcpy(site + 4*(18*mu + j), &w, 4);
+	}
+      }
+    }
+  }
+
+  createSharedFile(filename);
+  writeSublattice(filename, header_bytes, local, site_bytes, f.X, L, offset);
+
+  // the plaquette, with the forward faces read back from the file
+  double plaq = 0.0;
+  {
+    SiteBlock block(f, filename, header_bytes, L, offset, local);
+
+#pragma omp parallel for schedule(static) reduction(+:plaq)
+    for (long i=0; i<(long)volume; i++) {
+      int x[4];
+      long rest = i;
+      for (int d=0; d<4; d++) {
+	x[d] = rest % L[d];
+	rest /= L[d];
+      }
+      double U[4][18];
+      for (int mu=0; mu<4; mu++) fileLink(U[mu], f, block.site(x), mu);
+      plaq += sitePlaquette(f, block, x, U);
+    }
+  }
+  pool_host_free(local);
+
+  reduceDouble(plaq);
+  plaq /= 18.0 * global_volume;
+
+  double nersc_partial = (double)(nersc_sum & 0xffffffffull);
+  reduceDouble(nersc_partial);
+  unsigned int checksum = (unsigned int)((unsigned long long)nersc_partial & 0xffffffffull);
+
+  if (nerscHeader(header, sizeof(header), f, checksum, plaq) != header_bytes)
+    errorQuda("NERSC header length changed");
+  writeSharedHeader(filename, header, header_bytes);
+
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec);
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Wrote NERSC configuration %s (%dx%dx%dx%d): plaquette %.10f, checksum %08x, %.2f s\n",
+	       filename, f.X[0], f.X[1], f.X[2], f.X[3], plaq, checksum, secs);
+  }
+}
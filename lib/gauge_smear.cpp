@@ -0,0 +1,918 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <complex>
+#include <sys/time.h>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <face_quda.h>
+#include <malloc_quda.h>
+
+// APE, stout and HYP smearing and the Wilson flow of the host gauge
+// field, see smearLinkQuda() and wilsonFlowQuda() in quda.h.
+//
+// The links are copied into double-precision fields on the extended
+// sublattice, with a halo of depth one in every dimension as used by
+// the extended-volume link fattening, and filled by the same exchange.
+// The staples of a link then only involve the sites of the extended
+// sublattice, and each smearing step is a single OpenMP loop over the
+// interior, which writes the smeared links straight back into the
+// user field.  HYP smearing needs its two intermediate levels of
+// decorated links in full, with their halos exchanged in turn.  The
+// flow works on the extended fields throughout, and only writes the
+// links back at the end.
+
+typedef std::complex<double> Complex;
+
+struct Link {
+  Complex e[3][3];
+};
+
+static const char *smear_name[] = { "APE", "stout", "HYP" };
+
+// C = A*B
+static inline void mul(Link &C, const Link &A, const Link &B)
+{
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++)
+      C.e[i][j] = A.e[i][0]*B.e[0][j] + A.e[i][1]*B.e[1][j] + A.e[i][2]*B.e[2][j];
+}
+
+// C = A*B^dagger
+static inline void mulDagger(Link &C, const Link &A, const Link &B)
+{
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++)
+      C.e[i][j] = A.e[i][0]*conj(B.e[j][0]) + A.e[i][1]*conj(B.e[j][1]) + A.e[i][2]*conj(B.e[j][2]);
+}
+
+// C = A^dagger*B
+static inline void daggerMul(Link &C, const Link &A, const Link &B)
+{
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++)
+      C.e[i][j] = conj(A.e[0][i])*B.e[0][j] + conj(A.e[1][i])*B.e[1][j] + conj(A.e[2][i])*B.e[2][j];
+}
+
+static inline void zero(Link &A)
+{
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) A.e[i][j] = 0.0;
+}
+
+// A += a*B
+static inline void axpy(Link &A, double a, const Link &B)
+{
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) A.e[i][j] += a*B.e[i][j];
+}
+
+static inline Complex trace(const Link &A) { return A.e[0][0] + A.e[1][1] + A.e[2][2]; }
+
+static inline Complex det(const Link &A)
+{
+  return A.e[0][0]*(A.e[1][1]*A.e[2][2] - A.e[1][2]*A.e[2][1])
+    - A.e[0][1]*(A.e[1][0]*A.e[2][2] - A.e[1][2]*A.e[2][0])
+    + A.e[0][2]*(A.e[1][0]*A.e[2][1] - A.e[1][1]*A.e[2][0]);
+}
+
+// Re tr(A*B^dagger)
+static inline double reTraceMulDagger(const Link &A, const Link &B)
+{
+  double tr = 0.0;
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) tr += real(A.e[i][j]*conj(B.e[i][j]));
+  return tr;
+}
+
+// The unitary matrix closest to W, times the phase that makes its
+// determinant one.  The unitary factor of the polar decomposition is
+// found by the Newton iteration Y -> (Y + Y^-dagger)/2, which
+// converges quadratically for any invertible W.
+static void projectSU3(Link &W)
+{
+  Link Y = W;
+  for (int k=0; k<50; k++) {
+    Complex d = det(Y);
+    if (abs(d) == 0.0) errorQuda("Cannot project a singular link onto SU(3)");
+
+    // the inverse from the cofactors, Y^-dagger[i][j] = conj(cof[i][j]/det)
+    Link Z;
+    double change = 0.0;
+    for (int i=0; i<3; i++) {
+      int i1 = (i+1)%3, i2 = (i+2)%3;
+      for (int j=0; j<3; j++) {
+	int j1 = (j+1)%3, j2 = (j+2)%3;
+	Complex cof = Y.e[i1][j1]*Y.e[i2][j2] - Y.e[i1][j2]*Y.e[i2][j1];
+	Z.e[i][j] = 0.5*(Y.e[i][j] + conj(cof/d));
+	change += norm(Z.e[i][j] - Y.e[i][j]);
+      }
+    }
+    Y = Z;
+    if (change < 1e-28) break;
+  }
+
+  Complex phase = std::polar(1.0, -arg(det(Y))/3.0);
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) W.e[i][j] = phase*Y.e[i][j];
+}
+
+// exp(iQ) of a traceless hermitian Q, exactly, by the Cayley-Hamilton
+// theorem, exp(iQ) = f0 + f1 Q + f2 Q^2 (Morningstar and Peardon,
+// hep-lat/0311018)
+static void expiQ(Link &E, const Link &Q)
+{
+  Link Q2;
+  mul(Q2, Q, Q);
+  double c0 = real(det(Q));
+  double c1 = 0.5*real(trace(Q2));
+
+  Complex f[3];
+  if (c1 < 1e-8) {
+    // Q is tiny: the series of the coefficients to the order that
+    // matters in double precision
+    f[0] = Complex(1.0, -c0/6.0);
+    f[1] = Complex(c0/24.0, 1.0 - c1/6.0*(1.0 - c1/20.0));
+    f[2] = Complex(-0.5*(1.0 - c1/12.0*(1.0 - c1/30.0)), c0/120.0);
+  } else {
+    // f_j(-c0) = (-1)^j f_j(c0)^*
+    bool negative = (c0 < 0.0);
+    if (negative) c0 = -c0;
+
+    double c0_max = 2.0*pow(c1/3.0, 1.5);
+    double ratio = c0/c0_max;
+    if (ratio > 1.0) ratio = 1.0;
+    double theta = acos(ratio);
+    double u = sqrt(c1/3.0)*cos(theta/3.0);
+    double w = sqrt(c1)*sin(theta/3.0);
+    double u2 = u*u, w2 = w*w;
+    double cos_w = cos(w);
+    double xi0 = (fabs(w) < 0.05) ? 1.0 - w2/6.0*(1.0 - w2/20.0*(1.0 - w2/42.0)) : sin(w)/w;
+
+    Complex e2iu = std::polar(1.0, 2.0*u), emiu = std::polar(1.0, -u);
+    Complex h0 = (u2 - w2)*e2iu + emiu*Complex(8.0*u2*cos_w, 2.0*u*(3.0*u2 + w2)*xi0);
+    Complex h1 = 2.0*u*e2iu - emiu*Complex(2.0*u*cos_w, -(3.0*u2 - w2)*xi0);
+    Complex h2 = e2iu - emiu*Complex(cos_w, 3.0*u*xi0);
+
+    double denom = 9.0*u2 - w2;
+    f[0] = h0/denom;
+    f[1] = h1/denom;
+    f[2] = h2/denom;
+
+    if (negative) {
+      f[0] = conj(f[0]);
+      f[1] = -conj(f[1]);
+      f[2] = conj(f[2]);
+    }
+  }
+
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) E.e[i][j] = f[1]*Q.e[i][j] + f[2]*Q2.e[i][j];
+  for (int i=0; i<3; i++) E.e[i][i] += f[0];
+}
+
+// the traceless antihermitian part of M
+static inline void projectTA(Link &A, const Link &M)
+{
+  for (int a=0; a<3; a++)
+    for (int b=0; b<3; b++) A.e[a][b] = 0.5*(M.e[a][b] - conj(M.e[b][a]));
+  Complex tr = trace(A) / 3.0;
+  for (int a=0; a<3; a++) A.e[a][a] -= tr;
+}
+
+// exp(A) of a traceless antihermitian A
+static inline void expTA(Link &E, const Link &A)
+{
+  Link Q;
+  for (int a=0; a<3; a++)
+    for (int b=0; b<3; b++) Q.e[a][b] = Complex(imag(A.e[a][b]), -real(A.e[a][b]));
+  expiQ(E, Q);
+}
+
+// The extended sublattice: dimensions E = X + 2 with the even-odd
+// site order of the extended-volume fattening
+struct Lattice {
+  int X[4];
+  int E[4];
+  long volume;     // interior sites
+  long ext_volume;
+  long ext_half;
+
+  Lattice(const int *X_) : volume(1), ext_volume(1) {
+    for (int d=0; d<4; d++) {
+      X[d] = X_[d];
+      E[d] = X[d] + 2;
+      volume *= X[d];
+      ext_volume *= E[d];
+    }
+    ext_half = ext_volume / 2;
+  }
+
+  // index of the site at extended coordinates c
+  long index(const int *c) const {
+    long lex = ((long)(c[3]*E[2] + c[2])*E[1] + c[1])*E[0] + c[0];
+    return ((c[0] + c[1] + c[2] + c[3]) & 1)*ext_half + lex/2;
+  }
+
+  // index of the site c + shift in direction d
+  long neighbor(const int *c, int d, int shift) const {
+    int y[4] = {c[0], c[1], c[2], c[3]};
+    y[d] += shift;
+    return index(y);
+  }
+
+  // local and extended coordinates of interior site i, in the
+  // lexicographic order of the user field
+  void coords(int *x, int *c, long i) const {
+    for (int d=0; d<4; d++) {
+      x[d] = i % X[d];
+      i /= X[d];
+      c[d] = x[d] + 1;
+    }
+  }
+};
+
+// Fills the halos of the n (a multiple of four) fields U, from the
+// neighbouring ranks in the partitioned dimensions and periodically
+// in the others
+static void exchangeHalo(const Lattice &lat, Link **U, int n)
+{
+#ifdef MPI_COMMS
+  int X[4] = {lat.X[0], lat.X[1], lat.X[2], lat.X[3]};
+  int R[4] = {1, 1, 1, 1};
+  for (int i=0; i<n; i+=4)
+    exchange_cpu_sitelink_ex(X, R, (void**)(U + i), QUDA_QDP_GAUGE_ORDER, QUDA_DOUBLE_PRECISION, 0);
+#else
+  for (int d=0; d<4; d++)
+    if (commDimPartitioned(d)) errorQuda("Smearing a partitioned lattice requires MPI communications");
+
+#pragma omp parallel for schedule(static)
+  for (long s=0; s<lat.ext_volume; s++) {
+    int c[4], y[4];
+    long rest = s;
+    bool halo = false;
+    for (int d=0; d<4; d++) {
+      c[d] = rest % lat.E[d];
+      rest /= lat.E[d];
+      y[d] = c[d];
+      if (c[d] == 0) y[d] = lat.X[d];
+      else if (c[d] == lat.E[d]-1) y[d] = 1;
+      if (y[d] != c[d]) halo = true;
+    }
+    if (!halo) continue;
+    long dst = lat.index(c), src = lat.index(y);
+    for (int i=0; i<n; i++) U[i][dst] = U[i][src];
+  }
+#endif
+}
+
+template <typename Float>
+static Float* hostLink(void *h_gauge, QudaGaugeFieldOrder order, int mu, size_t lex, size_t eo)
+{
+  if (order == QUDA_QDP_GAUGE_ORDER) return (Float*)((void**)h_gauge)[mu] + eo*18;
+  else if (order == QUDA_QDP_LEX_GAUGE_ORDER) return (Float*)((void**)h_gauge)[mu] + lex*18;
+  else return (Float*)h_gauge + (eo*4 + mu)*18; // MILC
+}
+
+template <typename Float>
+static void loadLink(Link &U, void *h_gauge, QudaGaugeFieldOrder order, int mu, size_t lex, size_t eo)
+{
+  const Float *src = hostLink<Float>(h_gauge, order, mu, lex, eo);
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) U.e[i][j] = Complex(src[6*i+2*j], src[6*i+2*j+1]);
+}
+
+template <typename Float>
+static void storeLink(void *h_gauge, QudaGaugeFieldOrder order, int mu, size_t lex, size_t eo, const Link &U)
+{
+  Float *dst = hostLink<Float>(h_gauge, order, mu, lex, eo);
+  for (int i=0; i<3; i++) {
+    for (int j=0; j<3; j++) {
+      dst[6*i+2*j] = real(U.e[i][j]);
+      dst[6*i+2*j+1] = imag(U.e[i][j]);
+    }
+  }
+}
+
+// the user links and their place in the extended fields
+struct HostGauge {
+  void *h_gauge;
+  QudaGaugeFieldOrder order;
+  QudaPrecision precision;
+  const Lattice &lat;
+
+  HostGauge(void *h_gauge, const QudaGaugeParam *param, const Lattice &lat)
+    : h_gauge(h_gauge), order(param->gauge_order), precision(param->cpu_prec), lat(lat) { }
+
+  size_t eo(const int *x, long i) const { return ((x[0] + x[1] + x[2] + x[3]) & 1)*(lat.volume/2) + i/2; }
+
+  void load(Link &U, int mu, const int *x, long i) const {
+    if (precision == QUDA_DOUBLE_PRECISION) loadLink<double>(U, h_gauge, order, mu, i, eo(x, i));
+    else loadLink<float>(U, h_gauge, order, mu, i, eo(x, i));
+  }
+
+  void store(int mu, const int *x, long i, const Link &U) const {
+    if (precision == QUDA_DOUBLE_PRECISION) storeLink<double>(h_gauge, order, mu, i, eo(x, i), U);
+    else storeLink<float>(h_gauge, order, mu, i, eo(x, i), U);
+  }
+
+  // copies the user links into the interior of U and fills the halos
+  void extend(Link **U) const {
+#pragma omp parallel for schedule(static)
+    for (long i=0; i<lat.volume; i++) {
+      int x[4], c[4];
+      lat.coords(x, c, i);
+      long s = lat.index(c);
+      for (int mu=0; mu<4; mu++) load(U[mu][s], mu, x, i);
+    }
+    exchangeHalo(lat, U, 4);
+  }
+
+  // copies the interior of U back into the user links
+  void shrink(Link **U) const {
+#pragma omp parallel for schedule(static)
+    for (long i=0; i<lat.volume; i++) {
+      int x[4], c[4];
+      lat.coords(x, c, i);
+      long s = lat.index(c);
+      for (int mu=0; mu<4; mu++) store(mu, x, i, U[mu][s]);
+    }
+  }
+};
+
+// Adds to S the staples of the link at c in direction mu, in the
+// plane (mu, nu), with the mu links taken from Vmu and the nu links
+// from Vnu:
+//
+//     x+nu +-------+ x+nu+mu
+//          |       |            Vnu(x) Vmu(x+nu) Vnu(x+mu)^dagger
+//        x *       *
+//          |       |            Vnu(x-nu)^dagger Vmu(x-nu) Vnu(x-nu+mu)
+//     x-nu +-------+
+static inline void addStaples(Link &S, const Lattice &lat, const Link *Vmu, const Link *Vnu,
+			      const int *c, int mu, int nu, double a)
+{
+  Link A, B;
+
+  mul(A, Vnu[lat.index(c)], Vmu[lat.neighbor(c, nu, 1)]);
+  mulDagger(B, A, Vnu[lat.neighbor(c, mu, 1)]);
+  axpy(S, a, B);
+
+  int cm[4] = {c[0], c[1], c[2], c[3]};
+  cm[nu]--;
+  daggerMul(A, Vnu[lat.index(cm)], Vmu[lat.index(cm)]);
+  mul(B, A, Vnu[lat.neighbor(cm, mu, 1)]);
+  axpy(S, a, B);
+}
+
+// average plaquette, Re tr(U_p)/3, of the extended fields U with their
+// halos filled
+static double plaquette(const Lattice &lat, Link **U)
+{
+  double plaq = 0.0;
+
+#pragma omp parallel for schedule(static) reduction(+:plaq)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      for (int nu=mu+1; nu<4; nu++) {
+	Link A, B;
+	mul(A, U[mu][s], U[nu][lat.neighbor(c, mu, 1)]);
+	mul(B, U[nu][s], U[mu][lat.neighbor(c, nu, 1)]);
+	plaq += reTraceMulDagger(A, B);
+      }
+    }
+  }
+
+  reduceDouble(plaq);
+  return plaq / (18.0 * lat.volume * commDim(0) * commDim(1) * commDim(2) * commDim(3));
+}
+
+// index of the decorated link in direction mu that excludes
+// direction nu, among the twelve of a HYP level
+static inline int pair(int mu, int nu) { return 3*mu + (nu < mu ? nu : nu-1); }
+
+// APE: Proj[(1-alpha) U + alpha/6 sum of the staples]
+static void apeStep(const HostGauge &gauge, Link **U, double alpha)
+{
+  const Lattice &lat = gauge.lat;
+
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      Link W;
+      zero(W);
+      axpy(W, 1.0 - alpha, U[mu][s]);
+      for (int nu=0; nu<4; nu++) if (nu != mu) addStaples(W, lat, U[mu], U[nu], c, mu, nu, alpha/6.0);
+      projectSU3(W);
+      gauge.store(mu, x, i, W);
+    }
+  }
+}
+
+// stout: exp(iQ) U, where iQ is the traceless antihermitian part of
+// rho S U^dagger, with S the sum of the staples
+static void stoutStep(const HostGauge &gauge, Link **U, double rho)
+{
+  const Lattice &lat = gauge.lat;
+
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      Link S, Omega, iQ, E, W;
+      zero(S);
+      for (int nu=0; nu<4; nu++) if (nu != mu) addStaples(S, lat, U[mu], U[nu], c, mu, nu, rho);
+      mulDagger(Omega, S, U[mu][s]);
+      projectTA(iQ, Omega);
+      expTA(E, iQ);
+      mul(W, E, U[mu][s]);
+      gauge.store(mu, x, i, W);
+    }
+  }
+}
+
+// HYP (Hasenfratz and Knechtli, hep-lat/0103029), with the decorated
+// links of the first level, in direction mu excluding eta, in V1, and
+// those of the second level, in direction mu excluding nu, in V2
+static void hypStep(const HostGauge &gauge, Link **U, Link **V1, Link **V2, const double *alpha)
+{
+  const Lattice &lat = gauge.lat;
+
+  // level 1: staples in the one direction eta orthogonal to mu, nu and rho
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      for (int eta=0; eta<4; eta++) {
+	if (eta == mu) continue;
+	Link W;
+	zero(W);
+	axpy(W, 1.0 - alpha[2], U[mu][s]);
+	addStaples(W, lat, U[mu], U[eta], c, mu, eta, alpha[2]/2.0);
+	projectSU3(W);
+	V1[pair(mu, eta)][s] = W;
+      }
+    }
+  }
+  exchangeHalo(lat, V1, 12);
+
+  // level 2: staples in the two directions rho orthogonal to mu and nu
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      for (int nu=0; nu<4; nu++) {
+	if (nu == mu) continue;
+	Link W;
+	zero(W);
+	axpy(W, 1.0 - alpha[1], U[mu][s]);
+	for (int rho=0; rho<4; rho++) {
+	  if (rho == mu || rho == nu) continue;
+	  int eta = 6 - mu - nu - rho;
+	  addStaples(W, lat, V1[pair(mu, eta)], V1[pair(rho, eta)], c, mu, rho, alpha[1]/4.0);
+	}
+	projectSU3(W);
+	V2[pair(mu, nu)][s] = W;
+      }
+    }
+  }
+  exchangeHalo(lat, V2, 12);
+
+  // level 3: staples in all directions nu, written to the user field
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      Link W;
+      zero(W);
+      axpy(W, 1.0 - alpha[0], U[mu][s]);
+      for (int nu=0; nu<4; nu++)
+	if (nu != mu) addStaples(W, lat, V2[pair(mu, nu)], V2[pair(nu, mu)], c, mu, nu, alpha[0]/6.0);
+      projectSU3(W);
+      gauge.store(mu, x, i, W);
+    }
+  }
+}
+
+static void checkSmearParam(QudaGaugeParam *param)
+{
+  if (param->gauge_order != QUDA_QDP_GAUGE_ORDER && param->gauge_order != QUDA_QDP_LEX_GAUGE_ORDER &&
+      param->gauge_order != QUDA_MILC_GAUGE_ORDER)
+    errorQuda("Gauge order %d not supported", param->gauge_order);
+  if (param->cpu_prec != QUDA_DOUBLE_PRECISION && param->cpu_prec != QUDA_SINGLE_PRECISION)
+    errorQuda("Precision %d not supported", param->cpu_prec);
+  for (int d=0; d<4; d++)
+    if (param->X[d] % 2) errorQuda("Smearing requires even local lattice dimensions");
+}
+
+double smearLinkQuda(void *h_gauge, QudaGaugeParam *param, QudaLinkSmearType type,
+		     const double *coeff, int n_step)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  checkSmearParam(param);
+  if (type != QUDA_APE_SMEAR && type != QUDA_STOUT_SMEAR && type != QUDA_HYP_SMEAR)
+    errorQuda("Smearing type %d not supported", type);
+
+  const Lattice lat(param->X);
+  const HostGauge gauge(h_gauge, param, lat);
+
+  const size_t bytes = lat.ext_volume * sizeof(Link);
+  Link *U[4];
+  for (int mu=0; mu<4; mu++) U[mu] = (Link*)pool_host_malloc(bytes);
+
+  // the decorated links of HYP
+  Link *V1[12], *V2[12];
+  if (type == QUDA_HYP_SMEAR) {
+    for (int k=0; k<12; k++) {
+      V1[k] = (Link*)pool_host_malloc(bytes);
+      V2[k] = (Link*)pool_host_malloc(bytes);
+    }
+  }
+
+  gauge.extend(U);
+  double plaq_start = plaquette(lat, U);
+
+  for (int step=0; step<n_step; step++) {
+    if (step > 0) gauge.extend(U);
+    switch (type) {
+    case QUDA_APE_SMEAR: apeStep(gauge, U, coeff[0]); break;
+    case QUDA_STOUT_SMEAR: stoutStep(gauge, U, coeff[0]); break;
+    case QUDA_HYP_SMEAR: hypStep(gauge, U, V1, V2, coeff); break;
+    default: break;
+    }
+  }
+
+  double plaq = plaq_start;
+  if (n_step > 0) {
+    gauge.extend(U);
+    plaq = plaquette(lat, U);
+  }
+
+  if (type == QUDA_HYP_SMEAR) {
+    for (int k=0; k<12; k++) {
+      pool_host_free(V2[k]);
+      pool_host_free(V1[k]);
+    }
+  }
+  for (int mu=0; mu<4; mu++) pool_host_free(U[mu]);
+
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec);
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("%d %s smearing steps: plaquette %.10f -> %.10f, %.2f s\n",
+	       n_step, smear_name[type], plaq_start, plaq, secs);
+  }
+
+  return plaq;
+}
+
+// The clover field strength F_{mu nu} at c: the traceless
+// antihermitian part of the four plaquettes of the plane (mu, nu)
+// that start and end at c, over four
+static void cloverField(Link &F, const Lattice &lat, Link **U, const int *c, int mu, int nu)
+{
+  int c_mm[4] = {c[0], c[1], c[2], c[3]}, c_mn[4] = {c[0], c[1], c[2], c[3]};
+  c_mm[mu]--;
+  c_mn[nu]--;
+  int c_mm_mn[4] = {c_mm[0], c_mm[1], c_mm[2], c_mm[3]};
+  c_mm_mn[nu]--;
+
+  const long s = lat.index(c);
+  const long s_mm = lat.index(c_mm), s_mn = lat.index(c_mn), s_mm_mn = lat.index(c_mm_mn);
+  const Link *Umu = U[mu], *Unu = U[nu];
+
+  Link A, B, L, C;
+
+  mul(A, Umu[s], Unu[lat.neighbor(c, mu, 1)]);
+  mulDagger(B, A, Umu[lat.neighbor(c, nu, 1)]);
+  mulDagger(C, B, Unu[s]);
+
+  mulDagger(A, Unu[s], Umu[lat.neighbor(c_mm, nu, 1)]);
+  mulDagger(B, A, Unu[s_mm]);
+  mul(L, B, Umu[s_mm]);
+  axpy(C, 1.0, L);
+
+  mul(A, Unu[s_mm_mn], Umu[s_mm]);
+  daggerMul(B, A, Umu[s_mm_mn]);
+  mul(L, B, Unu[s_mn]);
+  axpy(C, 1.0, L);
+
+  daggerMul(A, Unu[s_mn], Umu[s_mn]);
+  mul(B, A, Unu[lat.neighbor(c_mn, mu, 1)]);
+  mulDagger(L, B, Umu[s]);
+  axpy(C, 1.0, L);
+
+  projectTA(F, C);
+  for (int a=0; a<3; a++)
+    for (int b=0; b<3; b++) F.e[a][b] *= 0.25;
+}
+
+// Re tr(A*B)
+static inline double reTraceMul(const Link &A, const Link &B)
+{
+  double tr = 0.0;
+  for (int i=0; i<3; i++)
+    for (int j=0; j<3; j++) tr += real(A.e[i][j]*B.e[j][i]);
+  return tr;
+}
+
+// The energy density, E = -1/2 sum_{mu,nu} tr F_{mu nu}^2, and the
+// topological charge density, q = -1/(32 pi^2) eps_{mu nu rho sigma}
+// tr F_{mu nu} F_{rho sigma}, at c
+static void fieldDensities(double &e, double &q, const Lattice &lat, Link **U, const int *c)
+{
+  Link F[4][4];
+  for (int mu=0; mu<4; mu++)
+    for (int nu=mu+1; nu<4; nu++) cloverField(F[mu][nu], lat, U, c, mu, nu);
+
+  e = 0.0;
+  for (int mu=0; mu<4; mu++)
+    for (int nu=mu+1; nu<4; nu++) e -= reTraceMul(F[mu][nu], F[mu][nu]);
+
+  q = -(reTraceMul(F[0][1], F[2][3]) - reTraceMul(F[0][2], F[1][3]) + reTraceMul(F[0][3], F[1][2]))
+    / (4.0 * M_PI * M_PI);
+}
+
+// the generator of the Wilson flow of the link (c, mu), the traceless
+// antihermitian part of S U^dagger, with S the sum of its staples
+static inline void flowGenerator(Link &Z, const Lattice &lat, Link **U, const int *c, int mu)
+{
+  Link S, Omega;
+  zero(S);
+  for (int nu=0; nu<4; nu++) if (nu != mu) addStaples(S, lat, U[mu], U[nu], c, mu, nu, 1.0);
+  mulDagger(Omega, S, U[mu][lat.index(c)]);
+  projectTA(Z, Omega);
+}
+
+struct FlowMeasurement {
+  double E; // average energy density
+  double Q; // topological charge
+};
+
+static void reduceMeasurement(FlowMeasurement &m, const Lattice &lat, double e, double q)
+{
+  double sums[2] = {e, q};
+  reduceDoubleArray(sums, 2);
+  m.E = sums[0] / ((double)lat.volume * commDim(0) * commDim(1) * commDim(2) * commDim(3));
+  m.Q = sums[1];
+}
+
+static void measureFlow(FlowMeasurement &m, const Lattice &lat, Link **W)
+{
+  double e_sum = 0.0, q_sum = 0.0;
+
+#pragma omp parallel for schedule(static) reduction(+:e_sum, q_sum)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    double e, q;
+    fieldDensities(e, q, lat, W, c);
+    e_sum += e;
+    q_sum += q;
+  }
+
+  reduceMeasurement(m, lat, e_sum, q_sum);
+}
+
+// One stage of Luscher's low-storage third-order Runge-Kutta scheme
+// (arXiv:1006.4518), on the extended fields W with their halos filled:
+//
+//   Z <- a eps Z(W) + b Z,  W <- exp(Z) W
+//
+// with (a, b) = (1/4, 0), (8/9, -17/9) and (3/4, -1) in turn, Z on the
+// interior sites only.  The first stage also measures the densities
+// at W if m is set, since it visits the same neighbours.  In the
+// second, Z holds eps Z0/4 before the update, and the embedded
+// second-order step exp(2 eps Z1 - 5/4 eps Z0) W1 is written to
+// estimate if set.
+static void flowStage(const Lattice &lat, Link **W, Link **Z, double a, double b, double eps,
+		      Link **estimate, FlowMeasurement *m)
+{
+  double e_sum = 0.0, q_sum = 0.0;
+
+#pragma omp parallel for schedule(static) reduction(+:e_sum, q_sum)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      Link G, Zi;
+      flowGenerator(G, lat, W, c, mu);
+      zero(Zi);
+      axpy(Zi, a*eps, G);
+      if (b != 0.0) axpy(Zi, b, Z[mu][i]);
+
+      if (estimate) {
+	Link X, E;
+	zero(X);
+	axpy(X, 2.0*eps, G);
+	axpy(X, -5.0, Z[mu][i]);
+	expTA(E, X);
+	mul(estimate[mu][i], E, W[mu][s]);
+      }
+
+      Z[mu][i] = Zi;
+    }
+    if (m) {
+      double e, q;
+      fieldDensities(e, q, lat, W, c);
+      e_sum += e;
+      q_sum += q;
+    }
+  }
+
+  if (m) reduceMeasurement(*m, lat, e_sum, q_sum);
+
+  // the update only reads the link it writes, so it waits for all of Z
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      Link E, V;
+      expTA(E, Z[mu][i]);
+      mul(V, E, W[mu][s]);
+      W[mu][s] = V;
+    }
+  }
+
+  exchangeHalo(lat, W, 4);
+}
+
+// copies the interior of the extended fields W to the fields V, or back
+static void copyInterior(const Lattice &lat, Link **V, Link **W, bool to_interior)
+{
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<lat.volume; i++) {
+    int x[4], c[4];
+    lat.coords(x, c, i);
+    long s = lat.index(c);
+    for (int mu=0; mu<4; mu++) {
+      if (to_interior) W[mu][s] = V[mu][i];
+      else V[mu][i] = W[mu][s];
+    }
+  }
+}
+
+// the largest difference between a link of the extended fields W and
+// of the fields V, |W - V|/3 in the Frobenius norm
+static double maxDistance(const Lattice &lat, Link **V, Link **W)
+{
+  double dist = 0.0;
+
+#pragma omp parallel
+  {
+    double local = 0.0;
+#pragma omp for schedule(static)
+    for (long i=0; i<lat.volume; i++) {
+      int x[4], c[4];
+      lat.coords(x, c, i);
+      long s = lat.index(c);
+      for (int mu=0; mu<4; mu++) {
+	double d = 0.0;
+	for (int a=0; a<3; a++)
+	  for (int b=0; b<3; b++) d += norm(W[mu][s].e[a][b] - V[mu][i].e[a][b]);
+	if (sqrt(d)/3.0 > local) local = sqrt(d)/3.0;
+      }
+    }
+#pragma omp critical
+    if (local > dist) dist = local;
+  }
+
+  reduceMaxDouble(dist);
+  return dist;
+}
+
+// the measurements of a flow, of which the first max are kept
+struct FlowHistory {
+  double *t, *E, *Q;
+  int max;
+  int n;
+
+  FlowHistory(double *t, double *E, double *Q, int max) : t(t), E(E), Q(Q), max(max), n(0) { }
+
+  void record(double t_, const FlowMeasurement &m) {
+    if (n < max) {
+      if (t) t[n] = t_;
+      if (E) E[n] = m.E;
+      if (Q) Q[n] = m.Q;
+    }
+    n++;
+    if (getVerbosity() >= QUDA_VERBOSE)
+      printfQuda("Wilson flow: t = %.6f, E = %.10e, t^2 E = %.10e, Q = %.10f\n", t_, m.E, t_*t_*m.E, m.Q);
+  }
+};
+
+int wilsonFlowQuda(void *h_gauge, QudaGaugeParam *param, double t_max, double epsilon, double tol,
+		   double *t_meas, double *E_meas, double *Q_meas, int max_meas)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  checkSmearParam(param);
+  if (epsilon <= 0.0) errorQuda("Wilson flow step size %e must be positive", epsilon);
+
+  const Lattice lat(param->X);
+  const HostGauge gauge(h_gauge, param, lat);
+  const bool adaptive = (tol > 0.0);
+
+  // the links on the extended sublattice, and the generators of the
+  // stages and, with an adaptive step, the links at the start of the
+  // step and those of the embedded step on the interior
+  Link *W[4], *Z[4], *W0[4], *estimate[4];
+  for (int mu=0; mu<4; mu++) {
+    W[mu] = (Link*)pool_host_malloc(lat.ext_volume * sizeof(Link));
+    Z[mu] = (Link*)pool_host_malloc(lat.volume * sizeof(Link));
+    if (adaptive) {
+      W0[mu] = (Link*)pool_host_malloc(lat.volume * sizeof(Link));
+      estimate[mu] = (Link*)pool_host_malloc(lat.volume * sizeof(Link));
+    }
+  }
+
+  gauge.extend(W);
+
+  FlowHistory history(t_meas, E_meas, Q_meas, max_meas);
+  FlowMeasurement m;
+  int n_step = 0, n_reject = 0;
+  double t = 0.0, eps = epsilon;
+  const double min_step = 1e-6*epsilon;
+  bool measured = false; // whether W at t has been measured, before a rejected step
+
+  while (t < t_max) {
+    // a remainder below the smallest step is absorbed into the last one
+    const bool final_step = (t_max - t - eps < min_step);
+    const double h = final_step ? t_max - t : eps;
+
+    if (adaptive) copyInterior(lat, W0, W, false);
+
+    flowStage(lat, W, Z, 0.25, 0.0, h, NULL, measured ? NULL : &m);
+    if (!measured) history.record(t, m);
+    measured = true;
+    flowStage(lat, W, Z, 8.0/9.0, -17.0/9.0, h, adaptive ? estimate : NULL, NULL);
+    flowStage(lat, W, Z, 0.75, -1.0, h, NULL, NULL);
+
+    if (adaptive) {
+      // the step size that would have made the distance 0.95^3 tol
+      double dist = maxDistance(lat, estimate, W);
+      double factor = (dist > 0.0) ? 0.95*pow(tol/dist, 1.0/3.0) : 2.0;
+      eps = h * (factor < 2.0 ? factor : 2.0);
+      if (dist > tol) {
+	copyInterior(lat, W0, W, true);
+	exchangeHalo(lat, W, 4);
+	n_reject++;
+	if (getVerbosity() >= QUDA_DEBUG_VERBOSE)
+	  printfQuda("Wilson flow: step %e at t = %.6f rejected, distance %e\n", h, t, dist);
+	if (eps < min_step) errorQuda("Wilson flow step size underflow at t = %e with tolerance %e", t, tol);
+	continue;
+      }
+    }
+
+    t = final_step ? t_max : t + h;
+    n_step++;
+    measured = false;
+  }
+
+  measureFlow(m, lat, W);
+  history.record(t, m);
+
+  gauge.shrink(W);
+
+  for (int mu=0; mu<4; mu++) {
+    if (adaptive) {
+      pool_host_free(estimate[mu]);
+      pool_host_free(W0[mu]);
+    }
+    pool_host_free(Z[mu]);
+    pool_host_free(W[mu]);
+  }
+
+  gettimeofday(&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec);
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Wilson flow to t = %g: %d steps (%d rejected), t^2 E = %.10e, Q = %.10f, %.2f s\n",
+	       t, n_step, n_reject, t*t*m.E, m.Q, secs);
+  }
+
+  return history.n;
+}
@@ -16,10 +16,10 @@
 #include <face_quda.h>
 #endif
 
-static double anisotropy_;
+static COMM_RANK_LOCAL double anisotropy_;
 extern float fat_link_max_;
-static int X_[4];
-static QudaTboundary t_boundary_;
+static COMM_RANK_LOCAL int X_[4];
+static COMM_RANK_LOCAL QudaTboundary t_boundary_;
 
 
 
@@ -19,6 +19,12 @@
 #include <llfat_quda.h>
 #include <fat_force_quda.h>
 #include <hisq_links_quda.h>
+#include <malloc_quda.h>
+#include <site_order.h>
+#include <solution_writer.h>
+#include <chrono_quda.h>
+#include <profile_quda.h>
+#include <trace_quda.h>
 
 #ifdef NUMA_AFFINITY
 #include <numa_affinity.h>
@@ -27,7 +33,7 @@
 #include <cuda.h>
 
 #ifdef MULTI_GPU
-#ifdef MPI_COMMS
+#if defined(MPI_COMMS) && !defined(THREAD_COMMS)
 #include <mpi.h>
 #endif
 #ifdef QMP_COMMS
@@ -68,28 +74,33 @@ int num_QMP;
 
 #include "face_quda.h"
 
-static QudaVerbosity verbosity;
+// The state of the interface belongs to a rank: with thread comms
+// every rank is a thread of this process, and each has its own
+// resident fields, streams and device.
+static COMM_RANK_LOCAL QudaVerbosity verbosity;
 int numa_affinity_enabled = 1;
 
-cudaGaugeField *gaugePrecise = NULL;
-cudaGaugeField *gaugeSloppy = NULL;
-cudaGaugeField *gaugePrecondition = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugePrecise = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugeSloppy = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugePrecondition = NULL;
 
-// It's important that these alias the above so that constants are set correctly in Dirac::Dirac()
-cudaGaugeField *&gaugeFatPrecise = gaugePrecise;
-cudaGaugeField *&gaugeFatSloppy = gaugeSloppy;
-cudaGaugeField *&gaugeFatPrecondition = gaugePrecondition;
+// It's important that these alias the above so that constants are set
+// correctly in Dirac::Dirac() (macros, since a reference would be
+// bound to the instance of the first rank)
+#define gaugeFatPrecise gaugePrecise
+#define gaugeFatSloppy gaugeSloppy
+#define gaugeFatPrecondition gaugePrecondition
 
-cudaGaugeField *gaugeLongPrecise = NULL;
-cudaGaugeField *gaugeLongSloppy = NULL;
-cudaGaugeField *gaugeLongPrecondition = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugeLongPrecise = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugeLongSloppy = NULL;
+COMM_RANK_LOCAL cudaGaugeField *gaugeLongPrecondition = NULL;
 
-cudaCloverField *cloverPrecise = NULL;
-cudaCloverField *cloverSloppy = NULL;
-cudaCloverField *cloverPrecondition = NULL;
+COMM_RANK_LOCAL cudaCloverField *cloverPrecise = NULL;
+COMM_RANK_LOCAL cudaCloverField *cloverSloppy = NULL;
+COMM_RANK_LOCAL cudaCloverField *cloverPrecondition = NULL;
 
-cudaDeviceProp deviceProp;
-cudaStream_t *streams;
+COMM_RANK_LOCAL cudaDeviceProp deviceProp;
+COMM_RANK_LOCAL cudaStream_t *streams;
 
 
 int getGpuCount()
@@ -116,7 +127,7 @@ void setVerbosityQuda(QudaVerbosity verbosity, const char prefix[], FILE *outfil
 
 void initQuda(int dev)
 {
-  static bool initialized = false;
+  static COMM_RANK_LOCAL bool initialized = false;
   if (initialized) {
     return;
   }
@@ -152,6 +163,10 @@ void initQuda(int dev)
 
 #ifdef MULTI_GPU
   comm_init();
+
+  // QUDA_HALO_COMPRESSION=none/spinor/link/all selects the halo wire format
+  char *compress_str = getenv("QUDA_HALO_COMPRESSION");
+  if (compress_str) setHaloCompression(compress_str);
 #endif
 
 #ifdef QMP_COMMS
@@ -211,19 +226,57 @@ void initQuda(int dev)
 
   quda::initBlas();
 
+  // QUDA_ENABLE_MEMORY_POOL=0 turns off caching of field allocations
+  char *pool_str = getenv("QUDA_ENABLE_MEMORY_POOL");
+  if (pool_str && strcmp(pool_str, "0") == 0) setPoolEnabled(false);
+  char *huge_str = getenv("QUDA_ENABLE_HUGE_PAGES");
+  if (huge_str && strcmp(huge_str, "0") == 0) setHostHugePages(false);
+
+  // QUDA_SOLUTION_WRITER_BUFFERS bounds the solutions queued for writing
+  char *buffers_str = getenv("QUDA_SOLUTION_WRITER_BUFFERS");
+  if (buffers_str) setSolutionWriterBuffers(atoi(buffers_str));
+
+  // QUDA_ENABLE_PROFILER=1 turns on the profile printed by endQuda()
+  char *profile_str = getenv("QUDA_ENABLE_PROFILER");
+  if (profile_str && strcmp(profile_str, "1") == 0) setProfilerEnabled(true);
+  // and QUDA_PROFILE_COUNTERS=1 adds the hardware counters to it
+  char *counters_str = getenv("QUDA_PROFILE_COUNTERS");
+  if (counters_str && strcmp(counters_str, "1") == 0) setProfilerCounters(true);
+
+  // QUDA_TRACE_FILE names the event trace written by endQuda()
+  char *trace_str = getenv("QUDA_TRACE_FILE");
+  if (trace_str) setTraceFile(trace_str);
+  char *events_str = getenv("QUDA_TRACE_EVENTS");
+  if (events_str) setTraceEvents(atoi(events_str));
+
   loadTuneCache(getVerbosity());
 }
 
 
 void loadGaugeQuda(void *h_gauge, QudaGaugeParam *param)
 {
+  ProfileRegion region("load_gauge");
+
   checkGaugeParam(param);
 
   // Set the specific cpu parameters and create the cpu gauge field
   GaugeFieldParam gauge_param(h_gauge, *param);
 
+  // lexicographic links are reordered into an even-odd copy
+  const bool lex = (param->gauge_order == QUDA_QDP_LEX_GAUGE_ORDER);
+  if (lex) {
+    gauge_param.order = QUDA_QDP_GAUGE_ORDER;
+    gauge_param.create = QUDA_NULL_FIELD_CREATE;
+  }
+
   cpuGaugeField cpu(gauge_param);
 
+  if (lex) {
+    for (int d=0; d<4; d++) 
+      lexToEvenOdd(((void**)cpu.Gauge_p())[d], ((void**)h_gauge)[d], gaugeSiteSize*param->cpu_prec, 4, param->X);
+    cpu.markModified();
+  }
+
   // switch the parameters for creating the mirror precise cuda gauge field
   gauge_param.create = QUDA_NULL_FIELD_CREATE;
   gauge_param.precision = param->cuda_prec;
@@ -305,6 +358,13 @@ void saveGaugeQuda(void *h_gauge, QudaGaugeParam *param)
 
   // Set the specific cpu parameters and create the cpu gauge field
   GaugeFieldParam gauge_param(h_gauge, *param);
+
+  const bool lex = (param->gauge_order == QUDA_QDP_LEX_GAUGE_ORDER);
+  if (lex) {
+    gauge_param.order = QUDA_QDP_GAUGE_ORDER;
+    gauge_param.create = QUDA_NULL_FIELD_CREATE;
+  }
+
   cpuGaugeField cpuGauge(gauge_param);
   cudaGaugeField *cudaGauge = NULL;
   switch (param->type) {
@@ -322,6 +382,11 @@ void saveGaugeQuda(void *h_gauge, QudaGaugeParam *param)
   }
 
   cudaGauge->saveCPUField(cpuGauge, QUDA_CPU_FIELD_LOCATION);
+
+  if (lex) {
+    for (int d=0; d<4; d++) 
+      evenOddToLex(((void**)h_gauge)[d], ((void**)cpuGauge.Gauge_p())[d], gaugeSiteSize*param->cpu_prec, 4, param->X);
+  }
 }
 
 
@@ -445,6 +510,13 @@ void freeCloverQuda(void)
 
 void endQuda(void)
 {
+  flushSolutionWriterQuda();
+  flushChronoQuda(-1);
+
+  printProfile();
+  resetProfile();
+  writeTrace();
+
   cudaColorSpinorField::freeBuffer();
   cudaColorSpinorField::freeGhostBuffer();
   cpuColorSpinorField::freeGhostBuffer();
@@ -460,10 +532,20 @@ void endQuda(void)
   }
   destroyDslashEvents();
 
+  if (getVerbosity() >= QUDA_VERBOSE) printPoolStats();
+  trimPool();
+
   saveTuneCache(getVerbosity());
 }
 
 
+void trimMemoryPoolQuda(void)
+{
+  if (getVerbosity() >= QUDA_VERBOSE) printPoolStats();
+  trimPool();
+}
+
+
 void setDiracParam(DiracParam &diracParam, QudaInvertParam *inv_param, const bool pc)
 {
   double kappa = inv_param->kappa;
@@ -829,6 +911,8 @@ cudaGaugeField* checkGauge(QudaInvertParam *param) {
 
 void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
 {
+  ProfileRegion region("invert");
+
   // check the gauge fields have been created
   cudaGaugeField *cudaGauge = checkGauge(param);
 
@@ -926,6 +1010,7 @@ void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
     }
     {
       DiracMdagM m(dirac), mSloppy(diracSloppy);
+      if (param->chrono_window > 0) chronoGuess(param->chrono_tag, m, true, *out, *in);
       CG cg(m, mSloppy, *param);
       cg(*out, *in);
     }
@@ -939,6 +1024,7 @@ void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
     }
     {
       DiracM m(dirac), mSloppy(diracSloppy), mPre(diracPre);
+      if (param->chrono_window > 0) chronoGuess(param->chrono_tag, m, false, *out, *in);
       BiCGstab bicg(m, mSloppy, mPre, *param);
       bicg(*out, *in);
     }
@@ -952,6 +1038,7 @@ void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
     }
     {
       DiracM m(dirac), mSloppy(diracSloppy), mPre(diracPre);
+      if (param->chrono_window > 0) chronoGuess(param->chrono_tag, m, false, *out, *in);
       GCR gcr(m, mSloppy, mPre, *param);
       gcr(*out, *in);
     }
@@ -959,6 +1046,10 @@ void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
   default:
     errorQuda("Inverter type %d not implemented", param->inv_type);
   }
+
+  // keep the solution of the system solved (M or MdagM, preconditioned
+  // or not) for the chronological guess of the next solve
+  if (param->chrono_window > 0) chronoSave(param->chrono_tag, param->chrono_window, *out);
   
   if (param->verbosity >= QUDA_VERBOSE){
    double nx = norm2(*x);
@@ -992,6 +1083,8 @@ void invertQuda(void *hp_x, void *hp_b, QudaInvertParam *param)
 void invertMultiShiftQuda(void **_hp_x, void *_hp_b, QudaInvertParam *param,
 			  double* offsets, int num_offsets, double* residue_sq)
 {
+  ProfileRegion region("multishift");
+
   // check the gauge fields have been created
   cudaGaugeField *cudaGauge = checkGauge(param);
   checkInvertParam(param);
@@ -1183,13 +1276,13 @@ void invertMultiShiftQuda(void **_hp_x, void *_hp_b, QudaInvertParam *param,
 
 /************************************** Ugly Mixed precision multishift CG solver ****************************/
 
-static void* fatlink;
-static int fatlink_pad;
-static void* longlink;
-static int longlink_pad;
-static QudaReconstructType longlink_recon;
-static QudaReconstructType longlink_recon_sloppy;
-static QudaGaugeParam* gauge_param;
+static COMM_RANK_LOCAL void* fatlink;
+static COMM_RANK_LOCAL int fatlink_pad;
+static COMM_RANK_LOCAL void* longlink;
+static COMM_RANK_LOCAL int longlink_pad;
+static COMM_RANK_LOCAL QudaReconstructType longlink_recon;
+static COMM_RANK_LOCAL QudaReconstructType longlink_recon_sloppy;
+static COMM_RANK_LOCAL QudaGaugeParam* gauge_param;
 
 void 
 record_gauge(int* X, void *_fatlink, int _fatlink_pad, void* _longlink, int _longlink_pad, 
@@ -1406,7 +1499,16 @@ invertMultiShiftQudaMixed(void **_hp_x, void *_hp_b, QudaInvertParam *param,
     double tmp1 = param->offset[0];
     param->offset[0]= param->offset[low_index];
     param->offset[low_index] =tmp1;
+
+    tmp1 = param->tol_offset[0];
+    param->tol_offset[0] = param->tol_offset[low_index];
+    param->tol_offset[low_index] = tmp1;
   }
+
+  // the sloppy solve returns its residual in tol_offset[0], so keep
+  // the tolerances of the refinement
+  double tol_offset[QUDA_MAX_MULTI_SHIFT];
+  for (int i=0; i < param->num_offset; i++) tol_offset[i] = param->tol_offset[i];
     
   // Create the matrix.
   // The way this works is that createDirac will create 'd' and 'dSloppy'
@@ -1532,26 +1634,55 @@ invertMultiShiftQudaMixed(void **_hp_x, void *_hp_b, QudaInvertParam *param,
     Dirac& dirac2 = *d;
     Dirac& diracSloppy2 = *dSloppy;
     
-    cudaColorSpinorField* high_x;
-    high_x = new cudaColorSpinorField(cudaParam);
-    for(int i=0;i < param->num_offset; i++){
-      *high_x  = *x[i];
-      delete x[i];
-      double mass = sqrt(param->offset[i]/4);
-      dirac2.setMass(mass);
-      diracSloppy2.setMass(mass);
+    if (param->refine_batch > 1) {
+      // refine refine_batch shifts at a time, each to its own
+      // tolerance, with the operator of the lowest shift
       DiracMdagM m(dirac2), mSloppy(diracSloppy2);
-      CG cg(m, mSloppy, *param);
-      cg(*high_x, *b);      
-      total_iters += param->iter;
-      total_secs  += param->secs;
-      total_gflops += param->gflops;      
-      *h_x[i] = *high_x;
+      QudaInvertParam batch_param = *param;
+      cudaColorSpinorField **high_x = new cudaColorSpinorField* [param->refine_batch];
+      for(int start=0; start < param->num_offset; start += param->refine_batch){
+	int n = param->num_offset - start < param->refine_batch ? param->num_offset - start : param->refine_batch;
+	batch_param.num_offset = n;
+	for(int j=0; j < n; j++){
+	  batch_param.offset[j] = param->offset[start+j];
+	  batch_param.tol_offset[j] = tol_offset[start+j];
+	  high_x[j] = new cudaColorSpinorField(cudaParam);
+	  *high_x[j] = *x[start+j];
+	  delete x[start+j];
+	}
+	MultiShiftRefineCG refine(m, mSloppy, batch_param);
+	refine(high_x, *b);
+	total_iters += batch_param.iter;
+	total_secs  += batch_param.secs;
+	total_gflops += batch_param.gflops;
+	for(int j=0; j < n; j++){
+	  *h_x[start+j] = *high_x[j];
+	  delete high_x[j];
+	}
+      }
+      param->telemetry_count = batch_param.telemetry_count;
+      delete [] high_x;
+    } else {
+      cudaColorSpinorField* high_x;
+      high_x = new cudaColorSpinorField(cudaParam);
+      for(int i=0;i < param->num_offset; i++){
+	*high_x  = *x[i];
+	delete x[i];
+	double mass = sqrt(param->offset[i]/4);
+	dirac2.setMass(mass);
+	diracSloppy2.setMass(mass);
+	DiracMdagM m(dirac2), mSloppy(diracSloppy2);
+	CG cg(m, mSloppy, *param);
+	cg(*high_x, *b);      
+	total_iters += param->iter;
+	total_secs  += param->secs;
+	total_gflops += param->gflops;      
+	*h_x[i] = *high_x;
+      }
+      delete high_x;
     }
     
     param->iter = total_iters;
-    
-    delete high_x;
   }
   
   
@@ -1645,7 +1776,7 @@ void computeFatLinkCore(cudaGaugeField* cudaSiteLink, double* act_path_coeff,
   }
 
 
-  static cudaGaugeField* cudaStapleField=NULL, *cudaStapleField1=NULL;
+  static COMM_RANK_LOCAL cudaGaugeField* cudaStapleField=NULL, *cudaStapleField1=NULL;
   if(cudaStapleField == NULL || cudaStapleField1 == NULL){
     gParam.pad    = qudaGaugeParam->staple_pad;
     gParam.create = QUDA_NULL_FIELD_CREATE;
@@ -1688,8 +1819,8 @@ computeFatLinkQuda(void* fatlink, void** sitelink, double* act_path_coeff,
 
   gettimeofday(&t0, NULL);
 
-  static cpuGaugeField* cpuFatLink=NULL, *cpuSiteLink=NULL;
-  static cudaGaugeField* cudaFatLink=NULL, *cudaSiteLink=NULL;
+  static COMM_RANK_LOCAL cpuGaugeField* cpuFatLink=NULL, *cpuSiteLink=NULL;
+  static COMM_RANK_LOCAL cudaGaugeField* cudaFatLink=NULL, *cudaSiteLink=NULL;
   int flag = qudaGaugeParam->preserve_gauge;
 
   QudaGaugeParam qudaGaugeParam_ex_buf;
@@ -1943,6 +2074,16 @@ void initCommsQuda(int argc, char **argv, const int *X, int nDim) {
   QMP_init_msg_passing(&argc, &argv, QMP_THREAD_SINGLE, &tl);
 
   QMP_declare_logical_topology(X, nDim);
+#elif defined(THREAD_COMMS)
+  // the ranks have already been started by comm_thread_launch()
+  int volume = 1;
+  for (int d=0; d<nDim; d++) volume *= X[d];
+  if (volume != comm_size())
+    errorQuda("Number of thread ranks %d must match requested grid volume %d",
+	      comm_size(), volume);
+
+  comm_set_gridsize(X[0], X[1], X[2], X[3]);
+  comm_init();
 #elif defined(MPI_COMMS)
   MPI_Init (&argc, &argv);  
 
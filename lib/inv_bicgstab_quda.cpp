@@ -13,6 +13,8 @@
 #include<face_quda.h>
 
 #include <color_spinor_field.h>
+#include <trace_quda.h>
+#include <solver_telemetry.h>
 
 // set the required parameters for the inner solver
 void fillInnerInvertParam(QudaInvertParam &inner, const QudaInvertParam &outer);
@@ -25,46 +27,40 @@ double resNorm(const DiracMatrix &mat, cudaColorSpinorField &b, cudaColorSpinorF
 
 
 BiCGstab::BiCGstab(DiracMatrix &mat, DiracMatrix &matSloppy, DiracMatrix &matPrecon, QudaInvertParam &invParam) :
-  Solver(invParam), mat(mat), matSloppy(matSloppy), matPrecon(matPrecon), init(false) {
+  Solver(invParam), mat(mat), matSloppy(matSloppy), matPrecon(matPrecon) {
 
 }
 
 BiCGstab::~BiCGstab() {
-  if(init) {
-    if (wp && wp != pp) delete wp;
-    if (zp && zp != pp) delete zp;
-    delete yp;
-    delete rp;
-    delete pp;
-    delete vp;
-    delete tmpp;
-    delete tp;
-  }
+
 }
 
 void BiCGstab::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b) 
 {
-  if (!init) {
-    ColorSpinorParam csParam(x);
-    csParam.create = QUDA_ZERO_FIELD_CREATE;
-    yp = new cudaColorSpinorField(x, csParam);
-    rp = new cudaColorSpinorField(x, csParam); 
-    csParam.precision = invParam.cuda_prec_sloppy;
-    pp = new cudaColorSpinorField(x, csParam);
-    vp = new cudaColorSpinorField(x, csParam);
-    tmpp = new cudaColorSpinorField(x, csParam);
-    tp = new cudaColorSpinorField(x, csParam);
-
-    // MR preconditioner - we need extra vectors
-    if (invParam.inv_type_precondition == QUDA_MR_INVERTER) {
-      wp = new cudaColorSpinorField(x, csParam);
-      zp = new cudaColorSpinorField(x, csParam);
-    } else { // dummy assignments
-      wp = pp;
-      zp = pp;
-    }
-
-    init = true;
+  // The work fields come from the memory pool for each solve and go
+  // back to it at the end, so that repeated solves reuse the same
+  // blocks while trimPool() can still release them between solves.
+  // Only y, which accumulates the solution, must start from zero; the
+  // others are written before they are read.
+  ColorSpinorParam csParam(x);
+  csParam.create = QUDA_ZERO_FIELD_CREATE;
+  cudaColorSpinorField *yp = new cudaColorSpinorField(x, csParam);
+  csParam.create = QUDA_NULL_FIELD_CREATE;
+  cudaColorSpinorField *rp = new cudaColorSpinorField(x, csParam); 
+  csParam.precision = invParam.cuda_prec_sloppy;
+  cudaColorSpinorField *pp = new cudaColorSpinorField(x, csParam);
+  cudaColorSpinorField *vp = new cudaColorSpinorField(x, csParam);
+  cudaColorSpinorField *tmpp = new cudaColorSpinorField(x, csParam);
+  cudaColorSpinorField *tp = new cudaColorSpinorField(x, csParam);
+
+  // MR preconditioner - we need extra vectors
+  cudaColorSpinorField *wp, *zp;
+  if (invParam.inv_type_precondition == QUDA_MR_INVERTER) {
+    wp = new cudaColorSpinorField(x, csParam);
+    zp = new cudaColorSpinorField(x, csParam);
+  } else { // dummy assignments
+    wp = pp;
+    zp = pp;
   }
 
   cudaColorSpinorField &y = *yp;
@@ -133,8 +129,10 @@ void BiCGstab::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     stopwatchStart();
   }
 
+  SolverTelemetry telemetry(invParam);
   while (r2 > stop && k<invParam.maxiter) {
     
+    double iter_start = traceClock();
     if (k==0) {
       rho = r2; // cDotProductCuda(r0, r_sloppy); // BiCRstab
       copyCuda(p, rSloppy);
@@ -214,12 +212,16 @@ void BiCGstab::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
       maxrx = rNorm;
       //r0Norm = rNorm;      
       rUpdate++;
+      telemetry.record(QUDA_SOLVER_RELIABLE_UPDATE, k+1, r2);
     }
     
     k++;
+    traceEvent("iteration", iter_start, traceClock(), k);
+    telemetry.record(QUDA_SOLVER_ITERATION, k, r2);
     if (invParam.verbosity >= QUDA_VERBOSE) 
       printfQuda("BiCGstab: %d iterations, r2 = %e\n", k, r2);
   }
+  telemetry.record(QUDA_SOLVER_DONE, k, r2);
   
   if (x.Precision() != xSloppy.Precision()) copyCuda(x, xSloppy);
   xpyCuda(y, x);
@@ -238,13 +240,15 @@ void BiCGstab::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     invParam.gflops += gflops;
     invParam.iter += k;
     
-    if (invParam.verbosity >= QUDA_SUMMARIZE) {
-      // Calculate the true residual
-      mat(r, x);
-      double true_res = xmyNormCuda(b, r);
+    // Calculate the true residual
+    mat(r, x);
+    double true_res = xmyNormCuda(b, r);
+    invParam.iter_res = sqrt(r2/b2);
+    invParam.true_res = sqrt(true_res/b2);
       
+    if (invParam.verbosity >= QUDA_SUMMARIZE) {
       printfQuda("BiCGstab: Converged after %d iterations, relative residua: iterated = %e, true = %e\n", 
-		 k, sqrt(r2/b2), sqrt(true_res / b2));    
+		 k, invParam.iter_res, invParam.true_res);
     }
   }
 
@@ -254,5 +258,14 @@ void BiCGstab::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     delete x_sloppy;
   }
 
+  if (wp != pp) delete wp;
+  if (zp != pp) delete zp;
+  delete yp;
+  delete rp;
+  delete pp;
+  delete vp;
+  delete tmpp;
+  delete tp;
+
   return;
 }
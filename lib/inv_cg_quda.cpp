@@ -11,6 +11,8 @@
 #include <sys/time.h>
 
 #include <face_quda.h>
+#include <trace_quda.h>
+#include <solver_telemetry.h>
 
 #include <iostream>
 
@@ -31,8 +33,10 @@ void CG::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     
   cudaColorSpinorField r(b);
 
+  // y, Ap and tmp are all written before they are read, so they need
+  // not be zeroed (y is zeroed once it has served as a temporary)
   ColorSpinorParam param(x);
-  param.create = QUDA_ZERO_FIELD_CREATE;
+  param.create = QUDA_NULL_FIELD_CREATE;
   cudaColorSpinorField y(b, param); 
   
   mat(r, x, y);
@@ -93,9 +97,11 @@ void CG::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
 
   quda::blas_flops = 0;
 
+  SolverTelemetry telemetry(invParam);
   stopwatchStart();
   while (r2 > stop && k<invParam.maxiter) {
 
+    double iter_start = traceClock();
     matSloppy(Ap, p, tmp, tmp2); // tmp as tmp
     
     pAp = reDotProductCuda(p, Ap);
@@ -128,12 +134,15 @@ void CG::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
       maxrx = rNorm;
       r0Norm = rNorm;      
       rUpdate++;
+      telemetry.record(QUDA_SOLVER_RELIABLE_UPDATE, k+1, r2);
 
       beta = r2 / r2_old; 
       xpayCuda(rSloppy, beta, p);
     }
 
     k++;
+    traceEvent("iteration", iter_start, traceClock(), k);
+    telemetry.record(QUDA_SOLVER_ITERATION, k, r2);
     if (invParam.verbosity == QUDA_DEBUG_VERBOSE) {
       double x2 = norm2(x);
       double p2 = norm2(p);
@@ -144,6 +153,8 @@ void CG::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     }
   }
 
+  telemetry.record(QUDA_SOLVER_DONE, k, r2);
+
   if (x.Precision() != xSloppy.Precision()) copyCuda(x, xSloppy);
   xpyCuda(y, x);
 
@@ -165,11 +176,17 @@ void CG::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
 
   quda::blas_flops = 0;
 
-  if (invParam.verbosity >= QUDA_SUMMARIZE){
+  // Calculate the true residual, unless this is an inner solver
+  invParam.iter_res = sqrt(r2/src_norm);
+  if (invParam.inv_type_precondition != QUDA_GCR_INVERTER || invParam.verbosity >= QUDA_SUMMARIZE) {
     mat(r, x, y);
     double true_res = xmyNormCuda(b, r);
+    invParam.true_res = sqrt(true_res/src_norm);
+  }
+
+  if (invParam.verbosity >= QUDA_SUMMARIZE){
     printfQuda("CG: Converged after %d iterations, relative residua: iterated = %e, true = %e\n", 
-	       k, sqrt(r2/src_norm), sqrt(true_res / src_norm));    
+	       k, invParam.iter_res, invParam.true_res);
   }
 
   if (&tmp2 != &tmp) delete tmp2_p;
@@ -13,10 +13,12 @@
 #include<face_quda.h>
 
 #include <color_spinor_field.h>
+#include <trace_quda.h>
+#include <solver_telemetry.h>
 
 #include <sys/time.h>
 
-struct timeval orth0, orth1, pre0, pre1, mat0, mat1, rst0, rst1;
+COMM_RANK_LOCAL struct timeval orth0, orth1, pre0, pre1, mat0, mat1, rst0, rst1;
 
 double timeInterval(struct timeval start, struct timeval end) {
   long ds = end.tv_sec - start.tv_sec;
@@ -230,6 +232,7 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
   cudaColorSpinorField rM(rSloppy);
   cudaColorSpinorField xM(rSloppy);
 
+  SolverTelemetry telemetry(invParam);
   stopwatchStart();
 
   int total_iter = 0;
@@ -243,6 +246,7 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
 
   while (r2 > stop && total_iter < invParam.maxiter) {
     
+    double iter_start = traceClock();
     gettimeofday(&pre0, NULL);
 
     for (int m=0; m<invParam.precondition_cycle; m++) {
@@ -301,6 +305,8 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
 
     k++;
     total_iter++;
+    traceEvent("iteration", iter_start, traceClock(), total_iter);
+    telemetry.record(QUDA_SOLVER_ITERATION, total_iter, r2);
 
     if (invParam.verbosity >= QUDA_VERBOSE) 
       printfQuda("GCR: %d total iterations, %d Krylov iterations, r2 = %e\n", total_iter, k, r2);
@@ -321,6 +327,7 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
       k = 0;
       mat(r, y);
       r2 = xmyNormCuda(b, r);  
+      telemetry.record(QUDA_SOLVER_RELIABLE_UPDATE, total_iter, r2);
 
       if (r2 > stop) {
 	restart++; // restarting if residual is still too great
@@ -341,6 +348,7 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
 
   }
 
+  telemetry.record(QUDA_SOLVER_DONE, total_iter, r2);
   copyCuda(x, y);
 
   if (k>=invParam.maxiter && invParam.verbosity >= QUDA_SUMMARIZE) 
@@ -358,13 +366,15 @@ void GCR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
   invParam.gflops += gflops;
   invParam.iter += total_iter;
   
-  if (invParam.verbosity >= QUDA_SUMMARIZE) {
-    // Calculate the true residual
-    mat(r, x);
-    double true_res = xmyNormCuda(b, r);
+  // Calculate the true residual
+  mat(r, x);
+  double true_res = xmyNormCuda(b, r);
+  invParam.iter_res = sqrt(r2/b2);
+  invParam.true_res = sqrt(true_res/b2);
     
+  if (invParam.verbosity >= QUDA_SUMMARIZE) {
     printfQuda("GCR: Converged after %d iterations, relative residua: iterated = %e, true = %e\n", 
-	       total_iter, sqrt(r2/b2), sqrt(true_res / b2));    
+	       total_iter, invParam.iter_res, invParam.true_res);
   }
 
   if (invParam.cuda_prec_sloppy != invParam.cuda_prec) {
@@ -122,14 +122,17 @@ void MR::operator()(cudaColorSpinorField &x, cudaColorSpinorField &b)
     invParam.gflops += gflops;
     invParam.iter += k;
     
-    if (invParam.verbosity >= QUDA_SUMMARIZE) {
-      // Calculate the true residual
-      r2 = norm2(r);
-      mat(r, x);
-      double true_res = xmyNormCuda(b, r);
+    // Calculate the true residual; the iterated one is still
+    // normalized by the source
+    r2 = norm2(r);
+    mat(r, x);
+    double true_res = xmyNormCuda(b, r);
+    invParam.iter_res = sqrt(r2);
+    invParam.true_res = sqrt(true_res/b2);
       
+    if (invParam.verbosity >= QUDA_SUMMARIZE) {
       printfQuda("MR: Converged after %d iterations, relative residua: iterated = %e, true = %e\n", 
-		 k, sqrt(r2/b2), sqrt(true_res / b2));    
+		 k, invParam.iter_res, invParam.true_res);
     }
   }
 
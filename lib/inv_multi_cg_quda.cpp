@@ -9,6 +9,9 @@
 #include <invert_quda.h>
 #include <util_quda.h>
 #include <face_quda.h>
+#include <solver_checkpoint.h>
+#include <trace_quda.h>
+#include <solver_telemetry.h>
 
 //#include <sys/time.h>
 
@@ -24,6 +27,45 @@
  *
  */
 
+// The scalar state of the solver that is checkpointed alongside r, x
+// and p: r2, j_low and num_offset_now, followed by finished, zeta_i,
+// zeta_im1, beta_im1 and alpha for each shift.
+
+static inline int checkpointStateLength(int num_offset) { return 3 + 5*num_offset; }
+
+static void packState(double *state, int num_offset, double r2, int j_low, int num_offset_now,
+		      const int *finished, const double *zeta_i, const double *zeta_im1,
+		      const double *beta_im1, const double *alpha)
+{
+  state[0] = r2;
+  state[1] = j_low;
+  state[2] = num_offset_now;
+  for (int i=0; i<num_offset; i++) {
+    double *s = state + 3 + 5*i;
+    s[0] = finished[i];
+    s[1] = zeta_i[i];
+    s[2] = zeta_im1[i];
+    s[3] = beta_im1[i];
+    s[4] = alpha[i];
+  }
+}
+
+static void unpackState(const double *state, int num_offset, double &r2, int &j_low, int &num_offset_now,
+			int *finished, double *zeta_i, double *zeta_im1, double *beta_im1, double *alpha)
+{
+  r2 = state[0];
+  j_low = (int)state[1];
+  num_offset_now = (int)state[2];
+  for (int i=0; i<num_offset; i++) {
+    const double *s = state + 3 + 5*i;
+    finished[i] = (int)s[0];
+    zeta_i[i] = s[1];
+    zeta_im1[i] = s[2];
+    beta_im1[i] = s[3];
+    alpha[i] = s[4];
+  }
+}
+
 MultiShiftCG::MultiShiftCG(DiracMatrix &mat, DiracMatrix &matSloppy, QudaInvertParam &invParam) 
   : MultiShiftSolver(invParam), mat(mat), matSloppy(matSloppy) {
 
@@ -50,6 +92,13 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
   double *beta_im1 = new double[num_offset];
   double *alpha = new double[num_offset];
   int i, j;
+
+  // the fields and coefficients of the shifts being updated
+  cudaColorSpinorField **p_active = new cudaColorSpinorField*[num_offset];
+  cudaColorSpinorField **x_active = new cudaColorSpinorField*[num_offset];
+  double *a_active = new double[num_offset];
+  double *b_active = new double[num_offset];
+  double *c_active = new double[num_offset];
   
   int j_low = 0;   
   int num_offset_now = num_offset;
@@ -89,7 +138,7 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
     p[i]= new cudaColorSpinorField(*r_sloppy);    
   }
   
-  param.create = QUDA_ZERO_FIELD_CREATE;
+  param.create = QUDA_NULL_FIELD_CREATE; // written before they are read
   param.precision = invParam.cuda_prec_sloppy;
   cudaColorSpinorField* Ap = new cudaColorSpinorField(*r_sloppy, param);
   
@@ -108,13 +157,39 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
   double r2 = b2;
   double r2_old;
   double stop = r2*invParam.tol*invParam.tol; // stopping condition of solver
+
+  // the stopping condition of each shift, from its own tolerance if set
+  double *stop_offset = new double[num_offset];
+  for (i=0; i<num_offset; i++)
+    stop_offset[i] = residue_sq[i] > 0.0 ? b2*residue_sq[i]*residue_sq[i] : stop;
     
   double pAp;
     
   int k = 0;
+
+  // the source norm and the shifts identify the solve that a
+  // checkpoint belongs to
+  SolverCheckpoint checkpoint(invParam, "MultiShiftCG");
+  const int nKey = num_offset + 1, nState = checkpointStateLength(num_offset), nField = 2*num_offset + 1;
+  double *key = new double[nKey];
+  double *state = new double[nState];
+  cudaColorSpinorField **fields = new cudaColorSpinorField*[nField];
+  key[0] = b2;
+  fields[0] = r_sloppy;
+  for (i=0; i<num_offset; i++) {
+    key[1+i] = offset[i];
+    fields[1+i] = x_sloppy[i];
+    fields[1+num_offset+i] = p[i];
+  }
+
+  if (checkpoint.Enabled() && checkpoint.load(k, key, nKey, state, nState, fields, nField)) {
+    unpackState(state, num_offset, r2, j_low, num_offset_now, finished, zeta_i, zeta_im1, beta_im1, alpha);
+  }
     
+  SolverTelemetry telemetry(invParam);
   stopwatchStart();
   while (r2 > stop &&  k < invParam.maxiter) {
+    double iter_start = traceClock();
     //dslashCuda_st(tmp_sloppy, fatlinkSloppy, longlinkSloppy, p[0], 1 - oddBit, 0);
     //dslashAxpyCuda(Ap, fatlinkSloppy, longlinkSloppy, tmp_sloppy, oddBit, 0, p[0], msq_x4);
     matSloppy(*Ap, *p[0], tmp1, tmp2);
@@ -126,6 +201,7 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
 
     zeta_ip1[0] = 1.0;
     for (j=1; j<num_offset_now; j++) {
+      if (finished[j]) continue;
       zeta_ip1[j] = zeta_i[j] * zeta_im1[j] * beta_im1[j_low];
       double c1 = beta_i[j_low] * alpha[j_low] * (zeta_im1[j]-zeta_i[j]);
       double c2 = zeta_im1[j] * beta_im1[j_low] * (1.0+(offset[j]-offset[0])*beta_i[j_low]);
@@ -162,6 +238,7 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
     alpha[0] = r2 / r2_old;
 	
     for (j=1; j<num_offset_now; j++) {
+      if (finished[j]) continue;
       /*THISBLOWSUP
 	alpha[j] = alpha[j_low] * zeta_ip1[j] * beta_i[j] /
 	(zeta_i[j] * beta_i[j_low]);
@@ -176,10 +253,19 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
       }
     }
 	
-    axpyZpbxCuda(beta_i[0], *p[0], *x_sloppy[0], *r_sloppy, alpha[0]);	
-    for (j=1; j<num_offset_now; j++) {
-      axpyBzpcxCuda(beta_i[j], *p[j], *x_sloppy[j], zeta_ip1[j], *r_sloppy, alpha[j]);
+    // x[j] += beta_i[j] p[j] and p[j] = zeta_ip1[j] r + alpha[j] p[j]
+    // for the shifts still being solved, in one pass over r
+    int num_active = 0;
+    for (j=0; j<num_offset_now; j++) {
+      if (finished[j]) continue;
+      p_active[num_active] = p[j];
+      x_active[num_active] = x_sloppy[j];
+      a_active[num_active] = beta_i[j];
+      b_active[num_active] = zeta_ip1[j];
+      c_active[num_active] = alpha[j];
+      num_active++;
     }
+    multiShiftAxpyBzpcxCuda(a_active, p_active, x_active, b_active, *r_sloppy, c_active, num_active);
     
     for (j=0; j<num_offset_now; j++) {
       beta_im1[j] = beta_i[j];
@@ -188,10 +274,39 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
     }
 
     k++;
+    traceEvent("iteration", iter_start, traceClock(), k);
+    telemetry.record(QUDA_SOLVER_ITERATION, k, r2);
+
+    // the residual of shift j is zeta_i[j] r, so any shift that has
+    // reached its own tolerance can be retired, not only the largest ones
+    for (j=1; j<num_offset_now; j++) {
+      if (!finished[j] && zeta_i[j]*zeta_i[j]*r2 < stop_offset[j]) {
+	finished[j] = 1;
+	if (invParam.verbosity >= QUDA_VERBOSE)
+	  printfQuda("MultiShift CG: shift %d converged after %d iterations\n", j, k);
+      }
+    }
+    while (num_offset_now > 1 && finished[num_offset_now-1]) num_offset_now--;
+
     if (invParam.verbosity >= QUDA_VERBOSE){
       printfQuda("Multimass CG: %d iterations, r2 = %e\n", k, r2);
     }
+
+    if (checkpoint.Due(k) && r2 > stop) {
+      packState(state, num_offset, r2, j_low, num_offset_now, finished, zeta_i, zeta_im1, beta_im1, alpha);
+      checkpoint.save(k, key, nKey, state, nState, fields, nField);
+    }
   }
+
+  telemetry.record(QUDA_SOLVER_DONE, k, r2);
+
+  // a converged solve needs no restart, while one stopped by maxiter
+  // keeps its last checkpoint so that it can be resumed
+  if (r2 <= stop) checkpoint.remove();
+  delete []fields;
+  delete []state;
+  delete []key;
+  delete []stop_offset;
     
   if (x[0]->Precision() != x_sloppy[0]->Precision()) {
     for(i=0;i < num_offset; i++){
@@ -219,6 +334,8 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
     axpyCuda(offset[0],*x[0], *r); // Offset it.
   }
   double true_res = xmyNormCuda(b, *r);
+  invParam.iter_res = sqrt(r2/b2);
+  invParam.true_res = sqrt(true_res/b2);
   if (invParam.verbosity >= QUDA_SUMMARIZE){
     printfQuda("MultiShift CG: Converged after %d iterations, r2 = %e, relative true_r2 = %e\n", 
 	       k,r2, (true_res / b2));
@@ -262,6 +379,11 @@ void MultiShiftCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
   delete []beta_i;
   delete []beta_im1;
   delete []alpha;
+  delete []p_active;
+  delete []x_active;
+  delete []a_active;
+  delete []b_active;
+  delete []c_active;
  
 }
 
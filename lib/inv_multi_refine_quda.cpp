@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <quda_internal.h>
+#include <color_spinor_field.h>
+#include <blas_quda.h>
+#include <dslash_quda.h>
+#include <invert_quda.h>
+#include <util_quda.h>
+
+#include <face_quda.h>
+#include <trace_quda.h>
+#include <solver_telemetry.h>
+
+/*!
+ * Refinement of the solutions of a sloppy multi-shift solve
+ *
+ * Every shift j is solved for by its own CG with reliable updates,
+ * (mat + offset[j]) x[j] = b, starting from the solution in x[j], but
+ * the CGs of all the shifts advance together, one iteration of each
+ * per sweep, and each stops as soon as it reaches its own tolerance
+ * tol_offset[j] (tol if not set).  The larger shifts, which are
+ * better conditioned and whose sloppy solutions are closer to
+ * converged, thus drop out after a few sweeps, and the work is that
+ * of the shifts that need it.
+ *
+ * As in MultiShiftCG, for staggered the mass is folded into the
+ * Dirac operator, which is that of the lowest shift, 4 mass^2.
+ */
+
+MultiShiftRefineCG::MultiShiftRefineCG(DiracMatrix &mat, DiracMatrix &matSloppy, QudaInvertParam &invParam)
+  : MultiShiftSolver(invParam), mat(mat), matSloppy(matSloppy) {
+
+}
+
+MultiShiftRefineCG::~MultiShiftRefineCG() {
+
+}
+
+void MultiShiftRefineCG::operator()(cudaColorSpinorField **x, cudaColorSpinorField &b)
+{
+  const int num_offset = invParam.num_offset;
+  if (num_offset == 0) return;
+
+  const double base = (invParam.dslash_type == QUDA_ASQTAD_DSLASH) ? 4.0*invParam.mass*invParam.mass : 0.0;
+
+  double *shift = new double[num_offset];
+  double *stop = new double[num_offset];
+  double *r2 = new double[num_offset];
+  double *r0Norm = new double[num_offset];
+  double *maxrx = new double[num_offset];
+  double *maxrr = new double[num_offset];
+  int *iter = new int[num_offset];
+  int *converged = new int[num_offset];
+  int rUpdate = 0;
+
+  // y[j] is the solution as of the last reliable update of shift j,
+  // and x_sloppy[j] the correction to it since
+  cudaColorSpinorField **y = new cudaColorSpinorField*[num_offset];
+  cudaColorSpinorField **r = new cudaColorSpinorField*[num_offset];
+  cudaColorSpinorField **x_sloppy = new cudaColorSpinorField*[num_offset];
+  cudaColorSpinorField **r_sloppy = new cudaColorSpinorField*[num_offset];
+  cudaColorSpinorField **p = new cudaColorSpinorField*[num_offset];
+
+  ColorSpinorParam param(*x[0]);
+  param.create = QUDA_NULL_FIELD_CREATE; // written before they are read
+  param.precision = invParam.cuda_prec_sloppy;
+  cudaColorSpinorField Ap(*x[0], param);
+  cudaColorSpinorField tmp(*x[0], param);
+
+  cudaColorSpinorField *tmp2_p = &tmp;
+  // tmp only needed for multi-gpu Wilson-like kernels
+  if (mat.Type() != typeid(DiracStaggeredPC).name() &&
+      mat.Type() != typeid(DiracStaggered).name()) {
+    tmp2_p = new cudaColorSpinorField(*x[0], param);
+  }
+  cudaColorSpinorField &tmp2 = *tmp2_p;
+
+  const double src_norm = norm2(b);
+  const bool sloppy = (invParam.cuda_prec_sloppy != x[0]->Precision());
+
+  quda::blas_flops = 0;
+
+  stopwatchStart();
+
+  int active = 0;
+  for (int j=0; j<num_offset; j++) {
+    shift[j] = invParam.offset[j] - base;
+    const double tol = invParam.tol_offset[j] > 0.0 ? invParam.tol_offset[j] : invParam.tol;
+    stop[j] = src_norm*tol*tol;
+
+    y[j] = new cudaColorSpinorField(*x[j]);
+    r[j] = new cudaColorSpinorField(b);
+    mat(*r[j], *y[j], *x[j]);
+    axpyCuda(shift[j], *y[j], *r[j]);
+    r2[j] = xmyNormCuda(b, *r[j]);
+    zeroCuda(*x[j]);
+
+    if (sloppy) {
+      param.create = QUDA_COPY_FIELD_CREATE;
+      x_sloppy[j] = new cudaColorSpinorField(*x[j], param);
+      r_sloppy[j] = new cudaColorSpinorField(*r[j], param);
+    } else {
+      x_sloppy[j] = x[j];
+      r_sloppy[j] = r[j];
+    }
+    p[j] = new cudaColorSpinorField(*r_sloppy[j]);
+
+    r0Norm[j] = maxrx[j] = maxrr[j] = sqrt(r2[j]);
+    iter[j] = 0;
+    converged[j] = (r2[j] <= stop[j]);
+    if (!converged[j]) active++;
+
+    if (invParam.verbosity >= QUDA_VERBOSE)
+      printfQuda("MultiShift refine: shift %d starts at relative r2 = %e\n", j, r2[j]/src_norm);
+  }
+
+  SolverTelemetry telemetry(invParam);
+  const double delta = invParam.reliable_delta;
+  int k = 0;
+
+  while (active > 0 && k < invParam.maxiter) {
+    double iter_start = traceClock();
+    double r2_max = 0.0;
+
+    for (int j=0; j<num_offset; j++) {
+      if (converged[j]) continue;
+
+      matSloppy(Ap, *p[j], tmp, tmp2);
+      axpyCuda(shift[j], *p[j], Ap);
+
+      double pAp = reDotProductCuda(*p[j], Ap);
+      double alpha = r2[j] / pAp;
+      double r2_old = r2[j];
+      r2[j] = axpyNormCuda(-alpha, Ap, *r_sloppy[j]);
+
+      // reliable update conditions, as in CG
+      double rNorm = sqrt(r2[j]);
+      if (rNorm > maxrx[j]) maxrx[j] = rNorm;
+      if (rNorm > maxrr[j]) maxrr[j] = rNorm;
+      int updateX = (rNorm < delta*r0Norm[j] && r0Norm[j] <= maxrx[j]) ? 1 : 0;
+      int updateR = ((rNorm < delta*maxrr[j] && r0Norm[j] <= maxrr[j]) || updateX) ? 1 : 0;
+
+      if ( !(updateR || updateX)) {
+	double beta = r2[j] / r2_old;
+	axpyZpbxCuda(alpha, *p[j], *x_sloppy[j], *r_sloppy[j], beta);
+      } else {
+	axpyCuda(alpha, *p[j], *x_sloppy[j]);
+	if (sloppy) copyCuda(*x[j], *x_sloppy[j]);
+
+	xpyCuda(*x[j], *y[j]);
+	mat(*r[j], *y[j], *x[j]); // here we can use x as tmp
+	axpyCuda(shift[j], *y[j], *r[j]);
+	r2[j] = xmyNormCuda(b, *r[j]);
+	if (sloppy) copyCuda(*r_sloppy[j], *r[j]);
+	zeroCuda(*x_sloppy[j]);
+
+	rNorm = sqrt(r2[j]);
+	maxrr[j] = rNorm;
+	maxrx[j] = rNorm;
+	r0Norm[j] = rNorm;
+	rUpdate++;
+	telemetry.record(QUDA_SOLVER_RELIABLE_UPDATE, k+1, r2[j]);
+
+	double beta = r2[j] / r2_old;
+	xpayCuda(*r_sloppy[j], beta, *p[j]);
+      }
+
+      iter[j]++;
+      if (r2[j] > r2_max) r2_max = r2[j];
+
+      if (r2[j] <= stop[j]) {
+	converged[j] = 1;
+	active--;
+	if (invParam.verbosity >= QUDA_VERBOSE)
+	  printfQuda("MultiShift refine: shift %d converged after %d iterations\n", j, iter[j]);
+      }
+    }
+
+    k++;
+    traceEvent("iteration", iter_start, traceClock(), k);
+    telemetry.record(QUDA_SOLVER_ITERATION, k, r2_max);
+    if (invParam.verbosity >= QUDA_VERBOSE)
+      printfQuda("MultiShift refine: %d iterations, %d shifts left, max r2 = %e\n", k, active, r2_max);
+  }
+
+  double r2_max = 0.0;
+  for (int j=0; j<num_offset; j++) if (r2[j] > r2_max) r2_max = r2[j];
+  telemetry.record(QUDA_SOLVER_DONE, k, r2_max);
+
+  for (int j=0; j<num_offset; j++) {
+    if (sloppy) copyCuda(*x[j], *x_sloppy[j]);
+    xpyCuda(*y[j], *x[j]);
+  }
+
+  invParam.secs = stopwatchReadSeconds();
+
+  if (k==invParam.maxiter)
+    warningQuda("Exceeded maximum iterations %d", invParam.maxiter);
+
+  if (invParam.verbosity >= QUDA_SUMMARIZE)
+    printfQuda("MultiShift refine: Reliable updates = %d\n", rUpdate);
+
+  double gflops = (quda::blas_flops + mat.flops() + matSloppy.flops())*1e-9;
+  reduceDouble(gflops);
+
+  invParam.gflops = gflops;
+  invParam.iter = k;
+
+  quda::blas_flops = 0;
+
+  // the residuals of the shift furthest from convergence
+  invParam.iter_res = sqrt(r2_max/src_norm);
+  invParam.true_res = 0.0;
+  for (int j=0; j<num_offset; j++) {
+    mat(*r[j], *x[j], *y[j]);
+    axpyCuda(shift[j], *x[j], *r[j]);
+    double true_res = xmyNormCuda(b, *r[j]);
+    if (sqrt(true_res/src_norm) > invParam.true_res) invParam.true_res = sqrt(true_res/src_norm);
+    if (invParam.verbosity >= QUDA_SUMMARIZE)
+      printfQuda("MultiShift refine: shift %d converged after %d iterations, relative residua: iterated = %e, true = %e\n",
+		 j, iter[j], sqrt(r2[j]/src_norm), sqrt(true_res/src_norm));
+  }
+
+  if (&tmp2 != &tmp) delete tmp2_p;
+
+  for (int j=0; j<num_offset; j++) {
+    if (sloppy) {
+      delete x_sloppy[j];
+      delete r_sloppy[j];
+    }
+    delete p[j];
+    delete r[j];
+    delete y[j];
+  }
+  delete []p;
+  delete []r_sloppy;
+  delete []x_sloppy;
+  delete []r;
+  delete []y;
+
+  delete []converged;
+  delete []iter;
+  delete []maxrr;
+  delete []maxrx;
+  delete []r0Norm;
+  delete []r2;
+  delete []stop;
+  delete []shift;
+}
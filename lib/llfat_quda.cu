@@ -7,6 +7,7 @@
 #include <read_gauge.h>
 #include "gauge_field.h"
 #include <force_common.h>
+#include <comm_quda.h>
 
 #if (__COMPUTE_CAPABILITY__ >= 200)
 #define SITE_MATRIX_LOAD_TEX 1
@@ -192,7 +193,7 @@ unsigned long staple_bytes=0;
 void
 llfat_init_cuda(QudaGaugeParam* param)
 {
-  static int llfat_init_cuda_flag = 0;
+  static COMM_RANK_LOCAL int llfat_init_cuda_flag = 0;
   if (llfat_init_cuda_flag){
     return;
   }
@@ -240,7 +241,7 @@ llfat_init_cuda(QudaGaugeParam* param)
 void
 llfat_init_cuda_ex(QudaGaugeParam* param_ex)
 {
-  static int llfat_init_cuda_flag = 0;
+  static COMM_RANK_LOCAL int llfat_init_cuda_flag = 0;
   if (llfat_init_cuda_flag){
     return;
   }
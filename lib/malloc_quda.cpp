@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <map>
+
+#include <quda_internal.h>
+#include <malloc_quda.h>
+
+#include <pthread.h>
+
+#ifdef NUMA_AFFINITY
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// See malloc_quda.h.  Each pool keeps the blocks that are in use, so
+// that pool_*_free() knows their size, and a multimap from size to
+// the cached blocks.
+
+static bool pool_enabled = true;
+
+// with thread comms every rank allocates from the same pools, and the
+// solution writer allocates from its own thread
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK() pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK() pthread_mutex_unlock(&pool_lock)
+
+static void *device_alloc(size_t bytes)
+{
+  void *ptr;
+  if (cudaMalloc(&ptr, bytes) != cudaSuccess) {
+    cudaGetLastError(); // clear the error, the caller will retry or fail
+    return NULL;
+  }
+  return ptr;
+}
+
+static void device_release(void *ptr, size_t) { cudaFree(ptr); }
+
+#ifdef NUMA_AFFINITY
+
+// Host fields of at least one huge page are mapped directly, aligned
+// to huge-page boundaries.  Unless disabled, we first ask for pages
+// from the hugetlbfs pool and otherwise advise the kernel to back the
+// mapping with transparent huge pages.  The pages are then first
+// touched by the OpenMP threads with a static schedule, so that each
+// page lands on the NUMA node of the thread whose share of the
+// lattice it holds in the (statically scheduled) host loops over
+// sites.  The schedule runs over huge pages, so that a transparent
+// huge page is not split between threads.
+//
+// Without host OpenMP the host loops run in the calling thread, and
+// so does the first touch: all pages of a block land on the node of
+// the thread that allocated it, i.e., with thread comms, of the rank
+// that uses it.
+
+#define HUGE_PAGE_SIZE (2ul<<20)
+
+static bool huge_pages = true;
+static long hugetlb_blocks = 0; // blocks backed by hugetlbfs
+static long mapped_blocks = 0;  // all mapped blocks
+
+static inline size_t hugeRound(size_t bytes) { return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+
+// bytes is a multiple of HUGE_PAGE_SIZE
+static void firstTouch(void *ptr, size_t bytes)
+{
+  const long page = sysconf(_SC_PAGESIZE);
+  const long nhuge = bytes / HUGE_PAGE_SIZE;
+  char *p = (char*)ptr;
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<nhuge; i++)
+    for (size_t j=0; j<HUGE_PAGE_SIZE; j+=page) p[i*HUGE_PAGE_SIZE + j] = 0;
+}
+
+static void *host_alloc(size_t bytes)
+{
+  if (bytes < HUGE_PAGE_SIZE) return malloc(bytes);
+
+  const size_t length = hugeRound(bytes);
+  void *ptr = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if (huge_pages) {
+    ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) hugetlb_blocks++;
+  }
+#endif
+
+  if (ptr == MAP_FAILED) {
+    // over-allocate by one huge page and trim to get an aligned range
+    char *base = (char*)mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == (char*)MAP_FAILED) return NULL;
+    char *aligned = (char*)(((size_t)base + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > base) munmap(base, aligned - base);
+    char *end = base + length + HUGE_PAGE_SIZE;
+    if (end > aligned + length) munmap(aligned + length, end - (aligned + length));
+    ptr = aligned;
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+  }
+
+  mapped_blocks++;
+  firstTouch(ptr, length);
+  return ptr;
+}
+
+static void host_release(void *ptr, size_t bytes)
+{
+  if (bytes < HUGE_PAGE_SIZE) free(ptr);
+  else munmap(ptr, hugeRound(bytes));
+}
+
+#define MAX_NUMA_NODES 64
+
+// Adds the NUMA node of (a sample of) the pages of the block to count;
+// count[MAX_NUMA_NODES] gets pages that are not resident or unknown.
+static void countPlacement(long *count, void *ptr, size_t bytes)
+{
+  const int max_sample = 1024;
+  const long page = sysconf(_SC_PAGESIZE);
+  const long npages = hugeRound(bytes) / page;
+  const long stride = npages > max_sample ? npages / max_sample : 1;
+
+  void *pages[max_sample];
+  int status[max_sample];
+  int n = 0;
+  for (long i=0; i<npages && n<max_sample; i+=stride) pages[n++] = (char*)ptr + i*page;
+
+  // move_pages() with no target nodes only reports where the pages are
+  if (syscall(SYS_move_pages, 0, n, pages, NULL, status, 0) != 0) {
+    count[MAX_NUMA_NODES] += n;
+    return;
+  }
+  for (int i=0; i<n; i++) {
+    if (status[i] >= 0 && status[i] < MAX_NUMA_NODES) count[status[i]]++;
+    else count[MAX_NUMA_NODES]++;
+  }
+}
+
+#else
+
+static void *host_alloc(size_t bytes) { return malloc(bytes); }
+
+static void host_release(void *ptr, size_t) { free(ptr); }
+
+#endif // NUMA_AFFINITY
+
+struct MemoryPool {
+  const char *name;
+  void *(*alloc)(size_t);
+  void (*release)(void*, size_t);
+
+  std::multimap<size_t, void*> cache;
+  std::map<void*, size_t> live;
+
+  size_t live_bytes;
+  size_t cached_bytes;
+  size_t peak_bytes;
+  long hits;
+  long misses;
+
+  MemoryPool(const char *name, void *(*alloc)(size_t), void (*release)(void*, size_t)) :
+    name(name), alloc(alloc), release(release), live_bytes(0), cached_bytes(0),
+    peak_bytes(0), hits(0), misses(0) { }
+
+  void trim() {
+    for (std::multimap<size_t, void*>::iterator it = cache.begin(); it != cache.end(); it++)
+      release(it->second, it->first);
+    cache.clear();
+    cached_bytes = 0;
+  }
+
+  void *get(size_t bytes) {
+    void *ptr = NULL;
+
+    std::multimap<size_t, void*>::iterator it = cache.find(bytes);
+    if (it != cache.end()) {
+      ptr = it->second;
+      cache.erase(it);
+      cached_bytes -= bytes;
+      hits++;
+    } else {
+      ptr = alloc(bytes);
+      if (!ptr && cached_bytes) {
+	// the cached blocks may be what stands in the way
+	trim();
+	ptr = alloc(bytes);
+      }
+      if (!ptr) return NULL;
+      misses++;
+    }
+
+    live[ptr] = bytes;
+    live_bytes += bytes;
+    if (live_bytes + cached_bytes > peak_bytes) peak_bytes = live_bytes + cached_bytes;
+    return ptr;
+  }
+
+  void put(void *ptr) {
+    std::map<void*, size_t>::iterator it = live.find(ptr);
+    if (it == live.end()) errorQuda("Pointer %p was not allocated from the %s pool", ptr, name);
+
+    size_t bytes = it->second;
+    live.erase(it);
+    live_bytes -= bytes;
+
+    if (pool_enabled) {
+      cache.insert(std::make_pair(bytes, ptr));
+      cached_bytes += bytes;
+    } else {
+      release(ptr, bytes);
+    }
+  }
+
+  PoolStats stats() const {
+    PoolStats s;
+    s.live_bytes = live_bytes;
+    s.cached_bytes = cached_bytes;
+    s.cached_blocks = cache.size();
+    s.peak_bytes = peak_bytes;
+    s.hits = hits;
+    s.misses = misses;
+    return s;
+  }
+
+  void print() const {
+    printfQuda("%s pool: %lu bytes in use, %lu bytes cached (%lu blocks), peak %lu bytes, "
+	       "%ld hits, %ld misses\n", name, (unsigned long)live_bytes, (unsigned long)cached_bytes,
+	       (unsigned long)cache.size(), (unsigned long)peak_bytes, hits, misses);
+  }
+};
+
+static MemoryPool devicePool("Device", device_alloc, device_release);
+static MemoryPool hostPool("Host", host_alloc, host_release);
+
+#ifdef NUMA_AFFINITY
+// where the pages of the mapped host blocks (in use or cached) reside
+static void printHostPlacement()
+{
+  long count[MAX_NUMA_NODES+1];
+  for (int i=0; i<=MAX_NUMA_NODES; i++) count[i] = 0;
+
+  for (std::map<void*, size_t>::const_iterator it = hostPool.live.begin(); it != hostPool.live.end(); it++)
+    if (it->second >= HUGE_PAGE_SIZE) countPlacement(count, it->first, it->second);
+  for (std::multimap<size_t, void*>::const_iterator it = hostPool.cache.begin(); it != hostPool.cache.end(); it++)
+    if (it->first >= HUGE_PAGE_SIZE) countPlacement(count, it->second, it->first);
+
+  long total = 0;
+  for (int i=0; i<=MAX_NUMA_NODES; i++) total += count[i];
+  if (total == 0) return;
+
+  char placement[1024] = "";
+  size_t len = 0;
+  for (int i=0; i<MAX_NUMA_NODES && len < sizeof(placement); i++)
+    if (count[i]) len += snprintf(placement + len, sizeof(placement) - len, " node %d %.1f%%", i, 100.0*count[i]/total);
+  if (count[MAX_NUMA_NODES] && len < sizeof(placement))
+    snprintf(placement + len, sizeof(placement) - len, " unknown %.1f%%", 100.0*count[MAX_NUMA_NODES]/total);
+
+  printfQuda("Host pool: %ld mapped blocks (%ld from hugetlbfs, transparent huge pages %s), sampled page placement:%s\n",
+	     mapped_blocks, hugetlb_blocks, huge_pages ? "advised" : "disabled", placement);
+}
+#endif
+
+void *pool_device_malloc(size_t bytes)
+{
+  POOL_LOCK();
+  void *ptr = devicePool.get(bytes);
+  POOL_UNLOCK();
+  if (!ptr) errorQuda("Failed to allocate %lu bytes of device memory", (unsigned long)bytes);
+  return ptr;
+}
+
+void pool_device_free(void *ptr)
+{
+  if (!ptr) return;
+  POOL_LOCK();
+  devicePool.put(ptr);
+  POOL_UNLOCK();
+}
+
+void *pool_host_malloc(size_t bytes)
+{
+  POOL_LOCK();
+  void *ptr = hostPool.get(bytes);
+  POOL_UNLOCK();
+  if (!ptr) errorQuda("Failed to allocate %lu bytes of host memory", (unsigned long)bytes);
+  return ptr;
+}
+
+void pool_host_free(void *ptr)
+{
+  if (!ptr) return;
+  POOL_LOCK();
+  hostPool.put(ptr);
+  POOL_UNLOCK();
+}
+
+void trimPool()
+{
+  POOL_LOCK();
+  devicePool.trim();
+  hostPool.trim();
+  POOL_UNLOCK();
+}
+
+void setPoolEnabled(bool enable)
+{
+  pool_enabled = enable;
+  if (!enable) trimPool();
+}
+
+void printPoolStats()
+{
+  POOL_LOCK();
+  devicePool.print();
+  hostPool.print();
+#ifdef NUMA_AFFINITY
+  printHostPlacement();
+#endif
+  POOL_UNLOCK();
+}
+
+PoolStats devicePoolStats()
+{
+  POOL_LOCK();
+  PoolStats s = devicePool.stats();
+  POOL_UNLOCK();
+  return s;
+}
+
+PoolStats hostPoolStats()
+{
+  POOL_LOCK();
+  PoolStats s = hostPool.stats();
+  POOL_UNLOCK();
+  return s;
+}
+
+void setHostHugePages(bool enable)
+{
+#ifdef NUMA_AFFINITY
+  huge_pages = enable;
+#endif
+}
@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <quda_internal.h>
+#include <comm_quda.h>
+#include <parallel_io.h>
+
+#if defined(MPI_COMMS) && !defined(THREAD_COMMS)
+#define USE_MPI_IO
+#include <mpi.h>
+#endif
+
+#ifdef QMP_COMMS
+#include <qmp.h>
+#endif
+
+// See parallel_io.h.
+
+static bool posix_io = false;
+
+static bool ioRoot()
+{
+#ifdef MULTI_GPU
+  return comm_rank() == 0;
+#else
+  return true;
+#endif
+}
+
+static void ioBarrier()
+{
+#if defined(MULTI_GPU) && defined(MPI_COMMS)
+  comm_barrier();
+#elif defined(MULTI_GPU) && defined(QMP_COMMS)
+  QMP_barrier();
+#endif
+}
+
+// each rank on its own: every row of the block is transferred with
+// pread()/pwrite(), by the OpenMP threads if threaded; returns the
+// number of rows that failed, or -1 if the file could not be opened
+static int transferRows(void *block, const char *filename, size_t offset, size_t site_bytes,
+			const int *X, const int *L, const int *start, bool write, bool threaded)
+{
+  int fd = write ? open(filename, O_WRONLY | O_CREAT, 0644) : open(filename, O_RDONLY);
+  if (fd < 0) return -1;
+
+  // each row in x is contiguous in the file
+  const int nRow = L[1]*L[2]*L[3];
+  const size_t row_bytes = L[0]*site_bytes;
+  int fail = 0;
+
+#pragma omp parallel for schedule(static) reduction(+:fail) if(threaded)
+  for (int r=0; r<nRow; r++) {
+    int y = r % L[1], z = (r / L[1]) % L[2], t = r / (L[1]*L[2]);
+    size_t site = ((size_t)((t + start[3])*X[2] + z + start[2])*X[1] + y + start[1])*X[0] + start[0];
+    off_t pos = offset + site*site_bytes;
+    char *buf = (char*)block + r*row_bytes;
+
+    for (size_t done = 0; done < row_bytes; ) {
+      ssize_t n = write ? pwrite(fd, buf + done, row_bytes - done, pos + done) :
+	pread(fd, buf + done, row_bytes - done, pos + done);
+      if (n <= 0) { fail++; break; }
+      done += n;
+    }
+  }
+
+  close(fd);
+  return fail;
+}
+
+static void checkRows(int fail, const char *filename, bool write)
+{
+  if (fail < 0) errorQuda("Cannot open %s", filename);
+  if (fail) errorQuda("Failed to %s %d rows of %s", write ? "write" : "read", fail, filename);
+}
+
+#ifdef USE_MPI_IO
+
+// the block as a subarray of the global lattice, in units of sites
+static void blockTypes(MPI_Datatype *site, MPI_Datatype *block, size_t site_bytes,
+		       const int *X, const int *L, const int *start)
+{
+  int sizes[4], subsizes[4], starts[4];
+  for (int d=0; d<4; d++) { // slowest dimension first
+    sizes[d] = X[3-d];
+    subsizes[d] = L[3-d];
+    starts[d] = start[3-d];
+  }
+  MPI_Type_contiguous(site_bytes, MPI_BYTE, site);
+  MPI_Type_commit(site);
+  MPI_Type_create_subarray(4, sizes, subsizes, starts, MPI_ORDER_C, *site, block);
+  MPI_Type_commit(block);
+}
+
+static void transferBlock(void *block, const char *filename, size_t offset, size_t site_bytes,
+			  const int *X, const int *L, const int *start, bool write)
+{
+  if (posix_io) {
+    checkRows(transferRows(block, filename, offset, site_bytes, X, L, start, write, true), filename, write);
+    return;
+  }
+
+  MPI_Datatype site, subarray;
+  blockTypes(&site, &subarray, site_bytes, X, L, start);
+
+  MPI_File fh;
+  int mode = write ? MPI_MODE_WRONLY | MPI_MODE_CREATE : MPI_MODE_RDONLY;
+  if (MPI_File_open(MPI_COMM_WORLD, (char*)filename, mode, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    errorQuda("MPI_File_open failed for %s", filename);
+  MPI_File_set_view(fh, offset, site, subarray, (char*)"native", MPI_INFO_NULL);
+
+  int volume = L[0]*L[1]*L[2]*L[3];
+  MPI_Status status;
+  int rc = write ? MPI_File_write_all(fh, (void*)block, volume, site, &status) :
+    MPI_File_read_all(fh, block, volume, site, &status);
+  if (rc != MPI_SUCCESS) errorQuda("MPI-IO %s of %s failed", write ? "write" : "read", filename);
+
+  int count;
+  MPI_Get_count(&status, site, &count);
+  if (count != volume) errorQuda("Short %s of %s: %d of %d sites", write ? "write" : "read", filename, count, volume);
+
+  MPI_File_close(&fh);
+  MPI_Type_free(&subarray);
+  MPI_Type_free(&site);
+}
+
+#else
+
+static void transferBlock(void *block, const char *filename, size_t offset, size_t site_bytes,
+			  const int *X, const int *L, const int *start, bool write)
+{
+  checkRows(transferRows(block, filename, offset, site_bytes, X, L, start, write, true), filename, write);
+}
+
+#endif // USE_MPI_IO
+
+void setPosixSublatticeIO(bool posix)
+{
+  posix_io = posix;
+}
+
+void readSublattice(void *block, const char *filename, size_t offset, size_t site_bytes,
+		    const int *X, const int *L, const int *start)
+{
+  transferBlock(block, filename, offset, site_bytes, X, L, start, false);
+}
+
+void writeSublattice(const char *filename, size_t offset, const void *block, size_t site_bytes,
+		     const int *X, const int *L, const int *start)
+{
+  transferBlock(const_cast<void*>(block), filename, offset, site_bytes, X, L, start, true);
+  // the data must be visible to all ranks before anyone reads it back
+  ioBarrier();
+}
+
+bool writeSublatticeLocal(const char *filename, size_t offset, const void *block, size_t site_bytes,
+			  const int *X, const int *L, const int *start)
+{
+  return transferRows(const_cast<void*>(block), filename, offset, site_bytes, X, L, start, true, false) == 0;
+}
+
+void createSharedFile(const char *filename)
+{
+  if (ioRoot()) {
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) errorQuda("Cannot create %s", filename);
+    close(fd);
+  }
+  ioBarrier();
+}
+
+void writeSharedHeader(const char *filename, const void *header, size_t bytes)
+{
+  if (ioRoot()) {
+    int fd = open(filename, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0 || pwrite(fd, header, bytes, 0) != (ssize_t)bytes)
+      errorQuda("Failed to write header of %s", filename);
+    close(fd);
+  }
+  ioBarrier();
+}
+
+size_t readSharedHeader(void *header, const char *filename, size_t bytes)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) errorQuda("Cannot open %s", filename);
+  ssize_t n = pread(fd, header, bytes, 0);
+  close(fd);
+  if (n < 0) errorQuda("Failed to read header of %s", filename);
+  return n;
+}
+
+void initCrcTable(unsigned int *crc_table)
+{
+  for (unsigned int n=0; n<256; n++) {
+    unsigned int c = n;
+    for (int k=0; k<8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+unsigned int scidacCrc32(const unsigned int *crc_table, const void *buf, size_t len)
+{
+  const unsigned char *b = (const unsigned char*)buf;
+  unsigned int c = 0xffffffffu;
+  for (size_t i=0; i<len; i++) c = crc_table[(c ^ b[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffu;
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <quda_internal.h>
+#include <comm_quda.h>
+#include <perf_counters.h>
+
+// See perf_counters.h.  Every thread has one file descriptor per
+// counter, stored as fd[thread*PERF_COUNTERS + counter], and the
+// counters are read with the time they were enabled and running, so
+// that the counts can be scaled up if the kernel had to multiplex
+// them with other events.
+
+static const char *counter_name[PERF_COUNTERS] = { "cycles", "instructions", "llc_references", "llc_misses" };
+
+const char* perfCounterName(PerfCounter counter) { return counter_name[counter]; }
+
+// with thread comms every rank has its own counters
+static COMM_RANK_LOCAL std::vector<int> *fd = NULL;
+
+#ifdef __linux__
+static int openCounter(int counter)
+{
+  static const unsigned long long config[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES
+  };
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config[counter];
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = 1; // allowed with the default perf_event_paranoid
+  attr.exclude_hv = 1;
+
+  // this thread, on any cpu
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bool perfCountersOpen()
+{
+  if (fd) return true;
+
+#ifdef __linux__
+#ifdef _OPENMP
+  const int threads = omp_get_max_threads();
+#else
+  const int threads = 1;
+#endif
+  std::vector<int> f(threads*PERF_COUNTERS, -1);
+
+#pragma omp parallel num_threads(threads)
+  {
+#ifdef _OPENMP
+    const int t = omp_get_thread_num();
+#else
+    const int t = 0;
+#endif
+    for (int c=0; c<PERF_COUNTERS; c++) f[t*PERF_COUNTERS + c] = openCounter(c);
+  }
+
+  bool any = false;
+  for (int c=0; c<PERF_COUNTERS; c++) {
+    if (f[c] >= 0) any = true;
+    else if (getVerbosity() >= QUDA_VERBOSE) warningQuda("Hardware counter %s is not available", counter_name[c]);
+  }
+  if (any) {
+    fd = new std::vector<int>(f);
+    return true;
+  }
+  for (size_t i=0; i<f.size(); i++) if (f[i] >= 0) close(f[i]);
+#endif
+
+  warningQuda("Hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid)");
+  return false;
+}
+
+void perfCountersClose()
+{
+  if (!fd) return;
+  for (size_t i=0; i<fd->size(); i++) if ((*fd)[i] >= 0) close((*fd)[i]);
+  delete fd;
+  fd = NULL;
+}
+
+void perfCountersRead(double count[PERF_COUNTERS])
+{
+  for (int c=0; c<PERF_COUNTERS; c++) count[c] = -1.0;
+  if (!fd) return;
+
+  for (size_t i=0; i<fd->size(); i++) {
+    if ((*fd)[i] < 0) continue;
+    unsigned long long value[3]; // count, time enabled, time running
+    if (read((*fd)[i], value, sizeof(value)) != sizeof(value)) continue;
+
+    const int c = i % PERF_COUNTERS;
+    if (count[c] < 0) count[c] = 0.0;
+    if (value[2] > 0) count[c] += (double)value[0] * value[1] / value[2];
+  }
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <quda_internal.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <profile_quda.h>
+#include <trace_quda.h>
+
+// See profile_quda.h.  The regions entered on a rank form a tree,
+// whose nodes are stored in the order in which they were first
+// entered, with the (nameless) root at index 0.
+
+struct ProfileNode {
+  std::string name;
+  int parent;
+  int depth;
+  double calls;
+  double time;
+  double flops;
+  double bytes;
+  double counter[PERF_COUNTERS];
+
+  ProfileNode(const std::string &name, int parent, int depth)
+    : name(name), parent(parent), depth(depth), calls(0), time(0), flops(0), bytes(0) {
+    for (int c=0; c<PERF_COUNTERS; c++) counter[c] = 0.0;
+  }
+};
+
+struct ProfileTree {
+  std::vector<ProfileNode> node;
+  int current; // the innermost open region
+
+  ProfileTree() : current(0) { node.push_back(ProfileNode("", -1, -1)); }
+
+  // returns the child of the current node with the given name, creating it if needed
+  int child(const char *name) {
+    for (size_t i=current+1; i<node.size(); i++) {
+      if (node[i].parent == current && node[i].name == name) return i;
+    }
+    node.push_back(ProfileNode(name, current, node[current].depth+1));
+    return node.size() - 1;
+  }
+};
+
+static bool enabled = false;
+static bool counters = false;
+
+// with thread comms every rank has its own tree
+static COMM_RANK_LOCAL ProfileTree *tree = NULL;
+
+static ProfileTree& getTree()
+{
+  if (!tree) {
+    tree = new ProfileTree;
+    if (counters && !perfCountersOpen()) counters = false;
+  }
+  return *tree;
+}
+
+ProfileRegion::ProfileRegion(const char *name, long long flops, long long bytes)
+  : name(NULL), node(-1)
+{
+  if (!enabled && !traceEnabled()) return;
+  this->name = name;
+
+  if (enabled) {
+    cudaDeviceSynchronize(); // work launched before the region is not ours
+
+    ProfileTree &t = getTree();
+    node = t.child(name);
+    t.current = node;
+    t.node[node].calls++;
+    t.node[node].flops += flops;
+    t.node[node].bytes += bytes;
+    if (counters) perfCountersRead(count);
+  }
+  start = traceClock();
+}
+
+ProfileRegion::~ProfileRegion()
+{
+  if (!name) return;
+
+  if (node >= 0) cudaDeviceSynchronize();
+  double end = traceClock();
+  traceEvent(name, start, end);
+
+  if (node >= 0) {
+    ProfileTree &t = getTree();
+    t.node[node].time += 1e-6 * (end - start);
+    if (counters) {
+      double now[PERF_COUNTERS];
+      perfCountersRead(now);
+      for (int c=0; c<PERF_COUNTERS; c++) if (now[c] >= 0) t.node[node].counter[c] += now[c] - count[c];
+    }
+    t.current = t.node[node].parent;
+  }
+}
+
+void ProfileRegion::add(long long flops, long long bytes)
+{
+  if (node < 0) return;
+  ProfileTree &t = getTree();
+  t.node[node].flops += flops;
+  t.node[node].bytes += bytes;
+}
+
+void profileRecord(const char *name, double start, double end, long long flops, long long bytes, int id)
+{
+  traceEvent(name, start, end, id);
+
+  if (!enabled) return;
+  ProfileTree &t = getTree();
+  ProfileNode &n = t.node[t.child(name)];
+  n.calls++;
+  n.time += 1e-6 * (end - start);
+  n.flops += flops;
+  n.bytes += bytes;
+}
+
+void setProfilerEnabled(bool enable) { enabled = enable; }
+
+bool profilerEnabled() { return enabled; }
+
+void setProfilerCounters(bool enable) { counters = enable; }
+
+// a checksum of the shape of the tree, to check that it is the same on every rank
+static double treeSignature(const ProfileTree &t)
+{
+  unsigned int hash = t.node.size();
+  for (size_t i=1; i<t.node.size(); i++) {
+    hash = 31*hash + t.node[i].parent;
+    for (const char *c = t.node[i].name.c_str(); *c; c++) hash = 31*hash + *c;
+  }
+  return hash & 0x7fffffff;
+}
+
+void printProfile()
+{
+  if (!enabled) return;
+
+  ProfileTree &t = getTree();
+  const int n = t.node.size();
+
+  double ranks = 1.0;
+  reduceDouble(ranks);
+
+  // the nodes can only be matched up if every rank has entered the same regions
+  double signature[2] = { treeSignature(t), -treeSignature(t) };
+  reduceMaxDouble(signature[0]);
+  reduceMaxDouble(signature[1]);
+  bool local = (signature[0] != -signature[1]);
+  if (local) {
+    warningQuda("Profiled regions differ between ranks, printing the profile of this rank only");
+    ranks = 1.0;
+  }
+
+  // calls, time, flops, bytes and the counters summed over the ranks, and the maximum time
+  const int m = 4 + PERF_COUNTERS;
+  std::vector<double> sum(m*n), max_time(n);
+  for (int i=0; i<n; i++) {
+    sum[m*i+0] = t.node[i].calls;
+    sum[m*i+1] = t.node[i].time;
+    sum[m*i+2] = t.node[i].flops;
+    sum[m*i+3] = t.node[i].bytes;
+    for (int c=0; c<PERF_COUNTERS; c++) sum[m*i+4+c] = t.node[i].counter[c];
+    max_time[i] = t.node[i].time;
+  }
+  if (!local) {
+    reduceDoubleArray(&sum[0], m*n);
+    for (int i=0; i<n; i++) reduceMaxDouble(max_time[i]);
+  }
+
+  printfQuda("Profile (%d ranks, per rank):\n", (int)ranks);
+  if (counters) {
+    printfQuda("%-32s %10s %10s %10s %8s %8s %6s %8s %8s\n", "region", "calls", "mean s", "max s", "GB/s", "GFLOP/s",
+	       "IPC", "LLC miss", "mem B/F");
+  } else {
+    printfQuda("%-32s %10s %10s %10s %8s %8s\n", "region", "calls", "mean s", "max s", "GB/s", "GFLOP/s");
+  }
+
+  // depth-first, in the order in which the regions were entered
+  std::vector<int> stack;
+  for (int i=n-1; i>0; i--) if (t.node[i].parent == 0) stack.push_back(i);
+  while (!stack.empty()) {
+    int i = stack.back();
+    stack.pop_back();
+
+    const double *s = &sum[m*i];
+    const double time = s[1];
+    char label[64];
+    snprintf(label, sizeof(label), "%*s%s", 2*t.node[i].depth, "", t.node[i].name.c_str());
+    if (counters) {
+      const double *count = s + 4;
+      printfQuda("%-32s %10.0f %10.4f %10.4f %8.2f %8.2f %6.2f %7.1f%% %8.2f\n", label, s[0] / ranks, time / ranks,
+		 max_time[i], time > 0 ? 1e-9 * s[3] / time : 0.0, time > 0 ? 1e-9 * s[2] / time : 0.0,
+		 count[PERF_CYCLES] > 0 ? count[PERF_INSTRUCTIONS] / count[PERF_CYCLES] : 0.0,
+		 count[PERF_LLC_REFERENCES] > 0 ? 100.0 * count[PERF_LLC_MISSES] / count[PERF_LLC_REFERENCES] : 0.0,
+		 s[2] > 0 ? 64.0 * count[PERF_LLC_MISSES] / s[2] : 0.0);
+    } else {
+      printfQuda("%-32s %10.0f %10.4f %10.4f %8.2f %8.2f\n", label, s[0] / ranks, time / ranks,
+		 max_time[i], time > 0 ? 1e-9 * s[3] / time : 0.0, time > 0 ? 1e-9 * s[2] / time : 0.0);
+    }
+
+    for (int j=n-1; j>i; j--) if (t.node[j].parent == i) stack.push_back(j);
+  }
+}
+
+void resetProfile()
+{
+  delete tree;
+  tree = NULL;
+  perfCountersClose();
+}
@@ -343,6 +343,7 @@ doubleN reduceLaunch(InputX X, InputY Y, InputZ Z, InputW W, InputV V, Reducer r
   cpu_sum += ((ReduceType*)h_reduce)[0];
 
   const int Nreduce = sizeof(doubleN) / sizeof(double);
+  ProfileRegion region("allreduce");
   reduceDoubleArray((double*)&cpu_sum, Nreduce);
 
   return cpu_sum;
@@ -560,6 +561,7 @@ doubleN reduceCuda(const int kernel, const double2 &a, const double2 &b, cudaCol
   quda::blas_bytes += Reducer<ReduceType,double2,double2>::streams()*x.RealLength()*x.Precision();
   quda::blas_flops += Reducer<ReduceType,double2,double2>::flops()*x.RealLength();
 
+  ProfileRegion region("reduction", reduce->flops(), reduce->bytes());
   reduce->apply(*blasStream);
   delete reduce;
 
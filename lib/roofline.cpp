@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <sys/time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <quda_internal.h>
+#include <roofline.h>
+
+// See roofline.h.  Every probe is run a few times and the best time
+// is kept, as in STREAM.
+
+#define TDIFF(a,b) (b.tv_sec - a.tv_sec + 0.000001*(b.tv_usec - a.tv_usec))
+
+static const long stream_length = 1 << 23;  // doubles per array, 64 MB
+static const long fma_iterations = 1 << 21;
+static const int trials = 4;
+
+// measured by each rank
+static COMM_RANK_LOCAL double peak_bandwidth = 0.0;
+static COMM_RANK_LOCAL double peak_flops[2] = { 0.0, 0.0 }; // single, double
+
+static COMM_RANK_LOCAL volatile double sink; // keeps the results of the flop probe alive
+
+static int hostThreads()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+static double streamTriad()
+{
+  double *a = (double*)malloc(3*stream_length*sizeof(double));
+  if (!a) errorQuda("Cannot allocate the bandwidth probe");
+  double *b = a + stream_length, *c = b + stream_length;
+
+  // touched by the threads that use them, for the first-touch placement
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<stream_length; i++) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+
+  double best = 1e100;
+  for (int t=0; t<trials; t++) {
+    struct timeval t0, t1;
+    gettimeofday(&t0, NULL);
+#pragma omp parallel for schedule(static)
+    for (long i=0; i<stream_length; i++) a[i] = b[i] + 3.0*c[i];
+    gettimeofday(&t1, NULL);
+    if (TDIFF(t0, t1) < best) best = TDIFF(t0, t1);
+  }
+  sink = a[stream_length/2];
+  free(a);
+
+  return 3.0 * stream_length * sizeof(double) / best;
+}
+
+template <typename Float>
+static double fmaThroughput()
+{
+  const int chains = 32;
+
+  double best = 1e100;
+  for (int t=0; t<trials; t++) {
+    double sum = 0.0;
+    struct timeval t0, t1;
+    gettimeofday(&t0, NULL);
+#pragma omp parallel reduction(+:sum)
+    {
+      Float x[chains];
+      const Float a = 0.999999, b = 1e-6;
+      for (int j=0; j<chains; j++) x[j] = j;
+      for (long i=0; i<fma_iterations; i++) {
+	for (int j=0; j<chains; j++) x[j] = a*x[j] + b;
+      }
+      for (int j=0; j<chains; j++) sum += x[j];
+    }
+    gettimeofday(&t1, NULL);
+    sink = sum;
+    if (TDIFF(t0, t1) < best) best = TDIFF(t0, t1);
+  }
+
+  return 2.0 * chains * fma_iterations * hostThreads() / best;
+}
+
+void probeRoofline()
+{
+  peak_bandwidth = streamTriad();
+  peak_flops[0] = fmaThroughput<float>();
+  peak_flops[1] = fmaThroughput<double>();
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Host roofline (%d threads): %.1f GB/s, %.1f GFLOP/s in single and %.1f GFLOP/s in double precision\n",
+	       hostThreads(), 1e-9*peak_bandwidth, 1e-9*peak_flops[0], 1e-9*peak_flops[1]);
+  }
+}
+
+bool rooflineMeasured() { return peak_bandwidth > 0.0; }
+
+double rooflineBandwidth() { return peak_bandwidth; }
+
+double rooflineFlops(QudaPrecision precision) { return precision == QUDA_DOUBLE_PRECISION ? peak_flops[1] : peak_flops[0]; }
+
+double rooflineFraction(double flops, double bytes, double seconds, QudaPrecision precision)
+{
+  if (!rooflineMeasured() || seconds <= 0.0) return 0.0;
+  double bound = bytes / peak_bandwidth;
+  if (flops / rooflineFlops(precision) > bound) bound = flops / rooflineFlops(precision);
+  return bound / seconds;
+}
@@ -0,0 +1,78 @@
+#include <string.h>
+
+#include <quda_internal.h>
+#include <site_order.h>
+
+// See site_order.h.  The copies are done in units of whole sites, so
+// site_bytes is dispatched to a fixed size where we can, letting the
+// compiler inline the memcpy().
+
+template <size_t bytes, bool toEvenOdd>
+static void reorderSites(char *eo, char *lex, size_t site_bytes, int nDim, const int *X)
+{
+  const size_t size = bytes ? bytes : site_bytes;
+
+  size_t volume = 1;
+  for (int d=0; d<nDim; d++) volume *= X[d];
+  const size_t Vh = volume / 2;
+  const int X0 = X[0];
+  const int nSlice = X[nDim-1];
+  const size_t nRow = volume / X0 / nSlice; // rows per slice
+
+#pragma omp parallel for schedule(static)
+  for (int slice=0; slice<nSlice; slice++) {
+    for (size_t r=0; r<nRow; r++) {
+      size_t row = slice*nRow + r;
+
+      // parity of the first site of the row
+      size_t rest = row;
+      int sum = 0;
+      for (int d=1; d<nDim; d++) {
+	sum += rest % X[d];
+	rest /= X[d];
+      }
+
+      char *l = lex + row*X0*size;
+      for (int x=0; x<X0; x++) {
+	size_t cb = (row*X0 + x) / 2;
+	char *e = eo + (((sum + x) & 1)*Vh + cb)*size;
+	if (toEvenOdd) memcpy(e, l + x*size, size);
+	else memcpy(l + x*size, e, size);
+      }
+    }
+  }
+}
+
+template <bool toEvenOdd>
+static void reorderSites(void *eo, const void *lex, size_t site_bytes, int nDim, const int *X)
+{
+  if (X[0] % 2) errorQuda("X[0] = %d must be even", X[0]);
+
+  char *e = (char*)eo, *l = (char*)lex;
+  switch (site_bytes) {
+  case 24:  // staggered spinor, single
+    reorderSites<24, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  case 48:  // staggered spinor, double
+    reorderSites<48, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  case 72:  // link, single
+    reorderSites<72, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  case 96:  // Wilson spinor, single
+    reorderSites<96, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  case 144: // link, double
+    reorderSites<144, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  case 192: // Wilson spinor, double
+    reorderSites<192, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  default:
+    reorderSites<0, toEvenOdd>(e, l, site_bytes, nDim, X); break;
+  }
+}
+
+void lexToEvenOdd(void *eo, const void *lex, size_t site_bytes, int nDim, const int *X)
+{
+  reorderSites<true>(eo, lex, site_bytes, nDim, X);
+}
+
+void evenOddToLex(void *lex, const void *eo, size_t site_bytes, int nDim, const int *X)
+{
+  reorderSites<false>(const_cast<void*>(eo), lex, site_bytes, nDim, X);
+}
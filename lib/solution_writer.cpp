@@ -0,0 +1,514 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <color_spinor_field.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <malloc_quda.h>
+#include <parallel_io.h>
+#include <solution_writer.h>
+
+// Asynchronous writer for solution fields, see writeSolutionAsyncQuda()
+// in quda.h.  Each rank has a writer thread and a bounded number of
+// host buffers.  writeSolutionAsyncQuda() waits for a free buffer,
+// copies the field into it and queues it; the writer thread then
+// brings the field into file order (lexicographic sites, spin-color
+// within a site), writes the rank's block and releases the buffer.
+// When the disk falls behind the solver, the buffers run out and
+// writeSolutionAsyncQuda() blocks until one is released.
+//
+// The writer thread does no communication, since the comms layer is
+// not thread safe (and with thread comms the ranks are identified by
+// their threads).  Everything that involves other ranks is done by
+// the calling thread: the layout of a shared file is fixed when a
+// field is queued, and the SciDAC checksum of a LIME file, which is
+// reduced over all ranks, is written once every rank has written its
+// block.  This happens in the first writeSolutionAsyncQuda() after
+// that, or in flushSolutionWriterQuda().  For the same reason the
+// writer thread does not call errorQuda(): a failed write is recorded,
+// and the error is raised by the next writeSolutionAsyncQuda() or by
+// flushSolutionWriterQuda().
+//
+// The two formats are
+//
+//   QUDA_LIME_FILE_FORMAT: a single SciDAC file (big endian, as read
+//   by QIO), the records written by rank 0 and each rank's block
+//   written with pwrite() into the binary data record;
+//
+//   QUDA_RAW_FILE_FORMAT: one file per rank, filename.<rank>, holding
+//   the rank's block in native byte order after a NERSC-style text
+//   header that records where the block lies in the global lattice.
+
+// default number of buffers, changed with QUDA_SOLUTION_WRITER_BUFFERS
+static int writer_buffers = 2;
+
+struct SolutionJob {
+  long seq;                 // position in the sequence of queued fields
+  void *buffer;             // copy of the field, released once written
+  QudaInvertParam param;
+  int X[4];                 // dimensions of the local lattice
+  int G[4], offset[4];      // global lattice and origin of the local block
+  int rank;
+  QudaFileFormat format;
+  std::string filename;
+
+  // layout of a LIME file
+  std::string header;       // records preceding the binary data
+  size_t data_bytes;
+  size_t checksum_offset;
+  size_t file_bytes;
+  unsigned int sum[2];      // partial SciDAC checksum of the local block
+
+  std::string error;        // why the write failed, empty if it succeeded
+};
+
+struct SolutionWriter {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;      // signalled whenever the queue changes
+
+  std::deque<SolutionJob*> queue;    // waiting for the writer thread
+  std::deque<SolutionJob*> written;  // LIME files awaiting their checksum
+  int in_flight;                     // fields holding a buffer
+  long queued, done;
+  bool stop;
+  std::string error;        // first failure of the writer thread
+
+  // statistics
+  size_t bytes;
+  double write_secs;
+  double wait_secs;
+};
+
+// with thread comms every rank has its own writer
+static COMM_RANK_LOCAL SolutionWriter *writer = NULL;
+
+static double elapsed(const struct timeval &start)
+{
+  struct timeval end;
+  gettimeofday(&end, NULL);
+  return (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec);
+}
+
+static bool bigEndianHost()
+{
+  const unsigned int one = 1;
+  return *(const char*)&one == 0;
+}
+
+static inline unsigned int rotl(unsigned int x, int n) { return n ? (x << n) | (x >> (32 - n)) : x; }
+
+static inline size_t pad8(size_t bytes) { return (bytes + 7) & ~(size_t)7; }
+
+static void putBig(char *p, unsigned long long x, int bytes)
+{
+  for (int i=0; i<bytes; i++) p[i] = (char)(x >> 8*(bytes - 1 - i));
+}
+
+static void limeRecord(std::string &out, const char *type, const std::string &data, bool begin, bool end)
+{
+  // the type fills the last 128 bytes of the header, NUL padded
+  const size_t type_bytes = strlen(type);
+  if (type_bytes > 128) errorQuda("LIME record type %s is longer than 128 bytes", type);
+
+  char h[LIME_HEADER_BYTES];
+  memset(h, 0, sizeof(h));
+  putBig(h, LIME_MAGIC, 4);
+  putBig(h + 4, 1, 2); // version
+  putBig(h + 6, (begin ? 0x8000 : 0) | (end ? 0x4000 : 0), 2);
+  putBig(h + 8, data.size(), 8);
+  memcpy(h + 16, type, std::min(type_bytes, (size_t)128));
+  out.append(h, sizeof(h));
+  out += data;
+  out.append(pad8(data.size()) - data.size(), '\0');
+}
+
+// fixed width, so that every rank arrives at the same layout
+static std::string scidacChecksumXml(const unsigned int *sum)
+{
+  char xml[256];
+  snprintf(xml, sizeof(xml), "<?xml version=\"1.0\" encoding=\"UTF-8\"?><scidacChecksum>"
+	   "<version>1.0</version><suma>%08x</suma><sumb>%08x</sumb></scidacChecksum>", sum[0], sum[1]);
+  return xml;
+}
+
+// The SciDAC file and record messages up to the header of the binary
+// data record, followed by the data and the checksum record.
+static void limeLayout(SolutionJob &job, const cpuColorSpinorField &field)
+{
+  const int nSpin = field.Nspin(), nColor = field.Ncolor();
+  const size_t site_bytes = nSpin * nColor * 2 * field.Precision();
+  const char prec = field.Precision() == QUDA_DOUBLE_PRECISION ? 'D' : 'F';
+  const size_t global_volume = (size_t)job.G[0] * job.G[1] * job.G[2] * job.G[3];
+
+  char date[64];
+  time_t now = time(NULL);
+  struct tm utc;
+  gmtime_r(&now, &utc);
+  strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S UTC", &utc);
+
+  char xml[1024];
+  std::string &h = job.header;
+  h.clear();
+
+  snprintf(xml, sizeof(xml), "<?xml version=\"1.0\" encoding=\"UTF-8\"?><scidacFile><version>1.1</version>"
+	   "<spacetime>4</spacetime><dims>%d %d %d %d </dims><volfmt>0</volfmt></scidacFile>",
+	   job.G[0], job.G[1], job.G[2], job.G[3]);
+  limeRecord(h, "scidac-private-file-xml", xml, true, false);
+  limeRecord(h, "scidac-file-xml", "<?xml version=\"1.0\"?><info>QUDA solution</info>", false, true);
+
+  snprintf(xml, sizeof(xml), "<?xml version=\"1.0\" encoding=\"UTF-8\"?><scidacRecord><version>1.1</version>"
+	   "<date>%s</date><recordtype>0</recordtype><datatype>USQCD_%c%d_%s</datatype>"
+	   "<precision>%c</precision><colors>%d</colors><spins>%d</spins><typesize>%d</typesize>"
+	   "<datacount>1</datacount></scidacRecord>", date, prec, nColor,
+	   nSpin == 4 ? "DiracFermion" : "ColorVector", prec, nColor, nSpin, (int)site_bytes);
+  limeRecord(h, "scidac-private-record-xml", xml, true, false);
+
+  snprintf(xml, sizeof(xml), "<?xml version=\"1.0\"?><quda><gamma_basis>%s</gamma_basis>"
+	   "<kappa>%.16e</kappa><mass>%.16e</mass><tol>%e</tol><iter>%d</iter></quda>",
+	   field.GammaBasis() == QUDA_DEGRAND_ROSSI_GAMMA_BASIS ? "DeGrand-Rossi" : "UKQCD",
+	   job.param.kappa, job.param.mass, job.param.tol, job.param.iter);
+  limeRecord(h, "scidac-record-xml", xml, false, false);
+
+  // the binary data record without its data
+  job.data_bytes = global_volume * site_bytes;
+  limeRecord(h, "scidac-binary-data", "", false, false);
+  putBig(&h[h.size() - LIME_HEADER_BYTES + 8], job.data_bytes, 8);
+
+  job.checksum_offset = h.size() + pad8(job.data_bytes);
+  unsigned int zero[2] = {0, 0};
+  job.file_bytes = job.checksum_offset + LIME_HEADER_BYTES + pad8(scidacChecksumXml(zero).size());
+}
+
+static bool writeAll(int fd, const void *buf, size_t bytes, off_t pos)
+{
+  for (size_t done = 0; done < bytes; ) {
+    ssize_t n = pwrite(fd, (const char*)buf + done, bytes - done, pos + done);
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+static bool jobError(SolutionJob &job, const char *what, const char *filename)
+{
+  job.error = std::string(what) + " " + filename;
+  return false;
+}
+
+static void swapBytes(void *data, size_t bytes, int word)
+{
+  char *p = (char*)data;
+  for (size_t i=0; i<bytes; i+=word)
+    for (int j=0; j<word/2; j++) {
+      char tmp = p[i+j];
+      p[i+j] = p[i+word-1-j];
+      p[i+word-1-j] = tmp;
+    }
+}
+
+static bool writeLime(SolutionJob &job, cpuColorSpinorField &lex)
+{
+  const size_t site_bytes = lex.Nspin() * lex.Ncolor() * 2 * lex.Precision();
+  const int *L = job.X;
+  char *data = (char*)lex.V();
+
+  if (!bigEndianHost()) swapBytes(data, lex.Volume() * site_bytes, lex.Precision());
+
+  unsigned int crc_table[256];
+  initCrcTable(crc_table);
+  job.sum[0] = job.sum[1] = 0;
+  for (int i=0; i<lex.Volume(); i++) {
+    int g[4];
+    int rest = i;
+    for (int d=0; d<4; d++) {
+      g[d] = rest % L[d] + job.offset[d];
+      rest /= L[d];
+    }
+    size_t rank = ((size_t)(g[3]*job.G[2] + g[2])*job.G[1] + g[1])*job.G[0] + g[0];
+    unsigned int crc = scidacCrc32(crc_table, data + i*site_bytes, site_bytes);
+    job.sum[0] ^= rotl(crc, rank % 29);
+    job.sum[1] ^= rotl(crc, rank % 31);
+  }
+
+  if (job.rank == 0) {
+    int fd = open(job.filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return jobError(job, "Cannot open", job.filename.c_str());
+    bool ok = writeAll(fd, job.header.data(), job.header.size(), 0);
+    close(fd);
+    if (!ok) return jobError(job, "Failed to write", job.filename.c_str());
+  }
+
+  if (!writeSublatticeLocal(job.filename.c_str(), job.header.size(), data, site_bytes, job.G, L, job.offset))
+    return jobError(job, "Failed to write", job.filename.c_str());
+  return true;
+}
+
+static bool writeRaw(SolutionJob &job, cpuColorSpinorField &lex)
+{
+  const size_t bytes = lex.Volume() * lex.Nspin() * lex.Ncolor() * 2 * lex.Precision();
+
+  // sum of the 32-bit words of the block
+  const unsigned int *w = (const unsigned int*)lex.V();
+  unsigned int checksum = 0;
+  for (size_t i=0; i<bytes/4; i++) checksum += w[i];
+
+  char header[2048];
+  size_t header_bytes = snprintf(header, sizeof(header),
+				 "BEGIN_HEADER\n"
+				 "DATATYPE = QUDA_SPINOR_BLOCK\n"
+				 "DIMENSION_1 = %d\n"
+				 "DIMENSION_2 = %d\n"
+				 "DIMENSION_3 = %d\n"
+				 "DIMENSION_4 = %d\n"
+				 "BLOCK_DIMENSION_1 = %d\n"
+				 "BLOCK_DIMENSION_2 = %d\n"
+				 "BLOCK_DIMENSION_3 = %d\n"
+				 "BLOCK_DIMENSION_4 = %d\n"
+				 "BLOCK_OFFSET_1 = %d\n"
+				 "BLOCK_OFFSET_2 = %d\n"
+				 "BLOCK_OFFSET_3 = %d\n"
+				 "BLOCK_OFFSET_4 = %d\n"
+				 "NSPIN = %d\n"
+				 "NCOLOR = %d\n"
+				 "GAMMA_BASIS = %d\n"
+				 "CHECKSUM = %08x\n"
+				 "FLOATING_POINT = IEEE%d%s\n"
+				 "END_HEADER\n",
+				 job.G[0], job.G[1], job.G[2], job.G[3], job.X[0], job.X[1], job.X[2], job.X[3],
+				 job.offset[0], job.offset[1], job.offset[2], job.offset[3],
+				 lex.Nspin(), lex.Ncolor(), lex.GammaBasis(), checksum,
+				 8*lex.Precision(), bigEndianHost() ? "BIG" : "LITTLE");
+
+  char filename[1024];
+  snprintf(filename, sizeof(filename), "%s.%d", job.filename.c_str(), job.rank);
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return jobError(job, "Cannot create", filename);
+  bool ok = writeAll(fd, header, header_bytes, 0) && writeAll(fd, lex.V(), bytes, header_bytes);
+  close(fd);
+  if (!ok) return jobError(job, "Failed to write", filename);
+  return true;
+}
+
+// run by the writer thread, failures are left in job.error
+static void writeJob(SolutionJob &job)
+{
+  ColorSpinorParam param(job.buffer, QUDA_CPU_FIELD_LOCATION, job.param, job.X, false);
+  cpuColorSpinorField in(param);
+
+  ColorSpinorParam lexParam(in);
+  lexParam.siteOrder = QUDA_LEXICOGRAPHIC_SITE_ORDER;
+  lexParam.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  lexParam.create = QUDA_NULL_FIELD_CREATE;
+  cpuColorSpinorField lex(lexParam);
+  lex.copy(in);
+
+  // the copy is in file order, so the buffer can be reused
+  pool_host_free(job.buffer);
+  job.buffer = NULL;
+
+  if (job.format == QUDA_LIME_FILE_FORMAT) writeLime(job, lex);
+  else writeRaw(job, lex);
+}
+
+static void *writerThread(void *arg)
+{
+  SolutionWriter *w = (SolutionWriter*)arg;
+
+  pthread_mutex_lock(&w->lock);
+  while (true) {
+    while (w->queue.empty() && !w->stop) pthread_cond_wait(&w->cond, &w->lock);
+    if (w->queue.empty()) break;
+
+    SolutionJob *job = w->queue.front();
+    w->queue.pop_front();
+    pthread_mutex_unlock(&w->lock);
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    writeJob(*job);
+    double secs = elapsed(start);
+
+    pthread_mutex_lock(&w->lock);
+    w->in_flight--;
+    w->done++;
+    w->write_secs += secs;
+    if (!job->error.empty() && w->error.empty()) w->error = job->error;
+    if (job->format == QUDA_LIME_FILE_FORMAT) w->written.push_back(job);
+    else delete job;
+    pthread_cond_broadcast(&w->cond);
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+static void startWriter()
+{
+  writer = new SolutionWriter;
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->cond, NULL);
+  writer->in_flight = 0;
+  writer->queued = writer->done = 0;
+  writer->stop = false;
+  writer->bytes = 0;
+  writer->write_secs = writer->wait_secs = 0.0;
+  if (pthread_create(&writer->thread, NULL, writerThread, writer) != 0)
+    errorQuda("Failed to start the solution writer thread");
+}
+
+// Writes the checksum records of the LIME files that every rank has
+// written (all of them if wait), must be called by all ranks.
+static void finishFiles(bool wait)
+{
+  pthread_mutex_lock(&writer->lock);
+  while (wait && writer->done < writer->queued) pthread_cond_wait(&writer->cond, &writer->lock);
+  double done = -(double)writer->done;
+  pthread_mutex_unlock(&writer->lock);
+
+  // the files finished everywhere are the same on every rank
+  reduceMaxDouble(done);
+  const long all_done = (long)-done;
+
+  std::deque<SolutionJob*> finished;
+  pthread_mutex_lock(&writer->lock);
+  while (!writer->written.empty() && writer->written.front()->seq < all_done) {
+    finished.push_back(writer->written.front());
+    writer->written.pop_front();
+  }
+  pthread_mutex_unlock(&writer->lock);
+  if (finished.empty()) return;
+
+  // the XOR checksums are reduced bit by bit
+  const int n = finished.size();
+  double *sums = new double[64*n];
+  for (int j=0; j<n; j++)
+    for (int b=0; b<64; b++) sums[64*j+b] = (finished[j]->sum[b/32] >> (b%32)) & 1;
+  reduceDoubleArray(sums, 64*n);
+
+  for (int j=0; j<n; j++) {
+    SolutionJob *job = finished[j];
+    unsigned int sum[2] = {0, 0};
+    for (int b=0; b<64; b++) sum[b/32] |= ((unsigned int)sums[64*j+b] & 1) << (b%32);
+
+    if (job->rank == 0) {
+      std::string record;
+      limeRecord(record, "scidac-checksum", scidacChecksumXml(sum), false, true);
+      int fd = open(job->filename.c_str(), O_WRONLY);
+      if (fd < 0) errorQuda("Cannot open %s", job->filename.c_str());
+      if (!writeAll(fd, record.data(), record.size(), job->checksum_offset))
+	errorQuda("Failed to write %s", job->filename.c_str());
+      // an older file of the same name may have been longer
+      if (ftruncate(fd, job->file_bytes)) errorQuda("Failed to truncate %s", job->filename.c_str());
+      close(fd);
+    }
+
+    if (getVerbosity() >= QUDA_VERBOSE)
+      printfQuda("Solution writer: finished %s, checksum %08x %08x\n", job->filename.c_str(), sum[0], sum[1]);
+    delete job;
+  }
+
+  delete []sums;
+}
+
+// raises a failure of the writer thread in the calling thread
+static void checkWriter()
+{
+  pthread_mutex_lock(&writer->lock);
+  std::string error = writer->error;
+  pthread_mutex_unlock(&writer->lock);
+  if (!error.empty()) errorQuda("Solution writer: %s", error.c_str());
+}
+
+void setSolutionWriterBuffers(int n)
+{
+  if (n < 1) errorQuda("Solution writer needs at least one buffer, not %d", n);
+  writer_buffers = n;
+}
+
+void writeSolutionAsyncQuda(void *h_x, QudaInvertParam *param, const int *X, const char *filename,
+			    QudaFileFormat format)
+{
+  if (format != QUDA_LIME_FILE_FORMAT && format != QUDA_RAW_FILE_FORMAT)
+    errorQuda("Unsupported solution file format %d", format);
+  if (!writer) startWriter();
+  checkWriter();
+
+  ColorSpinorParam cpuParam(h_x, QUDA_CPU_FIELD_LOCATION, *param, X, false);
+  cpuColorSpinorField field(cpuParam);
+  if (field.Ndim() != 4) errorQuda("Only 4-d solution fields are supported");
+
+  SolutionJob *job = new SolutionJob;
+  job->seq = writer->queued;
+  job->buffer = NULL;
+  job->param = *param;
+  job->format = format;
+  job->filename = filename;
+  for (int d=0; d<4; d++) {
+    job->X[d] = X[d];
+    job->G[d] = X[d] * commDim(d);
+    job->offset[d] = commCoords(d) * X[d];
+  }
+#ifdef MULTI_GPU
+  job->rank = comm_rank();
+#else
+  job->rank = 0;
+#endif
+  if (format == QUDA_LIME_FILE_FORMAT) limeLayout(*job, field);
+
+  // wait for a free buffer
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  pthread_mutex_lock(&writer->lock);
+  while (writer->in_flight >= writer_buffers) pthread_cond_wait(&writer->cond, &writer->lock);
+  writer->in_flight++;
+  writer->wait_secs += elapsed(start);
+  pthread_mutex_unlock(&writer->lock);
+
+  job->buffer = pool_host_malloc(field.Bytes());
+  memcpy(job->buffer, h_x, field.Bytes());
+
+  pthread_mutex_lock(&writer->lock);
+  writer->queue.push_back(job);
+  writer->queued++;
+  writer->bytes += field.Bytes();
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+
+  finishFiles(false);
+}
+
+void flushSolutionWriterQuda(void)
+{
+  if (!writer) return;
+
+  finishFiles(true);
+
+  pthread_mutex_lock(&writer->lock);
+  writer->stop = true;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->thread, NULL);
+  checkWriter();
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Solution writer: %ld fields (%.1f MB per rank) written in %.2f s, %.2f s waiting for buffers\n",
+	       writer->queued, writer->bytes / 1048576.0, writer->write_secs, writer->wait_secs);
+  }
+
+  pthread_cond_destroy(&writer->cond);
+  pthread_mutex_destroy(&writer->lock);
+  delete writer;
+  writer = NULL;
+}
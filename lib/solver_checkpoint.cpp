@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <quda_internal.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <malloc_quda.h>
+#include <solver_checkpoint.h>
+
+// See solver_checkpoint.h.  A checkpoint file holds, in the native
+// byte order,
+//
+//   char magic[8], char solver[32], int iter, int nKey, int nState, int nField
+//   double key[nKey], double state[nState], unsigned long long bytes[nField]
+//
+// followed by the raw storage of each field.
+
+static const char checkpoint_magic[8] = { 'Q', 'U', 'D', 'A', 'C', 'K', 'P', 'T' };
+
+SolverCheckpoint::SolverCheckpoint(const QudaInvertParam &param, const char *solver)
+  : interval(param.checkpoint_interval), solver(solver)
+{
+  filename[0] = '\0';
+  if (interval <= 0) return;
+  if (param.checkpoint_path[0] == '\0') errorQuda("checkpoint_interval is set but checkpoint_path is empty");
+
+#ifdef MULTI_GPU
+  int rank = comm_rank();
+#else
+  int rank = 0;
+#endif
+  snprintf(filename, sizeof(filename), "%s.%d", param.checkpoint_path, rank);
+}
+
+void SolverCheckpoint::save(int iter, const double *key, int nKey, const double *state, int nState,
+			    cudaColorSpinorField **fields, int nField) const
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  // written next to the checkpoint and renamed over it once complete
+  char tmp[sizeof(filename) + 8];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    warningQuda("Cannot write checkpoint %s", tmp);
+    return;
+  }
+
+  char name[32];
+  memset(name, 0, sizeof(name));
+  strncpy(name, solver, sizeof(name) - 1);
+  int dims[4] = { iter, nKey, nState, nField };
+
+  bool ok = fwrite(checkpoint_magic, sizeof(checkpoint_magic), 1, f) == 1 &&
+    fwrite(name, sizeof(name), 1, f) == 1 && fwrite(dims, sizeof(dims), 1, f) == 1 &&
+    fwrite(key, sizeof(double), nKey, f) == (size_t)nKey &&
+    fwrite(state, sizeof(double), nState, f) == (size_t)nState;
+
+  size_t total = 0;
+  for (int i=0; i<nField && ok; i++) {
+    unsigned long long bytes = fields[i]->BackupBytes();
+    ok = fwrite(&bytes, sizeof(bytes), 1, f) == 1;
+    total += bytes;
+  }
+
+  for (int i=0; i<nField && ok; i++) {
+    size_t bytes = fields[i]->BackupBytes();
+    void *buffer = pool_host_malloc(bytes);
+    fields[i]->backup(buffer);
+    ok = fwrite(buffer, 1, bytes, f) == bytes;
+    pool_host_free(buffer);
+  }
+
+  if (fclose(f) != 0) ok = false;
+  if (!ok || rename(tmp, filename) != 0) {
+    warningQuda("Failed to write checkpoint %s", filename);
+    unlink(tmp);
+    return;
+  }
+
+  gettimeofday(&end, NULL);
+  if (getVerbosity() >= QUDA_VERBOSE) {
+    printfQuda("%s: checkpoint at iteration %d (%.1f MB per rank) written in %.2f s\n", solver, iter,
+	       total / 1048576.0, (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec));
+  }
+}
+
+bool SolverCheckpoint::load(int &iter, const double *key, int nKey, double *state, int nState,
+			    cudaColorSpinorField **fields, int nField) const
+{
+  // first check that the checkpoint belongs to this solve
+  FILE *f = fopen(filename, "rb");
+  bool found = (f != NULL);
+  bool ok = found;
+  int dims[4] = { -1, 0, 0, 0 };
+  double *saved_state = new double[nState];
+
+  if (ok) {
+    char magic[8], name[32];
+    ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, checkpoint_magic, sizeof(magic)) &&
+      fread(name, sizeof(name), 1, f) == 1 && !strncmp(name, solver, sizeof(name)) &&
+      fread(dims, sizeof(dims), 1, f) == 1 &&
+      dims[1] == nKey && dims[2] == nState && dims[3] == nField;
+  }
+  for (int i=0; i<nKey && ok; i++) {
+    double saved;
+    ok = fread(&saved, sizeof(double), 1, f) == 1 &&
+      fabs(saved - key[i]) <= 1e-10 * fabs(key[i]);
+  }
+  if (ok) ok = fread(saved_state, sizeof(double), nState, f) == (size_t)nState;
+  for (int i=0; i<nField && ok; i++) {
+    unsigned long long bytes;
+    ok = fread(&bytes, sizeof(bytes), 1, f) == 1 && bytes == fields[i]->BackupBytes();
+  }
+
+  // every rank must resume from the same iteration
+  double status[2] = { ok ? 0.0 : 1.0, found ? 1.0 : 0.0 };
+  reduceDoubleArray(status, 2);
+  double max_iter = ok ? dims[0] : -1.0, min_iter = ok ? -dims[0] : -1e9;
+  reduceMaxDouble(max_iter);
+  reduceMaxDouble(min_iter);
+
+  if (status[0] > 0.0 || max_iter != -min_iter) {
+    if (status[1] > 0.0) warningQuda("Ignoring checkpoint %s that does not match this solve on all ranks", filename);
+    if (f) fclose(f);
+    delete []saved_state;
+    return false;
+  }
+
+  for (int i=0; i<nField && ok; i++) {
+    size_t bytes = fields[i]->BackupBytes();
+    void *buffer = pool_host_malloc(bytes);
+    ok = fread(buffer, 1, bytes, f) == bytes;
+    if (ok) fields[i]->restore(buffer);
+    pool_host_free(buffer);
+  }
+  fclose(f);
+
+  // the fields may already be partly overwritten at this point
+  if (!ok) errorQuda("Checkpoint %s is truncated", filename);
+
+  iter = dims[0];
+  memcpy(state, saved_state, nState * sizeof(double));
+  delete []saved_state;
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) printfQuda("%s: resuming from checkpoint at iteration %d\n", solver, iter);
+
+  return true;
+}
+
+void SolverCheckpoint::remove() const
+{
+  if (interval > 0) unlink(filename);
+}
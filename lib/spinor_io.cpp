@@ -0,0 +1,427 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <color_spinor_field.h>
+#include <face_quda.h>
+#include <malloc_quda.h>
+#include <parallel_io.h>
+
+// Spinor fields (e.g., solutions or propagators) are written to and
+// read from a shared file, each rank handling its own sublattice
+// through parallel_io.h, see writeSpinorFileQuda() and
+// writePropagatorFileQuda() in quda.h.  The file has a NERSC-style
+// text header followed by the global field in lexicographic site
+// order.  A file holds NFIELD fields (e.g., the 12 spin-color
+// components of a propagator); each site stores one block per field,
+// holding the field's spin-color components at that site:
+//
+//   BEGIN_HEADER
+//   DATATYPE = QUDA_SPINOR
+//   DIMENSION_1 = ...          (and _2, _3, _4)
+//   NFIELD = 1
+//   NSPIN = 4
+//   NCOLOR = 3
+//   GAMMA_BASIS = ...          (QudaGammaBasis)
+//   COMPRESSION = NONE         (or FIXED16, FIXED8)
+//   MAX_ERROR = ...            (compressed files only)
+//   CHECKSUM = ...             (sum of the 32-bit words of the data)
+//   FLOATING_POINT = IEEE64LITTLE
+//   END_HEADER
+//
+// Uncompressed blocks are stored in the precision and byte order of
+// the writer.  Compressed blocks use the representation of
+// half-precision device fields: a float norm, equal to the largest
+// magnitude in the block, followed by the reals in 16-bit (or 8-bit)
+// fixed point relative to it, padded to a multiple of 4 bytes.
+// FLOATING_POINT then describes the norm.  The rounding error is at
+// most half a unit in the last place of the mantissa relative to the
+// norm; MAX_ERROR records the largest such error in the field.
+
+#define SPINOR_HEADER_BYTES 4096
+
+#define MAX_CHAR 127.0f
+
+static bool bigEndianHost()
+{
+  const unsigned int one = 1;
+  return *(const char*)&one == 0;
+}
+
+static inline unsigned int swap32(unsigned int x)
+{
+  return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+static const char *compression_name[] = { "NONE", "FIXED8", "FIXED16" };
+
+static inline int compressionIndex(int bits) { return bits / 8; }
+
+// bytes per block, one field at one site
+static inline size_t blockBytes(int nReal, int bits, QudaPrecision precision)
+{
+  if (bits == 0) return nReal * precision;
+  return (sizeof(float) + nReal*bits/8 + 3) & ~(size_t)3;
+}
+
+static size_t spinorHeader(char *header, size_t bytes, const int *X, int nField, int nSpin, int nColor,
+			   QudaGammaBasis basis, QudaPrecision precision, int bits, double max_error,
+			   unsigned int checksum)
+{
+  char error[64] = "";
+  if (bits) snprintf(error, sizeof(error), "MAX_ERROR = %e\n", max_error);
+  return snprintf(header, bytes,
+		  "BEGIN_HEADER\n"
+		  "DATATYPE = QUDA_SPINOR\n"
+		  "DIMENSION_1 = %d\n"
+		  "DIMENSION_2 = %d\n"
+		  "DIMENSION_3 = %d\n"
+		  "DIMENSION_4 = %d\n"
+		  "NFIELD = %d\n"
+		  "NSPIN = %d\n"
+		  "NCOLOR = %d\n"
+		  "GAMMA_BASIS = %d\n"
+		  "COMPRESSION = %s\n"
+		  "%s"
+		  "CHECKSUM = %08x\n"
+		  "FLOATING_POINT = IEEE%d%s\n"
+		  "END_HEADER\n",
+		  X[0], X[1], X[2], X[3], nField, nSpin, nColor, basis,
+		  compression_name[compressionIndex(bits)], error, checksum,
+		  bits ? 32 : 8*precision, bigEndianHost() ? "BIG" : "LITTLE");
+}
+
+// value of "key = value" in the header
+static bool headerValue(char *value, size_t len, const char *header, const char *key)
+{
+  for (const char *line = header; line && *line; line = strchr(line, '\n'), line = line ? line+1 : NULL) {
+    char k[64], v[128];
+    if (sscanf(line, " %63[A-Z_0-9] = %127s", k, v) == 2 && !strcmp(k, key)) {
+      strncpy(value, v, len-1);
+      value[len-1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+// sum of the 32-bit words of the data as written, over all ranks
+static unsigned int wordSum(const void *data, size_t bytes, bool swap)
+{
+  const unsigned int *w = (const unsigned int*)data;
+  const long n = bytes / 4;
+  unsigned long long sum = 0;
+#pragma omp parallel for schedule(static) reduction(+:sum)
+  for (long i=0; i<n; i++) sum += swap ? swap32(w[i]) : w[i];
+
+  // the sum of the 32-bit partial sums stays below 2^53, so the reduction is exact
+  double partial = (double)(sum & 0xffffffffull);
+  reduceDouble(partial);
+  return (unsigned int)((unsigned long long)partial & 0xffffffffull);
+}
+
+// Stores the block and returns the largest rounding error relative to its norm.
+template <typename Mantissa, typename Float>
+static double encodeBlock(char *out, const Float *in, int nReal, float max_mantissa)
+{
+  // zero the padding, which is written and checksummed
+  const size_t bytes = sizeof(float) + nReal*sizeof(Mantissa);
+  memset(out + bytes, 0, ((bytes + 3) & ~(size_t)3) - bytes);
+
+  float norm = 0.0f;
+  for (int j=0; j<nReal; j++) {
+    float a = fabs((float)in[j]);
+    if (a > norm) norm = a;
+  }
+  memcpy(out, &norm, sizeof(float));
+  if (norm == 0.0f) {
+    memset(out + sizeof(float), 0, nReal*sizeof(Mantissa));
+    return 0.0;
+  }
+
+  Mantissa *m = (Mantissa*)(out + sizeof(float));
+  const double scale = max_mantissa / (double)norm, inv_scale = (double)norm / max_mantissa;
+  double error = 0.0;
+  for (int j=0; j<nReal; j++) {
+    m[j] = (Mantissa)lrint(in[j] * scale);
+    double e = fabs(m[j]*inv_scale - in[j]) / norm;
+    if (e > error) error = e;
+  }
+  return error;
+}
+
+template <typename Mantissa, typename Float>
+static void decodeBlock(Float *out, const char *in, int nReal, float max_mantissa, bool swap)
+{
+  unsigned int n;
+  memcpy(&n, in, sizeof(float));
+  if (swap) n = swap32(n);
+  float norm;
+  memcpy(&norm, &n, sizeof(float));
+
+  const Mantissa *m = (const Mantissa*)(in + sizeof(float));
+  const Float scale = (Float)norm / max_mantissa;
+  for (int j=0; j<nReal; j++) {
+    Mantissa v = m[j];
+    if (swap && sizeof(Mantissa) == 2) v = (Mantissa)(((unsigned short)v >> 8) | ((unsigned short)v << 8));
+    out[j] = scale * v;
+  }
+}
+
+// Stores field f of nField in the site blocks of data, returning the
+// largest rounding error.
+template <typename Float>
+static double encodeField(char *data, const Float *field, int volume, int nReal, int f, int nField, int bits)
+{
+  const size_t block_bytes = blockBytes(nReal, bits, (QudaPrecision)sizeof(Float));
+  double error = 0.0;
+
+#pragma omp parallel
+  {
+    double local = 0.0;
+#pragma omp for schedule(static)
+    for (int i=0; i<volume; i++) {
+      char *out = data + ((size_t)i*nField + f)*block_bytes;
+      const Float *in = field + (size_t)i*nReal;
+      double e = 0.0;
+      if (bits == 16) e = encodeBlock<short>(out, in, nReal, MAX_SHORT);
+      else if (bits == 8) e = encodeBlock<signed char>(out, in, nReal, MAX_CHAR);
+      else memcpy(out, in, nReal*sizeof(Float));
+      if (e > local) local = e;
+    }
+#pragma omp critical
+    if (local > error) error = local;
+  }
+
+  return error;
+}
+
+template <typename Float>
+static void decodeField(Float *field, const char *data, int volume, int nReal, int f, int nField,
+			int bits, QudaPrecision file_precision, bool swap)
+{
+  const size_t block_bytes = blockBytes(nReal, bits, file_precision);
+
+#pragma omp parallel for schedule(static)
+  for (int i=0; i<volume; i++) {
+    const char *in = data + ((size_t)i*nField + f)*block_bytes;
+    Float *out = field + (size_t)i*nReal;
+    if (bits == 16) {
+      decodeBlock<short>(out, in, nReal, MAX_SHORT, swap);
+    } else if (bits == 8) {
+      decodeBlock<signed char>(out, in, nReal, MAX_CHAR, swap);
+    } else {
+      // uncompressed blocks are read in the file precision
+      memcpy(out, in, block_bytes);
+      if (swap) {
+	unsigned char *b = (unsigned char*)out;
+	for (size_t k=0; k<block_bytes; k+=sizeof(Float))
+	  for (size_t j=0; j<sizeof(Float)/2; j++) {
+	    unsigned char tmp = b[k+j];
+	    b[k+j] = b[k+sizeof(Float)-1-j];
+	    b[k+sizeof(Float)-1-j] = tmp;
+	  }
+      }
+    }
+  }
+}
+
+static void spinorLattice(int *L, int *G, int *offset, const cpuColorSpinorField &field)
+{
+  if (field.Ndim() != 4) errorQuda("Only 4-d spinor fields are supported");
+  for (int d=0; d<4; d++) {
+    L[d] = field.X(d);
+    G[d] = L[d] * commDim(d);
+    offset[d] = commCoords(d) * L[d];
+  }
+}
+
+// the field in lexicographic order, spin-color within a site (see site_order.h)
+static ColorSpinorParam lexParam(const cpuColorSpinorField &field, QudaPrecision precision)
+{
+  ColorSpinorParam param(field);
+  param.siteOrder = QUDA_LEXICOGRAPHIC_SITE_ORDER;
+  param.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  param.precision = precision;
+  param.create = QUDA_NULL_FIELD_CREATE;
+  return param;
+}
+
+static void writeSpinorFile(void **h_spinor, int nField, QudaInvertParam *param, const int *X,
+			    const char *filename, int bits, double max_error)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  if (nField < 1) errorQuda("Invalid number of fields %d", nField);
+  if (bits != 0 && bits != 8 && bits != 16) errorQuda("Unsupported mantissa of %d bits", bits);
+
+  ColorSpinorParam cpuParam(h_spinor[0], QUDA_CPU_FIELD_LOCATION, *param, X, false);
+  cpuColorSpinorField in(cpuParam);
+  cpuColorSpinorField lex(lexParam(in, in.Precision()));
+
+  int L[4], G[4], offset[4];
+  spinorLattice(L, G, offset, in);
+
+  const int nReal = lex.Nspin() * lex.Ncolor() * 2;
+  const size_t site_bytes = nField * blockBytes(nReal, bits, lex.Precision());
+  const size_t bytes = lex.Volume() * site_bytes;
+  char *data = (char*)pool_host_malloc(bytes);
+
+  double error = 0.0;
+  for (int f=0; f<nField; f++) {
+    cpuParam.v = h_spinor[f];
+    cpuColorSpinorField field(cpuParam);
+    lex.copy(field);
+    double e = lex.Precision() == QUDA_DOUBLE_PRECISION ?
+      encodeField(data, (const double*)lex.V(), lex.Volume(), nReal, f, nField, bits) :
+      encodeField(data, (const float*)lex.V(), lex.Volume(), nReal, f, nField, bits);
+    if (e > error) error = e;
+  }
+
+  reduceMaxDouble(error);
+  if (max_error > 0.0 && error > max_error) {
+    errorQuda("Compression error %e exceeds the bound %e for %s, use more mantissa bits",
+	      error, max_error, filename);
+  }
+
+  const unsigned int checksum = wordSum(data, bytes, false);
+
+  char header[SPINOR_HEADER_BYTES];
+  size_t header_bytes = spinorHeader(header, sizeof(header), G, nField, lex.Nspin(), lex.Ncolor(),
+				     lex.GammaBasis(), lex.Precision(), bits, error, checksum);
+
+  createSharedFile(filename);
+  writeSublattice(filename, header_bytes, data, site_bytes, G, L, offset);
+  writeSharedHeader(filename, header, header_bytes);
+
+  pool_host_free(data);
+
+  gettimeofday(&end, NULL);
+  if (getVerbosity() >= QUDA_VERBOSE) {
+    printfQuda("Wrote %d spinor field%s to %s (%dx%dx%dx%d, compression %s, error %e), checksum %08x, %.2f s\n",
+	       nField, nField > 1 ? "s" : "", filename, G[0], G[1], G[2], G[3],
+	       compression_name[compressionIndex(bits)], error, checksum,
+	       (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec));
+  }
+}
+
+static void readSpinorFile(void **h_spinor, int nField, QudaInvertParam *param, const int *X,
+			   const char *filename)
+{
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  ColorSpinorParam cpuParam(h_spinor[0], QUDA_CPU_FIELD_LOCATION, *param, X, false);
+  cpuColorSpinorField out(cpuParam);
+
+  int L[4], G[4], offset[4];
+  spinorLattice(L, G, offset, out);
+
+  char header[SPINOR_HEADER_BYTES];
+  size_t n = readSharedHeader(header, filename, sizeof(header) - 1);
+  header[n] = '\0';
+  char *end_header = strstr(header, "END_HEADER\n");
+  if (strncmp(header, "BEGIN_HEADER", 12) || !end_header) errorQuda("%s is not a spinor file", filename);
+  const size_t header_bytes = end_header + strlen("END_HEADER\n") - header;
+  *end_header = '\0';
+
+  char value[128];
+  if (!headerValue(value, sizeof(value), header, "DATATYPE") || strcmp(value, "QUDA_SPINOR"))
+    errorQuda("%s is not a spinor file", filename);
+  for (int d=0; d<4; d++) {
+    char key[16];
+    sprintf(key, "DIMENSION_%d", d+1);
+    if (!headerValue(value, sizeof(value), header, key) || atoi(value) != G[d])
+      errorQuda("Lattice dimension %d of %s does not match %d", d, filename, G[d]);
+  }
+  int file_fields = headerValue(value, sizeof(value), header, "NFIELD") ? atoi(value) : 1;
+  if (file_fields != nField)
+    errorQuda("%s holds %d fields, expected %d", filename, file_fields, nField);
+  if (!headerValue(value, sizeof(value), header, "NSPIN") || atoi(value) != out.Nspin())
+    errorQuda("Number of spins in %s does not match %d", filename, out.Nspin());
+  if (!headerValue(value, sizeof(value), header, "NCOLOR") || atoi(value) != out.Ncolor())
+    errorQuda("Number of colors in %s does not match %d", filename, out.Ncolor());
+  if (!headerValue(value, sizeof(value), header, "GAMMA_BASIS") || atoi(value) != out.GammaBasis())
+    errorQuda("Gamma basis of %s does not match %d", filename, out.GammaBasis());
+
+  int bits = 0;
+  if (headerValue(value, sizeof(value), header, "COMPRESSION")) {
+    if (!strcmp(value, "FIXED16")) bits = 16;
+    else if (!strcmp(value, "FIXED8")) bits = 8;
+    else if (strcmp(value, "NONE")) errorQuda("Unsupported compression %s in %s", value, filename);
+  }
+
+  int fp_bits = 0;
+  char order[16] = "";
+  if (!headerValue(value, sizeof(value), header, "FLOATING_POINT") ||
+      sscanf(value, "IEEE%d%15s", &fp_bits, order) != 2 || (fp_bits != 32 && fp_bits != 64) ||
+      (bits && fp_bits != 32))
+    errorQuda("Unsupported floating point type in %s", filename);
+  const bool swap = (strcmp(order, "BIG") == 0) != bigEndianHost();
+
+  unsigned int expected = 0;
+  if (!headerValue(value, sizeof(value), header, "CHECKSUM")) errorQuda("No checksum in %s", filename);
+  expected = (unsigned int)strtoul(value, NULL, 16);
+
+  // uncompressed fields are decoded in the file precision, compressed
+  // ones in that of the output, and the copy below converts
+  const QudaPrecision file_precision = fp_bits == 64 ? QUDA_DOUBLE_PRECISION : QUDA_SINGLE_PRECISION;
+  cpuColorSpinorField lex(lexParam(out, bits ? out.Precision() : file_precision));
+
+  const int nReal = lex.Nspin() * lex.Ncolor() * 2;
+  const size_t site_bytes = nField * blockBytes(nReal, bits, file_precision);
+  const size_t bytes = lex.Volume() * site_bytes;
+  char *data = (char*)pool_host_malloc(bytes);
+  readSublattice(data, filename, header_bytes, site_bytes, G, L, offset);
+
+  const unsigned int checksum = wordSum(data, bytes, swap);
+  if (checksum != expected)
+    errorQuda("Checksum mismatch in %s: %08x, expected %08x", filename, checksum, expected);
+
+  for (int f=0; f<nField; f++) {
+    if (lex.Precision() == QUDA_DOUBLE_PRECISION)
+      decodeField((double*)lex.V(), data, lex.Volume(), nReal, f, nField, bits, file_precision, swap);
+    else
+      decodeField((float*)lex.V(), data, lex.Volume(), nReal, f, nField, bits, file_precision, swap);
+    cpuParam.v = h_spinor[f];
+    cpuColorSpinorField field(cpuParam);
+    field.copy(lex);
+  }
+
+  pool_host_free(data);
+
+  gettimeofday(&end, NULL);
+  if (getVerbosity() >= QUDA_VERBOSE) {
+    printfQuda("Read %d spinor field%s from %s (%dx%dx%dx%d, compression %s), checksum verified, %.2f s\n",
+	       nField, nField > 1 ? "s" : "", filename, G[0], G[1], G[2], G[3],
+	       compression_name[compressionIndex(bits)],
+	       (end.tv_sec - start.tv_sec) + 1e-6*(end.tv_usec - start.tv_usec));
+  }
+}
+
+void writeSpinorFileQuda(void *h_spinor, QudaInvertParam *param, const int *X, const char *filename)
+{
+  writeSpinorFile(&h_spinor, 1, param, X, filename, 0, 0.0);
+}
+
+void readSpinorFileQuda(void *h_spinor, QudaInvertParam *param, const int *X, const char *filename)
+{
+  readSpinorFile(&h_spinor, 1, param, X, filename);
+}
+
+void writePropagatorFileQuda(void **h_prop, int n_field, QudaInvertParam *param, const int *X,
+			     const char *filename, int bits, double max_error)
+{
+  writeSpinorFile(h_prop, n_field, param, X, filename, bits, max_error);
+}
+
+void readPropagatorFileQuda(void **h_prop, int n_field, QudaInvertParam *param, const int *X,
+			    const char *filename)
+{
+  readSpinorFile(h_prop, n_field, param, X, filename);
+}
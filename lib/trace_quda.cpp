@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include <quda_internal.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <parallel_io.h>
+#include <trace_quda.h>
+
+// See trace_quda.h.  Each rank writes its events as one chunk of the
+// trace file, padded with blanks to a multiple of chunk_bytes, so
+// that the chunks can be written with writeSublattice() as the
+// blocks of a one-dimensional lattice of chunk_bytes sites.  Rank 0
+// starts its chunk with the opening of the JSON array and the last
+// rank ends its chunk with the closing.
+
+static const size_t chunk_bytes = 4096;
+
+struct TraceEvent {
+  const char *name;
+  double start;
+  double end;
+  int id;
+};
+
+struct TraceBuffer {
+  std::vector<TraceEvent> event;
+  unsigned long long count; // the number of events recorded, including those overwritten
+
+  TraceBuffer(int capacity) : event(capacity), count(0) { }
+};
+
+static std::string trace_file;
+static int trace_events = 262144;
+
+// with thread comms every rank has its own buffer
+static COMM_RANK_LOCAL TraceBuffer *buffer = NULL;
+
+double traceClock()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return traceTime(now);
+}
+
+void traceEvent(const char *name, double start, double end, int id)
+{
+  if (trace_file.empty()) return;
+  if (!buffer) buffer = new TraceBuffer(trace_events);
+
+  TraceEvent &e = buffer->event[buffer->count % buffer->event.size()];
+  e.name = name;
+  e.start = start;
+  e.end = end;
+  e.id = id;
+  buffer->count++;
+}
+
+void setTraceFile(const char *filename) { trace_file = filename ? filename : ""; }
+
+void setTraceEvents(int events)
+{
+  if (events <= 0) errorQuda("Invalid number of trace events %d", events);
+  trace_events = events;
+}
+
+bool traceEnabled() { return !trace_file.empty(); }
+
+void writeTrace()
+{
+  if (trace_file.empty()) return;
+
+#ifdef MULTI_GPU
+  const int rank = comm_rank(), size = comm_size();
+#else
+  const int rank = 0, size = 1;
+#endif
+
+  const size_t capacity = buffer ? buffer->event.size() : 0;
+  const unsigned long long count = buffer ? buffer->count : 0;
+  const unsigned long long first = count > capacity ? count - capacity : 0;
+
+  // the times are given relative to the first event of any rank
+  double origin = -traceClock();
+  for (unsigned long long i=first; i<count; i++) {
+    if (-buffer->event[i % capacity].start > origin) origin = -buffer->event[i % capacity].start;
+  }
+  reduceMaxDouble(origin);
+  origin = -origin;
+
+  std::string chunk;
+  char line[256];
+  if (rank == 0) chunk += "{\"traceEvents\":[\n";
+
+  snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n",
+	   rank, rank);
+  chunk += line;
+  if (first > 0) { // marks the start of the events that were kept
+    snprintf(line, sizeof(line), "{\"name\":\"events dropped\",\"ph\":\"i\",\"s\":\"p\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,"
+	     "\"args\":{\"count\":%llu}},\n", rank, buffer->event[first % capacity].start - origin, first);
+    chunk += line;
+  }
+
+  for (unsigned long long i=first; i<count; i++) {
+    const TraceEvent &e = buffer->event[i % capacity];
+    int n = snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f",
+		     e.name, rank, e.start - origin, e.end - e.start);
+    if (e.id >= 0) n += snprintf(line + n, sizeof(line) - n, ",\"args\":{\"id\":%d}", e.id);
+    snprintf(line + n, sizeof(line) - n, "},\n");
+    chunk += line;
+  }
+
+  // an event without the trailing comma closes the array
+  snprintf(line, sizeof(line), "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"sort_index\":%d}}%s\n",
+	   rank, rank, rank == size-1 ? "" : ",");
+  chunk += line;
+  if (rank == size-1) chunk += "],\"displayTimeUnit\":\"ms\"}\n";
+  chunk.resize(((chunk.size() + chunk_bytes - 1) / chunk_bytes) * chunk_bytes, ' ');
+
+  // the chunks are laid out in the order of the ranks
+  std::vector<double> chunks(size, 0.0);
+  chunks[rank] = chunk.size() / chunk_bytes;
+  reduceDoubleArray(&chunks[0], size);
+
+  int X[4] = { 0, 1, 1, 1 }, L[4] = { (int)chunks[rank], 1, 1, 1 }, start[4] = { 0, 0, 0, 0 };
+  for (int r=0; r<size; r++) {
+    if (r < rank) start[0] += (int)chunks[r];
+    X[0] += (int)chunks[r];
+  }
+
+  createSharedFile(trace_file.c_str());
+  writeSublattice(trace_file.c_str(), 0, chunk.data(), chunk_bytes, X, L, start);
+
+  if (getVerbosity() >= QUDA_SUMMARIZE) {
+    printfQuda("Wrote a trace of %d ranks to %s (%.1f MB)\n", size, trace_file.c_str(), X[0] * (chunk_bytes / 1048576.0));
+  }
+  if (count > capacity && getVerbosity() >= QUDA_VERBOSE) {
+    warningQuda("Trace buffer overflowed, the first %llu events were dropped", first);
+  }
+
+  delete buffer;
+  buffer = NULL;
+}
@@ -8,18 +8,36 @@
 #include <fstream>
 #include <typeinfo>
 #include <map>
+#include <pthread.h>
 
 static const std::string quda_hash = QUDA_HASH; // defined in lib/Makefile
 static std::string resource_path;
 static std::map<TuneKey, TuneParam> tunecache;
 static size_t initial_cache_size = 0;
 
+// with thread comms the cache is shared by all ranks of the process
+static pthread_mutex_t tunecache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TUNECACHE_LOCK() pthread_mutex_lock(&tunecache_lock)
+#define TUNECACHE_UNLOCK() pthread_mutex_unlock(&tunecache_lock)
+
 #define STR_(x) #x
 #define STR(x) STR_(x)
 static const std::string quda_version = STR(QUDA_VERSION_MAJOR) "." STR(QUDA_VERSION_MINOR) "." STR(QUDA_VERSION_SUBMINOR);
 #undef STR
 #undef STR_
 
+const char* getQudaVersion() { return quda_version.c_str(); }
+const char* getQudaHash() { return quda_hash.c_str(); }
+
+
+static size_t tuneCacheSize()
+{
+  TUNECACHE_LOCK();
+  size_t size = tunecache.size();
+  TUNECACHE_UNLOCK();
+  return size;
+}
+
 
 /**
  * Deserialize tunecache from an istream, useful for reading a file or receiving from other nodes.
@@ -41,7 +59,9 @@ static void deserializeTuneCache(std::istream &in)
     ls.ignore(1); // throw away tab before comment
     getline(ls, param.comment); // assume anything remaining on the line is a comment
     param.comment += "\n"; // our convention is to include the newline, since ctime() likes to do this
+    TUNECACHE_LOCK();
     tunecache[key] = param;
+    TUNECACHE_UNLOCK();
   }
 }
 
@@ -53,6 +73,7 @@ static void serializeTuneCache(std::ostream &out)
 {
   std::map<TuneKey, TuneParam>::iterator entry;
 
+  TUNECACHE_LOCK();
   for (entry = tunecache.begin(); entry != tunecache.end(); entry++) {
     TuneKey key = entry->first;
     TuneParam param = entry->second;
@@ -62,6 +83,7 @@ static void serializeTuneCache(std::ostream &out)
     out << param.grid.x << "\t" << param.grid.y << "\t" << param.grid.z << "\t";
     out << param.shared_bytes << "\t" << param.comment; // param.comment ends with a newline
   }
+  TUNECACHE_UNLOCK();
 }
 
 
@@ -118,7 +140,9 @@ void loadTuneCache(QudaVerbosity verbosity)
     warningQuda("Caching of tuned parameters will be disabled.");
     return;
   } else {
+    TUNECACHE_LOCK();
     resource_path = path;
+    TUNECACHE_UNLOCK();
   }
 
 #ifdef MULTI_GPU
@@ -149,7 +173,7 @@ void loadTuneCache(QudaVerbosity verbosity)
       
       deserializeTuneCache(cache_file);
       cache_file.close();      
-      initial_cache_size = tunecache.size();
+      initial_cache_size = tuneCacheSize();
 
       if (verbosity >= QUDA_SUMMARIZE) {
 	printfQuda("Loaded %d sets of cached parameters from %s\n", static_cast<int>(initial_cache_size), cache_path.c_str());
@@ -187,7 +211,7 @@ void saveTuneCache(QudaVerbosity verbosity)
   if (comm_rank() == 0) {
 #endif
 
-    if (tunecache.size() == initial_cache_size) return;
+    if (tuneCacheSize() == initial_cache_size) return;
 
     // Acquire lock.  Note that this is only robust if the filesystem supports flock() semantics, which is true for
     // NFS on recent versions of linux but not Lustre by default (unless the filesystem was mounted with "-o flock").
@@ -208,7 +232,7 @@ void saveTuneCache(QudaVerbosity verbosity)
     cache_file.open(cache_path.c_str());
     
     if (verbosity >= QUDA_SUMMARIZE) {
-      printfQuda("Saving %d sets of cached parameters to %s\n", static_cast<int>(tunecache.size()), cache_path.c_str());
+      printfQuda("Saving %d sets of cached parameters to %s\n", static_cast<int>(tuneCacheSize()), cache_path.c_str());
     }
     
     time(&now);
@@ -221,7 +245,7 @@ void saveTuneCache(QudaVerbosity verbosity)
     close(lock_handle);
     remove(lock_path.c_str());
 
-    initial_cache_size = tunecache.size();
+    initial_cache_size = tuneCacheSize();
 
 #ifdef MULTI_GPU
   }
@@ -235,11 +259,13 @@ void saveTuneCache(QudaVerbosity verbosity)
  */
 TuneParam tuneLaunch(Tunable &tunable, QudaTune enabled, QudaVerbosity verbosity)
 {
-  static bool tuning = false; // tuning in progress?
-  static const Tunable *active_tunable; // for error checking
-  static TuneParam param;
+  // per rank, since each thread rank tunes its own launches
+  static COMM_RANK_LOCAL bool tuning = false; // tuning in progress?
+  static COMM_RANK_LOCAL const Tunable *active_tunable; // for error checking
+  static COMM_RANK_LOCAL TuneParam *active_param; // the candidate being timed
 
-  TuneParam best_param;
+  TuneParam param, best_param;
+  bool cached = false;
   cudaError_t error;
   cudaEvent_t start, end;
   float elapsed_time, best_time;
@@ -247,14 +273,25 @@ TuneParam tuneLaunch(Tunable &tunable, QudaTune enabled, QudaVerbosity verbosity
 
   const TuneKey key = tunable.tuneKey();
 
+  if (enabled != QUDA_TUNE_NO && !(tuning && &tunable == active_tunable)) {
+    TUNECACHE_LOCK();
+    std::map<TuneKey, TuneParam>::const_iterator entry = tunecache.find(key);
+    if (entry != tunecache.end()) {
+      param = entry->second;
+      cached = true;
+    }
+    TUNECACHE_UNLOCK();
+  }
+
   if (enabled == QUDA_TUNE_NO) {
     tunable.defaultTuneParam(param);
-  } else if (tunecache.count(key)) {
-    param = tunecache[key];
+  } else if (cached) {
+    // param already holds the cached launch parameters
   } else if (!tuning) {
 
     tuning = true;
     active_tunable = &tunable;
+    active_param = &param;
     best_time = FLT_MAX;
 
     if (verbosity >= QUDA_DEBUG_VERBOSE) printfQuda("PreTune %s\n", key.name.c_str());
@@ -312,10 +349,14 @@ TuneParam tuneLaunch(Tunable &tunable, QudaTune enabled, QudaVerbosity verbosity
     if (verbosity >= QUDA_DEBUG_VERBOSE) printfQuda("PostTune %s\n", key.name.c_str());
     tunable.postTune();
     param = best_param;
+    TUNECACHE_LOCK();
     tunecache[key] = best_param;
+    TUNECACHE_UNLOCK();
 
   } else if (&tunable != active_tunable) {
     errorQuda("Unexpected call to tuneLaunch() in %s::apply()", typeid(tunable).name());
+  } else {
+    param = *active_param;
   }
 
   return param;
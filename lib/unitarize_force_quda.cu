@@ -562,6 +562,7 @@ namespace quda{
 	  } // precision?
 	} // dir
       } // i
+      cpuNewForce->markModified();
       return;
     } // unitarize_force_cpu
 
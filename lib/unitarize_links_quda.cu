@@ -486,6 +486,7 @@ bool isUnitarizedLinkConsistent(const Matrix<Cmplx,3>& initial_matrix,
 	} // precision?
       } // dir
     }  // loop over volume
+    outfield->markModified();
     return;
   }
     
@@ -9,8 +9,9 @@
 
 static const size_t MAX_PREFIX_SIZE = 100;
 
-static QudaVerbosity verbosity_ = QUDA_SUMMARIZE;
-static char prefix_[MAX_PREFIX_SIZE] = "";
+// per rank, so that each thread rank prints with its own prefix
+static COMM_RANK_LOCAL QudaVerbosity verbosity_ = QUDA_SUMMARIZE;
+static COMM_RANK_LOCAL char prefix_[MAX_PREFIX_SIZE] = "";
 static FILE *outfile_ = stdout;
 
 QudaVerbosity getVerbosity() { return verbosity_; }
@@ -34,7 +35,7 @@ void setOutputFile(FILE *outfile)
 };
 
 
-static struct timeval startTime;
+static COMM_RANK_LOCAL struct timeval startTime;
 
 void stopwatchStart() {
   gettimeofday(&startTime, NULL);
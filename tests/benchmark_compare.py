@@ -0,0 +1,183 @@
+#!/usr/bin/env python
+#
+# Compares the results of tests/benchmark_test against a baseline and
+# reports the change in time of every kernel, failing if any kernel
+# got slower by more than the noise of the two runs allows.
+#
+# The baseline is either given explicitly with --baseline, or taken
+# from a store of earlier results (--store).  The store keeps the
+# results of every configuration (host, comms, rank grid, local volume
+# and the set of benchmarks run) in a directory of its own, and a run
+# is compared against the latest result stored for its configuration,
+# whatever QUDA version or build it came from; the version and build
+# hash of both runs are printed as part of the report.  A result that
+# passes becomes the latest of its configuration, while one that fails
+# is only stored with --accept, so that a slowdown keeps being
+# reported until it is fixed or accepted.  A configuration with no
+# stored result yet is reported as NO BASELINE (exit status 2), and
+# the result is stored to be compared against next time.
+#
+# A kernel is compared by its minimum time per call, which is the
+# least sensitive to interference from the rest of the system, and is
+# flagged if it changed by more than the larger of --threshold and
+# --sigma times the combined relative standard deviation of the two
+# runs.  The exit status is 0 if no kernel is slower, 1 if some kernel
+# is slower, and 2 if there was no baseline to compare against.
+#
+# Requires python 2.6 or later.
+
+import json
+import optparse
+import os
+import re
+import sys
+
+
+def load(filename):
+    try:
+        f = open(filename)
+        try:
+            return json.load(f)
+        finally:
+            f.close()
+    except (IOError, ValueError):
+        e = sys.exc_info()[1]
+        sys.exit("ERROR: cannot read benchmark results from %s: %s" % (filename, e))
+
+
+def configuration(run):
+    return (run.get("host"), run.get("comms"), run.get("ranks"), tuple(run.get("grid", [])),
+            tuple(run.get("local_volume", [])), run.get("benchmarks"))
+
+
+def store_dir(store, run):
+    """The directory in which the results of this configuration are kept (not of the build)."""
+    name = "%s_%s_%s_%s_%s" % (run.get("host", "unknown"), run.get("comms", "unknown"),
+                                "x".join([str(x) for x in run.get("grid", [run.get("ranks", 1)])]),
+                                "x".join([str(x) for x in run.get("local_volume", [])]),
+                                run.get("benchmarks", "all"))
+    return os.path.join(store, re.sub(r"[^A-Za-z0-9_.=,-]", "_", name))
+
+
+def stored_results(store, run):
+    """The results stored for this configuration, oldest first."""
+    directory = store_dir(store, run)
+    if not os.path.isdir(directory):
+        return []
+    names = [n for n in os.listdir(directory) if re.match(r"^[0-9]+\.json$", n)]
+    names.sort(key=lambda n: int(n.split(".")[0]))
+    return [os.path.join(directory, n) for n in names]
+
+
+def store_result(store, run):
+    """Stores the run as the latest result of its configuration and returns the file."""
+    directory = store_dir(store, run)
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    previous = stored_results(store, run)
+    number = 1
+    if previous:
+        number = int(os.path.basename(previous[-1]).split(".")[0]) + 1
+    filename = os.path.join(directory, "%06d.json" % number)
+    out = open(filename, "w")
+    try:
+        json.dump(run, out, indent=2)
+    finally:
+        out.close()
+    return filename
+
+
+def key(result):
+    return (result["kernel"], result["variant"], result["precision"])
+
+
+def relative_noise(result):
+    if result.get("mean_s", 0) <= 0:
+        return 0.0
+    return result.get("stddev_s", 0.0) / result["mean_s"]
+
+
+def compare(run, baseline, threshold, sigma):
+    """Prints the per-kernel deltas and returns the number of kernels that got slower."""
+    if configuration(run) != configuration(baseline):
+        sys.exit("ERROR: the results are of a different configuration than the baseline "
+                 "(host, comms, ranks, grid, local volume or benchmarks differ)")
+
+    print("Results:  version %s, build %s" % (run.get("version"), run.get("hash")))
+    print("Baseline: version %s, build %s" % (baseline.get("version"), baseline.get("hash")))
+    print("%-12s %-14s %-7s %12s %12s %8s %8s  %s" % ("kernel", "variant", "prec", "base ms", "new ms",
+                                                     "delta", "allowed", "status"))
+
+    base = dict([(key(r), r) for r in baseline.get("results", [])])
+    slower = 0
+    for r in run.get("results", []):
+        b = base.pop(key(r), None)
+        if b is None:
+            print("%-12s %-14s %-7s %12s %12.3f %8s %8s  new" % (r["kernel"], r["variant"], r["precision"],
+                                                               "-", 1e3 * r["min_s"], "-", "-"))
+            continue
+
+        delta = r["min_s"] / b["min_s"] - 1.0
+        noise = (relative_noise(r) ** 2 + relative_noise(b) ** 2) ** 0.5
+        allowed = max(threshold, sigma * noise)
+        if delta > allowed:
+            status = "SLOWER"
+            slower += 1
+        elif delta < -allowed:
+            status = "faster"
+        else:
+            status = "ok"
+        print("%-12s %-14s %-7s %12.3f %12.3f %+7.1f%% %7.1f%%  %s" % (r["kernel"], r["variant"], r["precision"],
+                                                                    1e3 * b["min_s"], 1e3 * r["min_s"],
+                                                                    100 * delta, 100 * allowed, status))
+
+    for b in base.values():
+        print("%-12s %-14s %-7s %12.3f %12s %8s %8s  missing" % (b["kernel"], b["variant"], b["precision"],
+                                                               1e3 * b["min_s"], "-", "-", "-"))
+    return slower
+
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options] results.json")
+    parser.add_option("--baseline", metavar="FILE", help="compare against the results in FILE")
+    parser.add_option("--store", metavar="DIR",
+                      help="compare against the latest stored result of the same configuration, "
+                      "and store these results if they pass")
+    parser.add_option("--accept", action="store_true", default=False,
+                      help="store the results even if some kernels are slower")
+    parser.add_option("--threshold", type="float", default=5.0, metavar="PCT",
+                      help="the smallest change in percent that is reported (default 5)")
+    parser.add_option("--sigma", type="float", default=3.0, metavar="N",
+                      help="the number of standard deviations of the noise that a change must exceed (default 3)")
+    options, args = parser.parse_args()
+    if len(args) != 1 or not (options.baseline or options.store):
+        parser.error("a results file and --baseline or --store are required")
+
+    run = load(args[0])
+    baseline_file = options.baseline
+    if not baseline_file:
+        stored = stored_results(options.store, run)
+        if stored:
+            baseline_file = stored[-1]
+
+    slower = 0
+    if baseline_file:
+        print("Baseline file: %s" % baseline_file)
+        slower = compare(run, load(baseline_file), options.threshold / 100.0, options.sigma)
+
+    if options.store and (slower == 0 or options.accept):
+        print("Stored the results as %s" % store_result(options.store, run))
+
+    if not baseline_file:
+        print("NO BASELINE: nothing stored for this configuration (version %s, build %s)" %
+              (run.get("version"), run.get("hash")))
+        return 2
+    if slower:
+        print("FAIL: %d kernels are slower than the baseline" % slower)
+        return 1
+    print("PASS")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
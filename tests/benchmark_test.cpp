@@ -0,0 +1,948 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include <quda.h>
+#include <quda_internal.h>
+#include <util_quda.h>
+#include <blas_quda.h>
+#include <color_spinor_field.h>
+#include <gauge_field.h>
+#include <face_quda.h>
+#include <tune_quda.h>
+#include <perf_counters.h>
+#include <roofline.h>
+
+#include <test_util.h>
+#include <wilson_dslash_reference.h>
+#include <domain_wall_dslash_reference.h>
+#include <staggered_dslash_reference.h>
+#include <gauge_force_reference.h>
+#include <llfat_reference.h>
+#include "misc.h"
+
+#ifdef MULTI_GPU
+#include <comm_quda.h>
+#endif
+
+// A benchmark of the host code: the reference dslash of the Wilson,
+// twisted-mass, domain-wall and asqtad actions, the host BLAS,
+// ghost-zone packing and field reordering, the reference gauge force
+// and link fattening, and a fixed number of CG iterations on the
+// even-odd preconditioned Wilson normal operator, each in double and
+// single precision (the host code has no half precision).
+//
+// Every kernel is run --warmup times untimed, followed by --niter
+// timed calls.  The time of a call is that of the slowest rank, and
+// the GFLOP/s and GB/s are given for the mean time over all ranks,
+// with the bytes being the compulsory traffic of the kernel.  The
+// results are printed as a table and written as JSON to --json (by
+// default benchmark.json), so that runs on different node types or
+// builds can be compared.
+//
+// With --scaling weak (the default) the lattice dimensions are those
+// of each rank, while with --scaling strong they are those of the
+// whole lattice, which is divided over the grid of ranks.
+//
+// With --counters the hardware counters (see perf_counters.h) are read
+// over the timed calls, and the instructions per cycle, last-level
+// cache miss rate and bytes moved from memory per flop of each kernel
+// are printed and written to the JSON as well.
+//
+// Before the kernels, the bandwidth and flop rate that the host can
+// reach are measured (see roofline.h), and every kernel is given with
+// the fraction of this roofline that it achieves at its arithmetic
+// intensity ("roof"), so that the kernels with headroom stand out.
+// The roofline is that of memory, so kernels whose fields fit in the
+// caches (e.g., the BLAS on a small lattice) can exceed 100%.
+
+#define TDIFF(a,b) (b.tv_sec - a.tv_sec + 0.000001*(b.tv_usec - a.tv_usec))
+
+extern int xdim, ydim, zdim, tdim;
+extern int gridsize_from_cmdline[];
+extern int niter;
+extern void usage(char**);
+
+// used by the gauge force and link fattening references
+COMM_RANK_LOCAL int V_ex;
+COMM_RANK_LOCAL int Vh_ex;
+COMM_RANK_LOCAL int E[4];
+COMM_RANK_LOCAL int Vs[4];
+COMM_RANK_LOCAL int Vsh[4];
+
+static const int dw_Ls = 8;     // fifth dimension of the domain-wall action
+static const int cg_iter = 50;  // iterations of the solver benchmark
+
+static int warmup = 2;
+static bool strong_scaling = false;
+static char json_file[256] = "benchmark.json";
+static bool counters = false;
+
+enum { BENCH_DSLASH = 1, BENCH_BLAS = 2, BENCH_PACK = 4, BENCH_REORDER = 8,
+       BENCH_GAUGE_FORCE = 16, BENCH_FATLINK = 32, BENCH_SOLVER = 64, BENCH_ALL = 127 };
+static int bench = BENCH_ALL;
+
+static const char *bench_name[] = { "dslash", "blas", "pack", "reorder", "gauge_force", "fatlink", "solver" };
+
+// per rank, since with thread comms the ranks share this process
+static COMM_RANK_LOCAL QudaGaugeParam gauge_param;
+static COMM_RANK_LOCAL int ranks = 1;
+
+struct Result {
+  std::string kernel;
+  std::string variant;
+  QudaPrecision precision;
+  double min, mean, max;  // seconds per call
+  double stddev;
+  double count[PERF_COUNTERS]; // hardware counters per call and rank, or -1 if not counted
+  double flops, bytes;    // per call and rank
+};
+
+static std::vector<Result> results;
+
+// the quantities derived from the counters, or 0 if they were not counted
+static double ipc(const Result &r)
+{
+  return r.count[PERF_CYCLES] > 0 && r.count[PERF_INSTRUCTIONS] >= 0 ? r.count[PERF_INSTRUCTIONS] / r.count[PERF_CYCLES] : 0.0;
+}
+
+static double llcMissRate(const Result &r)
+{
+  return r.count[PERF_LLC_REFERENCES] > 0 && r.count[PERF_LLC_MISSES] >= 0 ?
+    100.0 * r.count[PERF_LLC_MISSES] / r.count[PERF_LLC_REFERENCES] : 0.0;
+}
+
+static double memBytesPerFlop(const Result &r)
+{
+  return r.flops > 0 && r.count[PERF_LLC_MISSES] >= 0 ? 64.0 * r.count[PERF_LLC_MISSES] / r.flops : 0.0;
+}
+
+// a kernel to be timed, with its arguments set up by the constructor
+struct Kernel {
+  virtual ~Kernel() { }
+  virtual void apply() = 0;
+};
+
+static void run(const char *kernel, const char *variant, QudaPrecision precision,
+		double flops, double bytes, Kernel &k)
+{
+  for (int i=0; i<warmup; i++) k.apply();
+
+  double count0[PERF_COUNTERS], count1[PERF_COUNTERS];
+  if (counters) perfCountersRead(count0);
+
+  std::vector<double> time(niter);
+  for (int i=0; i<niter; i++) {
+    struct timeval t0, t1;
+    gettimeofday(&t0, NULL);
+    k.apply();
+    gettimeofday(&t1, NULL);
+    time[i] = TDIFF(t0, t1);
+  }
+  if (counters) perfCountersRead(count1);
+
+  Result r;
+  r.kernel = kernel;
+  r.variant = variant;
+  r.precision = precision;
+  r.flops = flops;
+  r.bytes = bytes;
+  r.min = 1e100;
+  r.mean = 0.0;
+  r.max = 0.0;
+  for (int i=0; i<niter; i++) {
+    reduceMaxDouble(time[i]);
+    if (time[i] < r.min) r.min = time[i];
+    if (time[i] > r.max) r.max = time[i];
+    r.mean += time[i] / niter;
+  }
+  r.stddev = 0.0;
+  for (int i=0; i<niter; i++) r.stddev += (time[i] - r.mean)*(time[i] - r.mean);
+  r.stddev = niter > 1 ? sqrt(r.stddev / (niter-1)) : 0.0;
+
+  for (int c=0; c<PERF_COUNTERS; c++) r.count[c] = counters && count1[c] >= 0 ? (count1[c] - count0[c]) / niter : -1.0;
+  if (counters) {
+    reduceDoubleArray(r.count, PERF_COUNTERS);
+    for (int c=0; c<PERF_COUNTERS; c++) r.count[c] /= ranks;
+  }
+#ifdef MULTI_GPU
+  if (comm_rank() == 0) // only rank 0 writes the results
+#endif
+  results.push_back(r);
+
+  const double roof = 100.0*rooflineFraction(flops, bytes, r.mean, precision);
+  if (counters) {
+    printfQuda("%-12s %-14s %-7s %12.3f %12.3f %10.2f %10.2f %6.1f%% %6.2f %7.1f%% %8.2f\n", kernel, variant,
+	       get_prec_str(precision), 1e3*r.mean, 1e3*r.min, 1e-9*ranks*flops/r.mean, 1e-9*ranks*bytes/r.mean,
+	       roof, ipc(r), llcMissRate(r), memBytesPerFlop(r));
+  } else {
+    printfQuda("%-12s %-14s %-7s %12.3f %12.3f %10.2f %10.2f %6.1f%%\n", kernel, variant, get_prec_str(precision),
+	       1e3*r.mean, 1e3*r.min, 1e-9*ranks*flops/r.mean, 1e-9*ranks*bytes/r.mean, roof);
+  }
+}
+
+static void* allocLinks(size_t bytes)
+{
+  void *p = malloc(bytes);
+  if (!p) errorQuda("malloc failed for %lu bytes", (unsigned long)bytes);
+  return p;
+}
+
+static cpuColorSpinorField* newSpinor(int nSpin, int nDim, QudaPrecision precision, QudaSiteSubset subset,
+				      QudaFieldOrder order=QUDA_SPACE_SPIN_COLOR_FIELD_ORDER,
+				      QudaSiteOrder site_order=QUDA_EVEN_ODD_SITE_ORDER)
+{
+  ColorSpinorParam param;
+  param.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  param.nColor = 3;
+  param.nSpin = nSpin;
+  param.nDim = nDim;
+  for (int d=0; d<4; d++) param.x[d] = gauge_param.X[d];
+  if (nDim == 5) param.x[4] = dw_Ls;
+  if (subset == QUDA_PARITY_SITE_SUBSET) param.x[0] /= 2;
+  param.precision = precision;
+  param.pad = 0;
+  param.siteSubset = subset;
+  param.siteOrder = site_order;
+  param.fieldOrder = order;
+  param.gammaBasis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.create = QUDA_ZERO_FIELD_CREATE;
+
+  cpuColorSpinorField *field = new cpuColorSpinorField(param);
+  field->Source(QUDA_RANDOM_SOURCE);
+  return field;
+}
+
+// ---------- dslash ----------
+
+struct WilsonDslash : Kernel {
+  void *out, *in, **gauge;
+  QudaPrecision precision;
+  WilsonDslash(void *out, void **gauge, void *in, QudaPrecision precision)
+    : out(out), in(in), gauge(gauge), precision(precision) { }
+  void apply() { wil_dslash(out, gauge, in, 0, QUDA_DAG_NO, precision, gauge_param); }
+};
+
+struct TwistedMassDslash : Kernel {
+  void *out, *in, **gauge;
+  QudaPrecision precision;
+  TwistedMassDslash(void *out, void **gauge, void *in, QudaPrecision precision)
+    : out(out), in(in), gauge(gauge), precision(precision) { }
+  void apply() { tm_dslash(out, gauge, in, 0.1, 0.01, QUDA_TWIST_MINUS, 0, QUDA_DAG_NO, precision, gauge_param); }
+};
+
+struct DomainWallDslash : Kernel {
+  void *out, *in, **gauge;
+  QudaPrecision precision;
+  DomainWallDslash(void *out, void **gauge, void *in, QudaPrecision precision)
+    : out(out), in(in), gauge(gauge), precision(precision) { }
+  void apply() { dw_dslash(out, gauge, in, 0, QUDA_DAG_NO, precision, gauge_param, 0.01); }
+};
+
+struct StaggeredDslash : Kernel {
+  cpuColorSpinorField *out, *in;
+  void **fatlink, **longlink, **ghost_fatlink, **ghost_longlink;
+  StaggeredDslash(cpuColorSpinorField *out, void **fatlink, void **longlink, void **ghost_fatlink,
+		  void **ghost_longlink, cpuColorSpinorField *in)
+    : out(out), in(in), fatlink(fatlink), longlink(longlink), ghost_fatlink(ghost_fatlink),
+      ghost_longlink(ghost_longlink) { }
+  void apply() {
+#ifdef MULTI_GPU
+    staggered_dslash_mg4dir(out, fatlink, longlink, ghost_fatlink, ghost_longlink, in, QUDA_EVEN_PARITY,
+			    QUDA_DAG_NO, in->Precision(), in->Precision());
+#else
+    staggered_dslash(out->V(), fatlink, longlink, in->V(), QUDA_EVEN_PARITY, QUDA_DAG_NO,
+		     in->Precision(), in->Precision());
+#endif
+  }
+};
+
+static void benchDslash(QudaPrecision precision)
+{
+  const double Vh_ = Vh;
+
+  void *gauge[4];
+  for (int d=0; d<4; d++) gauge[d] = allocLinks(V*gaugeSiteSize*precision);
+  construct_gauge_field(gauge, 1, precision, &gauge_param);
+
+  { // the Wilson-like actions read 8 links and 8 spinors and write 1 spinor per site
+    setSpinorSiteSize(24);
+    cpuColorSpinorField *in = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+    cpuColorSpinorField *out = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+    const double bytes = Vh_*(8*gaugeSiteSize + 9*spinorSiteSize)*precision;
+
+    WilsonDslash wilson(out->V(), gauge, in->V(), precision);
+    run("dslash", "wilson", precision, 1320*Vh_, bytes, wilson);
+
+    TwistedMassDslash twisted_mass(out->V(), gauge, in->V(), precision);
+    run("dslash", "twisted_mass", precision, (1320+72)*Vh_, bytes, twisted_mass);
+
+    delete in;
+    delete out;
+    cpuColorSpinorField::freeGhostBuffer();
+  }
+
+  { // the domain-wall action reads the links once for the whole fifth dimension
+    dw_setDims(gauge_param.X, dw_Ls);
+    cpuColorSpinorField *in = newSpinor(4, 5, precision, QUDA_PARITY_SITE_SUBSET);
+    cpuColorSpinorField *out = newSpinor(4, 5, precision, QUDA_PARITY_SITE_SUBSET);
+    const double flops = 1320.0*Vh_*dw_Ls + 96.0*Vh_*(dw_Ls-2) + 120.0*Vh_*2;
+    const double bytes = Vh_*(8*gaugeSiteSize + dw_Ls*11*spinorSiteSize)*precision;
+
+    DomainWallDslash domain_wall(out->V(), gauge, in->V(), precision);
+    run("dslash", "domain_wall", precision, flops, bytes, domain_wall);
+
+    delete in;
+    delete out;
+    cpuColorSpinorField::freeGhostBuffer();
+    setDims(gauge_param.X);
+  }
+
+  for (int d=0; d<4; d++) free(gauge[d]);
+
+  { // the asqtad action reads 8 fat and 8 long links and 16 vectors per site
+    setSpinorSiteSize(6);
+    void *fatlink[4], *longlink[4];
+    for (int d=0; d<4; d++) {
+      fatlink[d] = allocLinks(V*gaugeSiteSize*precision);
+      longlink[d] = allocLinks(V*gaugeSiteSize*precision);
+    }
+    construct_fat_long_gauge_field(fatlink, longlink, 1, precision, &gauge_param);
+
+    void **ghost_fatlink = NULL, **ghost_longlink = NULL;
+#ifdef MULTI_GPU
+    QudaGaugeParam param = gauge_param;
+    param.reconstruct = QUDA_RECONSTRUCT_NO;
+    param.type = QUDA_ASQTAD_FAT_LINKS;
+    GaugeFieldParam fat_param(fatlink, param);
+    cpuGaugeField cpu_fat(fat_param);
+    cpu_fat.exchangeGhost();
+    ghost_fatlink = (void**)cpu_fat.Ghost();
+
+    param.type = QUDA_ASQTAD_LONG_LINKS;
+    GaugeFieldParam long_param(longlink, param);
+    cpuGaugeField cpu_long(long_param);
+    cpu_long.exchangeGhost();
+    ghost_longlink = (void**)cpu_long.Ghost();
+#endif
+
+    cpuColorSpinorField *in = newSpinor(1, 4, precision, QUDA_PARITY_SITE_SUBSET);
+    cpuColorSpinorField *out = newSpinor(1, 4, precision, QUDA_PARITY_SITE_SUBSET);
+    const double bytes = Vh_*(16*gaugeSiteSize + 17*6)*precision;
+
+    StaggeredDslash asqtad(out, fatlink, longlink, ghost_fatlink, ghost_longlink, in);
+    run("dslash", "asqtad", precision, 1146*Vh_, bytes, asqtad);
+
+    delete in;
+    delete out;
+    cpuColorSpinorField::freeGhostBuffer();
+    for (int d=0; d<4; d++) {
+      free(fatlink[d]);
+      free(longlink[d]);
+    }
+    setSpinorSiteSize(24);
+  }
+}
+
+// ---------- BLAS ----------
+
+struct Blas : Kernel {
+  enum Type { AXPY, XPAY, CAXPY, NORM, REDOT, CDOT };
+  Type type;
+  cpuColorSpinorField &x, &y;
+  Blas(Type type, cpuColorSpinorField &x, cpuColorSpinorField &y) : type(type), x(x), y(y) { }
+  void apply() {
+    switch (type) {
+    case AXPY: axpyCpu(0.5, x, y); break;
+    case XPAY: xpayCpu(x, 0.5, y); break;
+    case CAXPY: caxpyCpu(quda::Complex(0.5, 0.25), x, y); break;
+    case NORM: normCpu(x); break;
+    case REDOT: reDotProductCpu(x, y); break;
+    case CDOT: cDotProductCpu(x, y); break;
+    }
+  }
+};
+
+// the shifted-solution update of multi-shift CG, fused over the shifts
+// or one shift at a time
+struct MultiShift : Kernel {
+  static const int nShift = 8;
+  bool fused;
+  cpuColorSpinorField &r;
+  cpuColorSpinorField *p[nShift], *x[nShift];
+  double a[nShift], b[nShift], c[nShift];
+  MultiShift(bool fused, cpuColorSpinorField &r) : fused(fused), r(r) {
+    for (int j=0; j<nShift; j++) {
+      p[j] = new cpuColorSpinorField(r);
+      x[j] = new cpuColorSpinorField(r);
+      a[j] = 0.5 / (j+1);
+      b[j] = 0.25 / (j+1);
+      c[j] = 0.75;
+    }
+  }
+  ~MultiShift() {
+    for (int j=0; j<nShift; j++) {
+      delete p[j];
+      delete x[j];
+    }
+  }
+  void apply() {
+    if (fused) multiShiftAxpyBzpcxCpu(a, p, x, b, r, c, nShift);
+    else for (int j=0; j<nShift; j++) axpyBzpcxCpu(a[j], *p[j], *x[j], b[j], r, c[j]);
+  }
+};
+
+static void benchBlas(QudaPrecision precision)
+{
+  cpuColorSpinorField *x = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+  cpuColorSpinorField *y = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+  const double n = x->Length();
+
+  // name, flops and fields read or written per real number
+  const struct { const char *name; Blas::Type type; int flops; int fields; } kernel[] = {
+    { "axpy", Blas::AXPY, 2, 3 },
+    { "xpay", Blas::XPAY, 2, 3 },
+    { "caxpy", Blas::CAXPY, 4, 3 },
+    { "norm", Blas::NORM, 2, 1 },
+    { "reDotProduct", Blas::REDOT, 2, 2 },
+    { "cDotProduct", Blas::CDOT, 4, 2 },
+  };
+
+  for (unsigned int i=0; i<sizeof(kernel)/sizeof(kernel[0]); i++) {
+    Blas blas(kernel[i].type, *x, *y);
+    run("blas", kernel[i].name, precision, kernel[i].flops*n, kernel[i].fields*n*precision, blas);
+  }
+
+  // the fused update reads r once for all the shifts
+  const int nShift = MultiShift::nShift;
+  MultiShift fused(true, *x), per_shift(false, *x);
+  run("blas", "mshiftFused", precision, 5*nShift*n, (4*nShift+1)*n*precision, fused);
+  run("blas", "mshiftSplit", precision, 5*nShift*n, 6*nShift*n*precision, per_shift);
+
+  delete x;
+  delete y;
+}
+
+// ---------- packing and reordering ----------
+
+struct Pack : Kernel {
+  cpuColorSpinorField &in;
+  Pack(cpuColorSpinorField &in) : in(in) { in.allocateGhostBuffer(); }
+  void apply() {
+    for (int d=0; d<4; d++) {
+      in.packGhost(in.backGhostFaceSendBuffer[d], d, QUDA_BACKWARDS, QUDA_EVEN_PARITY, QUDA_DAG_NO);
+      in.packGhost(in.fwdGhostFaceSendBuffer[d], d, QUDA_FORWARDS, QUDA_EVEN_PARITY, QUDA_DAG_NO);
+    }
+  }
+};
+
+struct Reorder : Kernel {
+  cpuColorSpinorField &out, &in;
+  Reorder(cpuColorSpinorField &out, cpuColorSpinorField &in) : out(out), in(in) { }
+  void apply() { out.copy(in); }
+};
+
+static void benchPack(QudaPrecision precision)
+{
+  cpuColorSpinorField *in = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+
+  // each face site is read and written once in either direction
+  double face = 0.0;
+  for (int d=0; d<4; d++) face += faceVolume[d];
+  Pack pack(*in);
+  run("pack", "wilson", precision, 0.0, 2*face*spinorSiteSize*precision, pack);
+
+  delete in;
+  cpuColorSpinorField::freeGhostBuffer();
+}
+
+static void benchReorder(QudaPrecision precision)
+{
+  cpuColorSpinorField *in = newSpinor(4, 4, precision, QUDA_FULL_SITE_SUBSET);
+  cpuColorSpinorField *color_spin = newSpinor(4, 4, precision, QUDA_FULL_SITE_SUBSET,
+					      QUDA_SPACE_COLOR_SPIN_FIELD_ORDER);
+  cpuColorSpinorField *lex = newSpinor(4, 4, precision, QUDA_FULL_SITE_SUBSET,
+				       QUDA_SPACE_SPIN_COLOR_FIELD_ORDER, QUDA_LEXICOGRAPHIC_SITE_ORDER);
+  const double bytes = 2.0*in->Bytes();
+
+  Reorder spin_color(*color_spin, *in);
+  run("reorder", "spin_color", precision, 0.0, bytes, spin_color);
+
+  Reorder even_odd(*lex, *in);
+  run("reorder", "even_odd", precision, 0.0, bytes, even_odd);
+
+  delete in;
+  delete color_spin;
+  delete lex;
+}
+
+// ---------- gauge force and link fattening ----------
+
+struct GaugeForce : Kernel {
+  void *mom, **sitelink, **sitelink_ex;
+  QudaPrecision precision;
+  int ***path;
+  int *length;
+  void *coeff;
+  int num_paths;
+  GaugeForce(void *mom, void **sitelink, void **sitelink_ex, QudaPrecision precision,
+	     int ***path, int *length, void *coeff, int num_paths)
+    : mom(mom), sitelink(sitelink), sitelink_ex(sitelink_ex), precision(precision),
+      path(path), length(length), coeff(coeff), num_paths(num_paths) { }
+  void apply() { gauge_force_reference(mom, 0.3, sitelink, sitelink_ex, precision, path, length, coeff, num_paths); }
+};
+
+static void setExtendedDims(const int *X)
+{
+  V_ex = 1;
+  for (int d=0; d<4; d++) {
+    E[d] = X[d] + 4;
+    V_ex *= E[d];
+    Vs[d] = faceVolume[d];
+    Vsh[d] = Vs[d] / 2;
+  }
+  Vh_ex = V_ex / 2;
+}
+
+#ifdef MULTI_GPU
+// copies the links into the interior of a field extended by two sites
+// in every direction, whose border is then filled by the neighbours
+static void extendLinks(void **link_ex, void **link, QudaPrecision precision)
+{
+  const int X1 = Z[0], X2 = Z[1], X3 = Z[2], X4 = Z[3];
+  const int E1h = E[0]/2, E2 = E[1], E3 = E[2];
+  const size_t bytes = gaugeSiteSize*precision;
+
+  for (int i=0; i<V_ex; i++) {
+    int sid = i, oddBit = 0;
+    if (i >= Vh_ex) {
+      sid = i - Vh_ex;
+      oddBit = 1;
+    }
+
+    int za = sid/E1h;
+    int x1h = sid - za*E1h;
+    int zb = za/E2;
+    int x2 = za - zb*E2;
+    int x4 = zb/E3;
+    int x3 = zb - x4*E3;
+    int x1 = 2*x1h + ((x2 + x3 + x4 + oddBit) & 1);
+
+    if (x1 < 2 || x1 >= X1+2 || x2 < 2 || x2 >= X2+2 || x3 < 2 || x3 >= X3+2 || x4 < 2 || x4 >= X4+2) continue;
+    x1 -= 2; x2 -= 2; x3 -= 2; x4 -= 2;
+
+    int idx = (x4*X3*X2*X1 + x3*X2*X1 + x2*X1 + x1) >> 1;
+    if (oddBit) idx += Vh;
+    for (int d=0; d<4; d++) memcpy((char*)link_ex[d] + i*bytes, (char*)link[d] + idx*bytes, bytes);
+  }
+
+  int R[4] = {2, 2, 2, 2};
+  exchange_cpu_sitelink_ex(gauge_param.X, R, link_ex, QUDA_QDP_GAUGE_ORDER, precision, 0);
+}
+#endif
+
+static void benchGaugeForce(QudaPrecision precision)
+{
+  // the plaquette staples of the Wilson gauge action: for each
+  // direction mu and each nu != mu, the paths nu, -mu, -nu and -nu,
+  // -mu, nu, with the backward directions encoded as 7-mu
+  const int num_paths = 6;
+  int length[num_paths];
+  int **path[4];
+  for (int mu=0; mu<4; mu++) {
+    path[mu] = new int*[num_paths];
+    int p = 0;
+    for (int nu=0; nu<4; nu++) {
+      if (nu == mu) continue;
+      int up[3] = { nu, 7-mu, 7-nu }, down[3] = { 7-nu, 7-mu, nu };
+      path[mu][p] = new int[3];
+      memcpy(path[mu][p], up, sizeof(up));
+      length[p++] = 3;
+      path[mu][p] = new int[3];
+      memcpy(path[mu][p], down, sizeof(down));
+      length[p++] = 3;
+    }
+  }
+  double coeff_d[num_paths];
+  float coeff_f[num_paths];
+  for (int i=0; i<num_paths; i++) coeff_d[i] = coeff_f[i] = 1.0;
+  void *coeff = (precision == QUDA_DOUBLE_PRECISION) ? (void*)coeff_d : (void*)coeff_f;
+
+  void *sitelink[4], **sitelink_ex = NULL;
+  for (int d=0; d<4; d++) sitelink[d] = allocLinks(V*gaugeSiteSize*precision);
+  createSiteLinkCPU(sitelink, precision, 0);
+#ifdef MULTI_GPU
+  void *link_ex[4];
+  for (int d=0; d<4; d++) link_ex[d] = allocLinks(V_ex*gaugeSiteSize*precision);
+  extendLinks(link_ex, sitelink, precision);
+  sitelink_ex = link_ex;
+#endif
+
+  void *mom = allocLinks(4*V*momSiteSize*precision);
+  createMomCPU(mom, precision);
+
+  // per link, each path of length L is L products of SU(3) matrices
+  // (198 flops each) accumulated into the staple (36), followed by the
+  // product with the link (198), the update and the projection (56);
+  // the links are read and the momentum read and written
+  double flops = 0.0;
+  for (int i=0; i<num_paths; i++) flops += 198*length[i] + 36;
+  flops = 4.0*V*(flops + 198 + 56);
+  const double bytes = 4.0*V*(gaugeSiteSize + 2*momSiteSize)*precision;
+
+  GaugeForce force(mom, sitelink, sitelink_ex, precision, path, length, coeff, num_paths);
+  run("gauge_force", "wilson", precision, flops, bytes, force);
+
+  free(mom);
+  for (int d=0; d<4; d++) free(sitelink[d]);
+#ifdef MULTI_GPU
+  for (int d=0; d<4; d++) free(link_ex[d]);
+#endif
+  for (int mu=0; mu<4; mu++) {
+    for (int i=0; i<num_paths; i++) delete []path[mu][i];
+    delete []path[mu];
+  }
+}
+
+struct FatLink : Kernel {
+  void **fatlink, **sitelink, **ghost_sitelink, **ghost_sitelink_diag;
+  QudaPrecision precision;
+  void *coeff;
+  FatLink(void **fatlink, void **sitelink, void **ghost_sitelink, void **ghost_sitelink_diag,
+	  QudaPrecision precision, void *coeff)
+    : fatlink(fatlink), sitelink(sitelink), ghost_sitelink(ghost_sitelink),
+      ghost_sitelink_diag(ghost_sitelink_diag), precision(precision), coeff(coeff) { }
+  void apply() {
+#ifdef MULTI_GPU
+    exchange_cpu_sitelink(gauge_param.X, sitelink, ghost_sitelink, ghost_sitelink_diag, precision, &gauge_param, 0);
+    llfat_reference_mg(fatlink, sitelink, ghost_sitelink, ghost_sitelink_diag, precision, coeff);
+#else
+    llfat_reference(fatlink, sitelink, precision, coeff);
+#endif
+  }
+};
+
+static void benchFatLink(QudaPrecision precision)
+{
+  double coeff_d[6];
+  float coeff_f[6];
+  for (int i=0; i<6; i++) coeff_d[i] = coeff_f[i] = 0.1*i;
+  void *coeff = (precision == QUDA_DOUBLE_PRECISION) ? (void*)coeff_d : (void*)coeff_f;
+
+  void *sitelink[4], *fatlink[4];
+  for (int d=0; d<4; d++) {
+    sitelink[d] = allocLinks(V*gaugeSiteSize*precision);
+    fatlink[d] = allocLinks(V*gaugeSiteSize*precision);
+  }
+  createSiteLinkCPU(sitelink, precision, 1);
+
+  void *ghost_sitelink[4] = { NULL, NULL, NULL, NULL }, *ghost_sitelink_diag[16];
+  for (int i=0; i<16; i++) ghost_sitelink_diag[i] = NULL;
+#ifdef MULTI_GPU
+  // the links of the faces and of the edges in every pair of directions
+  for (int d=0; d<4; d++) ghost_sitelink[d] = allocLinks(8*Vs[d]*gaugeSiteSize*precision);
+  for (int nu=0; nu<4; nu++) {
+    for (int mu=0; mu<4; mu++) {
+      if (nu == mu) continue;
+      int dir1 = 0, dir2;
+      while (dir1 == nu || dir1 == mu) dir1++;
+      for (dir2=0; dir2 == nu || dir2 == mu || dir2 == dir1; dir2++);
+      size_t bytes = Z[dir1]*Z[dir2]*gaugeSiteSize*precision;
+      ghost_sitelink_diag[nu*4+mu] = allocLinks(bytes);
+      memset(ghost_sitelink_diag[nu*4+mu], 0, bytes);
+    }
+  }
+#endif
+
+  // 61632 flops per site as counted by llfat_test; the links are read
+  // and the fat links written once
+  FatLink fat(fatlink, sitelink, ghost_sitelink, ghost_sitelink_diag, precision, coeff);
+  run("fatlink", "asqtad", precision, 61632.0*V, 8.0*V*gaugeSiteSize*precision, fat);
+
+#ifdef MULTI_GPU
+  exchange_llfat_cleanup();
+#endif
+  for (int i=0; i<16; i++) free(ghost_sitelink_diag[i]);
+  for (int d=0; d<4; d++) {
+    free(ghost_sitelink[d]);
+    free(sitelink[d]);
+    free(fatlink[d]);
+  }
+}
+
+// ---------- solver ----------
+
+// cg_iter iterations of CG on the even-odd preconditioned Wilson
+// normal operator, restarted whenever it converges
+struct WilsonCG : Kernel {
+  void **gauge;
+  cpuColorSpinorField &b, &x, &r, &p, &Ap, &tmp;
+  WilsonCG(void **gauge, cpuColorSpinorField &b, cpuColorSpinorField &x, cpuColorSpinorField &r,
+	   cpuColorSpinorField &p, cpuColorSpinorField &Ap, cpuColorSpinorField &tmp)
+    : gauge(gauge), b(b), x(x), r(r), p(p), Ap(Ap), tmp(tmp) { }
+
+  void MdagM(cpuColorSpinorField &out, cpuColorSpinorField &in) {
+    wil_matpc(tmp.V(), gauge, in.V(), 0.1, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_NO, in.Precision(), gauge_param);
+    wil_matpc(out.V(), gauge, tmp.V(), 0.1, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_YES, in.Precision(), gauge_param);
+  }
+
+  void apply() {
+    const double b2 = normCpu(b);
+    double rr = 0.0;
+    for (int k=0; k<cg_iter; k++) {
+      if (rr <= 1e-12*b2) { // (re)start, so that the residual never underflows
+	x.zero();
+	r.copy(b);
+	p.copy(b);
+	rr = b2;
+      }
+      MdagM(Ap, p);
+      double alpha = rr / reDotProductCpu(p, Ap);
+      axpyCpu(alpha, p, x);
+      axpyCpu(-alpha, Ap, r);
+      double rr_new = normCpu(r);
+      xpayCpu(r, rr_new / rr, p);
+      rr = rr_new;
+    }
+  }
+};
+
+static void benchSolver(QudaPrecision precision)
+{
+  setSpinorSiteSize(24);
+
+  void *gauge[4];
+  for (int d=0; d<4; d++) gauge[d] = allocLinks(V*gaugeSiteSize*precision);
+  construct_gauge_field(gauge, 1, precision, &gauge_param);
+
+  cpuColorSpinorField *f[6];
+  for (int i=0; i<6; i++) f[i] = newSpinor(4, 4, precision, QUDA_PARITY_SITE_SUBSET);
+
+  // per iteration, two applications of the operator, each of two
+  // dslashes, the second with an xpay, and five BLAS kernels
+  const double Vh_ = Vh;
+  const double flops = cg_iter*Vh_*(2*(1320 + 1368) + 5*2*spinorSiteSize);
+  const double bytes = cg_iter*Vh_*(2*(2*(8*gaugeSiteSize + 9*spinorSiteSize) + spinorSiteSize) +
+				    (2 + 3 + 3 + 1 + 3)*spinorSiteSize)*precision;
+
+  WilsonCG cg(gauge, *f[0], *f[1], *f[2], *f[3], *f[4], *f[5]);
+  run("solver", "cg_wilson", precision, flops, bytes, cg);
+
+  for (int i=0; i<6; i++) delete f[i];
+  cpuColorSpinorField::freeGhostBuffer();
+  for (int d=0; d<4; d++) free(gauge[d]);
+}
+
+// ---------- output ----------
+
+static const char* commsName()
+{
+#if defined(THREAD_COMMS)
+  return "thread";
+#elif defined(QMP_COMMS)
+  return "qmp";
+#elif defined(MPI_COMMS)
+  return "mpi";
+#else
+  return "none";
+#endif
+}
+
+static void writeJson(const int *grid)
+{
+#ifdef MULTI_GPU
+  if (comm_rank() != 0) return;
+#endif
+
+  FILE *f = fopen(json_file, "w");
+  if (!f) errorQuda("Cannot open %s", json_file);
+
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"version\": \"%s\",\n", getQudaVersion());
+  fprintf(f, "  \"hash\": \"%s\",\n", getQudaHash());
+  fprintf(f, "  \"host\": \"%s\",\n", host);
+  fprintf(f, "  \"comms\": \"%s\",\n", commsName());
+  fprintf(f, "  \"ranks\": %d,\n", ranks);
+  fprintf(f, "  \"grid\": [%d, %d, %d, %d],\n", grid[0], grid[1], grid[2], grid[3]);
+  fprintf(f, "  \"scaling\": \"%s\",\n", strong_scaling ? "strong" : "weak");
+  fprintf(f, "  \"benchmarks\": \"");
+  for (int b=0, n=0; b<(int)(sizeof(bench_name)/sizeof(bench_name[0])); b++)
+    if (bench & (1 << b)) fprintf(f, "%s%s", n++ ? "," : "", bench_name[b]);
+  fprintf(f, "\",\n");
+  fprintf(f, "  \"local_volume\": [%d, %d, %d, %d],\n", Z[0], Z[1], Z[2], Z[3]);
+  fprintf(f, "  \"global_volume\": [%d, %d, %d, %d],\n", grid[0]*Z[0], grid[1]*Z[1], grid[2]*Z[2], grid[3]*Z[3]);
+  fprintf(f, "  \"warmup\": %d,\n", warmup);
+  fprintf(f, "  \"repetitions\": %d,\n", niter);
+  fprintf(f, "  \"roofline\": {\"gbytes_per_rank\": %.4f, \"gflops_single_per_rank\": %.4f, "
+	  "\"gflops_double_per_rank\": %.4f},\n", 1e-9*rooflineBandwidth(),
+	  1e-9*rooflineFlops(QUDA_SINGLE_PRECISION), 1e-9*rooflineFlops(QUDA_DOUBLE_PRECISION));
+  fprintf(f, "  \"results\": [\n");
+  for (size_t i=0; i<results.size(); i++) {
+    const Result &r = results[i];
+    fprintf(f, "    {\"kernel\": \"%s\", \"variant\": \"%s\", \"precision\": \"%s\", "
+	    "\"mean_s\": %.6e, \"min_s\": %.6e, \"max_s\": %.6e, \"stddev_s\": %.6e, "
+	    "\"gflops\": %.4f, \"gbytes\": %.4f, \"gflops_per_rank\": %.4f, \"gbytes_per_rank\": %.4f",
+	    r.kernel.c_str(), r.variant.c_str(), get_prec_str(r.precision), r.mean, r.min, r.max, r.stddev,
+	    1e-9*ranks*r.flops/r.mean, 1e-9*ranks*r.bytes/r.mean, 1e-9*r.flops/r.mean, 1e-9*r.bytes/r.mean);
+    fprintf(f, ", \"roofline_fraction\": %.4f", rooflineFraction(r.flops, r.bytes, r.mean, r.precision));
+    if (counters) {
+      for (int c=0; c<PERF_COUNTERS; c++) fprintf(f, ", \"%s\": %.6e", perfCounterName((PerfCounter)c), r.count[c]);
+      fprintf(f, ", \"ipc\": %.4f, \"llc_miss_rate\": %.4f, \"mem_bytes_per_flop\": %.4f",
+	      ipc(r), 0.01*llcMissRate(r), memBytesPerFlop(r));
+    }
+    fprintf(f, "}%s\n", i+1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+
+  printfQuda("Wrote %d results to %s\n", (int)results.size(), json_file);
+}
+
+static int benchmark(int argc, char **argv)
+{
+  initCommsQuda(argc, argv, gridsize_from_cmdline, 4);
+
+  int grid[4] = { 1, 1, 1, 1 };
+#ifdef MULTI_GPU
+  ranks = comm_size();
+  for (int d=0; d<4; d++) grid[d] = gridsize_from_cmdline[d];
+#endif
+
+  gauge_param = newQudaGaugeParam();
+  const int X[4] = { xdim, ydim, zdim, tdim };
+  for (int d=0; d<4; d++) {
+    gauge_param.X[d] = X[d];
+    if (strong_scaling) {
+      if (X[d] % grid[d] != 0) errorQuda("Dimension %d of size %d is not divisible by the grid size %d", d, X[d], grid[d]);
+      gauge_param.X[d] /= grid[d];
+    }
+    if (gauge_param.X[d] % 2 != 0 || gauge_param.X[d] < 6)
+      errorQuda("Local dimension %d of size %d must be even and at least 6", d, gauge_param.X[d]);
+  }
+  gauge_param.anisotropy = 1.0;
+  gauge_param.type = QUDA_WILSON_LINKS;
+  gauge_param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+  gauge_param.t_boundary = QUDA_ANTI_PERIODIC_T;
+  gauge_param.tadpole_coeff = 0.8;
+  gauge_param.reconstruct = QUDA_RECONSTRUCT_NO;
+  gauge_param.gauge_fix = QUDA_GAUGE_FIXED_NO;
+  gauge_param.ga_pad = 0;
+
+  setDims(gauge_param.X);
+  setExtendedDims(gauge_param.X);
+  setSpinorSiteSize(24);
+
+  printfQuda("Host benchmark: %d ranks (%s comms), local volume %dx%dx%dx%d, %s scaling, %d warmup and %d timed calls\n",
+	     ranks, commsName(), Z[0], Z[1], Z[2], Z[3], strong_scaling ? "strong" : "weak", warmup, niter);
+  probeRoofline();
+  if (counters && !perfCountersOpen()) counters = false;
+  if (counters) {
+    printfQuda("%-12s %-14s %-7s %12s %12s %10s %10s %7s %6s %8s %8s\n", "kernel", "variant", "prec", "mean ms", "min ms",
+	       "GFLOP/s", "GB/s", "roof", "IPC", "LLC miss", "mem B/F");
+  } else {
+    printfQuda("%-12s %-14s %-7s %12s %12s %10s %10s %7s\n", "kernel", "variant", "prec", "mean ms", "min ms",
+	       "GFLOP/s", "GB/s", "roof");
+  }
+
+  const QudaPrecision precision[] = { QUDA_DOUBLE_PRECISION, QUDA_SINGLE_PRECISION };
+  for (int i=0; i<2; i++) {
+    gauge_param.cpu_prec = gauge_param.cuda_prec = gauge_param.cuda_prec_sloppy = precision[i];
+    if (bench & BENCH_DSLASH) benchDslash(precision[i]);
+    if (bench & BENCH_BLAS) benchBlas(precision[i]);
+    if (bench & BENCH_PACK) benchPack(precision[i]);
+    if (bench & BENCH_REORDER) benchReorder(precision[i]);
+    if (bench & BENCH_GAUGE_FORCE) benchGaugeForce(precision[i]);
+    if (bench & BENCH_FATLINK) benchFatLink(precision[i]);
+    if (bench & BENCH_SOLVER) benchSolver(precision[i]);
+  }
+
+  writeJson(grid);
+
+  perfCountersClose();
+  endCommsQuda();
+  return 0;
+}
+
+void usage_extra(char **argv)
+{
+  printf("Extra options:\n");
+  printf("    --bench <list>                            # Comma-separated kernels to run (default all):\n"
+	 "                                                  dslash,blas,pack,reorder,gauge_force,fatlink,solver\n");
+  printf("    --warmup <n>                              # Untimed calls before the --niter timed calls (default 2)\n");
+  printf("    --scaling <weak/strong>                   # Whether the dimensions are per rank or of the whole lattice (default weak)\n");
+  printf("    --json <file>                             # Write the results to file (default benchmark.json)\n");
+  printf("    --counters                                # Read the hardware performance counters over the timed calls\n");
+}
+
+static int parseBench(char *list)
+{
+  int mask = 0;
+  for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+    if (!strcmp(name, "all")) {
+      mask |= BENCH_ALL;
+      continue;
+    }
+    int i = 0;
+    while (i < 7 && strcmp(name, bench_name[i])) i++;
+    if (i == 7) {
+      fprintf(stderr, "ERROR: unknown benchmark %s\n", name);
+      exit(1);
+    }
+    mask |= 1 << i;
+  }
+  return mask;
+}
+
+int main(int argc, char **argv)
+{
+  for (int i=1; i<argc; i++) {
+    if (process_command_line_option(argc, argv, &i) == 0) continue;
+
+    if (i+1 < argc && !strcmp(argv[i], "--bench")) {
+      bench = parseBench(argv[++i]);
+      continue;
+    }
+    if (i+1 < argc && !strcmp(argv[i], "--warmup")) {
+      warmup = atoi(argv[++i]);
+      if (warmup < 0) usage(argv);
+      continue;
+    }
+    if (i+1 < argc && !strcmp(argv[i], "--scaling")) {
+      i++;
+      if (!strcmp(argv[i], "weak")) strong_scaling = false;
+      else if (!strcmp(argv[i], "strong")) strong_scaling = true;
+      else usage(argv);
+      continue;
+    }
+    if (!strcmp(argv[i], "--counters")) {
+      counters = true;
+      continue;
+    }
+    if (i+1 < argc && !strcmp(argv[i], "--json")) {
+      strncpy(json_file, argv[++i], sizeof(json_file) - 1);
+      continue;
+    }
+
+    fprintf(stderr, "ERROR: Invalid option:%s\n", argv[i]);
+    usage(argv);
+  }
+  if (niter <= 0) usage(argv);
+
+#ifdef THREAD_COMMS
+  // the lattice globals of the host reference code are per rank
+  int nranks = 1;
+  for (int d=0; d<4; d++) nranks *= gridsize_from_cmdline[d];
+  return comm_thread_launch(nranks, benchmark, argc, argv);
+#else
+  return benchmark(argc, argv);
+#endif
+}
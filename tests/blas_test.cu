@@ -610,6 +610,92 @@ double test(int kernel) {
   return error;
 }
 
+// the fused update of the multi-shift solver against one
+// axpyBzpcx per shift, with more shifts than are fused in one launch
+const int Nshift = 5;
+
+double testMultiShift(int prec, QudaSiteSubset subset)
+{
+  const double a[Nshift] = { 1.5, -0.5, 0.25, 2.0, -1.25 };
+  const double b[Nshift] = { 2.5, 0.75, -1.5, 0.5, 1.0 };
+  const double c[Nshift] = { 3.5, -2.0, 0.125, 1.75, -0.25 };
+  const QudaPrecision precision[] = { QUDA_HALF_PRECISION, QUDA_SINGLE_PRECISION, QUDA_DOUBLE_PRECISION };
+
+  ColorSpinorParam param;
+  param.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  param.nColor = 3;
+  param.nSpin = Nspin;
+  param.nDim = 4;
+  param.pad = 0;
+  param.siteSubset = subset;
+  param.x[0] = (subset == QUDA_PARITY_SITE_SUBSET) ? xdim/2 : xdim;
+  param.x[1] = ydim;
+  param.x[2] = zdim;
+  param.x[3] = tdim;
+  param.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+  param.gammaBasis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.precision = QUDA_DOUBLE_PRECISION;
+  param.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  param.create = QUDA_ZERO_FIELD_CREATE;
+
+  cpuColorSpinorField *rH = new cpuColorSpinorField(param);
+  cpuColorSpinorField *pH[Nshift], *sH[Nshift];
+  for (int j=0; j<Nshift; j++) {
+    pH[j] = new cpuColorSpinorField(param);
+    sH[j] = new cpuColorSpinorField(param);
+  }
+
+  if (param.nSpin == 4) param.gammaBasis = QUDA_UKQCD_GAMMA_BASIS;
+  param.fieldLocation = QUDA_CUDA_FIELD_LOCATION;
+  setPrec(param, precision[prec]);
+
+  cudaColorSpinorField *rD = new cudaColorSpinorField(param);
+  cudaColorSpinorField *pD[Nshift], *sD[Nshift];
+  for (int j=0; j<Nshift; j++) {
+    pD[j] = new cudaColorSpinorField(param);
+    sD[j] = new cudaColorSpinorField(param);
+  }
+
+  double error = 0.0;
+
+  // the fused update on the host against one update per shift on the
+  // device, and then the other way around
+  for (int fused_on_host=1; fused_on_host>=0; fused_on_host--) {
+    rH->Source(QUDA_RANDOM_SOURCE, 0, 0, 0);
+    *rD = *rH;
+    for (int j=0; j<Nshift; j++) {
+      pH[j]->Source(QUDA_RANDOM_SOURCE, 0, 0, 0);
+      sH[j]->Source(QUDA_RANDOM_SOURCE, 0, 0, 0);
+      *pD[j] = *pH[j];
+      *sD[j] = *sH[j];
+    }
+
+    if (fused_on_host) {
+      multiShiftAxpyBzpcxCpu(a, pH, sH, b, *rH, c, Nshift);
+      for (int j=0; j<Nshift; j++) axpyBzpcxCuda(a[j], *pD[j], *sD[j], b[j], *rD, c[j]);
+    } else {
+      multiShiftAxpyBzpcxCuda(a, pD, sD, b, *rD, c, Nshift);
+      for (int j=0; j<Nshift; j++) axpyBzpcxCpu(a[j], *pH[j], *sH[j], b[j], *rH, c[j]);
+    }
+
+    for (int j=0; j<Nshift; j++) {
+      error += fabs(norm2(*pD[j]) - norm2(*pH[j])) / norm2(*pH[j]);
+      error += fabs(norm2(*sD[j]) - norm2(*sH[j])) / norm2(*sH[j]);
+    }
+  }
+
+  for (int j=0; j<Nshift; j++) {
+    delete sD[j];
+    delete pD[j];
+    delete sH[j];
+    delete pH[j];
+  }
+  delete rD;
+  delete rH;
+
+  return error;
+}
+
 int main(int argc, char** argv)
 {
   for (int i = 1; i < argc; i++){
@@ -712,6 +798,11 @@ int main(int argc, char** argv)
       printfQuda("%-35s error = %e, \n", names[kernel], error);
     }
     freeFields();
+
+    printfQuda("%-35s error = %e, \n", "multiShiftAxpyBzpcx (parity)",
+	       testMultiShift(prec, QUDA_PARITY_SITE_SUBSET));
+    printfQuda("%-35s error = %e, \n", "multiShiftAxpyBzpcx (full)",
+	       testMultiShift(prec, QUDA_FULL_SITE_SUBSET));
   }
 
   endQuda();
@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <quda.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <color_spinor_field.h>
+#include <blas_quda.h>
+#include <test_util.h>
+#include <wilson_dslash_reference.h>
+
+#ifndef THREAD_COMMS
+#include <mpi.h>
+#endif
+
+// Exercises the point-to-point and collective routines of the comms
+// layer: every rank sends its grid coordinates to its eight
+// neighbours and checks what it gets back, followed by a set of
+// reductions and a broadcast.  With --enable-thread-comms the ranks
+// are threads of this process, so no MPI installation is needed.
+// The halo compression formats are checked by sending compressed
+// spinor and link faces to the forward neighbour.  The reference
+// operators must keep their ghost links while the host links are
+// unchanged.  Finally a CG solve of the reference Wilson operator runs
+// on the decomposed lattice, which exercises the ghost exchanges and
+// the per-rank state of the host code together; its solution is kept
+// in a different field order from the other vectors.
+
+extern int gridsize_from_cmdline[];
+extern void usage(char**);
+
+static const int niter_exchange = 10;
+
+static int check_exchange()
+{
+  int fwd_nbr[4] = {X_FWD_NBR, Y_FWD_NBR, Z_FWD_NBR, T_FWD_NBR};
+  int back_nbr[4] = {X_BACK_NBR, Y_BACK_NBR, Z_BACK_NBR, T_BACK_NBR};
+  int faults = 0;
+
+  for (int iter=0; iter<niter_exchange; iter++) {
+    for (int dir=0; dir<4; dir++) {
+      int send[5], from_back[5], from_fwd[5];
+      for (int d=0; d<4; d++) send[d] = comm_coords(d);
+      send[4] = iter;
+
+      MPI_Request recv_request1, recv_request2, send_request1, send_request2;
+      comm_recv_with_tag(from_back, sizeof(from_back), back_nbr[dir], 2*dir, &recv_request1);
+      comm_recv_with_tag(from_fwd, sizeof(from_fwd), fwd_nbr[dir], 2*dir+1, &recv_request2);
+      comm_send_with_tag(send, sizeof(send), fwd_nbr[dir], 2*dir, &send_request1);
+      comm_send_with_tag(send, sizeof(send), back_nbr[dir], 2*dir+1, &send_request2);
+      comm_wait(&recv_request1);
+      comm_wait(&recv_request2);
+      comm_wait(&send_request1);
+      comm_wait(&send_request2);
+
+      for (int d=0; d<4; d++) {
+	int L = comm_dim(d);
+	int back = (d == dir) ? (comm_coords(d) - 1 + L) % L : comm_coords(d);
+	int fwd = (d == dir) ? (comm_coords(d) + 1) % L : comm_coords(d);
+	if (from_back[d] != back || from_fwd[d] != fwd) faults++;
+      }
+      if (from_back[4] != iter || from_fwd[4] != iter) faults++;
+    }
+  }
+
+  return faults;
+}
+
+static int check_collectives()
+{
+  int faults = 0;
+  int rank = comm_rank();
+  int size = comm_size();
+
+  double sum = rank;
+  comm_allreduce(&sum);
+  if (sum != 0.5*size*(size-1)) faults++;
+
+  double max = rank;
+  comm_allreduce_max(&max);
+  if (max != size-1) faults++;
+
+  double array[3] = {1.0, (double)rank, -2.0*rank};
+  comm_allreduce_array(array, 3);
+  if (array[0] != size || array[1] != 0.5*size*(size-1) || array[2] != -1.0*size*(size-1)) faults++;
+
+  double value[2] = {0.0, 0.0};
+  if (rank == 0) { value[0] = 3.25; value[1] = -7.5; }
+  comm_broadcast(value, sizeof(value));
+  if (value[0] != 3.25 || value[1] != -7.5) faults++;
+
+  comm_barrier();
+
+  return faults;
+}
+
+// random SU(3) matrix: Gram-Schmidt on two random rows, the third
+// row is conj(row0 x row1)
+static void random_su3(double *U, unsigned int *seed)
+{
+  for (int j=0; j<12; j++) U[j] = rand_r(seed) / (double)RAND_MAX - 0.5;
+
+  double n0 = 0.0;
+  for (int j=0; j<6; j++) n0 += U[j]*U[j];
+  for (int j=0; j<6; j++) U[j] /= sqrt(n0);
+
+  double re = 0.0, im = 0.0; // <row0, row1>
+  for (int c=0; c<3; c++) {
+    re += U[2*c]*U[6+2*c] + U[2*c+1]*U[6+2*c+1];
+    im += U[2*c]*U[6+2*c+1] - U[2*c+1]*U[6+2*c];
+  }
+  for (int c=0; c<3; c++) {
+    U[6+2*c] -= re*U[2*c] - im*U[2*c+1];
+    U[6+2*c+1] -= re*U[2*c+1] + im*U[2*c];
+  }
+  double n1 = 0.0;
+  for (int j=6; j<12; j++) n1 += U[j]*U[j];
+  for (int j=6; j<12; j++) U[j] /= sqrt(n1);
+
+  for (int c=0; c<3; c++) {
+    int a = (c+1)%3, b = (c+2)%3;
+    double *r0 = U, *r1 = U+6;
+    U[12+2*c] = r0[2*a]*r1[2*b] - r0[2*a+1]*r1[2*b+1] - (r0[2*b]*r1[2*a] - r0[2*b+1]*r1[2*a+1]);
+    U[12+2*c+1] = -(r0[2*a]*r1[2*b+1] + r0[2*a+1]*r1[2*b] - (r0[2*b]*r1[2*a+1] + r0[2*b+1]*r1[2*a]));
+  }
+}
+
+// sends a compressed face to the forward neighbour in T and receives
+// the one from the backward neighbour
+static void exchange_wire(void *recv, void *send, size_t bytes)
+{
+  MPI_Request recv_request, send_request;
+  comm_recv_with_tag(recv, bytes, T_BACK_NBR, TUP, &recv_request);
+  comm_send_with_tag(send, bytes, T_FWD_NBR, TUP, &send_request);
+  comm_wait(&recv_request);
+  comm_wait(&send_request);
+}
+
+static int check_compression()
+{
+  const int nBlocks = 1024, blockLength = 24, nLinks = 1024;
+  const int rank = comm_rank();
+  int faults = 0;
+
+  // seeds depend on the rank's coordinates, so that each rank can
+  // regenerate the face it receives from its backward neighbour
+  // (rand_r since with thread comms the ranks share a process)
+  int back_coords[4] = {comm_coords(0), comm_coords(1), comm_coords(2), (comm_coords(3) - 1 + comm_dim(3)) % comm_dim(3)};
+  int back_seed = ((back_coords[3]*comm_dim(2) + back_coords[2])*comm_dim(1) + back_coords[1])*comm_dim(0) + back_coords[0];
+  int my_seed = ((comm_coords(3)*comm_dim(2) + comm_coords(2))*comm_dim(1) + comm_coords(1))*comm_dim(0) + comm_coords(0);
+
+  double *spinor = (double*)malloc(nBlocks*blockLength*sizeof(double));
+  double *spinor_ref = (double*)malloc(nBlocks*blockLength*sizeof(double));
+  double *links = (double*)malloc(nLinks*18*sizeof(double));
+  double *links_ref = (double*)malloc(nLinks*18*sizeof(double));
+  size_t spinor_bytes = spinorFaceWireBytes(nBlocks, blockLength);
+  size_t link_bytes = linkFaceWireBytes(nLinks, QUDA_DOUBLE_PRECISION);
+  void *send = malloc(spinor_bytes > link_bytes ? spinor_bytes : link_bytes);
+  void *recv = malloc(spinor_bytes > link_bytes ? spinor_bytes : link_bytes);
+
+  for (int seed_pass=0; seed_pass<2; seed_pass++) {
+    // pass 0 fills the send face, pass 1 regenerates the neighbour's face as the reference
+    unsigned int seed = 1234 + (seed_pass == 0 ? my_seed : back_seed);
+    double *s = seed_pass == 0 ? spinor : spinor_ref;
+    double *u = seed_pass == 0 ? links : links_ref;
+    for (int i=0; i<nBlocks*blockLength; i++) s[i] = rand_r(&seed) / (double)RAND_MAX - 0.5;
+    for (int i=0; i<nLinks; i++) {
+      random_su3(u + i*18, &seed);
+      if (i % 3 == 0) for (int j=0; j<18; j++) u[i*18+j] = -u[i*18+j]; // boundary sign
+    }
+  }
+
+  // spinor faces: error is bounded by half a unit in the last place of the 16-bit mantissa
+  compressSpinorFace(send, spinor, nBlocks, blockLength, QUDA_DOUBLE_PRECISION);
+  exchange_wire(recv, send, spinor_bytes);
+  decompressSpinorFace(spinor, recv, nBlocks, blockLength, QUDA_DOUBLE_PRECISION);
+  double spinor_err = 0.0;
+  for (int i=0; i<nBlocks; i++) {
+    double norm = 0.0;
+    for (int j=0; j<blockLength; j++) norm = fmax(norm, fabs(spinor_ref[i*blockLength+j]));
+    for (int j=0; j<blockLength; j++) {
+      double err = fabs(spinor[i*blockLength+j] - spinor_ref[i*blockLength+j]) / norm;
+      spinor_err = fmax(spinor_err, err);
+    }
+  }
+  if (spinor_err > 1.0/32767) faults++;
+
+  // link faces: the reconstructed third row should be exact to rounding
+  size_t link_sent = compressLinkFace(send, links, nLinks, QUDA_DOUBLE_PRECISION);
+  exchange_wire(recv, send, link_bytes);
+  decompressLinkFace(links, recv, nLinks, QUDA_DOUBLE_PRECISION);
+  double link_err = 0.0;
+  for (int i=0; i<nLinks*18; i++) link_err = fmax(link_err, fabs(links[i] - links_ref[i]));
+  if (link_err > 1e-12) faults++;
+
+  // a face that is not in SU(3) must go through untouched
+  for (int i=0; i<18; i++) links_ref[i] *= 2.0;
+  size_t raw_sent = compressLinkFace(send, links_ref, nLinks, QUDA_DOUBLE_PRECISION);
+  decompressLinkFace(links, send, nLinks, QUDA_DOUBLE_PRECISION);
+  if (memcmp(links, links_ref, nLinks*18*sizeof(double)) != 0) faults++;
+
+  if (rank == 0) {
+    printf("Halo compression: spinor error %e (%.2f of raw bytes), link error %e (%.2f of raw bytes, %.2f for non-SU(3))\n",
+	   spinor_err, (double)spinor_bytes / (nBlocks*blockLength*sizeof(double)),
+	   link_err, (double)link_sent / (nLinks*18*sizeof(double)), (double)raw_sent / (nLinks*18*sizeof(double)));
+  }
+
+  free(recv);
+  free(send);
+  free(links_ref);
+  free(links);
+  free(spinor_ref);
+  free(spinor);
+
+  return faults;
+}
+
+// links of a 6^4 lattice per rank, for the reference operators
+static QudaGaugeParam reference_gauge_param(QudaPrecision precision)
+{
+  QudaGaugeParam gauge_param = newQudaGaugeParam();
+  for (int d=0; d<4; d++) gauge_param.X[d] = 6;
+  gauge_param.anisotropy = 1.0;
+  gauge_param.type = QUDA_WILSON_LINKS;
+  gauge_param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+  gauge_param.t_boundary = QUDA_ANTI_PERIODIC_T;
+  gauge_param.cpu_prec = gauge_param.cuda_prec = gauge_param.cuda_prec_sloppy = precision;
+  gauge_param.reconstruct = QUDA_RECONSTRUCT_NO;
+  gauge_param.gauge_fix = QUDA_GAUGE_FIXED_NO;
+  setDims(gauge_param.X);
+  return gauge_param;
+}
+
+// A second call of the reference dslash with unchanged links must not
+// exchange the ghost links again.  The links are edited in place
+// without marking them modified, so a cached ghost zone still holds
+// the old links, while an exchange would bring in the new ones.
+static int check_ghost_cache()
+{
+  const QudaPrecision precision = QUDA_DOUBLE_PRECISION;
+  QudaGaugeParam gauge_param = reference_gauge_param(precision);
+  int faults = 0;
+
+  void *gauge[4], *saved[4];
+  for (int d=0; d<4; d++) gauge[d] = malloc(V*gaugeSiteSize*precision);
+  construct_gauge_field(gauge, 1, precision, &gauge_param);
+
+  void **ghost = wil_ghost_gauge(gauge, gauge_param);
+  for (int d=0; d<4; d++) {
+    saved[d] = malloc(faceVolume[d]*gaugeSiteSize*precision);
+    memcpy(saved[d], ghost[d], faceVolume[d]*gaugeSiteSize*precision);
+  }
+
+  for (int d=0; d<4; d++)
+    for (int i=0; i<V*gaugeSiteSize; i++) ((double*)gauge[d])[i] *= 2.0;
+
+  int stale = 0, fresh = 0, partitioned = 0;
+  ghost = wil_ghost_gauge(gauge, gauge_param);
+  for (int d=0; d<4; d++) {
+    if (!comm_dim_partitioned(d)) continue;
+    partitioned++;
+    if (memcmp(ghost[d], saved[d], faceVolume[d]*gaugeSiteSize*precision) == 0) stale++;
+  }
+
+  markHostGaugeModified();
+  ghost = wil_ghost_gauge(gauge, gauge_param);
+  for (int d=0; d<4; d++) {
+    if (!comm_dim_partitioned(d)) continue;
+    int same = 1;
+    for (int i=0; i<faceVolume[d]*gaugeSiteSize; i++)
+      if (((double*)ghost[d])[i] != 2.0*((double*)saved[d])[i]) same = 0;
+    fresh += same;
+  }
+
+  if (stale != partitioned || fresh != partitioned) faults++;
+
+  if (comm_rank() == 0) {
+    printf("Reference ghost links: %d of %d partitioned dimensions kept while unchanged, %d exchanged once modified\n",
+	   stale, partitioned, fresh);
+  }
+
+  for (int d=0; d<4; d++) {
+    free(saved[d]);
+    free(gauge[d]);
+  }
+
+  return faults;
+}
+
+static const int solver_max_iter = 1000;
+
+// CG on the normal equations of the even-even preconditioned Wilson
+// operator
+static int check_solver()
+{
+  const QudaPrecision precision = QUDA_DOUBLE_PRECISION;
+  const double kappa = 0.1, tol = 1e-7;
+  int faults = 0;
+
+  QudaGaugeParam gauge_param = reference_gauge_param(precision);
+  setSpinorSiteSize(24);
+
+  void *gauge[4];
+  for (int d=0; d<4; d++) gauge[d] = malloc(V*gaugeSiteSize*precision);
+  construct_gauge_field(gauge, 1, precision, &gauge_param);
+
+  ColorSpinorParam param;
+  param.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  param.nColor = 3;
+  param.nSpin = 4;
+  param.nDim = 4;
+  for (int d=0; d<4; d++) param.x[d] = gauge_param.X[d];
+  param.x[0] /= 2;
+  param.precision = precision;
+  param.pad = 0;
+  param.siteSubset = QUDA_PARITY_SITE_SUBSET;
+  param.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+  param.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  param.gammaBasis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.create = QUDA_ZERO_FIELD_CREATE;
+
+  cpuColorSpinorField b(param), r(param), p(param), Ap(param), tmp(param), x_ref(param);
+  b.Source(QUDA_RANDOM_SOURCE);
+
+  // the solution is accumulated in place in "application" memory of
+  // space-color-spin order, which the host BLAS reach through the
+  // field-order accessors
+  void *x_app = calloc(Vh*spinorSiteSize, precision);
+  ColorSpinorParam x_param(param);
+  x_param.fieldOrder = QUDA_SPACE_COLOR_SPIN_FIELD_ORDER;
+  x_param.create = QUDA_REFERENCE_FIELD_CREATE;
+  x_param.v = x_app;
+  cpuColorSpinorField x(x_param);
+
+  const double b2 = normCpu(b);
+  r.copy(b);
+  p.copy(b);
+  double rr = b2;
+  int iter = 0;
+  while (rr > tol*tol*b2 && iter < solver_max_iter) {
+    wil_matpc(tmp.V(), gauge, p.V(), kappa, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_NO, precision, gauge_param);
+    wil_matpc(Ap.V(), gauge, tmp.V(), kappa, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_YES, precision, gauge_param);
+    double alpha = rr / reDotProductCpu(p, Ap);
+    axpyCpu(alpha, p, x);
+    axpyCpu(-alpha, Ap, r);
+    double rr_new = normCpu(r);
+    xpayCpu(r, rr_new / rr, p);
+    rr = rr_new;
+    iter++;
+  }
+
+  // true residual, which the iterated one tracks to round-off
+  x_ref.copy(x);
+  wil_matpc(tmp.V(), gauge, x_ref.V(), kappa, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_NO, precision, gauge_param);
+  wil_matpc(Ap.V(), gauge, tmp.V(), kappa, QUDA_MATPC_EVEN_EVEN, QUDA_DAG_YES, precision, gauge_param);
+  double true_res = sqrt(xmyNormCpu(b, Ap) / b2);
+  if (iter == solver_max_iter || true_res > 10*tol) faults++;
+
+  // the reductions are global, so every rank takes the same number of steps
+  double max_iter = iter;
+  comm_allreduce_max(&max_iter);
+  if (max_iter != iter) faults++;
+
+  if (comm_rank() == 0) {
+    printf("Decomposed CG: converged in %d iterations, true residual %e (tolerance %e)\n", iter, true_res, tol);
+  }
+
+  cpuColorSpinorField::freeGhostBuffer();
+  for (int d=0; d<4; d++) free(gauge[d]);
+  free(x_app);
+
+  return faults;
+}
+
+int comm_test(int argc, char **argv)
+{
+  initCommsQuda(argc, argv, gridsize_from_cmdline, 4);
+
+  int faults = check_exchange();
+  faults += check_collectives();
+  faults += check_compression();
+  faults += check_ghost_cache();
+  faults += check_solver();
+
+  double total = faults;
+  comm_allreduce(&total);
+
+  if (comm_rank() == 0) {
+    printf("Comms test on %d ranks (grid %d %d %d %d): %s (%d faults)\n", comm_size(),
+	   comm_dim(0), comm_dim(1), comm_dim(2), comm_dim(3), total == 0 ? "PASSED" : "FAILED", (int)total);
+  }
+
+  endCommsQuda();
+
+  return total == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  for (int i =1;i < argc; i++){
+    if(process_command_line_option(argc, argv, &i) == 0){
+      continue;
+    }
+
+    fprintf(stderr, "ERROR: Invalid option:%s\n", argv[i]);
+    usage(argv);
+  }
+
+#ifdef THREAD_COMMS
+  int nranks = 1;
+  for (int d=0; d<4; d++) nranks *= gridsize_from_cmdline[d];
+  return comm_thread_launch(nranks, comm_test, argc, argv);
+#else
+  return comm_test(argc, argv);
+#endif
+}
@@ -7,6 +7,7 @@
 #include <test_util.h>
 #include <dslash_util.h>
 #include <domain_wall_dslash_reference.h>
+#include <wilson_dslash_reference.h>
 #include <blas_reference.h>
 
 #include <gauge_field.h>
@@ -676,12 +677,7 @@ void dw_dslash(void *out, void **gauge, void *in, int oddBit, int daggerBit, Qud
 //      faceBuf.exchangeCpuLink(ghostGauge, sendGauge);
 //    }
     
-//BEGINOFNEW    
-    GaugeFieldParam gauge_field_param(gauge, gauge_param);
-    cpuGaugeField cpu(gauge_field_param);
-    cpu.exchangeGhost();
-    void **ghostGauge = (void**)cpu.Ghost();    
-//ENDOFNEW    
+    void **ghostGauge = wil_ghost_gauge(gauge, gauge_param);
   
     // Get spinor ghost fields
     // First wrap the input spinor into a ColorSpinorField
@@ -16,6 +16,7 @@
 #include <wilson_dslash_reference.h>
 #include <domain_wall_dslash_reference.h>
 #include "misc.h"
+#include <gauge_field.h>
 
 #include <gauge_qio.h>
 
@@ -37,6 +38,8 @@ cpuColorSpinorField *spinor, *spinorOut, *spinorRef, *spinorTmp;
 cudaColorSpinorField *cudaSpinor, *cudaSpinorOut, *tmp1=0, *tmp2=0;
 
 void *hostGauge[4], *hostClover, *hostCloverInv;
+void **cpuGaugeLink; // hostGauge, or its compressed copy
+cpuGaugeField *cpuGauge = NULL;
 
 Dirac *dirac;
 
@@ -55,6 +58,7 @@ extern int zdim;
 extern int tdim;
 extern int gridsize_from_cmdline[];
 extern QudaReconstructType link_recon;
+extern QudaReconstructType cpu_link_recon;
 extern QudaPrecision prec;
 extern bool kernelPackT;
 extern QudaDagType dagger;
@@ -232,6 +236,20 @@ void init(int argc, char **argv) {
     construct_gauge_field(hostGauge, 1, gauge_param.cpu_prec, &gauge_param);
   }
 
+  // the Wilson reference operators use links stored with cpu_link_recon
+  cpuGaugeLink = hostGauge;
+  if (cpu_link_recon != QUDA_RECONSTRUCT_NO) {
+    if (dslash_type == QUDA_DOMAIN_WALL_DSLASH)
+      errorQuda("Host link reconstruction not supported for the domain wall reference");
+    GaugeFieldParam cpuParam(hostGauge, gauge_param);
+    cpuParam.reconstruct = cpu_link_recon;
+    cpuParam.create = QUDA_NULL_FIELD_CREATE;
+    cpuGauge = new cpuGaugeField(cpuParam);
+    cpuGauge->loadLinks(hostGauge);
+    setCpuGaugeField(cpuGauge);
+    cpuGaugeLink = (void**)cpuGauge->Gauge_p();
+  }
+
   spinor->Source(QUDA_RANDOM_SOURCE);
 
   if (dslash_type == QUDA_CLOVER_WILSON_DSLASH) {
@@ -323,6 +341,9 @@ void end() {
   delete spinorRef;
   delete spinorTmp;
 
+  setCpuGaugeField(NULL);
+  if (cpuGauge) delete cpuGauge;
+
   for (int dir = 0; dir < 4; dir++) free(hostGauge[dir]);
   if (dslash_type == QUDA_CLOVER_WILSON_DSLASH) {
     if (hostClover != hostCloverInv && hostClover) free(hostClover);
@@ -398,24 +419,24 @@ void dslashRef() {
       dslash_type == QUDA_WILSON_DSLASH) {
     switch (test_type) {
     case 0:
-      wil_dslash(spinorRef->V(), hostGauge, spinor->V(), parity, dagger, inv_param.cpu_prec, gauge_param);
+      wil_dslash(spinorRef->V(), cpuGaugeLink, spinor->V(), parity, dagger, inv_param.cpu_prec, gauge_param);
       break;
     case 1:    
-      wil_matpc(spinorRef->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.matpc_type, dagger, 
+      wil_matpc(spinorRef->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.matpc_type, dagger, 
 		inv_param.cpu_prec, gauge_param);
       break;
     case 2:
-      wil_mat(spinorRef->V(), hostGauge, spinor->V(), inv_param.kappa, dagger, inv_param.cpu_prec, gauge_param);
+      wil_mat(spinorRef->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, dagger, inv_param.cpu_prec, gauge_param);
       break;
     case 3:
-      wil_matpc(spinorTmp->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.matpc_type, QUDA_DAG_NO, 
+      wil_matpc(spinorTmp->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.matpc_type, QUDA_DAG_NO, 
 		inv_param.cpu_prec, gauge_param);
-      wil_matpc(spinorRef->V(), hostGauge, spinorTmp->V(), inv_param.kappa, inv_param.matpc_type, QUDA_DAG_YES, 
+      wil_matpc(spinorRef->V(), cpuGaugeLink, spinorTmp->V(), inv_param.kappa, inv_param.matpc_type, QUDA_DAG_YES, 
 		inv_param.cpu_prec, gauge_param);
       break;
     case 4:
-      wil_mat(spinorTmp->V(), hostGauge, spinor->V(), inv_param.kappa, QUDA_DAG_NO, inv_param.cpu_prec, gauge_param);
-      wil_mat(spinorRef->V(), hostGauge, spinorTmp->V(), inv_param.kappa, QUDA_DAG_YES, inv_param.cpu_prec, gauge_param);
+      wil_mat(spinorTmp->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, QUDA_DAG_NO, inv_param.cpu_prec, gauge_param);
+      wil_mat(spinorRef->V(), cpuGaugeLink, spinorTmp->V(), inv_param.kappa, QUDA_DAG_YES, inv_param.cpu_prec, gauge_param);
       break;
     default:
       printfQuda("Test type not defined\n");
@@ -424,27 +445,27 @@ void dslashRef() {
   } else if (dslash_type == QUDA_TWISTED_MASS_DSLASH) {
     switch (test_type) {
     case 0:
-      tm_dslash(spinorRef->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_dslash(spinorRef->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 		parity, dagger, inv_param.cpu_prec, gauge_param);
       break;
     case 1:    
-      tm_matpc(spinorRef->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_matpc(spinorRef->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	       inv_param.matpc_type, dagger, inv_param.cpu_prec, gauge_param);
       break;
     case 2:
-      tm_mat(spinorRef->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_mat(spinorRef->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	     dagger, inv_param.cpu_prec, gauge_param);
       break;
     case 3:    
-      tm_matpc(spinorTmp->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_matpc(spinorTmp->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	       inv_param.matpc_type, QUDA_DAG_NO, inv_param.cpu_prec, gauge_param);
-      tm_matpc(spinorRef->V(), hostGauge, spinorTmp->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_matpc(spinorRef->V(), cpuGaugeLink, spinorTmp->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	       inv_param.matpc_type, QUDA_DAG_YES, inv_param.cpu_prec, gauge_param);
       break;
     case 4:
-      tm_mat(spinorTmp->V(), hostGauge, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_mat(spinorTmp->V(), cpuGaugeLink, spinor->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	     QUDA_DAG_NO, inv_param.cpu_prec, gauge_param);
-      tm_mat(spinorRef->V(), hostGauge, spinorTmp->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+      tm_mat(spinorRef->V(), cpuGaugeLink, spinorTmp->V(), inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
 	     QUDA_DAG_YES, inv_param.cpu_prec, gauge_param);
       break;
     default:
@@ -482,9 +503,9 @@ void display_test_info()
 {
   printfQuda("running the following test:\n");
  
-  printfQuda("prec recon   test_type     dagger   S_dim         T_dimension   dslash_type niter\n");
-  printfQuda("%s   %s       %d           %d       %d/%d/%d        %d            %s   %d\n", 
-	     get_prec_str(prec), get_recon_str(link_recon), 
+  printfQuda("prec recon   cpu_recon   test_type     dagger   S_dim         T_dimension   dslash_type niter\n");
+  printfQuda("%s   %s       %s          %d           %d       %d/%d/%d        %d            %s   %d\n", 
+	     get_prec_str(prec), get_recon_str(link_recon), get_recon_str(cpu_link_recon),
 	     test_type, dagger, xdim, ydim, zdim, tdim, 
 	     get_dslash_type_str(dslash_type), niter);
   printfQuda("Grid partition info:     X  Y  Z  T\n"); 
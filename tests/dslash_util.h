@@ -93,7 +93,7 @@ static inline void su3Tmul(sFloat *res, gFloat *mat, sFloat *vec) {
 
 
 template <typename Float>
-static inline Float *gaugeLink(int i, int dir, int oddBit, Float **gaugeEven, Float **gaugeOdd, int nbr_distance) {
+static inline Float *gaugeLink(int i, int dir, int oddBit, Float **gaugeEven, Float **gaugeOdd, int nbr_distance, int site_size=gaugeSiteSize) {
   Float **gaugeField;
   int j;
   int d = nbr_distance;
@@ -112,7 +112,7 @@ static inline Float *gaugeLink(int i, int dir, int oddBit, Float **gaugeEven, Fl
     gaugeField = (oddBit ? gaugeEven : gaugeOdd);
   }
   
-  return &gaugeField[dir/2][j*(3*3*2)];
+  return &gaugeField[dir/2][j*site_size];
 }
 
 template <typename Float>
@@ -148,7 +148,8 @@ x4_mg(int i, int oddBit)
 
 template <typename Float>
 static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeEven, Float **gaugeOdd,
-			Float** ghostGaugeEven, Float** ghostGaugeOdd, int n_ghost_faces, int nbr_distance) {
+			Float** ghostGaugeEven, Float** ghostGaugeOdd, int n_ghost_faces, int nbr_distance,
+			int site_size=gaugeSiteSize) {
   Float **gaugeField;
   int j;
   int d = nbr_distance;
@@ -176,7 +177,7 @@ static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeE
         if (x1 -d < 0){
 	  ghostGaugeField = (oddBit?ghostGaugeEven[0]: ghostGaugeOdd[0]);
 	  int offset = (n_ghost_faces + x1 -d)*X4*X3*X2/2 + (x4*X3*X2 + x3*X2+x2)/2;
-	  return &ghostGaugeField[offset*(3*3*2)];
+	  return &ghostGaugeField[offset*site_size];
         }
         j = (x4*X3*X2*X1 + x3*X2*X1 + x2*X1 + new_x1) / 2;
         break;
@@ -187,7 +188,7 @@ static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeE
         if (x2 -d < 0){
           ghostGaugeField = (oddBit?ghostGaugeEven[1]: ghostGaugeOdd[1]);
           int offset = (n_ghost_faces + x2 -d)*X4*X3*X1/2 + (x4*X3*X1 + x3*X1+x1)/2;
-          return &ghostGaugeField[offset*(3*3*2)];
+          return &ghostGaugeField[offset*site_size];
         }
         j = (x4*X3*X2*X1 + x3*X2*X1 + new_x2*X1 + x1) / 2;
         break;
@@ -199,7 +200,7 @@ static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeE
         if (x3 -d < 0){
           ghostGaugeField = (oddBit?ghostGaugeEven[2]: ghostGaugeOdd[2]);
           int offset = (n_ghost_faces + x3 -d)*X4*X2*X1/2 + (x4*X2*X1 + x2*X1+x1)/2;
-          return &ghostGaugeField[offset*(3*3*2)];
+          return &ghostGaugeField[offset*site_size];
         }
         j = (x4*X3*X2*X1 + new_x3*X2*X1 + x2*X1 + x1) / 2;
         break;
@@ -210,7 +211,7 @@ static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeE
         if (x4 -d < 0){
           ghostGaugeField = (oddBit?ghostGaugeEven[3]: ghostGaugeOdd[3]);
           int offset = (n_ghost_faces + x4 -d)*X1*X2*X3/2 + (x3*X2*X1 + x2*X1+x1)/2;
-          return &ghostGaugeField[offset*(3*3*2)];
+          return &ghostGaugeField[offset*site_size];
         }
         j = (new_x4*(X3*X2*X1) + x3*(X2*X1) + x2*(X1) + x1) / 2;
         break;
@@ -222,7 +223,7 @@ static inline Float *gaugeLink_mg4dir(int i, int dir, int oddBit, Float **gaugeE
 
   }
 
-  return &gaugeField[dir/2][j*(3*3*2)];
+  return &gaugeField[dir/2][j*site_size];
 }
 
 template <typename Float>
@@ -8,11 +8,11 @@
 #include "misc.h"
 #include "gauge_force_reference.h"
 
-extern int Z[4];
-extern int V;
-extern int Vh;
-extern int Vh_ex;
-extern int E[4];
+extern COMM_RANK_LOCAL int Z[4];
+extern COMM_RANK_LOCAL int V;
+extern COMM_RANK_LOCAL int Vh;
+extern COMM_RANK_LOCAL int Vh_ex;
+extern COMM_RANK_LOCAL int E[4];
 
 
 #define CADD(a,b,c) { (c).real = (a).real + (b).real;	\
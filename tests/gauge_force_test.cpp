@@ -34,17 +34,17 @@ extern bool tune;
 
 int attempts = 1;
 
-int Z[4];
-int V;
-int Vh;
+COMM_RANK_LOCAL int Z[4];
+COMM_RANK_LOCAL int V;
+COMM_RANK_LOCAL int Vh;
 
-int V_ex;
-int Vh_ex;
+COMM_RANK_LOCAL int V_ex;
+COMM_RANK_LOCAL int Vh_ex;
 
 static int X1, X1h, X2, X3, X4;
 static int E1, E1h, E2, E3, E4;
 
-int E[4];
+COMM_RANK_LOCAL int E[4];
 
 extern QudaReconstructType link_recon;
 QudaPrecision  link_prec = QUDA_SINGLE_PRECISION;
@@ -4,9 +4,13 @@
 #ifdef HAVE_QIO
 void read_gauge_field(char *filename, void *gauge[], QudaPrecision prec, int *X, int argc, char *argv[]);
 #else
+// without QIO, NERSC, ILDG and MILC files are read by the library
 void read_gauge_field(char *filename, void *gauge[], QudaPrecision prec, int *X, int argc, char *argv[]) {
-  printf("QIO support has not been enabled\n");
-  exit(-1);
+  QudaGaugeParam param = newQudaGaugeParam();
+  for (int d=0; d<4; d++) param.X[d] = X[d];
+  param.cpu_prec = prec;
+  param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+  readGaugeFileQuda(gauge, &param, filename);
 }
 #endif
 
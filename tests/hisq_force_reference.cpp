@@ -8,9 +8,9 @@
 #include "misc.h"
 #include "hisq_force_reference.h"
 
-extern int Z[4];
-extern int V;
-extern int Vh;
+extern COMM_RANK_LOCAL int Z[4];
+extern COMM_RANK_LOCAL int V;
+extern COMM_RANK_LOCAL int Vh;
 
 
 #define CADD(a,b,c) { (c).real = (a).real + (b).real;	\
@@ -12,8 +12,8 @@
 #define RETURN_IF_ERR if(err) return;
 
 extern int gauge_order;
-extern int Vh;
-extern int Vh_ex;
+extern COMM_RANK_LOCAL int Vh;
+extern COMM_RANK_LOCAL int Vh_ex;
 
   static int OPP_DIR(int dir){ return 7-dir; }
   static bool GOES_FORWARDS(int dir){ return (dir<=3); }
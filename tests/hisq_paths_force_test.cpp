@@ -86,15 +86,15 @@ static void setPrecision(QudaPrecision precision)
   return;
 }
 
-int Z[4];
-int V;
-int Vh;
-int V_ex;
-int Vh_ex;
+COMM_RANK_LOCAL int Z[4];
+COMM_RANK_LOCAL int V;
+COMM_RANK_LOCAL int Vh;
+COMM_RANK_LOCAL int V_ex;
+COMM_RANK_LOCAL int Vh_ex;
 
 static int X1, X1h, X2, X3, X4;
 static int E1, E1h, E2, E3, E4;
-int E[4];
+COMM_RANK_LOCAL int E[4];
 
 
 void
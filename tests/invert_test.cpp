@@ -3,6 +3,7 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <util_quda.h>
 #include <test_util.h>
@@ -43,6 +44,14 @@ extern char latfile[];
 
 extern void usage(char** );
 
+// the length of the sequence of solves with chronological initial
+// guesses run after the main test (0 = none)
+static int chrono_window = 0;
+
+// the checkpoint interval of the interrupted multi-shift solve run
+// after the main test (0 = none)
+static int checkpoint_interval = 0;
+
 void
 display_test_info()
 {
@@ -65,6 +74,437 @@ display_test_info()
   
 }
 
+void
+usage_extra(char** argv )
+{
+  printfQuda("Extra options:\n");
+  printfQuda("    --chrono-window <n>                      # Also solve a sequence of perturbed sources with chronological\n"
+	     "                                               initial guesses from the last n solutions (default 0 = no)\n");
+  printfQuda("    --checkpoint <n>                         # Also interrupt a multi-shift solve after n iterations and resume it\n"
+	     "                                               from its checkpoint (default 0 = no)\n");
+  return ;
+}
+
+static void matpc(void *out, void **gauge, void *in, int dagger, QudaInvertParam &inv_param,
+		  QudaGaugeParam &gauge_param, double kappa5)
+{
+  if (dslash_type == QUDA_TWISTED_MASS_DSLASH) {
+    tm_matpc(out, gauge, in, inv_param.kappa, inv_param.mu, inv_param.twist_flavor,
+	     inv_param.matpc_type, dagger, inv_param.cpu_prec, gauge_param);
+  } else if (dslash_type == QUDA_WILSON_DSLASH || dslash_type == QUDA_CLOVER_WILSON_DSLASH) {
+    wil_matpc(out, gauge, in, inv_param.kappa, inv_param.matpc_type, dagger, inv_param.cpu_prec, gauge_param);
+  } else {
+    dw_matpc(out, gauge, in, kappa5, inv_param.matpc_type, dagger, inv_param.cpu_prec, gauge_param, inv_param.mass);
+  }
+}
+
+// the true relative residual of the preconditioned system solved for
+// x, |b - M x| / |b|, or |M^dag (b - M x)| / |M^dag b| for the normal
+// equations
+static double matpcResidual(void *x, void *b, bool normal, void **gauge, QudaInvertParam &inv_param,
+			    QudaGaugeParam &gauge_param, double kappa5)
+{
+  const int len = Vh*spinorSiteSize*inv_param.Ls;
+  const size_t sSize = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION) ? sizeof(double) : sizeof(float);
+  void *r = malloc(len*sSize);
+  void *tmp = malloc(len*sSize);
+
+  matpc(r, gauge, x, 0, inv_param, gauge_param, kappa5);
+  mxpy(b, r, len, inv_param.cpu_prec);
+
+  double res;
+  if (normal) {
+    matpc(tmp, gauge, r, 1, inv_param, gauge_param, kappa5);
+    res = norm_2(tmp, len, inv_param.cpu_prec);
+    matpc(tmp, gauge, b, 1, inv_param, gauge_param, kappa5);
+    res = sqrt(res / norm_2(tmp, len, inv_param.cpu_prec));
+  } else {
+    res = sqrt(norm_2(r, len, inv_param.cpu_prec) / norm_2(b, len, inv_param.cpu_prec));
+  }
+
+  free(tmp);
+  free(r);
+  return res;
+}
+
+// Solves a sequence of sources that differ from the point source by
+// small random perturbations, with the initial guess of each
+// extrapolated from the solutions of the last chrono_window, with CG
+// and (except for domain wall) BiCGstab and GCR.  Every solve after
+// the first must take fewer iterations than the first, which starts
+// from zero, and reach the requested tolerance.
+static int chronoTest(void **gauge, QudaInvertParam &inv_param, QudaGaugeParam &gauge_param, double kappa5)
+{
+  const int len = Vh*spinorSiteSize*inv_param.Ls;
+  const size_t sSize = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION) ? sizeof(double) : sizeof(float);
+  const double perturbation = 1e-2; // relative to the norm of the point source
+  const int n_solve = chrono_window + 2;
+  const int tag = 1;
+
+  void *src = malloc(len*sSize);
+  void *b = malloc(len*sSize);
+  void *x = malloc(len*sSize);
+
+  const QudaInverterType inv_type[] = { QUDA_CG_INVERTER, QUDA_BICGSTAB_INVERTER, QUDA_GCR_INVERTER };
+  const char *inv_str[] = { "CG", "BiCGstab", "GCR" };
+  const int n_inv = (dslash_type == QUDA_DOMAIN_WALL_DSLASH) ? 1 : 3;
+
+  const QudaVerbosity verbosity = inv_param.verbosity;
+  inv_param.verbosity = QUDA_SUMMARIZE;
+  inv_param.chrono_window = chrono_window;
+  inv_param.chrono_tag = tag;
+
+  int fail = 0;
+  for (int s=0; s<n_inv; s++) {
+    inv_param.inv_type = inv_type[s];
+    inv_param.solve_type = (inv_type[s] == QUDA_CG_INVERTER) ? QUDA_NORMEQ_PC_SOLVE : QUDA_DIRECT_PC_SOLVE;
+    flushChronoQuda(tag);
+
+    int iter0 = 0;
+    for (int k=0; k<n_solve; k++) {
+      for (int i=0; i<len; i++) {
+	double value = (i == 0 ? 1.0 : 0.0) + perturbation * (2.0*rand()/RAND_MAX - 1.0) / sqrt((double)len);
+	if (inv_param.cpu_prec == QUDA_SINGLE_PRECISION) ((float*)b)[i] = value;
+	else ((double*)b)[i] = value;
+      }
+      memcpy(src, b, len*sSize);
+      memset(x, 0, len*sSize);
+
+      invertQuda(x, src, &inv_param);
+
+      const double res = matpcResidual(x, b, inv_param.inv_type == QUDA_CG_INVERTER, gauge, inv_param, gauge_param, kappa5);
+      if (k == 0) iter0 = inv_param.iter;
+      printfQuda("Chrono %s solve %d: %d iter, relative residual: requested = %g, actual = %g\n",
+		 inv_str[s], k, inv_param.iter, inv_param.tol, res);
+
+      // the solvers stop on the iterated residual, which in the sloppy
+      // precision drifts a little from the true one
+      if (res > 2*inv_param.tol) {
+	printfQuda("Chrono %s solve %d: the true residual %g exceeds the tolerance %g\n", inv_str[s], k, res, inv_param.tol);
+	fail++;
+      }
+      if (k > 0 && inv_param.iter >= iter0) {
+	printfQuda("Chrono %s solve %d: the guess from %d solutions did not reduce the %d iterations from zero\n",
+		   inv_str[s], k, k < chrono_window ? k : chrono_window, iter0);
+	fail++;
+      }
+    }
+  }
+
+  flushChronoQuda(tag);
+  inv_param.chrono_window = 0;
+  inv_param.verbosity = verbosity;
+
+  free(x);
+  free(b);
+  free(src);
+
+  printfQuda("Chrono test %s\n", fail ? "FAILED" : "PASSED");
+  return fail;
+}
+
+// telemetry callback that records the first iteration of the solve
+static void firstIteration(const QudaSolverEvent *event, void *arg)
+{
+  int *first = (int*)arg;
+  if (event->type == QUDA_SOLVER_ITERATION && *first == 0) *first = event->iter;
+}
+
+// a multi-shift CG solve of src, starting from zero, with each shift
+// solved to inv_param.tol; returns the first iteration it performed
+static int multiShiftSolve(void **x, void *src, double *offsets, int num_offsets, QudaInvertParam &inv_param)
+{
+  const int len = Vh*spinorSiteSize*inv_param.Ls;
+  const size_t sSize = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION) ? sizeof(double) : sizeof(float);
+
+  void *b = malloc(len*sSize);
+  memcpy(b, src, len*sSize);
+  for (int i=0; i<num_offsets; i++) memset(x[i], 0, len*sSize);
+
+  int first = 0;
+  inv_param.telemetry_callback = firstIteration;
+  inv_param.telemetry_arg = &first;
+
+  double resid_sq[QUDA_MAX_MULTI_SHIFT];
+  for (int i=0; i<num_offsets; i++) resid_sq[i] = inv_param.tol;
+  invertMultiShiftQuda(x, b, &inv_param, offsets, num_offsets, resid_sq);
+
+  inv_param.telemetry_callback = NULL;
+  inv_param.telemetry_arg = NULL;
+  free(b);
+  return first;
+}
+
+// Interrupts a multi-shift CG solve at maxiter = checkpoint_interval,
+// where it writes a checkpoint, and resumes it.  The resumed solve
+// must start from the iteration after the checkpoint, end after as
+// many iterations as an uninterrupted solve of the same system and
+// reach the same solutions.  In between, a solve with different
+// shifts must reject the checkpoint and start from the first
+// iteration, and the checkpoint must be removed once the resumed
+// solve has converged.
+static int checkpointTest(void *src, double *offsets, int num_offsets, QudaInvertParam &inv_param)
+{
+  const int len = Vh*spinorSiteSize*inv_param.Ls;
+  const size_t sSize = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION) ? sizeof(double) : sizeof(float);
+  const int n = checkpoint_interval;
+
+  void *ref[QUDA_MAX_MULTI_SHIFT], *x[QUDA_MAX_MULTI_SHIFT];
+  for (int i=0; i<num_offsets; i++) {
+    ref[i] = malloc(len*sSize);
+    x[i] = malloc(len*sSize);
+  }
+
+  QudaInvertParam param = inv_param;
+  param.inv_type = QUDA_CG_INVERTER;
+  param.solve_type = QUDA_NORMEQ_PC_SOLVE;
+  param.verbosity = QUDA_SUMMARIZE;
+  param.telemetry_buffer = NULL;
+  snprintf(param.checkpoint_path, sizeof(param.checkpoint_path), "invert_test_checkpoint");
+
+  char filename[512];
+#ifdef MULTI_GPU
+  snprintf(filename, sizeof(filename), "%s.%d", param.checkpoint_path, comm_rank());
+#else
+  snprintf(filename, sizeof(filename), "%s.0", param.checkpoint_path);
+#endif
+  unlink(filename);
+
+  int fail = 0;
+
+  // the uninterrupted solve
+  param.checkpoint_interval = 0;
+  multiShiftSolve(ref, src, offsets, num_offsets, param);
+  const int iter = param.iter;
+  printfQuda("Checkpoint: uninterrupted solve took %d iter\n", iter);
+  if (iter <= n) {
+    printfQuda("Checkpoint: the solve converges within the interval of %d iterations\n", n);
+    fail++;
+  }
+
+  // interrupted by maxiter, which leaves the checkpoint of iteration n
+  param.checkpoint_interval = n;
+  param.maxiter = n;
+  multiShiftSolve(x, src, offsets, num_offsets, param);
+  if (access(filename, F_OK) != 0) {
+    printfQuda("Checkpoint: the interrupted solve left no checkpoint %s\n", filename);
+    fail++;
+  }
+
+  // the checkpoint belongs to other shifts, so this starts from scratch;
+  // one iteration neither converges nor is due for a checkpoint, so the
+  // one on disk is left alone
+  double wrong_offsets[QUDA_MAX_MULTI_SHIFT];
+  for (int i=0; i<num_offsets; i++) wrong_offsets[i] = 2.0*offsets[i];
+  param.checkpoint_interval = 2;
+  param.maxiter = 1;
+  int first = multiShiftSolve(x, src, wrong_offsets, num_offsets, param);
+  printfQuda("Checkpoint: solve with other shifts started from iteration %d\n", first);
+  if (first != 1) {
+    printfQuda("Checkpoint: the checkpoint of other shifts was not rejected\n");
+    fail++;
+  }
+
+  // resumed from the checkpoint
+  param.checkpoint_interval = n;
+  param.maxiter = inv_param.maxiter;
+  first = multiShiftSolve(x, src, offsets, num_offsets, param);
+  printfQuda("Checkpoint: resumed solve started from iteration %d and took %d iter in total\n", first, param.iter);
+  if (first != n+1) {
+    printfQuda("Checkpoint: the resumed solve did not start from iteration %d\n", n+1);
+    fail++;
+  }
+  // the reductions after the restart may be summed in a different
+  // order, which can move convergence by an iteration
+  if (abs(param.iter - iter) > 1) {
+    printfQuda("Checkpoint: the resumed solve took %d iter, the uninterrupted one %d\n", param.iter, iter);
+    fail++;
+  }
+  if (access(filename, F_OK) == 0) {
+    printfQuda("Checkpoint: %s was not removed after the solve converged\n", filename);
+    fail++;
+  }
+
+  for (int i=0; i<num_offsets; i++) {
+    double ref2 = norm_2(ref[i], len, inv_param.cpu_prec);
+    mxpy(ref[i], x[i], len, inv_param.cpu_prec);
+    double diff = sqrt(norm_2(x[i], len, inv_param.cpu_prec) / ref2);
+    printfQuda("Checkpoint: shift %d, resumed and uninterrupted solutions differ by %e\n", i, diff);
+    if (diff > inv_param.tol) fail++;
+  }
+
+  unlink(filename);
+  for (int i=0; i<num_offsets; i++) {
+    free(x[i]);
+    free(ref[i]);
+  }
+
+  printfQuda("Checkpoint test %s\n", fail ? "FAILED" : "PASSED");
+  return fail;
+}
+
+// every event of a solve, as seen by the telemetry callback
+struct TelemetryLog {
+  QudaSolverEvent *event;
+  int size;
+  int count;
+};
+
+static void logEvent(const QudaSolverEvent *event, void *arg)
+{
+  TelemetryLog *log = (TelemetryLog*)arg;
+  if (log->count < log->size) log->event[log->count] = *event;
+  log->count++;
+}
+
+static bool sameEvent(const QudaSolverEvent &a, const QudaSolverEvent &b)
+{
+  return a.type == b.type && a.iter == b.iter && a.r2 == b.r2 && a.time == b.time;
+}
+
+// Solves the point source with CG and (except for domain wall)
+// BiCGstab and GCR, recording the telemetry both in a ring buffer too
+// small for the solve and through the callback.  The buffer must hold
+// the last events the callback saw, each at its slot of the ring, and
+// nothing outside it; the iterations must never go back; and the
+// final event must be the end of the solve, after inv_param.iter
+// iterations at the residual inv_param.iter_res reports, with
+// inv_param.true_res that of the host operator.
+static int telemetryTest(void **gauge, QudaInvertParam &inv_param, QudaGaugeParam &gauge_param, double kappa5)
+{
+  const int len = Vh*spinorSiteSize*inv_param.Ls;
+  const size_t sSize = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION) ? sizeof(double) : sizeof(float);
+  const int ring = 8;
+  const bool exact = (inv_param.cpu_prec == QUDA_DOUBLE_PRECISION && inv_param.cuda_prec == QUDA_DOUBLE_PRECISION);
+  const double eps = exact ? 1e-10 : 1e-4;
+
+  void *src = malloc(len*sSize);
+  void *b = malloc(len*sSize);
+  void *x = malloc(len*sSize);
+  void *tmp = malloc(len*sSize);
+
+  const QudaInverterType inv_type[] = { QUDA_CG_INVERTER, QUDA_BICGSTAB_INVERTER, QUDA_GCR_INVERTER };
+  const char *inv_str[] = { "CG", "BiCGstab", "GCR" };
+  const int n_inv = (dslash_type == QUDA_DOMAIN_WALL_DSLASH) ? 1 : 3;
+
+  QudaInvertParam param = inv_param;
+  param.verbosity = QUDA_SUMMARIZE;
+  param.checkpoint_interval = 0;
+
+  // one more slot than the ring, which must stay untouched
+  QudaSolverEvent buffer[ring+1];
+  param.telemetry_buffer = buffer;
+  param.telemetry_size = ring;
+
+  TelemetryLog log;
+  log.size = 2*(param.maxiter+1); // an iteration and a reliable update each, and the end
+  log.event = (QudaSolverEvent*)malloc(log.size*sizeof(QudaSolverEvent));
+  param.telemetry_callback = logEvent;
+  param.telemetry_arg = &log;
+
+  int fail = 0;
+  for (int s=0; s<n_inv; s++) {
+    // the host reference of the normal equations has no clover term
+    if (inv_type[s] == QUDA_CG_INVERTER && dslash_type == QUDA_CLOVER_WILSON_DSLASH) continue;
+
+    param.inv_type = inv_type[s];
+    param.solve_type = (inv_type[s] == QUDA_CG_INVERTER) ? QUDA_NORMEQ_PC_SOLVE : QUDA_DIRECT_PC_SOLVE;
+    const bool normal = (param.solve_type == QUDA_NORMEQ_PC_SOLVE);
+
+    memset(b, 0, len*sSize);
+    if (inv_param.cpu_prec == QUDA_SINGLE_PRECISION) *((float*)b) = 1.0;
+    else *((double*)b) = 1.0;
+    memcpy(src, b, len*sSize);
+    memset(x, 0, len*sSize);
+
+    QudaSolverEvent guard;
+    guard.type = QUDA_SOLVER_DONE;
+    guard.iter = -1;
+    guard.r2 = -1.0;
+    guard.time = -1.0;
+    buffer[ring] = guard;
+    log.count = 0;
+
+    invertQuda(x, src, &param);
+
+    const int count = param.telemetry_count;
+    int wrong = 0;
+
+    if (count != log.count || count > log.size) {
+      printfQuda("Telemetry %s: %d events recorded, %d seen by the callback\n", inv_str[s], count, log.count);
+      fail++;
+      continue;
+    }
+
+    // the solve must overrun the ring for it to wrap
+    if (count <= ring) {
+      printfQuda("Telemetry %s: only %d events, which do not wrap the buffer of %d\n", inv_str[s], count, ring);
+      fail++;
+    }
+    for (int i=(count > ring ? count-ring : 0); i<count; i++) {
+      if (!sameEvent(buffer[i % ring], log.event[i])) wrong++;
+    }
+    if (!sameEvent(buffer[ring], guard)) wrong++;
+    if (wrong) {
+      printfQuda("Telemetry %s: %d slots of the ring buffer do not hold the last events\n", inv_str[s], wrong);
+      fail++;
+    }
+
+    // the iterations and times never go back, and each iteration is a new one
+    int last_iteration = 0, backwards = 0;
+    for (int i=0; i<count; i++) {
+      const QudaSolverEvent &e = log.event[i];
+      if (i > 0 && (e.iter < log.event[i-1].iter || e.time < log.event[i-1].time)) backwards++;
+      if (e.type == QUDA_SOLVER_ITERATION) {
+	if (e.iter <= last_iteration) backwards++;
+	last_iteration = e.iter;
+      }
+    }
+    if (backwards) {
+      printfQuda("Telemetry %s: %d events go back in iterations or time\n", inv_str[s], backwards);
+      fail++;
+    }
+
+    // the source the device solved, b or M^dag b
+    double b2;
+    if (normal) {
+      matpc(tmp, gauge, b, 1, param, gauge_param, kappa5);
+      b2 = norm_2(tmp, len, param.cpu_prec);
+    } else {
+      b2 = norm_2(b, len, param.cpu_prec);
+    }
+
+    const QudaSolverEvent &last = buffer[(count-1) % ring];
+    const double iter_res = sqrt(last.r2 / b2);
+    const double true_res = matpcResidual(x, b, normal, gauge, param, gauge_param, kappa5);
+    printfQuda("Telemetry %s: %d events, last %d iter, residual %e (iter_res %e), %d iter reported, true_res %e (host %e)\n",
+	       inv_str[s], count, last.iter, iter_res, param.iter_res, param.iter, param.true_res, true_res);
+
+    if (last.type != QUDA_SOLVER_DONE || last.iter != param.iter) {
+      printfQuda("Telemetry %s: the last event is not the end of the solve after %d iterations\n", inv_str[s], param.iter);
+      fail++;
+    }
+    if (fabs(iter_res - param.iter_res) > eps*param.iter_res) {
+      printfQuda("Telemetry %s: the final residual %e differs from iter_res %e\n", inv_str[s], iter_res, param.iter_res);
+      fail++;
+    }
+    // the host and device operators round differently
+    if (fabs(true_res - param.true_res) > 0.1*true_res + (exact ? 1e-12 : 1e-6)) {
+      printfQuda("Telemetry %s: true_res %e differs from the host residual %e\n", inv_str[s], param.true_res, true_res);
+      fail++;
+    }
+  }
+
+  free(log.event);
+  free(tmp);
+  free(x);
+  free(b);
+  free(src);
+
+  printfQuda("Telemetry test %s\n", fail ? "FAILED" : "PASSED");
+  return fail;
+}
+
 int main(int argc, char **argv)
 {
   int i;
@@ -72,6 +512,20 @@ int main(int argc, char **argv)
     if(process_command_line_option(argc, argv, &i) == 0){
       continue;
     } 
+    if (strcmp(argv[i], "--chrono-window") == 0) {
+      if (i+1 >= argc) usage(argv);
+      chrono_window = atoi(argv[i+1]);
+      if (chrono_window < 0) usage(argv);
+      i++;
+      continue;
+    }
+    if (strcmp(argv[i], "--checkpoint") == 0) {
+      if (i+1 >= argc) usage(argv);
+      checkpoint_interval = atoi(argv[i+1]);
+      if (checkpoint_interval < 0) usage(argv);
+      i++;
+      continue;
+    }
     printfQuda("ERROR: Invalid option:%s\n", argv[i]);
     usage(argv);
   }
@@ -296,10 +750,17 @@ int main(int argc, char **argv)
   // load the clover term, if desired
   if (dslash_type == QUDA_CLOVER_WILSON_DSLASH) loadCloverQuda(clover, clover_inv, &inv_param);
   
+  // record the convergence history
+  QudaSolverEvent telemetry[256];
+  inv_param.telemetry_buffer = telemetry;
+  inv_param.telemetry_size = 256;
+
   // perform the inversion
   if (multi_shift) {
-    double resid_sq;
-    invertMultiShiftQuda(spinorOutMulti, spinorIn, &inv_param, offsets, num_offsets, &resid_sq);
+    // each shift is retired at its own tolerance
+    double resid_sq[QUDA_MAX_MULTI_SHIFT];
+    for (int i=0; i<num_offsets; i++) resid_sq[i] = inv_param.tol;
+    invertMultiShiftQuda(spinorOutMulti, spinorIn, &inv_param, offsets, num_offsets, resid_sq);
   } else {
     invertQuda(spinorOut, spinorIn, &inv_param);
   }
@@ -314,6 +775,17 @@ int main(int argc, char **argv)
   printfQuda("\nDone: %i iter / %g secs = %g Gflops, total time = %g secs\n", 
 	 inv_param.iter, inv_param.secs, inv_param.gflops/inv_param.secs, time0);
 
+  int reliable_updates = 0;
+  for (int i=0; i<inv_param.telemetry_count && i<inv_param.telemetry_size; i++) {
+    if (telemetry[i].type == QUDA_SOLVER_RELIABLE_UPDATE) reliable_updates++;
+  }
+  if (inv_param.telemetry_count > 0) {
+    const QudaSolverEvent &last = telemetry[(inv_param.telemetry_count-1) % inv_param.telemetry_size];
+    printfQuda("Telemetry: %d events, %d reliable updates in the last %d, r2 = %e after %d iter / %g secs\n",
+	       inv_param.telemetry_count, reliable_updates, inv_param.telemetry_size < inv_param.telemetry_count ?
+	       inv_param.telemetry_size : inv_param.telemetry_count, last.r2, last.iter, last.time);
+  }
+
   if (multi_shift) {
 
     void *spinorTmp = malloc(V*spinorSiteSize*sSize*inv_param.Ls);
@@ -401,6 +873,11 @@ int main(int argc, char **argv)
     
   }
 
+  int fail = 0;
+  if (!multi_shift) fail += telemetryTest(gauge, inv_param, gauge_param, kappa5);
+  if (chrono_window > 0 && !multi_shift) fail += chronoTest(gauge, inv_param, gauge_param, kappa5);
+  if (checkpoint_interval > 0) fail += checkpointTest(spinorIn, offsets, num_offsets, inv_param);
+
   freeGaugeQuda();
   if (dslash_type == QUDA_CLOVER_WILSON_DSLASH) freeCloverQuda();
 
@@ -410,5 +887,5 @@ int main(int argc, char **argv)
   // finalize the communications layer
   endCommsQuda();
 
-  return 0;
+  return fail;
 }
@@ -0,0 +1,766 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <quda.h>
+#include <comm_quda.h>
+#include <face_quda.h>
+#include <parallel_io.h>
+#include <gauge_io.h>
+#include <test_util.h>
+
+// Round trips of the partitioned parallel I/O: every rank writes its
+// sublattice of a random gauge field and spinor field into shared
+// files and reads them back, and the checksums of what was written
+// and what was read must agree on every rank.  This is done with the
+// default transfer (MPI-IO with MPI comms), with the pread()/pwrite()
+// fallback forced, and with a file written by one and read by the
+// other.  The asynchronous solution writer is checked the same way:
+// more solutions are queued than it has buffers, and the blocks of its
+// RAW and LIME files must hold what writeSpinorFileQuda() writes, with
+// the checksums that the files record.  Last, propagators are stored
+// with 16- and 8-bit mantissas, for 4 spins and 1 (staggered): the
+// error at every site must be within the documented half unit in the
+// last place relative to the site's norm, and the padding of the site
+// blocks must be zero.  The gauge reader is also given configurations
+// generated here in every format it reads: NERSC with 3x3 and 2-row
+// links, ILDG, and MILC, in both precisions and byte orders, with
+// checksums computed here independently of lib/.  The links read must
+// match, including the completed third rows, and a file whose
+// recorded checksum is corrupted must be rejected.  With
+// --enable-thread-comms the ranks are threads of this process, so no
+// MPI installation is needed.
+
+extern int xdim;
+extern int ydim;
+extern int zdim;
+extern int tdim;
+extern int gridsize_from_cmdline[];
+extern void usage(char**);
+
+static const char *gauge_file = "io_test_gauge.nersc";
+static const char *gauge_format_file = "io_test_gauge.dat";
+static const char *spinor_file = "io_test_spinor.dat";
+static const char *solution_file = "io_test_solution";
+static const char *propagator_file = "io_test_propagator.dat";
+
+// random SU(3) matrix: Gram-Schmidt on two random rows, the third
+// row is conj(row0 x row1)
+static void random_su3(double *U, unsigned int *seed)
+{
+  for (int j=0; j<12; j++) U[j] = rand_r(seed) / (double)RAND_MAX - 0.5;
+
+  double n0 = 0.0;
+  for (int j=0; j<6; j++) n0 += U[j]*U[j];
+  for (int j=0; j<6; j++) U[j] /= sqrt(n0);
+
+  double re = 0.0, im = 0.0; // <row0, row1>
+  for (int c=0; c<3; c++) {
+    re += U[2*c]*U[6+2*c] + U[2*c+1]*U[6+2*c+1];
+    im += U[2*c]*U[6+2*c+1] - U[2*c+1]*U[6+2*c];
+  }
+  for (int c=0; c<3; c++) {
+    U[6+2*c] -= re*U[2*c] - im*U[2*c+1];
+    U[6+2*c+1] -= re*U[2*c+1] + im*U[2*c];
+  }
+  double n1 = 0.0;
+  for (int j=6; j<12; j++) n1 += U[j]*U[j];
+  for (int j=6; j<12; j++) U[j] /= sqrt(n1);
+
+  for (int c=0; c<3; c++) {
+    int a = (c+1)%3, b = (c+2)%3;
+    double *r0 = U, *r1 = U+6;
+    U[12+2*c] = r0[2*a]*r1[2*b] - r0[2*a+1]*r1[2*b+1] - (r0[2*b]*r1[2*a] - r0[2*b+1]*r1[2*a+1]);
+    U[12+2*c+1] = -(r0[2*a]*r1[2*b+1] + r0[2*a+1]*r1[2*b] - (r0[2*b]*r1[2*a+1] + r0[2*b+1]*r1[2*a]));
+  }
+}
+
+// the checksum of n arrays of bytes each, and its sum over the ranks
+static unsigned int checksum(void **field, int n, size_t bytes, double *global)
+{
+  unsigned int crc_table[256];
+  initCrcTable(crc_table);
+  unsigned int crc = 0;
+  for (int i=0; i<n; i++) crc += scidacCrc32(crc_table, field[i], bytes);
+
+  *global = crc;
+  comm_allreduce(global);
+  return crc;
+}
+
+static int check_gauge(int volume, unsigned int *seed, bool write_posix, bool read_posix)
+{
+  QudaGaugeParam param = newQudaGaugeParam();
+  param.X[0] = xdim;
+  param.X[1] = ydim;
+  param.X[2] = zdim;
+  param.X[3] = tdim;
+  param.cpu_prec = QUDA_DOUBLE_PRECISION;
+  param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+
+  const size_t bytes = volume*18*sizeof(double);
+  void *gauge[4], *gauge_read[4];
+  for (int mu=0; mu<4; mu++) {
+    gauge[mu] = malloc(bytes);
+    gauge_read[mu] = malloc(bytes);
+    for (int i=0; i<volume; i++) random_su3((double*)gauge[mu] + 18*i, seed);
+  }
+
+  setPosixSublatticeIO(write_posix);
+  writeGaugeFileQuda(gauge, &param, gauge_file);
+  setPosixSublatticeIO(read_posix);
+  readGaugeFileQuda(gauge_read, &param, gauge_file);
+
+  double sum_written, sum_read;
+  const unsigned int crc_written = checksum(gauge, 4, bytes, &sum_written);
+  const unsigned int crc_read = checksum(gauge_read, 4, bytes, &sum_read);
+  int faults = (crc_read != crc_written) ? 1 : 0;
+
+  if (comm_rank() == 0) {
+    printf("Gauge field written with %s, read with %s: checksum %.0f, read back %.0f\n",
+	   write_posix ? "pwrite" : "the default", read_posix ? "pread" : "the default", sum_written, sum_read);
+  }
+
+  for (int mu=0; mu<4; mu++) {
+    free(gauge_read[mu]);
+    free(gauge[mu]);
+  }
+
+  return faults;
+}
+
+static int check_spinor(int volume, unsigned int *seed, bool write_posix, bool read_posix)
+{
+  QudaInvertParam param = newQudaInvertParam();
+  param.dslash_type = QUDA_WILSON_DSLASH;
+  param.cpu_prec = QUDA_DOUBLE_PRECISION;
+  param.dirac_order = QUDA_DIRAC_ORDER;
+  param.gamma_basis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.verbosity = QUDA_SILENT;
+  const int X[4] = { xdim, ydim, zdim, tdim };
+
+  const size_t bytes = volume*24*sizeof(double);
+  void *spinor = malloc(bytes);
+  void *spinor_read = malloc(bytes);
+  for (int i=0; i<volume*24; i++) ((double*)spinor)[i] = rand_r(seed) / (double)RAND_MAX - 0.5;
+
+  setPosixSublatticeIO(write_posix);
+  writeSpinorFileQuda(spinor, &param, X, spinor_file);
+  setPosixSublatticeIO(read_posix);
+  readSpinorFileQuda(spinor_read, &param, X, spinor_file);
+
+  double sum_written, sum_read;
+  const unsigned int crc_written = checksum(&spinor, 1, bytes, &sum_written);
+  const unsigned int crc_read = checksum(&spinor_read, 1, bytes, &sum_read);
+  int faults = (crc_read != crc_written) ? 1 : 0;
+
+  if (comm_rank() == 0) {
+    printf("Spinor field written with %s, read with %s: checksum %.0f, read back %.0f\n",
+	   write_posix ? "pwrite" : "the default", read_posix ? "pread" : "the default", sum_written, sum_read);
+  }
+
+  free(spinor_read);
+  free(spinor);
+
+  return faults;
+}
+
+static unsigned long long getBig(const char *p, int bytes)
+{
+  unsigned long long x = 0;
+  for (int i=0; i<bytes; i++) x = (x << 8) | (unsigned char)p[i];
+  return x;
+}
+
+static inline unsigned int rotl(unsigned int x, int n) { return n ? (x << n) | (x >> (32 - n)) : x; }
+
+// offset of the data in a file that begins with a text header
+static size_t headerBytes(const char *filename)
+{
+  char header[4096];
+  size_t n = readSharedHeader(header, filename, sizeof(header) - 1);
+  header[n] = '\0';
+  char *end = strstr(header, "END_HEADER\n");
+  return end ? end + strlen("END_HEADER\n") - header : 0;
+}
+
+// this rank's file of a RAW solution: the header checksum and the block
+static int check_raw(const char *filename, const char *expected, size_t bytes)
+{
+  char name[256];
+  snprintf(name, sizeof(name), "%s.%d", filename, comm_rank());
+  FILE *f = fopen(name, "rb");
+  if (!f) {
+    printf("Rank %d: cannot open %s\n", comm_rank(), name);
+    return 1;
+  }
+  char *file = (char*)malloc(bytes + 4096);
+  size_t n = fread(file, 1, bytes + 4096, f);
+  fclose(f);
+
+  int faults = 0;
+  char *end = (char*)memmem(file, n, "END_HEADER\n", strlen("END_HEADER\n"));
+  size_t header_bytes = end ? end + strlen("END_HEADER\n") - file : n;
+  unsigned int checksum = 0, sum = 0;
+  char *line = (char*)memmem(file, header_bytes, "CHECKSUM = ", strlen("CHECKSUM = "));
+  if (!end || !line || sscanf(line, "CHECKSUM = %x", &checksum) != 1 || n != header_bytes + bytes) {
+    faults++;
+  } else {
+    for (size_t i=0; i<bytes/4; i++) sum += ((unsigned int*)(file + header_bytes))[i];
+    if (sum != checksum || memcmp(file + header_bytes, expected, bytes)) faults++;
+  }
+  if (faults) printf("Rank %d: %s does not hold the solution\n", comm_rank(), name);
+
+  free(file);
+  return faults;
+}
+
+// a LIME solution: the binary data record and the SciDAC checksum record
+static int check_lime(const char *filename, const char *expected, size_t site_bytes,
+		      const int *G, const int *L, const int *offset)
+{
+  const int volume = L[0]*L[1]*L[2]*L[3];
+  const size_t bytes = volume*site_bytes;
+
+  // the records before the data fit in the first few kB
+  char header[8192];
+  size_t n = readSharedHeader(header, filename, sizeof(header));
+  size_t pos = 0, data_pos = 0, data_bytes = 0;
+  while (pos + LIME_HEADER_BYTES <= n && getBig(header + pos, 4) == LIME_MAGIC) {
+    size_t len = getBig(header + pos + 8, 8);
+    if (!strncmp(header + pos + 16, "scidac-binary-data", 128)) {
+      data_pos = pos + LIME_HEADER_BYTES;
+      data_bytes = len;
+      break;
+    }
+    pos += LIME_HEADER_BYTES + ((len + 7) & ~(size_t)7);
+  }
+  if (data_bytes != (size_t)G[0]*G[1]*G[2]*G[3]*site_bytes) {
+    printf("Rank %d: no binary data record of %lu bytes in %s\n", comm_rank(),
+	   (unsigned long)((size_t)G[0]*G[1]*G[2]*G[3]*site_bytes), filename);
+    return 1;
+  }
+
+  // big endian doubles
+  char *block = (char*)malloc(bytes);
+  readSublattice(block, filename, data_pos, site_bytes, G, L, offset);
+
+  unsigned int crc_table[256];
+  initCrcTable(crc_table);
+  unsigned int sum[2] = {0, 0};
+  int faults = 0;
+  for (int i=0; i<volume; i++) {
+    int g[4];
+    int rest = i;
+    for (int d=0; d<4; d++) {
+      g[d] = rest % L[d] + offset[d];
+      rest /= L[d];
+    }
+    size_t rank = ((size_t)(g[3]*G[2] + g[2])*G[1] + g[1])*G[0] + g[0];
+    unsigned int crc = scidacCrc32(crc_table, block + i*site_bytes, site_bytes);
+    sum[0] ^= rotl(crc, rank % 29);
+    sum[1] ^= rotl(crc, rank % 31);
+
+    for (size_t j=0; j<site_bytes; j+=sizeof(double)) {
+      unsigned long long w = getBig(block + i*site_bytes + j, sizeof(double));
+      double x;
+      memcpy(&x, &w, sizeof(double));
+      if (memcmp(&x, expected + i*site_bytes + j, sizeof(double))) faults++;
+    }
+  }
+  free(block);
+  if (faults) printf("Rank %d: %s does not hold the solution at %d words\n", comm_rank(), filename, faults);
+
+  // the XOR checksums of all ranks, bit by bit
+  double bits[64];
+  for (int b=0; b<64; b++) bits[b] = (sum[b/32] >> (b%32)) & 1;
+  comm_allreduce_array(bits, 64);
+  sum[0] = sum[1] = 0;
+  for (int b=0; b<64; b++) sum[b/32] |= ((unsigned int)bits[b] & 1) << (b%32);
+
+  // the checksum record closes the file
+  char record[LIME_HEADER_BYTES + 512];
+  memset(record, 0, sizeof(record));
+  int fd = open(filename, O_RDONLY);
+  const off_t checksum_pos = data_pos + ((data_bytes + 7) & ~(size_t)7);
+  ssize_t m = fd < 0 ? -1 : pread(fd, record, sizeof(record) - 1, checksum_pos);
+  off_t file_bytes = fd < 0 ? 0 : lseek(fd, 0, SEEK_END);
+  if (fd >= 0) close(fd);
+
+  unsigned int suma = 0, sumb = 0;
+  const char *xml = record + LIME_HEADER_BYTES;
+  const size_t len = m >= LIME_HEADER_BYTES ? getBig(record + 8, 8) : 0;
+  if (m < LIME_HEADER_BYTES || strncmp(record + 16, "scidac-checksum", 128) ||
+      file_bytes != checksum_pos + LIME_HEADER_BYTES + (off_t)((len + 7) & ~(size_t)7) ||
+      !strstr(xml, "<suma>") || sscanf(strstr(xml, "<suma>"), "<suma>%x</suma><sumb>%x", &suma, &sumb) != 2 ||
+      suma != sum[0] || sumb != sum[1]) {
+    printf("Rank %d: bad checksum record in %s (%08x %08x, expected %08x %08x)\n",
+	   comm_rank(), filename, suma, sumb, sum[0], sum[1]);
+    faults++;
+  }
+
+  return faults;
+}
+
+static int check_writer(int volume, unsigned int *seed)
+{
+  QudaInvertParam param = newQudaInvertParam();
+  param.dslash_type = QUDA_WILSON_DSLASH;
+  param.cpu_prec = QUDA_DOUBLE_PRECISION;
+  param.dirac_order = QUDA_DIRAC_ORDER;
+  param.gamma_basis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.verbosity = QUDA_SILENT;
+  const int X[4] = { xdim, ydim, zdim, tdim };
+  int G[4], offset[4];
+  for (int d=0; d<4; d++) {
+    G[d] = X[d] * commDim(d);
+    offset[d] = commCoords(d) * X[d];
+  }
+
+  // more than the writer has buffers, so that the queue fills up
+  const int nSolution = 3;
+  const size_t site_bytes = 24*sizeof(double);
+  const size_t bytes = volume*site_bytes;
+  void *spinor[nSolution];
+  char raw[nSolution][64], lime[nSolution][64];
+  for (int k=0; k<nSolution; k++) {
+    spinor[k] = malloc(bytes);
+    for (int i=0; i<volume*24; i++) ((double*)spinor[k])[i] = rand_r(seed) / (double)RAND_MAX - 0.5;
+    snprintf(raw[k], sizeof(raw[k]), "%s_%d.raw", solution_file, k);
+    snprintf(lime[k], sizeof(lime[k]), "%s_%d.lime", solution_file, k);
+    writeSolutionAsyncQuda(spinor[k], &param, X, raw[k], QUDA_RAW_FILE_FORMAT);
+    writeSolutionAsyncQuda(spinor[k], &param, X, lime[k], QUDA_LIME_FILE_FORMAT);
+  }
+  flushSolutionWriterQuda();
+
+  // the block in file order, as writeSpinorFileQuda() writes it
+  char *expected = (char*)malloc(bytes);
+  int faults = 0;
+  for (int k=0; k<nSolution; k++) {
+    writeSpinorFileQuda(spinor[k], &param, X, spinor_file);
+    readSublattice(expected, spinor_file, headerBytes(spinor_file), site_bytes, G, X, offset);
+    faults += check_raw(raw[k], expected, bytes);
+    faults += check_lime(lime[k], expected, site_bytes, G, X, offset);
+  }
+  free(expected);
+
+  comm_barrier();
+  for (int k=0; k<nSolution; k++) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s.%d", raw[k], comm_rank());
+    unlink(name);
+    if (comm_rank() == 0) unlink(lime[k]);
+    free(spinor[k]);
+  }
+
+  double total = faults;
+  comm_allreduce(&total);
+  if (comm_rank() == 0) {
+    printf("Solution writer, %d solutions in RAW and LIME files: %s\n", nSolution,
+	   total == 0 ? "match" : "MISMATCH");
+  }
+
+  return faults;
+}
+
+static int check_compressed(int volume, unsigned int *seed, int nSpin, int bits)
+{
+  QudaInvertParam param = newQudaInvertParam();
+  param.dslash_type = nSpin == 1 ? QUDA_ASQTAD_DSLASH : QUDA_WILSON_DSLASH;
+  param.cpu_prec = QUDA_DOUBLE_PRECISION;
+  param.dirac_order = QUDA_DIRAC_ORDER;
+  param.gamma_basis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  param.verbosity = QUDA_SILENT;
+  const int X[4] = { xdim, ydim, zdim, tdim };
+  int G[4], offset[4];
+  for (int d=0; d<4; d++) {
+    G[d] = X[d] * commDim(d);
+    offset[d] = commCoords(d) * X[d];
+  }
+
+  // the half unit in the last place, with room for the rounding of
+  // the norm to float
+  const double max_mantissa = bits == 16 ? 32767.0 : 127.0;
+  const double bound = 0.5 / max_mantissa * (1.0 + 1e-6);
+
+  const int nField = 3;
+  const int nReal = nSpin*3*2;
+  const size_t bytes = (size_t)volume*nReal*sizeof(double);
+  void *prop[nField], *prop_read[nField];
+  for (int f=0; f<nField; f++) {
+    prop[f] = malloc(bytes);
+    prop_read[f] = malloc(bytes);
+    // site norms over several orders of magnitude
+    for (int i=0; i<volume; i++) {
+      double scale = exp(6.0 * (rand_r(seed) / (double)RAND_MAX - 0.5));
+      for (int j=0; j<nReal; j++)
+	((double*)prop[f])[i*nReal+j] = scale * (rand_r(seed) / (double)RAND_MAX - 0.5);
+    }
+  }
+
+  writePropagatorFileQuda(prop, nField, &param, X, propagator_file, bits, bound);
+  readPropagatorFileQuda(prop_read, nField, &param, X, propagator_file);
+
+  double error = 0.0;
+  for (int f=0; f<nField; f++) {
+    const double *in = (const double*)prop[f], *out = (const double*)prop_read[f];
+    for (int i=0; i<volume; i++) {
+      double norm = 0.0, e = 0.0;
+      for (int j=0; j<nReal; j++) {
+	norm = fmax(norm, fabs(in[i*nReal+j]));
+	e = fmax(e, fabs(out[i*nReal+j] - in[i*nReal+j]));
+      }
+      if (norm > 0.0) error = fmax(error, e / norm);
+    }
+  }
+  int faults = error > bound ? 1 : 0;
+
+  // a float norm and the mantissas, padded to 4 bytes
+  const size_t used = sizeof(float) + nReal*bits/8;
+  const size_t block_bytes = (used + 3) & ~(size_t)3;
+  const size_t site_bytes = nField*block_bytes;
+  char *data = (char*)malloc(volume*site_bytes);
+  readSublattice(data, propagator_file, headerBytes(propagator_file), site_bytes, G, X, offset);
+  int padding = 0;
+  for (size_t b=0; b<(size_t)volume*nField; b++)
+    for (size_t k=used; k<block_bytes; k++) if (data[b*block_bytes + k]) padding++;
+  if (padding) faults++;
+  free(data);
+
+  double max_error = error;
+  comm_allreduce_max(&max_error);
+  double bad_padding = padding;
+  comm_allreduce(&bad_padding);
+  if (comm_rank() == 0) {
+    printf("Propagator with %d spins, %d-bit mantissas: relative error %e, bound %e, %d nonzero padding bytes\n",
+	   nSpin, bits, max_error, bound, (int)bad_padding);
+  }
+
+  for (int f=0; f<nField; f++) {
+    free(prop_read[f]);
+    free(prop[f]);
+  }
+
+  return faults;
+}
+
+enum { NERSC, ILDG, MILC };
+
+struct GaugeFileCase {
+  int format;
+  int prec;  // bytes per real
+  int rows;  // rows stored per link
+  bool big;  // big-endian file
+};
+
+static bool bigEndianHost()
+{
+  const unsigned int one = 1;
+  return *(const char*)&one == 0;
+}
+
+static void putWord(char *p, unsigned long long x, int bytes, bool big)
+{
+  for (int i=0; i<bytes; i++) p[big ? i : bytes-1-i] = (char)(x >> 8*(bytes-1-i));
+}
+
+// the bits of v in the precision of the file
+static unsigned long long realBits(double v, int prec)
+{
+  if (prec == 8) {
+    unsigned long long w;
+    memcpy(&w, &v, 8);
+    return w;
+  }
+  float f = v;
+  unsigned int w;
+  memcpy(&w, &f, 4);
+  return w;
+}
+
+// CRC-32 (as in zlib), bit by bit
+static unsigned int crc32Bitwise(const char *buf, size_t len)
+{
+  unsigned int c = 0xffffffffu;
+  for (size_t i=0; i<len; i++) {
+    c ^= (unsigned char)buf[i];
+    for (int k=0; k<8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+  }
+  return c ^ 0xffffffffu;
+}
+
+static size_t limeRecord(char *out, const char *type, const char *data, size_t bytes, bool begin, bool end)
+{
+  memset(out, 0, LIME_HEADER_BYTES);
+  putWord(out, LIME_MAGIC, 4, true);
+  putWord(out + 4, 1, 2, true);
+  putWord(out + 6, (begin ? 0x8000 : 0) | (end ? 0x4000 : 0), 2, true);
+  putWord(out + 8, bytes, 8, true);
+  memcpy(out + 16, type, strlen(type));
+  memcpy(out + LIME_HEADER_BYTES, data, bytes);
+  size_t padded = (bytes + 7) & ~(size_t)7;
+  memset(out + LIME_HEADER_BYTES + bytes, 0, padded - bytes);
+  return LIME_HEADER_BYTES + padded;
+}
+
+// Link U of the generated configuration as the reader must see it:
+// the stored rows in the file precision, and for 2-row files the
+// third row completed from them as conj(row0 x row1).
+static void fileLink(double *V, const double *U, const GaugeFileCase &c)
+{
+  for (int j=0; j<18; j++) {
+    if (c.prec == 8) V[j] = U[j];
+    else V[j] = (float)U[j];
+  }
+  if (c.rows == 2) {
+    for (int k=0; k<3; k++) {
+      int a = (k+1)%3, b = (k+2)%3;
+      const double *r0 = V, *r1 = V+6;
+      V[12+2*k] = r0[2*a]*r1[2*b] - r0[2*a+1]*r1[2*b+1] - (r0[2*b]*r1[2*a] - r0[2*b+1]*r1[2*a+1]);
+      V[12+2*k+1] = -(r0[2*a]*r1[2*b+1] + r0[2*a+1]*r1[2*b] - (r0[2*b]*r1[2*a+1] + r0[2*b+1]*r1[2*a]));
+    }
+  }
+}
+
+// Writes the links U of the global lattice G (x fastest, four links
+// per site) to filename in the given format; with corrupt set, the
+// recorded checksum is off by one bit.  Only rank 0 writes.
+static void writeGaugeCase(const char *filename, const double *U, const int *G, const GaugeFileCase &c,
+			   bool corrupt)
+{
+  const size_t volume = (size_t)G[0]*G[1]*G[2]*G[3];
+  const int reals = 4*6*c.rows;
+  const size_t site_bytes = reals*c.prec;
+  char *data = (char*)malloc(volume*site_bytes);
+
+  unsigned int nersc = 0, sum29 = 0, sum31 = 0;
+  for (size_t s=0; s<volume; s++) {
+    char *site = data + s*site_bytes;
+    for (int mu=0; mu<4; mu++) {
+      double V[18];
+      fileLink(V, U + (s*4 + mu)*18, c);
+      for (int j=0; j<18; j++) {
+	unsigned long long w = realBits(V[j], c.prec);
+	nersc += (unsigned int)w + (unsigned int)(w >> 32);
+	if (j < 6*c.rows) putWord(site + (mu*6*c.rows + j)*c.prec, w, c.prec, c.big);
+      }
+    }
+    if (c.format == ILDG) {
+      unsigned int crc = crc32Bitwise(site, site_bytes);
+      sum29 ^= rotl(crc, s % 29);
+      sum31 ^= rotl(crc, s % 31);
+    } else if (c.format == MILC) {
+      for (int k=0; k<reals; k++) {
+	unsigned int w = getBig(site + 4*k, 4);
+	if (!c.big) w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+	size_t index = s*reals + k;
+	sum29 ^= rotl(w, index % 29);
+	sum31 ^= rotl(w, index % 31);
+      }
+    }
+  }
+  if (corrupt) {
+    nersc ^= 1;
+    sum29 ^= 1;
+  }
+
+  FILE *f = fopen(filename, "wb");
+  if (c.format == NERSC) {
+    fprintf(f, "BEGIN_HEADER\nHDR_VERSION = 1.0\nDATATYPE = %s\nSTORAGE_FORMAT = 1.0\n"
+	    "DIMENSION_1 = %d\nDIMENSION_2 = %d\nDIMENSION_3 = %d\nDIMENSION_4 = %d\n"
+	    "CHECKSUM = %08x\nFLOATING_POINT = IEEE%d%s\nEND_HEADER\n",
+	    c.rows == 2 ? "4D_SU3_GAUGE" : "4D_SU3_GAUGE_3x3", G[0], G[1], G[2], G[3],
+	    nersc, 8*c.prec, c.big ? "BIG" : "LITTLE");
+    fwrite(data, site_bytes, volume, f);
+  } else if (c.format == ILDG) {
+    char xml[512];
+    char *record = (char*)malloc(LIME_HEADER_BYTES + volume*site_bytes + 8);
+    int n = snprintf(xml, sizeof(xml), "<?xml version=\"1.0\" encoding=\"UTF-8\"?><ildgFormat>"
+		     "<version>1.0</version><field>su3gauge</field><precision>%d</precision>"
+		     "<lx>%d</lx><ly>%d</ly><lz>%d</lz><lt>%d</lt></ildgFormat>", 8*c.prec, G[0], G[1], G[2], G[3]);
+    fwrite(record, 1, limeRecord(record, "ildg-format", xml, n, true, false), f);
+    fwrite(record, 1, limeRecord(record, "ildg-binary-data", data, volume*site_bytes, false, false), f);
+    n = snprintf(xml, sizeof(xml), "<?xml version=\"1.0\" encoding=\"UTF-8\"?><scidacChecksum>"
+		 "<version>1.0</version><suma>%x</suma><sumb>%x</sumb></scidacChecksum>", sum29, sum31);
+    fwrite(record, 1, limeRecord(record, "scidac-checksum", xml, n, false, true), f);
+    free(record);
+  } else {
+    char header[96];
+    memset(header, 0, sizeof(header));
+    putWord(header, 20103, 4, c.big);
+    for (int d=0; d<4; d++) putWord(header + 4 + 4*d, G[d], 4, c.big);
+    snprintf(header + 20, 64, "generated by io_test");
+    putWord(header + 88, sum29, 4, c.big);
+    putWord(header + 92, sum31, 4, c.big);
+    fwrite(header, 1, sizeof(header), f);
+    fwrite(data, site_bytes, volume, f);
+  }
+  fclose(f);
+  free(data);
+}
+
+// Reads each generated configuration on every rank and compares the
+// links with those generated, to round-off in the file precision;
+// each must be verified, and rejected with its checksum corrupted.
+static int check_gauge_formats(int volume, const char *filename)
+{
+  const int X[4] = { xdim, ydim, zdim, tdim };
+  int G[4], offset[4];
+  for (int d=0; d<4; d++) {
+    G[d] = X[d] * commDim(d);
+    offset[d] = commCoords(d) * X[d];
+  }
+  const size_t global_volume = (size_t)G[0]*G[1]*G[2]*G[3];
+
+  // the same random SU(3) links on every rank
+  unsigned int seed = 4321;
+  double *U = (double*)malloc(global_volume*4*18*sizeof(double));
+  for (size_t i=0; i<global_volume*4; i++) random_su3(U + 18*i, &seed);
+
+  QudaGaugeParam param = newQudaGaugeParam();
+  for (int d=0; d<4; d++) param.X[d] = X[d];
+  param.cpu_prec = QUDA_DOUBLE_PRECISION;
+  param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+
+  void *gauge[4];
+  for (int mu=0; mu<4; mu++) gauge[mu] = malloc(volume*18*sizeof(double));
+
+  const char *format_name[] = { "NERSC", "ILDG", "MILC" };
+  const GaugeFileCase cases[] = {
+    { NERSC, 8, 3, true }, { NERSC, 4, 3, false }, { NERSC, 8, 2, false }, { NERSC, 4, 2, true },
+    { ILDG, 8, 3, true }, { ILDG, 4, 3, true },
+    { MILC, 4, 3, bigEndianHost() }, { MILC, 4, 3, !bigEndianHost() },
+  };
+  const int nCase = sizeof(cases) / sizeof(cases[0]);
+
+  // the reference CRC-32 check value
+  int faults = crc32Bitwise("123456789", 9) != 0xcbf43926u ? 1 : 0;
+
+  for (int k=0; k<nCase; k++) {
+    const GaugeFileCase &c = cases[k];
+    int case_faults = 0;
+
+    if (comm_rank() == 0) writeGaugeCase(filename, U, G, c, false);
+    comm_barrier();
+    double plaq;
+    if (!readGaugeFile(gauge, &param, filename, &plaq)) case_faults++;
+
+    double error = 0.0;
+    for (int i=0; i<volume; i++) {
+      int x[4], rest = i;
+      for (int d=0; d<4; d++) {
+	x[d] = rest % X[d];
+	rest /= X[d];
+      }
+      size_t s = ((size_t)((x[3]+offset[3])*G[2] + x[2]+offset[2])*G[1] + x[1]+offset[1])*G[0] + x[0]+offset[0];
+      size_t eo = ((x[0] + x[1] + x[2] + x[3]) & 1) * (volume/2) + i/2;
+      for (int mu=0; mu<4; mu++) {
+	double V[18];
+	fileLink(V, U + (s*4 + mu)*18, c);
+	for (int j=0; j<18; j++) {
+	  double read = ((double*)gauge[mu])[eo*18 + j];
+	  error = fmax(error, fabs(read - U[(s*4 + mu)*18 + j]));
+	  if (fabs(read - V[j]) > 1e-14) case_faults++;
+	}
+      }
+    }
+    // the links are unitary, so their elements are at most 1
+    if (error > (c.prec == 8 ? 1e-14 : 1e-6)) case_faults++;
+
+    comm_barrier();
+    if (comm_rank() == 0) writeGaugeCase(filename, U, G, c, true);
+    comm_barrier();
+    const bool rejected = !readGaugeFile(gauge, &param, filename, &plaq);
+    if (!rejected) case_faults++;
+
+    double total = case_faults, max_error = error;
+    comm_allreduce(&total);
+    comm_allreduce_max(&max_error);
+    if (comm_rank() == 0) {
+      printf("Gauge file %s %d-bit %s%s: max link error %e, corrupted checksum %s: %s\n",
+	     format_name[c.format], 8*c.prec, c.big ? "big endian" : "little endian",
+	     c.rows == 2 ? ", 2 rows" : "", max_error, rejected ? "rejected" : "ACCEPTED",
+	     total == 0 ? "PASSED" : "FAILED");
+    }
+    faults += case_faults;
+    comm_barrier();
+  }
+
+  if (comm_rank() == 0) unlink(filename);
+  for (int mu=0; mu<4; mu++) free(gauge[mu]);
+  free(U);
+
+  return faults;
+}
+
+int io_test(int argc, char **argv)
+{
+  initCommsQuda(argc, argv, gridsize_from_cmdline, 4);
+
+  const int volume = xdim*ydim*zdim*tdim;
+  // rand_r since with thread comms the ranks share a process
+  unsigned int seed = 1234 + comm_rank();
+
+  // the default transfer, the pread()/pwrite() fallback, and a file
+  // written by one and read by the other
+  const bool write_posix[] = { false, true, false };
+  const bool read_posix[] = { false, true, true };
+
+  int faults = 0;
+  for (int i=0; i<3; i++) {
+    faults += check_gauge(volume, &seed, write_posix[i], read_posix[i]);
+    faults += check_spinor(volume, &seed, write_posix[i], read_posix[i]);
+  }
+  setPosixSublatticeIO(false);
+
+  faults += check_gauge_formats(volume, gauge_format_file);
+
+  faults += check_writer(volume, &seed);
+
+  for (int nSpin=4; nSpin>=1; nSpin-=3) {
+    faults += check_compressed(volume, &seed, nSpin, 16);
+    faults += check_compressed(volume, &seed, nSpin, 8);
+  }
+
+  double total = faults;
+  comm_allreduce(&total);
+
+  comm_barrier();
+  if (comm_rank() == 0) {
+    unlink(gauge_file);
+    unlink(spinor_file);
+    unlink(propagator_file);
+    printf("Parallel I/O test on %d ranks (grid %d %d %d %d, local volume %dx%dx%dx%d): %s (%d faults)\n",
+	   comm_size(), comm_dim(0), comm_dim(1), comm_dim(2), comm_dim(3), xdim, ydim, zdim, tdim,
+	   total == 0 ? "PASSED" : "FAILED", (int)total);
+  }
+
+  endCommsQuda();
+
+  return total == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  xdim=ydim=zdim=tdim=8;
+
+  for (int i =1;i < argc; i++){
+    if(process_command_line_option(argc, argv, &i) == 0){
+      continue;
+    }
+
+    fprintf(stderr, "ERROR: Invalid option:%s\n", argv[i]);
+    usage(argv);
+  }
+
+#ifdef THREAD_COMMS
+  int nranks = 1;
+  for (int d=0; d<4; d++) nranks *= gridsize_from_cmdline[d];
+  return comm_thread_launch(nranks, io_test, argc, argv);
+#else
+  return io_test(argc, argv);
+#endif
+}
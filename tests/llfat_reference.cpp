@@ -47,13 +47,13 @@ typedef struct { dcomplex c[3]; } dsu3_vector;
 #define CMUL_J(a,b,c) { (c).real = (a).real*(b).real + (a).imag*(b).imag; \
     (c).imag = (a).imag*(b).real - (a).real*(b).imag; }
 
-extern int Z[4];
-extern int V;
-extern int Vh;
-extern int Vs[];
-extern int Vsh[];
-extern int Vs_x, Vs_y, Vs_z, Vs_t;
-extern int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
+extern COMM_RANK_LOCAL int Z[4];
+extern COMM_RANK_LOCAL int V;
+extern COMM_RANK_LOCAL int Vh;
+extern COMM_RANK_LOCAL int Vs[];
+extern COMM_RANK_LOCAL int Vsh[];
+extern COMM_RANK_LOCAL int Vs_x, Vs_y, Vs_z, Vs_t;
+extern COMM_RANK_LOCAL int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
 
 
 template<typename su3_matrix, typename Real>
@@ -22,13 +22,13 @@ extern void usage(char** argv);
 static int verify_results = 0;
 
 extern int device;
-int Z[4];
-int V;
-int Vh;
-int Vs[4];
-int Vsh[4];
-static int Vs_x, Vs_y, Vs_z, Vs_t;
-static int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
+COMM_RANK_LOCAL int Z[4];
+COMM_RANK_LOCAL int V;
+COMM_RANK_LOCAL int Vh;
+COMM_RANK_LOCAL int Vs[4];
+COMM_RANK_LOCAL int Vsh[4];
+static COMM_RANK_LOCAL int Vs_x, Vs_y, Vs_z, Vs_t;
+static COMM_RANK_LOCAL int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
 
 static int V_ex;
 static int Vh_ex;
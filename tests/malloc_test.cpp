@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <quda.h>
+#include <malloc_quda.h>
+#include <test_util.h>
+
+#include <unistd.h>
+
+#ifdef NUMA_AFFINITY
+#include <sys/syscall.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Exercises the caching allocators of lib/malloc_quda.cpp on the
+// host.  A freed block must be handed out again for a request of the
+// same size and only then, the statistics must count every request,
+// and trimPool() must give the cached memory back to the system.
+// With NUMA affinity, a large host block must also come back with
+// all its pages resident, each on the NUMA node of the thread that
+// works on that part of the block in a static loop (the first-touch
+// placement).  This needs neither a GPU nor comms.
+
+extern void usage(char**);
+
+static int poolCheck(const char *what, bool ok)
+{
+  if (!ok) printf("  %s FAILED\n", what);
+  return ok ? 0 : 1;
+}
+
+// resident set size of the process in bytes, or -1 if unknown
+static long residentBytes()
+{
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f) return -1;
+  long size, resident;
+  int n = fscanf(f, "%ld %ld", &size, &resident);
+  fclose(f);
+  return n == 2 ? resident*sysconf(_SC_PAGESIZE) : -1;
+}
+
+static int poolTest()
+{
+  int fail = 0;
+  const size_t small = 1000, large = 64ul<<20;
+
+  trimPool();
+  PoolStats s0 = hostPoolStats();
+  fail += poolCheck("empty cache after trim", s0.cached_bytes == 0 && s0.cached_blocks == 0);
+
+  // a miss, then the freed block comes back for the same size
+  void *a = pool_host_malloc(small);
+  PoolStats s1 = hostPoolStats();
+  fail += poolCheck("miss counted", s1.misses == s0.misses + 1 && s1.hits == s0.hits);
+  fail += poolCheck("live bytes", s1.live_bytes == s0.live_bytes + small);
+
+  pool_host_free(a);
+  PoolStats s2 = hostPoolStats();
+  fail += poolCheck("freed block cached", s2.live_bytes == s0.live_bytes &&
+		    s2.cached_bytes == small && s2.cached_blocks == 1);
+
+  void *b = pool_host_malloc(small);
+  PoolStats s3 = hostPoolStats();
+  fail += poolCheck("same-size request reuses the block", b == a);
+  fail += poolCheck("hit counted", s3.hits == s2.hits + 1 && s3.misses == s2.misses);
+  fail += poolCheck("reused block leaves the cache", s3.cached_bytes == 0 && s3.cached_blocks == 0);
+
+  // another size does not take the cached block
+  pool_host_free(b);
+  void *c = pool_host_malloc(small + 8);
+  PoolStats s4 = hostPoolStats();
+  fail += poolCheck("other size misses", c != b && s4.misses == s3.misses + 1 && s4.cached_blocks == 1);
+  fail += poolCheck("peak bytes", s4.peak_bytes >= 2*small + 8);
+  pool_host_free(c);
+
+  // a large block stays resident while cached and is released by the trim
+  long rss0 = residentBytes();
+  char *d = (char*)pool_host_malloc(large);
+  memset(d, 1, large);
+  pool_host_free(d);
+  long rss_cached = residentBytes();
+  PoolStats s5 = hostPoolStats();
+  fail += poolCheck("three blocks cached", s5.cached_blocks == 3 && s5.cached_bytes == 2*small + 8 + large);
+
+  trimPool();
+  long rss_trimmed = residentBytes();
+  PoolStats s6 = hostPoolStats();
+  fail += poolCheck("trim empties the cache", s6.cached_bytes == 0 && s6.cached_blocks == 0 &&
+		    s6.live_bytes == s0.live_bytes);
+  if (rss0 >= 0) {
+    fail += poolCheck("cached block resident", rss_cached - rss0 > (long)large/2);
+    fail += poolCheck("trim returns the memory", rss_cached - rss_trimmed > (long)large/2);
+  }
+
+  // with caching disabled, freed blocks go straight back
+  setPoolEnabled(false);
+  void *e = pool_host_malloc(small);
+  pool_host_free(e);
+  PoolStats s7 = hostPoolStats();
+  fail += poolCheck("nothing cached when disabled", s7.cached_blocks == 0);
+  setPoolEnabled(true);
+
+  printf("Host pool: %ld hits, %ld misses, resident %ld MB cached, %ld MB after trim: %s\n",
+	 s6.hits - s0.hits, s6.misses - s0.misses, rss_cached >> 20, rss_trimmed >> 20, fail ? "FAILED" : "PASSED");
+
+  return fail;
+}
+
+#ifdef NUMA_AFFINITY
+
+#define HUGE_PAGE_SIZE (2ul<<20)
+
+// the NUMA node of each huge page of the block, or a negative errno
+// if the page is not resident; returns false if the kernel cannot
+// tell
+static bool pageNodes(int *node, char *ptr, long nhuge)
+{
+  void **pages = (void**)malloc(nhuge*sizeof(void*));
+  for (long i=0; i<nhuge; i++) pages[i] = ptr + i*HUGE_PAGE_SIZE;
+  bool ok = (syscall(SYS_move_pages, 0, nhuge, pages, NULL, node, 0) == 0);
+  free(pages);
+  return ok;
+}
+
+static int placementTest()
+{
+  const long nhuge = 64;
+  const size_t bytes = nhuge*HUGE_PAGE_SIZE;
+
+  // a size no other test uses, so that the block is freshly mapped
+  char *ptr = (char*)pool_host_malloc(bytes);
+
+  int *node = (int*)malloc(nhuge*sizeof(int));
+  int *thread_node = (int*)malloc(nhuge*sizeof(int));
+
+  if (!pageNodes(node, ptr, nhuge)) {
+    printf("Placement: move_pages() not supported, test skipped\n");
+    free(node);
+    free(thread_node);
+    pool_host_free(ptr);
+    trimPool();
+    return 0;
+  }
+
+  // the node of the thread that gets each huge page in a static loop
+#pragma omp parallel for schedule(static)
+  for (long i=0; i<nhuge; i++) {
+    unsigned cpu, n;
+    thread_node[i] = (syscall(SYS_getcpu, &cpu, &n, NULL) == 0) ? (int)n : -1;
+  }
+
+  int absent = 0, misplaced = 0;
+  for (long i=0; i<nhuge; i++) {
+    if (node[i] < 0) absent++;
+    else if (thread_node[i] >= 0 && node[i] != thread_node[i]) misplaced++;
+  }
+
+  // threads that are not bound may have moved since the first touch
+  bool bound = false;
+#ifdef _OPENMP
+  bound = (omp_get_proc_bind() != omp_proc_bind_false);
+#endif
+
+  printf("Placement: %ld huge pages, %d not resident, %d on another node than their thread%s\n",
+	 nhuge, absent, misplaced, bound ? "" : " (threads not bound, not checked)");
+
+  free(node);
+  free(thread_node);
+  pool_host_free(ptr);
+  trimPool();
+
+  return absent + (bound ? misplaced : 0);
+}
+
+#endif // NUMA_AFFINITY
+
+int main(int argc, char **argv)
+{
+  for (int i=1; i<argc; i++) {
+    if (process_command_line_option(argc, argv, &i) == 0) continue;
+    fprintf(stderr, "ERROR: Invalid option:%s\n", argv[i]);
+    usage(argv);
+  }
+
+  // the pools are per process, so no comms are set up
+  int fail = poolTest();
+#ifdef NUMA_AFFINITY
+  fail += placementTest();
+#endif
+
+  printf("%s\n", fail ? "FAILED" : "PASSED");
+
+  return fail ? 1 : 0;
+}
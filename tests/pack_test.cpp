@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 
 #include <quda_internal.h>
@@ -11,6 +12,8 @@
 
 #include <color_spinor_field.h>
 #include <blas_quda.h>
+#include <face_quda.h>
+#include <site_order.h>
 
 QudaGaugeParam param;
 cudaColorSpinorField *cudaSpinor;
@@ -94,6 +97,309 @@ void end() {
   endQuda();
 }
 
+// even-odd index of the site with lexicographic index lex, computed
+// from its coordinates independently of lexToEvenOdd()
+static size_t evenOddIndex(size_t lex, int nDim, const int *X) {
+  size_t volume = 1;
+  for (int d=0; d<nDim; d++) volume *= X[d];
+
+  size_t rest = lex;
+  int sum = 0;
+  for (int d=0; d<nDim; d++) {
+    sum += rest % X[d];
+    rest /= X[d];
+  }
+  return (sum & 1)*(volume/2) + lex/2;
+}
+
+// Host round trips of the site reordering: lexToEvenOdd() must put
+// every site where evenOddIndex() says, and evenOddToLex() must undo
+// it exactly, for each of the site sizes it specializes and a generic
+// one.  The extents after X[0] are odd, so that rows start on both
+// parities.  Last, a full lexicographic spinor field is copied into an
+// even-odd one and back through cpuColorSpinorField::copy().
+int siteOrderTest() {
+
+  int fails = 0;
+  const int X[4] = {4, 3, 5, 3};
+  size_t volume = X[0]*X[1]*X[2]*X[3];
+  const size_t site_bytes[] = {24, 48, 72, 96, 144, 192, 40};
+
+  for (unsigned int b=0; b<sizeof(site_bytes)/sizeof(site_bytes[0]); b++) {
+    size_t bytes = site_bytes[b];
+    unsigned char *lex = (unsigned char*)malloc(volume*bytes);
+    unsigned char *eo = (unsigned char*)malloc(volume*bytes);
+    unsigned char *back = (unsigned char*)malloc(volume*bytes);
+    for (size_t i=0; i<volume*bytes; i++) lex[i] = rand() & 0xff;
+
+    lexToEvenOdd(eo, lex, bytes, 4, X);
+    int misplaced = 0;
+    for (size_t x=0; x<volume; x++)
+      if (memcmp(eo + evenOddIndex(x, 4, X)*bytes, lex + x*bytes, bytes)) misplaced++;
+
+    evenOddToLex(back, eo, bytes, 4, X);
+    bool identity = !memcmp(back, lex, volume*bytes);
+
+    printf("Site order, %2lu-byte sites: %d misplaced, lex -> even-odd -> lex %s\n",
+	   (unsigned long)bytes, misplaced, identity ? "is the identity" : "FAILED");
+    if (misplaced || !identity) fails++;
+
+    free(back);
+    free(eo);
+    free(lex);
+  }
+
+  ColorSpinorParam lexParam;
+  lexParam.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  lexParam.nColor = 3;
+  lexParam.nSpin = 4;
+  lexParam.nDim = 4;
+  for (int d=0; d<4; d++) lexParam.x[d] = X[d];
+  lexParam.precision = QUDA_DOUBLE_PRECISION;
+  lexParam.pad = 0;
+  lexParam.siteSubset = QUDA_FULL_SITE_SUBSET;
+  lexParam.siteOrder = QUDA_LEXICOGRAPHIC_SITE_ORDER;
+  lexParam.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  lexParam.gammaBasis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  lexParam.create = QUDA_NULL_FIELD_CREATE;
+
+  cpuColorSpinorField lexSpinor(lexParam);
+  lexSpinor.Source(QUDA_RANDOM_SOURCE);
+
+  ColorSpinorParam eoParam(lexParam);
+  eoParam.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+  cpuColorSpinorField eoSpinor(eoParam);
+  cpuColorSpinorField lexSpinor2(lexParam);
+
+  eoSpinor = lexSpinor;
+  lexSpinor2 = eoSpinor;
+
+  const size_t bytes = spinorSiteSize*sizeof(double);
+  const char *l = (const char*)lexSpinor.V(), *e = (const char*)eoSpinor.V();
+  int misplaced = 0;
+  for (size_t x=0; x<volume; x++)
+    if (memcmp(e + evenOddIndex(x, 4, X)*bytes, l + x*bytes, bytes)) misplaced++;
+  bool identity = !memcmp(lexSpinor2.V(), lexSpinor.V(), volume*bytes);
+
+  printf("Site order, spinor field copy: %d misplaced, lex -> even-odd -> lex %s\n",
+	 misplaced, identity ? "is the identity" : "FAILED");
+  if (misplaced || !identity) fails++;
+
+  return fails;
+}
+
+// relative difference of the field a from the field ref (which is of the reference layout)
+static double fieldDiff(const cpuColorSpinorField &a, const cpuColorSpinorField &ref) {
+  ColorSpinorParam p(ref);
+  p.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  p.create = QUDA_NULL_FIELD_CREATE;
+  cpuColorSpinorField tmp(p);
+  tmp.copy(a);
+  return sqrt(xmyNormCpu(ref, tmp) / normCpu(ref));
+}
+
+static const char *layoutName(QudaFieldOrder order, QudaSiteOrder site_order) {
+  if (order == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) return "QOP domain wall";
+  const char *o = (order == QUDA_SPACE_SPIN_COLOR_FIELD_ORDER) ? "space-spin-color" : "space-color-spin";
+  const char *s = (site_order == QUDA_LEXICOGRAPHIC_SITE_ORDER) ? "lexicographic" :
+    (site_order == QUDA_ODD_EVEN_SITE_ORDER) ? "odd-even" : "even-odd";
+  static char name[64];
+  snprintf(name, sizeof(name), "%s, %s", o, s);
+  return name;
+}
+
+// number of elements of f, of a 4-d layout, that are not where the field
+// order and site order put the element of ref (of the reference layout)
+static int misplacedElements(const cpuColorSpinorField &f, const cpuColorSpinorField &ref) {
+  const int volume = ref.Volume();
+  const int *X = ref.X();
+  int *site = (int*)malloc(volume*sizeof(int)); // storage index of each even-odd index
+  for (int x=0; x<volume; x++) {
+    if (f.SiteOrder() == QUDA_LEXICOGRAPHIC_SITE_ORDER) site[evenOddIndex(x, 4, X)] = x;
+    else if (f.SiteOrder() == QUDA_ODD_EVEN_SITE_ORDER) site[x] = (x + volume/2) % volume;
+    else site[x] = x;
+  }
+
+  int misplaced = 0;
+  const double *r = (const double*)ref.V();
+  for (int x=0; x<volume; x++) {
+    for (int s=0; s<4; s++) {
+      for (int c=0; c<3; c++) {
+	for (int z=0; z<2; z++) {
+	  size_t i = (f.FieldOrder() == QUDA_SPACE_SPIN_COLOR_FIELD_ORDER) ?
+	    ((site[x]*4 + s)*3 + c)*2 + z : ((site[x]*3 + c)*4 + s)*2 + z;
+	  double v = (f.Precision() == QUDA_DOUBLE_PRECISION) ? ((const double*)f.V())[i] : ((const float*)f.V())[i];
+	  if (v != r[((x*4 + s)*3 + c)*2 + z]) misplaced++;
+	}
+      }
+    }
+  }
+
+  free(site);
+  return misplaced;
+}
+
+static int blasCheck(const char *name, double diff, double tol) {
+  bool ok = (diff <= tol);
+  if (!ok) printf("  %s: relative difference %e FAILED\n", name, diff);
+  return ok ? 0 : 1;
+}
+
+// The host BLAS on fields of the given layout, which go through the
+// field-order accessors, must agree with the flat loops on fields of
+// the reference layout (space-spin-color, even-odd, double) holding
+// the same values.  Each routine is called with one argument of each
+// layout, and with the result in the given layout.  That the values
+// are where the layout says is checked independently of the accessors.
+int blasOrderTest(QudaFieldOrder order, QudaSiteOrder site_order, QudaPrecision precision) {
+
+  const int X[5] = {4, 3, 5, 3, 2};
+  ColorSpinorParam refParam;
+  refParam.fieldLocation = QUDA_CPU_FIELD_LOCATION;
+  refParam.nColor = 3;
+  refParam.nSpin = 4;
+  refParam.nDim = (order == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) ? 5 : 4;
+  for (int d=0; d<refParam.nDim; d++) refParam.x[d] = X[d];
+  refParam.precision = QUDA_DOUBLE_PRECISION;
+  refParam.pad = 0;
+  refParam.siteSubset = QUDA_FULL_SITE_SUBSET;
+  refParam.siteOrder = QUDA_EVEN_ODD_SITE_ORDER;
+  refParam.fieldOrder = QUDA_SPACE_SPIN_COLOR_FIELD_ORDER;
+  refParam.gammaBasis = QUDA_DEGRAND_ROSSI_GAMMA_BASIS;
+  refParam.create = QUDA_NULL_FIELD_CREATE;
+
+  if (order == QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) { // stored as one parity per fifth-dimension slice
+    refParam.siteSubset = QUDA_PARITY_SITE_SUBSET;
+    refParam.x[0] /= 2;
+  }
+
+  ColorSpinorParam param(refParam);
+  param.fieldOrder = order;
+  param.siteOrder = site_order;
+  param.precision = precision;
+
+  cpuColorSpinorField x(refParam), y(refParam), z(refParam), w(refParam);
+  cpuColorSpinorField xo(param), yo(param), zo(param);
+  x.Source(QUDA_RANDOM_SOURCE);
+  y.Source(QUDA_RANDOM_SOURCE);
+  z.Source(QUDA_RANDOM_SOURCE);
+  w.Source(QUDA_RANDOM_SOURCE);
+
+  // both layouts hold the same (in single precision, rounded) values
+  xo.copy(x); x.copy(xo);
+  yo.copy(y); y.copy(yo);
+  zo.copy(z); z.copy(zo);
+
+  int fails = 0;
+  if (order != QUDA_QOP_DOMAIN_WALL_FIELD_ORDER) {
+    int misplaced = misplacedElements(xo, x);
+    if (misplaced) printf("  copy: %d elements misplaced FAILED\n", misplaced);
+    if (misplaced) fails++;
+  }
+
+  const double tol = (precision == QUDA_DOUBLE_PRECISION) ? 1e-13 : 1e-6;
+  const quda::Complex a(0.3, -0.7), b(-1.1, 0.2);
+  cpuColorSpinorField yr(refParam), zr(refParam), yor(refParam);
+
+  // these fields are local to the process
+  globalReduce = false;
+
+  fails += blasCheck("reDotProduct", fabs(reDotProductCpu(xo, y) - reDotProductCpu(x, y)) / normCpu(x), tol);
+  fails += blasCheck("cDotProduct", abs(cDotProductCpu(xo, y) - cDotProductCpu(x, y)) / normCpu(x), tol);
+  fails += blasCheck("cDotProduct (other way)", abs(cDotProductCpu(y, xo) - cDotProductCpu(y, x)) / normCpu(x), tol);
+  fails += blasCheck("norm", fabs(normCpu(xo) - normCpu(x)) / normCpu(x), tol);
+
+  // results in the reference layout
+  yr.copy(y); axpbyCpu(0.5, xo, -2.0, yr);
+  yor.copy(y); axpbyCpu(0.5, x, -2.0, yor);
+  fails += blasCheck("axpby", fieldDiff(yr, yor), tol);
+
+  yr.copy(y); caxpbyCpu(a, xo, b, yr);
+  yor.copy(y); caxpbyCpu(a, x, b, yor);
+  fails += blasCheck("caxpby", fieldDiff(yr, yor), tol);
+
+  zr.copy(z); cxpaypbzCpu(xo, a, y, b, zr);
+  yor.copy(z); cxpaypbzCpu(x, a, y, b, yor);
+  fails += blasCheck("cxpaypbz", fieldDiff(zr, yor), tol);
+
+  // results in the given layout
+  caxpbyCpu(a, x, b, yo);
+  yor.copy(y); caxpbyCpu(a, x, b, yor);
+  fails += blasCheck("caxpby (result)", fieldDiff(yo, yor), tol);
+
+  axCpu(-1.5, zo);
+  yor.copy(z); axCpu(-1.5, yor);
+  fails += blasCheck("ax (result)", fieldDiff(zo, yor), tol);
+
+  // z += a*x + b*y, y -= b*w, with x, y and z of the given layout
+  xo.copy(x); yo.copy(y); zo.copy(z);
+  yr.copy(y); zr.copy(z);
+  caxpbypzYmbwCpu(a, xo, b, yo, zo, w);
+  caxpbypzYmbwCpu(a, x, b, yr, zr, w);
+  fails += blasCheck("caxpbypzYmbw (z)", fieldDiff(zo, zr), tol);
+  fails += blasCheck("caxpbypzYmbw (y)", fieldDiff(yo, yr), tol);
+
+  globalReduce = true;
+
+  printf("Host BLAS, %s, %s precision: %s\n", layoutName(order, site_order),
+	 precision == QUDA_DOUBLE_PRECISION ? "double" : "single", fails ? "FAILED" : "agrees with the flat loops");
+
+  return fails;
+}
+
+// The QDP_LEX path of loadGaugeQuda() and saveGaugeQuda(): random
+// links loaded in lexicographic order must come back unchanged when
+// saved in that order, and saved in QDP (even-odd) order every site
+// must be where evenOddIndex() puts it.  The links are not
+// reconstructed, so the comparisons are exact.
+int lexGaugeTest() {
+
+  QudaGaugeParam lexParam = newQudaGaugeParam();
+  for (int d=0; d<4; d++) lexParam.X[d] = param.X[d];
+  lexParam.type = QUDA_WILSON_LINKS;
+  lexParam.gauge_order = QUDA_QDP_LEX_GAUGE_ORDER;
+  lexParam.anisotropy = 1.0;
+  lexParam.t_boundary = QUDA_PERIODIC_T;
+  lexParam.gauge_fix = QUDA_GAUGE_FIXED_NO;
+  lexParam.cpu_prec = QUDA_SINGLE_PRECISION;
+  lexParam.cuda_prec = QUDA_SINGLE_PRECISION;
+  lexParam.reconstruct = QUDA_RECONSTRUCT_NO;
+  lexParam.cuda_prec_sloppy = lexParam.cuda_prec;
+  lexParam.reconstruct_sloppy = lexParam.reconstruct;
+  lexParam.ga_pad = 0;
+
+  const size_t bytes = gaugeSiteSize*sizeof(float);
+  void *lex[4], *back[4], *eo[4];
+  for (int d=0; d<4; d++) {
+    lex[d] = malloc(V*bytes);
+    back[d] = malloc(V*bytes);
+    eo[d] = malloc(V*bytes);
+    for (int i=0; i<V*gaugeSiteSize; i++) ((float*)lex[d])[i] = rand() / (float)RAND_MAX;
+  }
+
+  loadGaugeQuda(lex, &lexParam);
+  saveGaugeQuda(back, &lexParam);
+  lexParam.gauge_order = QUDA_QDP_GAUGE_ORDER;
+  saveGaugeQuda(eo, &lexParam);
+
+  int misplaced = 0, changed = 0;
+  for (int d=0; d<4; d++) {
+    for (int x=0; x<V; x++) {
+      if (memcmp((char*)eo[d] + evenOddIndex(x, 4, param.X)*bytes, (char*)lex[d] + x*bytes, bytes)) misplaced++;
+      if (memcmp((char*)back[d] + x*bytes, (char*)lex[d] + x*bytes, bytes)) changed++;
+    }
+    free(eo[d]);
+    free(back[d]);
+    free(lex[d]);
+  }
+
+  printf("QDP_LEX gauge: %d links misplaced in even-odd order, %d changed by load and save\n",
+	 misplaced, changed);
+  freeGaugeQuda();
+
+  return (misplaced || changed) ? 1 : 0;
+}
+
 void packTest() {
 
   float spinorGiB = (float)Vh*spinorSiteSize*param.cuda_prec / (1 << 30);
@@ -196,8 +502,19 @@ void packTest() {
 }
 
 int main(int argc, char **argv) {
+  int fails = siteOrderTest();
+  fails += blasOrderTest(QUDA_SPACE_SPIN_COLOR_FIELD_ORDER, QUDA_ODD_EVEN_SITE_ORDER, QUDA_DOUBLE_PRECISION);
+  fails += blasOrderTest(QUDA_SPACE_SPIN_COLOR_FIELD_ORDER, QUDA_LEXICOGRAPHIC_SITE_ORDER, QUDA_DOUBLE_PRECISION);
+  fails += blasOrderTest(QUDA_SPACE_SPIN_COLOR_FIELD_ORDER, QUDA_EVEN_ODD_SITE_ORDER, QUDA_SINGLE_PRECISION);
+  fails += blasOrderTest(QUDA_SPACE_COLOR_SPIN_FIELD_ORDER, QUDA_EVEN_ODD_SITE_ORDER, QUDA_DOUBLE_PRECISION);
+  fails += blasOrderTest(QUDA_SPACE_COLOR_SPIN_FIELD_ORDER, QUDA_LEXICOGRAPHIC_SITE_ORDER, QUDA_SINGLE_PRECISION);
+  fails += blasOrderTest(QUDA_QOP_DOMAIN_WALL_FIELD_ORDER, QUDA_EVEN_ODD_SITE_ORDER, QUDA_DOUBLE_PRECISION);
   init();
+  fails += lexGaugeTest();
   packTest();
   end();
+
+  if (fails) printf("%d site order and host BLAS checks FAILED\n", fails);
+  return fails ? 1 : 0;
 }
 
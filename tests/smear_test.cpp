@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex>
+
+#include <quda.h>
+#include <test_util.h>
+#include <dslash_util.h>
+#include <face_quda.h>
+
+// Checks the host link smearing of smearLinkQuda() on a random gauge
+// field: the smeared links must be in SU(3), the plaquette must grow,
+// and smearing must commute with a random gauge transformation,
+// which tests the staples of every link.  The last check needs the
+// transformation on the neighbouring sites, so it is only done when
+// no dimension is partitioned.
+//
+// The Wilson flow of wilsonFlowQuda() is checked likewise: the links
+// must stay in SU(3), the energy density must decrease along the
+// flow, and the flow with adaptive steps must agree with the one with
+// small fixed steps.
+
+extern int xdim;
+extern int ydim;
+extern int zdim;
+extern int tdim;
+extern int gridsize_from_cmdline[];
+extern QudaPrecision prec;
+extern void usage(char** argv);
+
+typedef std::complex<double> Complex;
+
+static QudaLinkSmearType smear_type = QUDA_INVALID_SMEAR; // all
+static int n_step = 1;
+static double flow_time = 0.2;
+
+static const char *smear_str[] = { "ape", "stout", "hyp" };
+
+static QudaGaugeParam param;
+
+// the link of the site at local coordinates x in direction mu, as complex numbers
+static void getLink(Complex U[3][3], void **gauge, int mu, const int *x)
+{
+  int i = (((x[3]*param.X[2] + x[2])*param.X[1] + x[1])*param.X[0] + x[0]) / 2;
+  int oddBit = (x[0] + x[1] + x[2] + x[3]) & 1;
+  size_t offset = ((size_t)oddBit*Vh + i)*gaugeSiteSize;
+  for (int a=0; a<3; a++) {
+    for (int b=0; b<3; b++) {
+      if (prec == QUDA_DOUBLE_PRECISION) {
+	double *p = (double*)gauge[mu] + offset + 6*a + 2*b;
+	U[a][b] = Complex(p[0], p[1]);
+      } else {
+	float *p = (float*)gauge[mu] + offset + 6*a + 2*b;
+	U[a][b] = Complex(p[0], p[1]);
+      }
+    }
+  }
+}
+
+static void setLink(void **gauge, int mu, const int *x, Complex U[3][3])
+{
+  int i = (((x[3]*param.X[2] + x[2])*param.X[1] + x[1])*param.X[0] + x[0]) / 2;
+  int oddBit = (x[0] + x[1] + x[2] + x[3]) & 1;
+  size_t offset = ((size_t)oddBit*Vh + i)*gaugeSiteSize;
+  for (int a=0; a<3; a++) {
+    for (int b=0; b<3; b++) {
+      if (prec == QUDA_DOUBLE_PRECISION) {
+	double *p = (double*)gauge[mu] + offset + 6*a + 2*b;
+	p[0] = real(U[a][b]);
+	p[1] = imag(U[a][b]);
+      } else {
+	float *p = (float*)gauge[mu] + offset + 6*a + 2*b;
+	p[0] = real(U[a][b]);
+	p[1] = imag(U[a][b]);
+      }
+    }
+  }
+}
+
+static void siteCoords(int *x, int s)
+{
+  for (int d=0; d<4; d++) {
+    x[d] = s % param.X[d];
+    s /= param.X[d];
+  }
+}
+
+// the largest deviation of a link from SU(3), max |U U^dagger - 1| and |det U - 1|
+static double su3Deviation(void **gauge)
+{
+  double dev = 0.0;
+  for (int s=0; s<V; s++) {
+    int x[4];
+    siteCoords(x, s);
+    for (int mu=0; mu<4; mu++) {
+      Complex U[3][3];
+      getLink(U, gauge, mu, x);
+      for (int a=0; a<3; a++) {
+	for (int b=0; b<3; b++) {
+	  Complex uu = U[a][0]*conj(U[b][0]) + U[a][1]*conj(U[b][1]) + U[a][2]*conj(U[b][2]);
+	  dev = std::max(dev, abs(uu - (a == b ? 1.0 : 0.0)));
+	}
+      }
+      Complex det = U[0][0]*(U[1][1]*U[2][2] - U[1][2]*U[2][1])
+	- U[0][1]*(U[1][0]*U[2][2] - U[1][2]*U[2][0]) + U[0][2]*(U[1][0]*U[2][1] - U[1][1]*U[2][0]);
+      dev = std::max(dev, abs(det - 1.0));
+    }
+  }
+  reduceMaxDouble(dev);
+  return dev;
+}
+
+// U_mu(x) -> g(x) U_mu(x) g(x+mu)^dagger
+static void gaugeTransform(void **out, void **in, void **g)
+{
+  for (int s=0; s<V; s++) {
+    int x[4];
+    siteCoords(x, s);
+    Complex gx[3][3];
+    getLink(gx, g, 0, x);
+    for (int mu=0; mu<4; mu++) {
+      int y[4] = {x[0], x[1], x[2], x[3]};
+      y[mu] = (y[mu] + 1) % param.X[mu];
+      Complex gy[3][3], U[3][3], A[3][3], B[3][3];
+      getLink(gy, g, 0, y);
+      getLink(U, in, mu, x);
+      for (int a=0; a<3; a++)
+	for (int b=0; b<3; b++) A[a][b] = gx[a][0]*U[0][b] + gx[a][1]*U[1][b] + gx[a][2]*U[2][b];
+      for (int a=0; a<3; a++)
+	for (int b=0; b<3; b++) B[a][b] = A[a][0]*conj(gy[b][0]) + A[a][1]*conj(gy[b][1]) + A[a][2]*conj(gy[b][2]);
+      setLink(out, mu, x, B);
+    }
+  }
+}
+
+static double maxDifference(void **a, void **b)
+{
+  double diff = 0.0;
+  for (int s=0; s<V; s++) {
+    int x[4];
+    siteCoords(x, s);
+    for (int mu=0; mu<4; mu++) {
+      Complex A[3][3], B[3][3];
+      getLink(A, a, mu, x);
+      getLink(B, b, mu, x);
+      for (int i=0; i<3; i++)
+	for (int j=0; j<3; j++) diff = std::max(diff, abs(A[i][j] - B[i][j]));
+    }
+  }
+  return diff;
+}
+
+static int smear_test(QudaLinkSmearType type)
+{
+  const double coeff[3][3] = { {0.5, 0.0, 0.0}, {0.1, 0.0, 0.0}, {0.75, 0.6, 0.3} };
+  const double tol = (prec == QUDA_DOUBLE_PRECISION) ? 1e-10 : 1e-5;
+  const size_t bytes = V*gaugeSiteSize*param.cpu_prec;
+
+  void *gauge[4], *smeared[4], *g[4], *transformed[4];
+  for (int mu=0; mu<4; mu++) {
+    gauge[mu] = malloc(bytes);
+    smeared[mu] = malloc(bytes);
+    g[mu] = malloc(bytes);
+    transformed[mu] = malloc(bytes);
+  }
+
+  construct_gauge_field(gauge, 1, param.cpu_prec, &param);
+  for (int mu=0; mu<4; mu++) memcpy(smeared[mu], gauge[mu], bytes);
+
+  double plaq_start = smearLinkQuda(gauge, &param, type, coeff[type], 0);
+  double plaq = smearLinkQuda(smeared, &param, type, coeff[type], n_step);
+  double dev = su3Deviation(smeared);
+
+  int fail = 0;
+  printfQuda("%s smearing, %d steps: plaquette %.10f -> %.10f, deviation from SU(3) %e\n",
+	     smear_str[type], n_step, plaq_start, plaq, dev);
+  if (dev > tol) fail = 1;
+  if (plaq <= plaq_start) fail = 1;
+
+  bool partitioned = false;
+  for (int d=0; d<4; d++) if (commDimPartitioned(d)) partitioned = true;
+  if (!partitioned) {
+    // smear(g U g^dagger) = g smear(U) g^dagger, with a random g(x) in the links of g[0]
+    construct_gauge_field(g, 1, param.cpu_prec, &param);
+    gaugeTransform(transformed, gauge, g);
+    smearLinkQuda(transformed, &param, type, coeff[type], n_step);
+    gaugeTransform(gauge, smeared, g);
+    double diff = maxDifference(transformed, gauge);
+    printfQuda("%s smearing: gauge covariance violated by %e\n", smear_str[type], diff);
+    if (diff > 10*n_step*tol) fail = 1;
+  }
+
+  for (int mu=0; mu<4; mu++) {
+    free(transformed[mu]);
+    free(g[mu]);
+    free(smeared[mu]);
+    free(gauge[mu]);
+  }
+
+  return fail;
+}
+
+static int flow_test()
+{
+  const double eps = 0.01;
+  const double tol = (prec == QUDA_DOUBLE_PRECISION) ? 1e-10 : 1e-5;
+  const size_t bytes = V*gaugeSiteSize*param.cpu_prec;
+  // the measurements of the fixed-step flow, with room for the
+  // adaptive one to take smaller steps
+  const int max_meas = 100*((int)ceil(flow_time/eps) + 1);
+
+  void *gauge[4], *flowed[4];
+  for (int mu=0; mu<4; mu++) {
+    gauge[mu] = malloc(bytes);
+    flowed[mu] = malloc(bytes);
+  }
+  double *t = new double[max_meas];
+  double *E = new double[max_meas];
+  double *Q = new double[max_meas];
+
+  // the clover energy density of a random field need not decrease, so
+  // the flow starts from a smeared one
+  const double alpha = 0.5;
+  construct_gauge_field(gauge, 1, param.cpu_prec, &param);
+  smearLinkQuda(gauge, &param, QUDA_APE_SMEAR, &alpha, 3);
+  for (int mu=0; mu<4; mu++) memcpy(flowed[mu], gauge[mu], bytes);
+
+  int n = wilsonFlowQuda(flowed, &param, flow_time, eps, 0.0, t, E, Q, max_meas);
+  double dev = su3Deviation(flowed);
+
+  int fail = 0;
+  if (n > max_meas) { // the measurement at flow_time was not stored
+    printfQuda("Wilson flow: %d measurements, of which only %d were stored\n", n, max_meas);
+    n = max_meas;
+    fail = 1;
+  }
+  int increases = 0;
+  for (int k=1; k<n; k++) if (E[k] >= E[k-1]) increases++;
+  printfQuda("Wilson flow to t = %g in %d steps: E %.10e -> %.10e, t^2 E = %.10e, Q = %.6f, deviation from SU(3) %e\n",
+	     t[n-1], n-1, E[0], E[n-1], t[n-1]*t[n-1]*E[n-1], Q[n-1], dev);
+  if (dev > tol) fail = 1;
+  if (increases) {
+    printfQuda("Wilson flow: the energy density increased in %d steps\n", increases);
+    fail = 1;
+  }
+
+  // the same flow with adaptive steps, from a larger first step
+  double E_fixed = E[n-1];
+  for (int mu=0; mu<4; mu++) memcpy(flowed[mu], gauge[mu], bytes);
+  int n_adaptive = wilsonFlowQuda(flowed, &param, flow_time, 4*eps, 1e-5, t, E, Q, max_meas);
+  if (n_adaptive > max_meas) {
+    printfQuda("Wilson flow with adaptive steps: %d measurements, of which only %d were stored\n",
+	       n_adaptive, max_meas);
+    n_adaptive = max_meas;
+    fail = 1;
+  }
+  double E_adaptive = E[n_adaptive-1];
+  double diff = fabs(E_adaptive - E_fixed) / E_fixed;
+  printfQuda("Wilson flow with adaptive steps: %d steps, E = %.10e, relative difference %e\n",
+	     n_adaptive-1, E_adaptive, diff);
+  if (diff > 1e-4) fail = 1;
+
+  delete []Q;
+  delete []E;
+  delete []t;
+  for (int mu=0; mu<4; mu++) {
+    free(flowed[mu]);
+    free(gauge[mu]);
+  }
+
+  return fail;
+}
+
+void
+usage_extra(char** argv )
+{
+  printfQuda("Extra options:\n");
+  printfQuda("    --smear <ape/stout/hyp>                  # Smearing to test (default all)\n");
+  printfQuda("    --nsteps <n>                             # Number of smearing steps (default 1)\n");
+  printfQuda("    --flow-time <t>                          # Flow time of the Wilson flow test (default 0.2, 0 to skip)\n");
+  return ;
+}
+
+int
+main(int argc, char **argv)
+{
+  xdim=ydim=zdim=tdim=8;
+  prec = QUDA_DOUBLE_PRECISION;
+
+  for (int i=1; i<argc; i++) {
+    if (process_command_line_option(argc, argv, &i) == 0) {
+      continue;
+    }
+
+    if (strcmp(argv[i], "--smear") == 0) {
+      if (i+1 >= argc) usage(argv);
+      if (strcmp(argv[i+1], "ape") == 0) smear_type = QUDA_APE_SMEAR;
+      else if (strcmp(argv[i+1], "stout") == 0) smear_type = QUDA_STOUT_SMEAR;
+      else if (strcmp(argv[i+1], "hyp") == 0) smear_type = QUDA_HYP_SMEAR;
+      else usage(argv);
+      i++;
+      continue;
+    }
+
+    if (strcmp(argv[i], "--nsteps") == 0) {
+      if (i+1 >= argc) usage(argv);
+      n_step = atoi(argv[i+1]);
+      i++;
+      continue;
+    }
+
+    if (strcmp(argv[i], "--flow-time") == 0) {
+      if (i+1 >= argc) usage(argv);
+      flow_time = atof(argv[i+1]);
+      i++;
+      continue;
+    }
+
+    fprintf(stderr, "ERROR: Invalid option:%s\n", argv[i]);
+    usage(argv);
+  }
+
+  if (prec == QUDA_HALF_PRECISION) prec = QUDA_SINGLE_PRECISION; // host links
+
+  initCommsQuda(argc, argv, gridsize_from_cmdline, 4);
+
+  param = newQudaGaugeParam();
+  param.cpu_prec = prec;
+  param.type = QUDA_WILSON_LINKS;
+  param.gauge_order = QUDA_QDP_GAUGE_ORDER;
+  param.X[0] = xdim;
+  param.X[1] = ydim;
+  param.X[2] = zdim;
+  param.X[3] = tdim;
+  param.anisotropy = 1.0;
+  param.t_boundary = QUDA_PERIODIC_T;
+  param.gauge_fix = QUDA_GAUGE_FIXED_NO;
+  setDims(param.X);
+
+  int fail = 0;
+  for (int type=QUDA_APE_SMEAR; type<=QUDA_HYP_SMEAR; type++) {
+    if (smear_type != QUDA_INVALID_SMEAR && type != smear_type) continue;
+    fail += smear_test((QudaLinkSmearType)type);
+  }
+  if (flow_time > 0.0) fail += flow_test();
+
+  printfQuda("%s\n", fail ? "FAILED" : "PASSED");
+
+  endCommsQuda();
+
+  return fail ? 1 : 0;
+}
@@ -12,11 +12,43 @@
 #include <blas_quda.h>
 
 #include <face_quda.h>
+#include <gauge_field.h>
+#include <cpu_reconstruct.h>
 
 extern void *memset(void *s, int c, size_t n);
 
 #include <dslash_util.h>
 
+// When set, the long links passed to the reference operators are
+// stored with the reconstruction of this field and are expanded one
+// link at a time as they are used.
+static COMM_RANK_LOCAL const cpuGaugeField *cpuLongLinkField = NULL;
+
+void setCpuLongLinkField(const cpuGaugeField *field)
+{
+  cpuLongLinkField = field;
+}
+
+static inline int longLinkSiteSize()
+{
+  return cpuLongLinkField ? cpuLongLinkField->Reconstruct() : gaugeSiteSize;
+}
+
+// the full long link used at site i in direction dir, where lnk points to its stored form
+template <typename gFloat>
+static inline gFloat* longLink(gFloat *tmp, gFloat *lnk, int i, int dir, int oddBit)
+{
+  if (longLinkSiteSize() == gaugeSiteSize) return lnk;
+
+  // backward links live on the site three steps back
+  int Y = fullLatticeIndex(i, oddBit);
+  int x[4] = {Y % Z[0], (Y/Z[0]) % Z[1], (Y/(Z[1]*Z[0])) % Z[2], Y/(Z[2]*Z[1]*Z[0])};
+  if (dir % 2 == 1) x[dir/2] -= 3;
+
+  loadLink(tmp, lnk, cpuLongLinkField->Reconstruct(), (gFloat)cpuLongLinkField->LinkScale(dir/2, x));
+  return tmp;
+}
+
 //
 // dslashReference()
 //
@@ -55,14 +87,16 @@ void dslashReference(sFloat *res, gFloat **fatlink, gFloat** longlink, sFloat *s
     fatlinkEven[dir] = fatlink[dir];
     fatlinkOdd[dir] = fatlink[dir] + Vh*gaugeSiteSize;
     longlinkEven[dir] =longlink[dir];
-    longlinkOdd[dir] = longlink[dir] + Vh*gaugeSiteSize;    
+    longlinkOdd[dir] = longlink[dir] + Vh*longLinkSiteSize();
   }
   
   for (int i = 0; i < Vh; i++) {
     memset(res + i*mySpinorSiteSize, 0, mySpinorSiteSize*sizeof(sFloat));
     for (int dir = 0; dir < 8; dir++) {
       gFloat* fatlnk = gaugeLink(i, dir, oddBit, fatlinkEven, fatlinkOdd, 1);
-      gFloat* longlnk = gaugeLink(i, dir, oddBit, longlinkEven, longlinkOdd, 3);
+      gFloat longtmp[gaugeSiteSize];
+      gFloat* longlnk = longLink(longtmp, gaugeLink(i, dir, oddBit, longlinkEven, longlinkOdd, 3, longLinkSiteSize()),
+				 i, dir, oddBit);
       
       sFloat *first_neighbor_spinor = spinorNeighbor(i, dir, oddBit, spinorField, 1);
       sFloat *third_neighbor_spinor = spinorNeighbor(i, dir, oddBit, spinorField, 3);
@@ -286,19 +320,21 @@ void dslashReference_mg4dir(sFloat *res, gFloat **fatlink, gFloat** longlink,
     fatlinkEven[dir] = fatlink[dir];
     fatlinkOdd[dir] = fatlink[dir] + Vh*gaugeSiteSize;
     longlinkEven[dir] =longlink[dir];
-    longlinkOdd[dir] = longlink[dir] + Vh*gaugeSiteSize;
+    longlinkOdd[dir] = longlink[dir] + Vh*longLinkSiteSize();
     
     ghostFatlinkEven[dir] = ghostFatlink[dir];
     ghostFatlinkOdd[dir] = ghostFatlink[dir] + Vsh[dir]*gaugeSiteSize;
     ghostLonglinkEven[dir] = ghostLonglink[dir];
-    ghostLonglinkOdd[dir] = ghostLonglink[dir] + 3*Vsh[dir]*gaugeSiteSize;
+    ghostLonglinkOdd[dir] = ghostLonglink[dir] + 3*Vsh[dir]*longLinkSiteSize();
   }
 
   for (int i = 0; i < Vh; i++) {
     memset(res + i*mySpinorSiteSize, 0, mySpinorSiteSize*sizeof(sFloat));
     for (int dir = 0; dir < 8; dir++) {
       gFloat* fatlnk = gaugeLink_mg4dir(i, dir, oddBit, fatlinkEven, fatlinkOdd, ghostFatlinkEven, ghostFatlinkOdd, 1, 1);
-      gFloat* longlnk = gaugeLink_mg4dir(i, dir, oddBit, longlinkEven, longlinkOdd, ghostLonglinkEven, ghostLonglinkOdd, 3, 3);
+      gFloat longtmp[gaugeSiteSize];
+      gFloat* longlnk = longLink(longtmp, gaugeLink_mg4dir(i, dir, oddBit, longlinkEven, longlinkOdd, ghostLonglinkEven,
+							   ghostLonglinkOdd, 3, 3, longLinkSiteSize()), i, dir, oddBit);
 
       sFloat *first_neighbor_spinor = spinorNeighbor_mg4dir(i, dir, oddBit, spinorField, fwd_nbr_spinor, back_nbr_spinor, 1, 3);
       sFloat *third_neighbor_spinor = spinorNeighbor_mg4dir(i, dir, oddBit, spinorField, fwd_nbr_spinor, back_nbr_spinor, 3, 3);
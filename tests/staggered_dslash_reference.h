@@ -5,12 +5,16 @@
 #include <quda_internal.h>
 #include "color_spinor_field.h"
 
-extern int Z[4];
-extern int Vh;
-extern int V;
+extern COMM_RANK_LOCAL int Z[4];
+extern COMM_RANK_LOCAL int Vh;
+extern COMM_RANK_LOCAL int V;
 
 void setDims(int *);
 
+// long links stored with 12 or 8 reconstruction (NULL for full links)
+class cpuGaugeField;
+void setCpuLongLinkField(const cpuGaugeField *field);
+
 void staggered_dslash(void *res, void ** fatlink, void** longlink, void *spinorField,
 		      int oddBit, int daggerBit, QudaPrecision sPrecision, QudaPrecision gPrecision);
 void staggered_dslash_mg4dir(cpuColorSpinorField* out, void **fatlink, void** longlink, void** ghost_fatlink, 
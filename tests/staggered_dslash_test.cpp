@@ -44,6 +44,7 @@ cudaColorSpinorField* tmp;
 
 void *hostGauge[4];
 void *fatlink[4], *longlink[4];
+void **cpuLongLink; // longlink, or its compressed copy
 
 #ifdef MULTI_GPU
 const void **ghost_fatlink, **ghost_longlink;
@@ -60,6 +61,7 @@ extern int zdim;
 extern int tdim;
 extern int gridsize_from_cmdline[];
 extern QudaReconstructType link_recon;
+extern QudaReconstructType cpu_link_recon;
 extern QudaPrecision prec;
 
 extern int device;
@@ -169,10 +171,23 @@ void init()
   cpuFat = new cpuGaugeField(cpuFatParam);
   cpuFat->exchangeGhost();
   ghost_fatlink = cpuFat->Ghost();
+#endif
 
+  // the reference operator uses long links stored with cpu_link_recon
   gaugeParam.type = QUDA_ASQTAD_LONG_LINKS;
   GaugeFieldParam cpuLongParam(longlink, gaugeParam);
+  if (cpu_link_recon != QUDA_RECONSTRUCT_NO) {
+    cpuLongParam.reconstruct = cpu_link_recon;
+    cpuLongParam.create = QUDA_NULL_FIELD_CREATE;
+  }
   cpuLong = new cpuGaugeField(cpuLongParam);
+  if (cpu_link_recon != QUDA_RECONSTRUCT_NO) {
+    cpuLong->loadLinks(longlink);
+    setCpuLongLinkField(cpuLong);
+  }
+  cpuLongLink = (void**)cpuLong->Gauge_p();
+
+#ifdef MULTI_GPU
   cpuLong->exchangeGhost();
   ghost_longlink = cpuLong->Ghost();
 
@@ -275,6 +290,7 @@ void end(void)
   delete spinorOut;
   delete spinorRef;
 
+  setCpuLongLinkField(NULL);
   if (cpuFat) delete cpuFat;
   if (cpuLong) delete cpuLong;
     
@@ -346,11 +362,11 @@ void staggeredDslashRef()
   case 0:    
 #ifdef MULTI_GPU
 
-    staggered_dslash_mg4dir(spinorRef, fatlink, longlink, (void**)ghost_fatlink, (void**)ghost_longlink, 
+    staggered_dslash_mg4dir(spinorRef, fatlink, cpuLongLink, (void**)ghost_fatlink, (void**)ghost_longlink, 
 			    spinor, parity, dagger, inv_param.cpu_prec, gaugeParam.cpu_prec);
 #else
     cpu_parity = 0; //EVEN
-    staggered_dslash(spinorRef->V(), fatlink, longlink, spinor->V(), cpu_parity, dagger, 
+    staggered_dslash(spinorRef->V(), fatlink, cpuLongLink, spinor->V(), cpu_parity, dagger, 
 		     inv_param.cpu_prec, gaugeParam.cpu_prec);
     
 #endif    
@@ -359,12 +375,12 @@ void staggeredDslashRef()
     break;
   case 1: 
 #ifdef MULTI_GPU
-    staggered_dslash_mg4dir(spinorRef, fatlink, longlink, (void**)ghost_fatlink, (void**)ghost_longlink, 
+    staggered_dslash_mg4dir(spinorRef, fatlink, cpuLongLink, (void**)ghost_fatlink, (void**)ghost_longlink, 
 			    spinor, parity, dagger, inv_param.cpu_prec, gaugeParam.cpu_prec);    
     
 #else
     cpu_parity=1; //ODD
-    staggered_dslash(spinorRef->V(), fatlink, longlink, spinor->V(), cpu_parity, dagger, 
+    staggered_dslash(spinorRef->V(), fatlink, cpuLongLink, spinor->V(), cpu_parity, dagger, 
 		     inv_param.cpu_prec, gaugeParam.cpu_prec);
 #endif
     break;
@@ -446,9 +462,9 @@ void display_test_info()
 {
   printfQuda("running the following test:\n");
  
-  printfQuda("prec recon   test_type     dagger   S_dim         T_dimension\n");
-  printfQuda("%s   %s       %d           %d       %d/%d/%d        %d \n", 
-	     get_prec_str(prec), get_recon_str(link_recon), 
+  printfQuda("prec recon   cpu_recon   test_type     dagger   S_dim         T_dimension\n");
+  printfQuda("%s   %s       %s          %d           %d       %d/%d/%d        %d \n", 
+	     get_prec_str(prec), get_recon_str(link_recon), get_recon_str(cpu_link_recon),
 	     test_type, dagger, xdim, ydim, zdim, tdim);
   printfQuda("Grid partition info:     X  Y  Z  T\n"); 
   printfQuda("                         %d  %d  %d  %d\n", 
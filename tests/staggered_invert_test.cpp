@@ -46,6 +46,7 @@ cpuGaugeField *cpuFat = NULL;
 cpuGaugeField *cpuLong = NULL;
 
 static double tol = 1e-6;
+static int refine_batch = 0; // shifts refined together in the mixed multi-shift test
 
 extern int test_type;
 extern int xdim;
@@ -104,6 +105,7 @@ set_params(QudaGaugeParam* gaugeParam, QudaInvertParam* inv_param,
   inv_param->tol = tol;
   inv_param->maxiter = 10000;
   inv_param->reliable_delta = 1e-1; // ignored by multi-shift solver
+  inv_param->refine_batch = refine_batch;
 
   //inv_param->inv_type = QUDA_GCR_INVERTER;
   //inv_param->gcrNkrylov = 10;
@@ -346,14 +348,15 @@ invert_test(void)
       errorQuda("test 5 not supported\n");
     }
     
-    double residue_sq;
+    // the tolerance of every shift in the refinement
+    double residue_sq[NUM_OFFSETS];
+    for (int i=0; i < num_offsets; i++) residue_sq[i] = inv_param.tol;
     if (test_type == 6){
-      invertMultiShiftQudaMixed(outArray, in->V(), &inv_param, offsets, num_offsets, &residue_sq);
+      invertMultiShiftQudaMixed(outArray, in->V(), &inv_param, offsets, num_offsets, residue_sq);
     }else{      
-      invertMultiShiftQuda(outArray, in->V(), &inv_param, offsets, num_offsets, &residue_sq);	
+      invertMultiShiftQuda(outArray, in->V(), &inv_param, offsets, num_offsets, residue_sq);	
     }
     cudaDeviceSynchronize();
-    printfQuda("Final residue squred =%g\n", residue_sq);
     time0 += clock(); // stop the timer
     time0 /= CLOCKS_PER_SEC;
     
@@ -483,6 +486,7 @@ usage_extra(char** argv )
   printfQuda("                                                4: Odd odd spinor multishift CG inverter\n");
   printfQuda("                                                6: Even even spinor mixed precision multishift CG inverter\n");
   printfQuda("    --cpu_prec <double/single/half>          # Set CPU precision\n");
+  printfQuda("    --refine_batch <n>                       # Shifts refined together in test 6 (default 0, one at a time)\n");
   
   return ;
 }
@@ -521,6 +525,19 @@ int main(int argc, char** argv)
       i++;
       continue;
     }
+
+    if( strcmp(argv[i], "--refine_batch") == 0){
+      if (i+1 >= argc){
+	usage(argv);
+      }
+      refine_batch = atoi(argv[i+1]);
+      if (refine_batch < 0){
+	printf("ERROR: invalid refine_batch(%d)\n", refine_batch);
+	usage(argv);
+      }
+      i++;
+      continue;
+    }
    
         
     printf("ERROR: Invalid option:%s\n", argv[i]);
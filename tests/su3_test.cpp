@@ -2,8 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <math.h>
+
 #include <test_util.h>
 #include <dslash_util.h>
+#include <cpu_reconstruct.h>
 
 #include <gauge_qio.h>
 
@@ -82,7 +85,46 @@ void end() {
 
 extern void usage(char**);
 
-void SU3Test(int argc, char **argv) {
+// Compress the SU(3) links U/u0 with 12 and 8 reconstruction and check
+// that the reconstructed links agree with them to round-off, for the
+// scales u0 met in practice: none, a temporal boundary, an anisotropy
+// and an asqtad long-link coefficient with a staggered phase.
+template <typename Float>
+static int reconstructTest(double **su3, double tol)
+{
+  const double scale[] = {1.0, -1.0, 2.3, -24.0*0.8*0.8, 24.0*0.8*0.8};
+  const int nScale = sizeof(scale)/sizeof(double);
+  const QudaReconstructType recon[] = {QUDA_RECONSTRUCT_12, QUDA_RECONSTRUCT_8};
+  int fail = 0;
+
+  for (int r=0; r<2; r++) {
+    for (int s=0; s<nScale; s++) {
+      const Float u0 = scale[s];
+      double max_dev = 0.0;
+      for (int dir=0; dir<4; dir++) {
+	for (int i=0; i<V; i++) {
+	  Float U[gaugeSiteSize], packed[gaugeSiteSize], tmp[gaugeSiteSize];
+	  for (int j=0; j<gaugeSiteSize; j++) U[j] = su3[dir][i*gaugeSiteSize+j] / scale[s];
+	  packLink(packed, U, recon[r]);
+	  const Float *W = loadLink(tmp, packed, recon[r], u0);
+	  // the elements of U/u0 are of order 1/|u0|
+	  for (int j=0; j<gaugeSiteSize; j++) {
+	    double dev = fabs((double)W[j] - (double)U[j]) * fabs(scale[s]);
+	    if (dev > max_dev) max_dev = dev;
+	  }
+	}
+      }
+      bool ok = (max_dev <= tol);
+      printf("reconstruct %2d, %s, u0 = %7.3f: max deviation %e %s\n", recon[r],
+	     sizeof(Float) == sizeof(double) ? "double" : "single", scale[s], max_dev, ok ? "" : "FAILED");
+      if (!ok) fail++;
+    }
+  }
+
+  return fail;
+}
+
+int SU3Test(int argc, char **argv) {
 
   for (int i =1;i < argc; i++){    
     if(process_command_line_option(argc, argv, &i) == 0){
@@ -95,6 +137,13 @@ void SU3Test(int argc, char **argv) {
 
   init();
 
+  int fail = 0;
+
+  // round trip through the host link compression, on a random SU(3) field
+  construct_gauge_field((void**)gauge, 1, param.cpu_prec, &param);
+  fail += reconstructTest<double>((double**)gauge, 1e-13);
+  fail += reconstructTest<float>((double**)gauge, 1e-5);
+
   if (strcmp(latfile,"")) {  // load in the command line supplied gauge field
     read_gauge_field(latfile, gauge, param.cpu_prec, param.X, argc, argv);
     construct_gauge_field((void**)gauge, 2, param.cpu_prec, &param);
@@ -110,15 +159,17 @@ void SU3Test(int argc, char **argv) {
   check_gauge(gauge, new_gauge, 1e-3, param.cpu_prec);
 
   end();
+
+  return fail;
 }
 
 int main(int argc, char **argv) {
 
   initCommsQuda(argc, argv, gridsize_from_cmdline, 4);
 
-  SU3Test(argc, argv);
+  int fail = SU3Test(argc, argv);
 
   endCommsQuda();
 
-  return 0;
+  return fail ? 1 : 0;
 }
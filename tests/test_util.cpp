@@ -18,18 +18,18 @@ using namespace std;
 #define ZUP 2
 #define TUP 3
 
-int Z[4];
-int V;
-int Vh;
-int Vs_t;
-int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
-int faceVolume[4];
+COMM_RANK_LOCAL int Z[4];
+COMM_RANK_LOCAL int V;
+COMM_RANK_LOCAL int Vh;
+COMM_RANK_LOCAL int Vs_t;
+COMM_RANK_LOCAL int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
+COMM_RANK_LOCAL int faceVolume[4];
 
-int Ls;
-int V5;
-int V5h;
+COMM_RANK_LOCAL int Ls;
+COMM_RANK_LOCAL int V5;
+COMM_RANK_LOCAL int V5h;
 
-int mySpinorSiteSize;
+COMM_RANK_LOCAL int mySpinorSiteSize;
 
 extern float fat_link_max;
 
@@ -876,7 +876,13 @@ void constructUnitaryGaugeField(Float **res)
 }
 
 
+static COMM_RANK_LOCAL int host_gauge_version = 0;
+
+void markHostGaugeModified() { host_gauge_version++; }
+int hostGaugeVersion() { return host_gauge_version; }
+
 void construct_gauge_field(void **gauge, int type, QudaPrecision precision, QudaGaugeParam *param) {
+  markHostGaugeModified();
   if (type == 0) {
     if (precision == QUDA_DOUBLE_PRECISION) constructUnitGaugeField((double**)gauge, param);
     else constructUnitGaugeField((float**)gauge, param);
@@ -894,6 +900,7 @@ void
 construct_fat_long_gauge_field(void **fatlink, void** longlink,  
 			       int type, QudaPrecision precision, QudaGaugeParam* param)
 {
+  markHostGaugeModified();
   if (type == 0) {
     if (precision == QUDA_DOUBLE_PRECISION) {
       constructUnitGaugeField((double**)fatlink, param);
@@ -1382,6 +1389,7 @@ int device = 0;
 
 QudaReconstructType link_recon = QUDA_RECONSTRUCT_12;
 QudaReconstructType link_recon_sloppy = QUDA_RECONSTRUCT_INVALID;
+QudaReconstructType cpu_link_recon = QUDA_RECONSTRUCT_NO;
 QudaPrecision prec = QUDA_SINGLE_PRECISION;
 QudaPrecision  prec_sloppy = QUDA_INVALID_PRECISION;
 int xdim = 24;
@@ -1410,6 +1418,7 @@ void usage(char** argv )
   printf("    --prec_sloppy <double/single/half>        # Sloppy precision in GPU\n"); 
   printf("    --recon <8/12/18>                         # Link reconstruction type\n"); 
   printf("    --recon_sloppy <8/12/18>                  # Sloppy link reconstruction type\n"); 
+  printf("    --cpu_recon <8/12/18>                     # Link reconstruction type of the host links (default 18)\n"); 
   printf("    --dagger                                  # Set the dagger to 1 (default 0)\n"); 
   printf("    --sdim <n>                                # Set space dimention(X/Y/Z) size\n"); 
   printf("    --xdim <n>                                # Set X dimension size(default 24)\n");     
@@ -1422,9 +1431,10 @@ void usage(char** argv )
   printf("    --tgridsize <n>                           # Set grid size in T dimension (default 1)\n");
   printf("    --partition <mask>                        # Set the communication topology (X=1, Y=2, Z=4, T=8, and combinations of these)\n");
   printf("    --kernel_pack_t                           # Set T dimension kernel packing to be true (default false)\n");
+  printf("    --compress-halo <none/spinor/link/all>    # Compress halo messages of the given type (default none)\n");
   printf("    --dslash_type <type>                      # Set the dslash type, the following values are valid\n"
 	 "                                                  wilson/clover/twisted_mass/asqtad/domain_wall\n");
-  printf("    --load-gauge file                         # Load gauge field \"file\" for the test (requires QIO)\n");
+  printf("    --load-gauge file                         # Load gauge field \"file\" for the test (NERSC, ILDG or MILC without QIO)\n");
   printf("    --niter <n>                               # The number of iterations to perform (default 10)\n");
   printf("    --tune <true/false>                       # Whether to autotune or not (default true)\n");     
   printf("    --test                                    # Test method (different for each test)\n");
@@ -1509,6 +1519,16 @@ int process_command_line_option(int argc, char** argv, int* idx)
     ret = 0;
     goto out;
   }
+
+  if( strcmp(argv[i], "--cpu_recon") == 0){
+    if (i+1 >= argc){
+      usage(argv);
+    }	    
+    cpu_link_recon =  get_recon(argv[i+1]);
+    i++;
+    ret = 0;
+    goto out;
+  }
   
   if( strcmp(argv[i], "--xdim") == 0){
     if (i+1 >= argc){
@@ -1611,6 +1631,16 @@ int process_command_line_option(int argc, char** argv, int* idx)
     goto out;
   }
 
+  if( strcmp(argv[i], "--compress-halo") == 0){
+    if (i+1 >= argc){
+      usage(argv);
+    }
+    setHaloCompression(argv[i+1]);
+    i++;
+    ret = 0;
+    goto out;
+  }
+
 
   if( strcmp(argv[i], "--tune") == 0){
     if (i+1 >= argc){
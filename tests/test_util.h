@@ -2,6 +2,7 @@
 #define _TEST_UTIL_H
 
 #include <quda.h>
+#include <comm_quda.h>
 
 #define gaugeSiteSize 18 // real numbers per link
 #define spinorSiteSize 24 // real numbers per spinor
@@ -13,18 +14,18 @@
 extern "C" {
 #endif
 
-  extern int Z[4];
-  extern int V;
-  extern int Vh;
-  extern int Vs_t;
-  extern int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
-  extern int faceVolume[4];
+  extern COMM_RANK_LOCAL int Z[4];
+  extern COMM_RANK_LOCAL int V;
+  extern COMM_RANK_LOCAL int Vh;
+  extern COMM_RANK_LOCAL int Vs_t;
+  extern COMM_RANK_LOCAL int Vsh_x, Vsh_y, Vsh_z, Vsh_t;
+  extern COMM_RANK_LOCAL int faceVolume[4];
   
-  extern int Ls;
-  extern int V5;
-  extern int V5h;
+  extern COMM_RANK_LOCAL int Ls;
+  extern COMM_RANK_LOCAL int V5;
+  extern COMM_RANK_LOCAL int V5h;
   
-  extern int mySpinorSiteSize;
+  extern COMM_RANK_LOCAL int mySpinorSiteSize;
 
   void setDims(int *X);
   void dw_setDims(int *X, const int L5);
@@ -42,6 +43,10 @@ extern "C" {
   int getOddBit(int X);
 
   void construct_gauge_field(void **gauge, int type, QudaPrecision precision, QudaGaugeParam *param);
+  // version of the host links, to be bumped by code that writes them
+  // (the reference operators keep their ghost links until it changes)
+  void markHostGaugeModified();
+  int hostGaugeVersion();
     void construct_fat_long_gauge_field(void **fatlink, void** longlink, int type, QudaPrecision precision, QudaGaugeParam*);
     void construct_clover_field(void *clover, double norm, double diag, QudaPrecision precision);
   void construct_spinor_field(void *spinor, int type, int i0, int s0, int c0, QudaPrecision precision);
@@ -28,11 +28,11 @@ extern void usage(char** argv);
 static int verify_results = 0;
 
 extern int device;
-int Z[4];
-int V;
-int Vh;
-int Vs[4];
-int Vsh[4];
+COMM_RANK_LOCAL int Z[4];
+COMM_RANK_LOCAL int V;
+COMM_RANK_LOCAL int Vh;
+COMM_RANK_LOCAL int Vs[4];
+COMM_RANK_LOCAL int Vsh[4];
 
 static int V_ex;
 static int Vh_ex;
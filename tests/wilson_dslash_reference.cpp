@@ -11,9 +11,40 @@
 #include <gauge_field.h>
 #include <color_spinor_field.h>
 #include <face_quda.h>
+#include <cpu_reconstruct.h>
 
 #include <dslash_util.h>
 
+// When set, the links passed to the reference operators are stored
+// with the reconstruction of this field and are expanded one link at
+// a time as they are used.
+static COMM_RANK_LOCAL const cpuGaugeField *cpuGauge = NULL;
+
+void setCpuGaugeField(const cpuGaugeField *field)
+{
+  cpuGauge = field;
+}
+
+static inline int gaugeLinkSiteSize()
+{
+  return cpuGauge ? cpuGauge->Reconstruct() : gaugeSiteSize;
+}
+
+// the full link used at site i in direction dir, where lnk points to its stored form
+template <typename gFloat>
+static inline gFloat* fullLink(gFloat *tmp, gFloat *lnk, int i, int dir, int oddBit)
+{
+  if (gaugeLinkSiteSize() == gaugeSiteSize) return lnk;
+
+  // backward links live on the neighbouring site
+  int Y = fullLatticeIndex(i, oddBit);
+  int x[4] = {Y % Z[0], (Y/Z[0]) % Z[1], (Y/(Z[1]*Z[0])) % Z[2], Y/(Z[2]*Z[1]*Z[0])};
+  if (dir % 2 == 1) x[dir/2] -= 1;
+
+  loadLink(tmp, lnk, cpuGauge->Reconstruct(), (gFloat)cpuGauge->LinkScale(dir/2, x));
+  return tmp;
+}
+
 static const double projector[8][4][4][2] = {
   {
     {{1,0}, {0,0}, {0,0}, {0,-1}},
@@ -106,12 +137,14 @@ void dslashReference(sFloat *res, gFloat **gaugeFull, sFloat *spinorField, int o
   gFloat *gaugeEven[4], *gaugeOdd[4];
   for (int dir = 0; dir < 4; dir++) {  
     gaugeEven[dir] = gaugeFull[dir];
-    gaugeOdd[dir]  = gaugeFull[dir]+Vh*gaugeSiteSize;
+    gaugeOdd[dir]  = gaugeFull[dir]+Vh*gaugeLinkSiteSize();
   }
   
   for (int i = 0; i < Vh; i++) {
     for (int dir = 0; dir < 8; dir++) {
-      gFloat *gauge = gaugeLink(i, dir, oddBit, gaugeEven, gaugeOdd, 1);
+      gFloat tmp[gaugeSiteSize];
+      gFloat *gauge = fullLink(tmp, gaugeLink(i, dir, oddBit, gaugeEven, gaugeOdd, 1, gaugeLinkSiteSize()),
+			       i, dir, oddBit);
       sFloat *spinor = spinorNeighbor(i, dir, oddBit, spinorField, 1);
       
       sFloat projectedSpinor[4*3*2], gaugedSpinor[4*3*2];
@@ -139,16 +172,18 @@ void dslashReference(sFloat *res, gFloat **gaugeFull,  gFloat **ghostGauge, sFlo
   gFloat *ghostGaugeEven[4], *ghostGaugeOdd[4];
   for (int dir = 0; dir < 4; dir++) {  
     gaugeEven[dir] = gaugeFull[dir];
-    gaugeOdd[dir]  = gaugeFull[dir]+Vh*gaugeSiteSize;
+    gaugeOdd[dir]  = gaugeFull[dir]+Vh*gaugeLinkSiteSize();
 
     ghostGaugeEven[dir] = ghostGauge[dir];
-    ghostGaugeOdd[dir] = ghostGauge[dir] + (faceVolume[dir]/2)*gaugeSiteSize;
+    ghostGaugeOdd[dir] = ghostGauge[dir] + (faceVolume[dir]/2)*gaugeLinkSiteSize();
   }
   
   for (int i = 0; i < Vh; i++) {
 
     for (int dir = 0; dir < 8; dir++) {
-      gFloat *gauge = gaugeLink_mg4dir(i, dir, oddBit, gaugeEven, gaugeOdd, ghostGaugeEven, ghostGaugeOdd, 1, 1);
+      gFloat tmp[gaugeSiteSize];
+      gFloat *gauge = fullLink(tmp, gaugeLink_mg4dir(i, dir, oddBit, gaugeEven, gaugeOdd, ghostGaugeEven,
+						     ghostGaugeOdd, 1, 1, gaugeLinkSiteSize()), i, dir, oddBit);
       sFloat *spinor = spinorNeighbor_mg4dir(i, dir, oddBit, spinorField, fwdSpinor, backSpinor, 1, 1);
       
       sFloat projectedSpinor[mySpinorSiteSize], gaugedSpinor[mySpinorSiteSize];
@@ -168,6 +203,41 @@ void dslashReference(sFloat *res, gFloat **gaugeFull,  gFloat **ghostGauge, sFlo
 
 #endif
 
+#ifdef MULTI_GPU
+
+// The cpuGaugeField wrapping the reference links, with its send
+// buffers, packing tables and ghost zone, is kept between calls as long
+// as the same arrays are passed in with the same layout.  The wrapper
+// is marked modified, and the ghost zone exchanged again, only when
+// the host links have changed since (see markHostGaugeModified()).
+void** wil_ghost_gauge(void **gauge, QudaGaugeParam &gauge_param) {
+  static COMM_RANK_LOCAL cpuGaugeField *cpu = NULL;
+  static COMM_RANK_LOCAL void *gauge_p[4];
+  static COMM_RANK_LOCAL QudaGaugeParam param_p;
+  static COMM_RANK_LOCAL int version_p;
+
+  bool same = (cpu != NULL && param_p.cpu_prec == gauge_param.cpu_prec &&
+	       param_p.gauge_order == gauge_param.gauge_order);
+  for (int d=0; d<4; d++) if (gauge_p[d] != gauge[d] || param_p.X[d] != gauge_param.X[d]) same = false;
+
+  if (!same) {
+    delete cpu;
+    GaugeFieldParam gauge_field_param(gauge, gauge_param);
+    cpu = new cpuGaugeField(gauge_field_param);
+    for (int d=0; d<4; d++) gauge_p[d] = gauge[d];
+    param_p = gauge_param;
+    version_p = hostGaugeVersion();
+  } else if (version_p != hostGaugeVersion()) {
+    cpu->markModified();
+    version_p = hostGaugeVersion();
+  }
+
+  cpu->exchangeGhost(); // returns at once if the links are unchanged
+  return (void**)cpu->Ghost();
+}
+
+#endif
+
 // this actually applies the preconditioned dslash, e.g., D_ee^{-1} D_eo or D_oo^{-1} D_oe
 void wil_dslash(void *out, void **gauge, void *in, int oddBit, int daggerBit,
 		QudaPrecision precision, QudaGaugeParam &gauge_param) {
@@ -179,10 +249,13 @@ void wil_dslash(void *out, void **gauge, void *in, int oddBit, int daggerBit,
     dslashReference((float*)out, (float**)gauge, (float*)in, oddBit, daggerBit);
 #else
 
-  GaugeFieldParam gauge_field_param(gauge, gauge_param);
-  cpuGaugeField cpu(gauge_field_param);
-  cpu.exchangeGhost();
-  void **ghostGauge = (void**)cpu.Ghost();
+  void **ghostGauge;
+  if (cpuGauge) { // the compressed links carry their own ghost zone
+    cpuGauge->exchangeGhost();
+    ghostGauge = (void**)cpuGauge->Ghost();
+  } else {
+    ghostGauge = wil_ghost_gauge(gauge, gauge_param);
+  }
 
   // Get spinor ghost fields
   // First wrap the input spinor into a ColorSpinorField
@@ -4,10 +4,17 @@
 #include <enum_quda.h>
 #include <quda.h>
 
+// links stored with 12 or 8 reconstruction (NULL for full links)
+class cpuGaugeField;
+void setCpuGaugeField(const cpuGaugeField *field);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+  // ghost zone of the reference gauge field (multi-GPU only)
+  void** wil_ghost_gauge(void **gauge, QudaGaugeParam &param);
+
   void wil_dslash(void *res, void **gauge, void *spinorField, int oddBit,
 		  int daggerBit, QudaPrecision precision, QudaGaugeParam &param);
   